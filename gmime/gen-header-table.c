@@ -0,0 +1,201 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/* The well-known header fields that get a compile-time GMimeHeaderId.
+ * New entries may be added anywhere; the ids are just their index
+ * (plus one, since 0 is GMIME_HEADER_ID_UNKNOWN). There must be fewer
+ * than 64 of them so that a set of ids fits in a 64-bit mask. */
+static const char *headers[] = {
+	"Return-Path",
+	"Received",
+	"Date",
+	"From",
+	"Sender",
+	"Reply-To",
+	"To",
+	"Cc",
+	"Bcc",
+	"Message-Id",
+	"In-Reply-To",
+	"References",
+	"Subject",
+	"Comments",
+	"Keywords",
+	"Resent-Date",
+	"Resent-From",
+	"Resent-Sender",
+	"Resent-Reply-To",
+	"Resent-To",
+	"Resent-Cc",
+	"Resent-Bcc",
+	"Resent-Message-Id",
+	"MIME-Version",
+	"Content-Type",
+	"Content-Transfer-Encoding",
+	"Content-Disposition",
+	"Content-Description",
+	"Content-Id",
+	"Content-Location",
+	"Content-Md5",
+	"Content-Base",
+	"Content-Language",
+	"Content-Length",
+	"Disposition-Notification-To",
+	"Newsgroups",
+	"Followup-To",
+	"Organization",
+	"List-Id",
+	"List-Unsubscribe",
+	"Delivered-To",
+	"Authentication-Results",
+	"DKIM-Signature",
+	"ARC-Seal",
+	"ARC-Message-Signature",
+	"ARC-Authentication-Results",
+	"Autocrypt",
+	"Autocrypt-Gossip",
+	"X-Mailer",
+};
+
+#define N_HEADERS (sizeof (headers) / sizeof (headers[0]))
+
+#define MIN_BITS 6
+#define MAX_BITS 10
+
+/* must match header_id_hash() in gmime-header.c */
+static unsigned int
+header_hash (const char *name)
+{
+	unsigned int h = 0;
+	
+	while (*name != '\0') {
+		h = (h << 5) - h + (unsigned char) tolower ((unsigned char) *name);
+		name++;
+	}
+	
+	return h;
+}
+
+static int
+try_table (unsigned char *slots, unsigned int bits, unsigned int mult)
+{
+	unsigned int i, slot;
+	
+	memset (slots, 0, 1 << bits);
+	
+	for (i = 0; i < N_HEADERS; i++) {
+		slot = (header_hash (headers[i]) * mult) >> (32 - bits);
+		if (slots[slot] != 0)
+			return 0;
+		
+		slots[slot] = i + 1;
+	}
+	
+	return 1;
+}
+
+static void
+print_id (const char *name)
+{
+	printf ("\tGMIME_HEADER_ID_");
+	
+	while (*name != '\0') {
+		putchar (*name == '-' ? '_' : toupper ((unsigned char) *name));
+		name++;
+	}
+	
+	printf (",\n");
+}
+
+int main (int argc, char **argv)
+{
+	unsigned char slots[1 << MAX_BITS];
+	unsigned int bits, mult = 0;
+	unsigned int i, k;
+	int found = 0;
+	
+	if (N_HEADERS >= 64) {
+		fprintf (stderr, "too many headers: %u\n", (unsigned int) N_HEADERS);
+		return 1;
+	}
+	
+	/* find the smallest multiplicative hash that maps every header
+	 * to a slot of its own */
+	for (bits = MIN_BITS; bits <= MAX_BITS && !found; bits++) {
+		for (k = 0; k < 100000 && !found; k++) {
+			mult = 0x9e3779b1 + 2 * k;
+			found = try_table (slots, bits, mult);
+		}
+	}
+	
+	if (!found) {
+		fprintf (stderr, "failed to find a perfect hash\n");
+		return 1;
+	}
+	
+	bits--;
+	
+	printf ("/* THIS FILE IS AUTOGENERATED: DO NOT EDIT! */\n\n");
+	printf ("/*\n * To regenerate:\n * make gen-header-table\n");
+	printf (" * ./gen-header-table > gmime-header-table-private.h\n */\n\n");
+	
+	printf ("#ifndef __GMIME_HEADER_TABLE_PRIVATE_H__\n");
+	printf ("#define __GMIME_HEADER_TABLE_PRIVATE_H__\n\n");
+	
+	/* print out the enum */
+	printf ("typedef enum {\n");
+	printf ("\tGMIME_HEADER_ID_UNKNOWN,\n");
+	for (i = 0; i < N_HEADERS; i++)
+		print_id (headers[i]);
+	printf ("\tGMIME_HEADER_ID_LAST\n");
+	printf ("} GMimeHeaderId;\n\n");
+	
+	printf ("#define GMIME_HEADER_ID_HASH_BITS %u\n", bits);
+	printf ("#define GMIME_HEADER_ID_HASH_MULT 0x%08xU\n\n", mult);
+	
+	/* the tables are only needed by gmime-header.c */
+	printf ("#ifdef GMIME_HEADER_TABLE_DATA\n\n");
+	
+	/* print out the names */
+	printf ("static const char *gmime_header_names[GMIME_HEADER_ID_LAST] = {\n");
+	printf ("\tNULL,\n");
+	for (i = 0; i < N_HEADERS; i++)
+		printf ("\t\"%s\",\n", headers[i]);
+	printf ("};\n\n");
+	
+	/* print out the slots */
+	printf ("static const unsigned char gmime_header_id_slots[1 << GMIME_HEADER_ID_HASH_BITS] = {");
+	for (i = 0; i < (1U << bits); i++) {
+		printf ("%s%2u%s", (i % 16) ? " " : "\n\t",
+			slots[i], i != (1U << bits) - 1 ? "," : "\n");
+	}
+	printf ("};\n\n");
+	
+	printf ("#endif /* GMIME_HEADER_TABLE_DATA */\n\n");
+	
+	printf ("#endif /* __GMIME_HEADER_TABLE_PRIVATE_H__ */\n");
+	
+	return 0;
+}
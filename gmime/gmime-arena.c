@@ -0,0 +1,230 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+#include "gmime-arena.h"
+
+
+/* A GMimeArena hands out strings carved from a small number of large
+ * blocks. Nothing allocated from an arena is ever freed individually;
+ * the blocks are all released at once when the last reference to the
+ * arena is dropped.
+ *
+ * An arena may only be allocated from by one thread at a time, but
+ * references may be added and dropped from any thread. */
+
+/* the first block is sized to hold a typical message header; each
+ * block after that is twice as large up to ARENA_BLOCK_MAX */
+#define ARENA_BLOCK_MIN 4096
+#define ARENA_BLOCK_MAX (64 * 1024)
+
+typedef struct _ArenaBlock {
+	struct _ArenaBlock *next;
+	size_t size, used;
+	char data[1];
+} ArenaBlock;
+
+struct _GMimeArena {
+	volatile int ref_count;
+	ArenaBlock *blocks;
+	size_t next_size;
+};
+
+static ArenaBlock *
+arena_block_new (size_t size)
+{
+	ArenaBlock *block;
+	
+	block = g_malloc (offsetof (ArenaBlock, data) + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	
+	return block;
+}
+
+
+/**
+ * g_mime_arena_new:
+ *
+ * Creates a new #GMimeArena with a reference count of 1.
+ *
+ * Returns: a new #GMimeArena.
+ **/
+GMimeArena *
+g_mime_arena_new (void)
+{
+	GMimeArena *arena;
+	
+	arena = g_slice_new (GMimeArena);
+	arena->next_size = ARENA_BLOCK_MIN;
+	arena->blocks = NULL;
+	arena->ref_count = 1;
+	
+	return arena;
+}
+
+
+/**
+ * g_mime_arena_ref:
+ * @arena: a #GMimeArena
+ *
+ * Adds a reference to @arena.
+ *
+ * Returns: @arena.
+ **/
+GMimeArena *
+g_mime_arena_ref (GMimeArena *arena)
+{
+	g_atomic_int_inc (&arena->ref_count);
+	
+	return arena;
+}
+
+
+/**
+ * g_mime_arena_unref:
+ * @arena: a #GMimeArena
+ *
+ * Drops a reference to @arena. When the last reference is dropped,
+ * every string that was allocated from @arena is freed.
+ **/
+void
+g_mime_arena_unref (GMimeArena *arena)
+{
+	ArenaBlock *block, *next;
+	
+	if (!g_atomic_int_dec_and_test (&arena->ref_count))
+		return;
+	
+	block = arena->blocks;
+	while (block != NULL) {
+		next = block->next;
+		g_free (block);
+		block = next;
+	}
+	
+	g_slice_free (GMimeArena, arena);
+}
+
+static char *
+arena_alloc (GMimeArena *arena, size_t size)
+{
+	ArenaBlock *block = arena->blocks;
+	char *mem;
+	
+	if (block == NULL || block->size - block->used < size) {
+		if (size > arena->next_size / 2) {
+			/* large strings get a block of their own so that the
+			 * unused tail of the current block is not wasted */
+			block = arena_block_new (size);
+			
+			if (arena->blocks != NULL) {
+				block->next = arena->blocks->next;
+				arena->blocks->next = block;
+			} else {
+				arena->blocks = block;
+			}
+		} else {
+			block = arena_block_new (arena->next_size);
+			block->next = arena->blocks;
+			arena->blocks = block;
+			
+			if (arena->next_size < ARENA_BLOCK_MAX)
+				arena->next_size *= 2;
+		}
+	}
+	
+	mem = block->data + block->used;
+	block->used += size;
+	
+	return mem;
+}
+
+
+/**
+ * g_mime_arena_strndup:
+ * @arena: a #GMimeArena
+ * @str: the string to copy
+ * @n: the number of bytes of @str to copy
+ *
+ * Copies the first @n bytes of @str into @arena and nul-terminates
+ * the result.
+ *
+ * Returns: the copy of @str, owned by @arena.
+ **/
+char *
+g_mime_arena_strndup (GMimeArena *arena, const char *str, size_t n)
+{
+	char *dup;
+	
+	dup = arena_alloc (arena, n + 1);
+	memcpy (dup, str, n);
+	dup[n] = '\0';
+	
+	return dup;
+}
+
+
+/**
+ * g_mime_arena_strdup:
+ * @arena: a #GMimeArena
+ * @str: the string to copy
+ *
+ * Copies @str into @arena.
+ *
+ * Returns: the copy of @str, owned by @arena.
+ **/
+char *
+g_mime_arena_strdup (GMimeArena *arena, const char *str)
+{
+	return g_mime_arena_strndup (arena, str, strlen (str));
+}
+
+
+/**
+ * g_mime_arena_contains:
+ * @arena: a #GMimeArena
+ * @ptr: a pointer
+ *
+ * Checks whether @ptr points into memory owned by @arena.
+ *
+ * Returns: %TRUE if @ptr was allocated from @arena or %FALSE otherwise.
+ **/
+gboolean
+g_mime_arena_contains (GMimeArena *arena, const void *ptr)
+{
+	const char *inptr = ptr;
+	ArenaBlock *block;
+	
+	for (block = arena->blocks; block != NULL; block = block->next) {
+		if (inptr >= block->data && inptr < block->data + block->used)
+			return TRUE;
+	}
+	
+	return FALSE;
+}
@@ -44,6 +44,8 @@
 #include "gmime-table-private.h"
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-common.h"
+#include "gmime-internal.h"
 
 #ifdef HAVE_ICONV_DETECT_H
 #include "iconv-detect.h"
@@ -137,6 +139,21 @@ static struct {
 	{ NULL,              NULL         }
 };
 
+/* charsets that are common enough that g_mime_charset_map_init()
+ * looks up their iconv names ahead of time */
+static const char *common_charsets[] = {
+	"us-ascii",
+	"iso-8859-1", "iso-8859-2", "iso-8859-3", "iso-8859-4",
+	"iso-8859-5", "iso-8859-6", "iso-8859-7", "iso-8859-8",
+	"iso-8859-9", "iso-8859-10", "iso-8859-13", "iso-8859-14",
+	"iso-8859-15", "iso-8859-16",
+	"windows-1250", "windows-1251", "windows-1252", "windows-1253",
+	"windows-1254", "windows-1255", "windows-1256", "windows-1257",
+	"windows-1258",
+	"iso-2022-jp", "shift_jis", "euc-jp", "euc-kr", "big5",
+	"koi8-r", "koi8-u"
+};
+
 static const char *shiftjis_aliases[] = {
 	"shift-jis", "shift_jis", "sjis", "shift_jis-2004", "shift_jisx0213",
 	"jisx0208.1983-0", "jisx0212.1990-0", "pck", NULL
@@ -166,7 +183,12 @@ static struct {
 	{ "koi8-u",        "uk" }
 };
 
+/* iconv_charsets is filled in by g_mime_charset_map_init() and is
+ * read-only from then on, which means it can be searched without
+ * taking the lock. The iconv names of any other charsets are cached
+ * in extra_charsets, which is protected by the lock. */
 static GHashTable *iconv_charsets = NULL;
+static GHashTable *extra_charsets = NULL;
 static char *locale_charset = NULL;
 static char *locale_lang = NULL;
 static int initialized = 0;
@@ -180,6 +202,8 @@ static GMutex lock;
 #define CHARSET_LOCK()
 #endif /* G_THREADS_ENABLED */
 
+static char *charset_iconv_name (const char *name, const char *charset);
+
 
 /**
  * g_mime_charset_map_shutdown:
@@ -203,6 +227,9 @@ g_mime_charset_map_shutdown (void)
 	}
 #endif
 	
+	g_hash_table_destroy (extra_charsets);
+	extra_charsets = NULL;
+	
 	g_hash_table_destroy (iconv_charsets);
 	iconv_charsets = NULL;
 	
@@ -288,6 +315,16 @@ g_mime_charset_map_init (void)
 		g_hash_table_insert (iconv_charsets, charset, iconv_name);
 	}
 	
+	for (i = 0; i < G_N_ELEMENTS (common_charsets); i++) {
+		if (g_hash_table_lookup (iconv_charsets, common_charsets[i]))
+			continue;
+		
+		iconv_name = charset_iconv_name (common_charsets[i], common_charsets[i]);
+		g_hash_table_insert (iconv_charsets, g_strdup (common_charsets[i]), iconv_name);
+	}
+	
+	extra_charsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	
 #ifndef WIN32
 #ifdef HAVE_CODESET
 	if ((locale_charset = nl_langinfo (CODESET)) && locale_charset[0]) {
@@ -438,33 +475,12 @@ strdown (char *str)
 	return str;
 }
 
-/**
- * g_mime_charset_iconv_name:
- * @charset: charset name
- *
- * Attempts to find an iconv-friendly charset name for @charset.
- *
- * Returns: an iconv-friendly charset name for @charset.
- **/
-const char *
-g_mime_charset_iconv_name (const char *charset)
+/* Computes the iconv name of @charset, given its lowercase form @name */
+static char *
+charset_iconv_name (const char *name, const char *charset)
 {
-	char *name, *iconv_name, *buf;
-	
-	if (charset == NULL)
-		return NULL;
-	
-	name = g_alloca (strlen (charset) + 1);
-	strcpy (name, charset);
-	strdown (name);
-	
-	CHARSET_LOCK ();
-	
-	iconv_name = g_hash_table_lookup (iconv_charsets, name);
-	if (iconv_name) {
-		CHARSET_UNLOCK ();
-		return iconv_name;
-	}
+	const char *buf;
+	char *iconv_name;
 	
 	if (!strncmp (name, "iso", 3)) {
 		int iso, codepage;
@@ -523,7 +539,40 @@ g_mime_charset_iconv_name (const char *charset)
 		iconv_name = g_strdup (charset);
 	}
 	
-	g_hash_table_insert (iconv_charsets, g_strdup (name), iconv_name);
+	return iconv_name;
+}
+
+/**
+ * g_mime_charset_iconv_name:
+ * @charset: charset name
+ *
+ * Attempts to find an iconv-friendly charset name for @charset.
+ *
+ * Note: This function is thread-safe.
+ *
+ * Returns: an iconv-friendly charset name for @charset.
+ **/
+const char *
+g_mime_charset_iconv_name (const char *charset)
+{
+	char *name, *iconv_name;
+	
+	if (charset == NULL)
+		return NULL;
+	
+	name = g_alloca (strlen (charset) + 1);
+	strcpy (name, charset);
+	strdown (name);
+	
+	if ((iconv_name = g_hash_table_lookup (iconv_charsets, name)))
+		return iconv_name;
+	
+	CHARSET_LOCK ();
+	
+	if (!(iconv_name = g_hash_table_lookup (extra_charsets, name))) {
+		iconv_name = charset_iconv_name (name, charset);
+		g_hash_table_insert (extra_charsets, g_strdup (name), iconv_name);
+	}
 	
 	CHARSET_UNLOCK ();
 	
@@ -903,7 +952,7 @@ g_mime_charset_can_encode (GMimeCharset *mask, const char *charset, const char *
 	}
 	
 	/* down to the nitty gritty slow and painful way... */
-	if ((cd = g_mime_iconv_open (charset, "UTF-8")) == (iconv_t) -1)
+	if ((cd = _g_mime_iconv_open (charset, "UTF-8")) == (iconv_t) -1)
 		return FALSE;
 	
 	inleft = len;
@@ -926,7 +975,279 @@ g_mime_charset_can_encode (GMimeCharset *mask, const char *charset, const char *
 		rc = iconv (cd, NULL, NULL, &outbuf, &outleft);
 	}
 	
-	g_mime_iconv_close (cd);
+	_g_mime_iconv_close (cd);
 	
 	return rc != (size_t) -1;
 }
+
+
+/* Built-in decoders for the most common charsets.
+ *
+ * The vast majority of mail is in one of a handful of charsets, so
+ * rather than going through iconv for those, they are converted to
+ * UTF-8 directly: runs of ASCII are located with a vectorized scan
+ * and copied verbatim, the high half of the single-byte charsets is
+ * mapped through a table and UTF-8 is validated and passed through.
+ * Invalid input is treated the same way that the iconv code paths
+ * treat EILSEQ: each invalid byte is replaced (or dropped) and
+ * counted. */
+
+/* the Unicode code points for 0x80-0xff (0 means that the byte is undefined) */
+static const guint16 latin1_table[128] = {
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+	0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+	0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+	0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+	0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+	0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+	0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+	0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+	0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+	0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+	0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+	0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+	0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+	0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+};
+
+static const guint16 latin9_table[128] = {
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+	0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+	0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+	0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7,
+	0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7,
+	0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+	0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+	0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+	0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+	0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+	0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+	0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+	0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+	0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+};
+
+static const guint16 cp1252_table[128] = {
+	0x20ac, 0x0000, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017d, 0x0000,
+	0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x0000, 0x017e, 0x0178,
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+	0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+	0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+	0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+	0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+	0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+	0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+	0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+	0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+	0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+	0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+};
+
+/**
+ * _g_mime_charset_get_utf8_decoder:
+ * @charset: charset name
+ *
+ * Gets the built-in decoder that converts text in @charset to UTF-8.
+ *
+ * Returns: the built-in decoder for @charset or
+ * %GMIME_CHARSET_DECODER_NONE if iconv must be used instead.
+ **/
+GMimeCharsetDecoder
+_g_mime_charset_get_utf8_decoder (const char *charset)
+{
+	const char *canon;
+	
+	if (charset == NULL)
+		return GMIME_CHARSET_DECODER_NONE;
+	
+	canon = g_mime_charset_canon_name (charset);
+	
+	if (!g_ascii_strcasecmp (canon, "utf-8") || !g_ascii_strcasecmp (canon, "utf8"))
+		return GMIME_CHARSET_DECODER_UTF8;
+	
+	if (!g_ascii_strcasecmp (canon, "us-ascii") || !g_ascii_strcasecmp (canon, "ascii"))
+		return GMIME_CHARSET_DECODER_ASCII;
+	
+	if (!g_ascii_strcasecmp (canon, "iso-8859-1") || !g_ascii_strcasecmp (canon, "latin1"))
+		return GMIME_CHARSET_DECODER_LATIN1;
+	
+	if (!g_ascii_strcasecmp (canon, "iso-8859-15") || !g_ascii_strcasecmp (canon, "latin9"))
+		return GMIME_CHARSET_DECODER_LATIN9;
+	
+	if (!g_ascii_strcasecmp (canon, "windows-cp1252") || !g_ascii_strcasecmp (canon, "cp1252"))
+		return GMIME_CHARSET_DECODER_CP1252;
+	
+	return GMIME_CHARSET_DECODER_NONE;
+}
+
+/* Returns the length of the UTF-8 sequence at @inptr, 0 if it is
+ * invalid or -1 if it is a valid prefix that is truncated by @inend.
+ * Overlong forms, surrogates and code points above U+10FFFF are all
+ * rejected. */
+static int
+utf8_sequence_length (const unsigned char *inptr, const unsigned char *inend)
+{
+	unsigned char lo = 0x80, hi = 0xbf;
+	unsigned char c = *inptr;
+	int len, i;
+	
+	if (c >= 0xc2 && c <= 0xdf) {
+		len = 2;
+	} else if (c >= 0xe0 && c <= 0xef) {
+		if (c == 0xe0)
+			lo = 0xa0;
+		else if (c == 0xed)
+			hi = 0x9f;
+		len = 3;
+	} else if (c >= 0xf0 && c <= 0xf4) {
+		if (c == 0xf0)
+			lo = 0x90;
+		else if (c == 0xf4)
+			hi = 0x8f;
+		len = 4;
+	} else {
+		return 0;
+	}
+	
+	for (i = 1; i < len; i++) {
+		if (inptr + i >= inend)
+			return -1;
+		
+		if (inptr[i] < lo || inptr[i] > hi)
+			return 0;
+		
+		lo = 0x80;
+		hi = 0xbf;
+	}
+	
+	return len;
+}
+
+/**
+ * _g_mime_utf8_validate:
+ * @inbuf: input buffer
+ * @inlen: length of the input buffer
+ * @incomplete: (out) (optional): whether the input ends with a truncated sequence
+ *
+ * Finds the length of the longest prefix of @inbuf that is valid UTF-8.
+ *
+ * Returns: the number of bytes at the start of @inbuf that are valid
+ * UTF-8. If this is less than @inlen, @incomplete is set to %TRUE if
+ * the remainder of the input is the start of a valid sequence that is
+ * merely truncated.
+ **/
+size_t
+_g_mime_utf8_validate (const char *inbuf, size_t inlen, gboolean *incomplete)
+{
+	const unsigned char *inend = (const unsigned char *) inbuf + inlen;
+	const unsigned char *inptr = (const unsigned char *) inbuf;
+	int n = 0;
+	
+	while (inptr < inend) {
+		inptr = (const unsigned char *) g_mime_scan_non_ascii ((const char *) inptr, (const char *) inend);
+		if (inptr == inend)
+			break;
+		
+		if ((n = utf8_sequence_length (inptr, inend)) <= 0)
+			break;
+		
+		inptr += n;
+	}
+	
+	if (incomplete)
+		*incomplete = inptr < inend && n == -1;
+	
+	return (size_t) (inptr - (const unsigned char *) inbuf);
+}
+
+/**
+ * _g_mime_charset_decode_to_utf8:
+ * @decoder: a built-in decoder
+ * @inbuf: input buffer
+ * @inlen: length of the input buffer
+ * @outbuf: output buffer (must be at least 3 times @inlen bytes)
+ * @replace: the character to replace invalid bytes with or -1 to drop them
+ * @flush: %TRUE if this is the end of the input
+ * @nread: (out): the number of input bytes consumed
+ * @ninval: (out): the number of invalid input bytes
+ *
+ * Converts @inbuf to UTF-8 using the built-in @decoder. Unless @flush
+ * is %TRUE, a truncated UTF-8 sequence at the end of the input is not
+ * consumed so that it can be completed by the next block of input.
+ *
+ * Returns: the number of bytes written to @outbuf.
+ **/
+size_t
+_g_mime_charset_decode_to_utf8 (GMimeCharsetDecoder decoder, const char *inbuf, size_t inlen, char *outbuf,
+				int replace, gboolean flush, size_t *nread, size_t *ninval)
+{
+	const unsigned char *inend = (const unsigned char *) inbuf + inlen;
+	const unsigned char *inptr = (const unsigned char *) inbuf;
+	const unsigned char *start;
+	const guint16 *table;
+	char *outptr = outbuf;
+	size_t n = 0;
+	guint16 c;
+	int len;
+	
+	switch (decoder) {
+	case GMIME_CHARSET_DECODER_LATIN1: table = latin1_table; break;
+	case GMIME_CHARSET_DECODER_LATIN9: table = latin9_table; break;
+	case GMIME_CHARSET_DECODER_CP1252: table = cp1252_table; break;
+	default: table = NULL; break;
+	}
+	
+	while (inptr < inend) {
+		start = inptr;
+		
+		if (decoder == GMIME_CHARSET_DECODER_UTF8)
+			inptr += _g_mime_utf8_validate ((const char *) inptr, (size_t) (inend - inptr), NULL);
+		else
+			inptr = (const unsigned char *) g_mime_scan_non_ascii ((const char *) inptr, (const char *) inend);
+		
+		memcpy (outptr, start, (size_t) (inptr - start));
+		outptr += inptr - start;
+		
+		if (inptr == inend)
+			break;
+		
+		if (table != NULL && (c = table[*inptr - 0x80]) != 0) {
+			if (c < 0x800) {
+				*outptr++ = (char) (0xc0 | (c >> 6));
+			} else {
+				*outptr++ = (char) (0xe0 | (c >> 12));
+				*outptr++ = (char) (0x80 | ((c >> 6) & 0x3f));
+			}
+			
+			*outptr++ = (char) (0x80 | (c & 0x3f));
+			inptr++;
+			continue;
+		}
+		
+		if (decoder == GMIME_CHARSET_DECODER_UTF8) {
+			len = utf8_sequence_length (inptr, inend);
+			
+			/* save the truncated sequence for the next block of input */
+			if (len == -1 && !flush)
+				break;
+		}
+		
+		if (replace != -1)
+			*outptr++ = (char) replace;
+		
+		inptr++;
+		n++;
+	}
+	
+	*nread = (size_t) (inptr - (const unsigned char *) inbuf);
+	*ninval = n;
+	
+	return (size_t) (outptr - outbuf);
+}
@@ -30,6 +30,10 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "gmime-table-private.h"
 #include "gmime-common.h"
 
@@ -122,3 +126,226 @@ g_mime_strdup_trim (const char *str)
 	
 	return g_strndup (start, (size_t) (end - start));
 }
+
+
+/**
+ * g_mime_simd_get_features:
+ *
+ * Gets the set of SIMD instruction set extensions supported by the
+ * CPU that GMime has optimized code paths for. The features are
+ * detected once and cached.
+ *
+ * Returns: a bitmask of #GMimeSimdFeatures.
+ **/
+guint
+g_mime_simd_get_features (void)
+{
+	static gsize features = 0;
+	
+	if (g_once_init_enter (&features)) {
+		gsize detected = GMIME_SIMD_DETECTED;
+		
+#ifdef HAVE_X86_SIMD
+		__builtin_cpu_init ();
+		
+		if (__builtin_cpu_supports ("sse2"))
+			detected |= GMIME_SIMD_SSE2;
+		if (__builtin_cpu_supports ("ssse3"))
+			detected |= GMIME_SIMD_SSSE3;
+		if (__builtin_cpu_supports ("sse4.1"))
+			detected |= GMIME_SIMD_SSE4_1;
+		if (__builtin_cpu_supports ("avx2"))
+			detected |= GMIME_SIMD_AVX2;
+#endif
+		
+		g_once_init_leave (&features, detected);
+	}
+	
+	return (guint) features;
+}
+
+static const char *
+scan_line_starts_scalar (const char *inptr, const char *inend, char c1, char c2)
+{
+	while (inptr < inend) {
+		if (!(inptr = memchr (inptr, '\n', (size_t) (inend - inptr))))
+			return inend;
+		
+		if (inptr[1] == c1 || inptr[1] == c2)
+			return inptr;
+		
+		inptr++;
+	}
+	
+	return inend;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static const char *
+scan_line_starts_sse2 (const char *inptr, const char *inend, char c1, char c2)
+{
+	const __m128i lf = _mm_set1_epi8 ('\n');
+	const __m128i v1 = _mm_set1_epi8 (c1);
+	const __m128i v2 = _mm_set1_epi8 (c2);
+	__m128i cur, next, hit;
+	int mask;
+	
+	/* Note: the unaligned load at inptr + 1 reads at most up to and
+	 * including *inend, which the caller guarantees is readable. */
+	while (inend - inptr >= 16) {
+		cur = _mm_loadu_si128 ((const __m128i *) inptr);
+		next = _mm_loadu_si128 ((const __m128i *) (inptr + 1));
+		hit = _mm_or_si128 (_mm_cmpeq_epi8 (next, v1), _mm_cmpeq_epi8 (next, v2));
+		hit = _mm_and_si128 (_mm_cmpeq_epi8 (cur, lf), hit);
+		
+		if ((mask = _mm_movemask_epi8 (hit)) != 0)
+			return inptr + __builtin_ctz ((unsigned int) mask);
+		
+		inptr += 16;
+	}
+	
+	return scan_line_starts_scalar (inptr, inend, c1, c2);
+}
+
+__attribute__((target("avx2")))
+static const char *
+scan_line_starts_avx2 (const char *inptr, const char *inend, char c1, char c2)
+{
+	const __m256i lf = _mm256_set1_epi8 ('\n');
+	const __m256i v1 = _mm256_set1_epi8 (c1);
+	const __m256i v2 = _mm256_set1_epi8 (c2);
+	__m256i cur, next, hit;
+	unsigned int mask;
+	
+	while (inend - inptr >= 32) {
+		cur = _mm256_loadu_si256 ((const __m256i *) inptr);
+		next = _mm256_loadu_si256 ((const __m256i *) (inptr + 1));
+		hit = _mm256_or_si256 (_mm256_cmpeq_epi8 (next, v1), _mm256_cmpeq_epi8 (next, v2));
+		hit = _mm256_and_si256 (_mm256_cmpeq_epi8 (cur, lf), hit);
+		
+		if ((mask = (unsigned int) _mm256_movemask_epi8 (hit)) != 0)
+			return inptr + __builtin_ctz (mask);
+		
+		inptr += 32;
+	}
+	
+	return scan_line_starts_sse2 (inptr, inend, c1, c2);
+}
+#endif /* HAVE_X86_SIMD */
+
+
+static const char *
+scan_non_ascii_scalar (const char *inptr, const char *inend)
+{
+	guint64 word;
+	
+	/* check 8 bytes at a time */
+	while (inend - inptr >= (ptrdiff_t) sizeof (word)) {
+		memcpy (&word, inptr, sizeof (word));
+		if (word & G_GUINT64_CONSTANT (0x8080808080808080))
+			break;
+		
+		inptr += sizeof (word);
+	}
+	
+	while (inptr < inend && !(*inptr & 0x80))
+		inptr++;
+	
+	return inptr;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static const char *
+scan_non_ascii_sse2 (const char *inptr, const char *inend)
+{
+	int mask;
+	
+	while (inend - inptr >= 16) {
+		if ((mask = _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) inptr))) != 0)
+			return inptr + __builtin_ctz ((unsigned int) mask);
+		
+		inptr += 16;
+	}
+	
+	return scan_non_ascii_scalar (inptr, inend);
+}
+
+__attribute__((target("avx2")))
+static const char *
+scan_non_ascii_avx2 (const char *inptr, const char *inend)
+{
+	unsigned int mask;
+	
+	while (inend - inptr >= 32) {
+		if ((mask = (unsigned int) _mm256_movemask_epi8 (_mm256_loadu_si256 ((const __m256i *) inptr))) != 0)
+			return inptr + __builtin_ctz (mask);
+		
+		inptr += 32;
+	}
+	
+	return scan_non_ascii_sse2 (inptr, inend);
+}
+#endif /* HAVE_X86_SIMD */
+
+
+/**
+ * g_mime_scan_non_ascii:
+ * @inptr: the start of the buffer to scan
+ * @inend: the end of the buffer to scan
+ *
+ * Scans the buffer for the first byte that is not 7-bit ASCII.
+ *
+ * Returns: a pointer to the first byte with the high bit set or
+ * @inend if there is none.
+ **/
+const char *
+g_mime_scan_non_ascii (const char *inptr, const char *inend)
+{
+#ifdef HAVE_X86_SIMD
+	guint features = g_mime_simd_get_features ();
+	
+	if (features & GMIME_SIMD_AVX2)
+		return scan_non_ascii_avx2 (inptr, inend);
+	
+	if (features & GMIME_SIMD_SSE2)
+		return scan_non_ascii_sse2 (inptr, inend);
+#endif
+	
+	return scan_non_ascii_scalar (inptr, inend);
+}
+
+
+/**
+ * g_mime_scan_line_starts:
+ * @inptr: the start of the buffer to scan
+ * @inend: the end of the buffer to scan
+ * @c1: a character that a line of interest may start with
+ * @c2: another character that a line of interest may start with
+ *
+ * Scans the buffer for the first newline that is immediately followed
+ * by either @c1 or @c2 (i.e. the end of the line preceding a line
+ * that starts with @c1 or @c2).
+ *
+ * Note: the byte at @inend must be readable since the character
+ * following a newline at @inend - 1 is examined.
+ *
+ * Returns: a pointer to the matching newline or @inend if none was
+ * found.
+ **/
+const char *
+g_mime_scan_line_starts (const char *inptr, const char *inend, char c1, char c2)
+{
+#ifdef HAVE_X86_SIMD
+	guint features = g_mime_simd_get_features ();
+	
+	if (features & GMIME_SIMD_AVX2)
+		return scan_line_starts_avx2 (inptr, inend, c1, c2);
+	
+	if (features & GMIME_SIMD_SSE2)
+		return scan_line_starts_sse2 (inptr, inend, c1, c2);
+#endif
+	
+	return scan_line_starts_scalar (inptr, inend, c1, c2);
+}
@@ -30,6 +30,14 @@
 
 G_BEGIN_DECLS
 
+typedef enum {
+	GMIME_SIMD_DETECTED = 1 << 0,
+	GMIME_SIMD_SSE2     = 1 << 1,
+	GMIME_SIMD_SSSE3    = 1 << 2,
+	GMIME_SIMD_SSE4_1   = 1 << 3,
+	GMIME_SIMD_AVX2     = 1 << 4
+} GMimeSimdFeatures;
+
 G_GNUC_INTERNAL void g_mime_read_random_pool (unsigned char *buffer, size_t bytes);
 
 G_GNUC_INTERNAL int g_mime_strcase_equal (gconstpointer v, gconstpointer v2);
@@ -38,6 +46,12 @@ G_GNUC_INTERNAL guint g_mime_strcase_hash (gconstpointer key);
 
 G_GNUC_INTERNAL char *g_mime_strdup_trim (const char *str);
 
+G_GNUC_INTERNAL guint g_mime_simd_get_features (void);
+
+G_GNUC_INTERNAL const char *g_mime_scan_line_starts (const char *inptr, const char *inend, char c1, char c2);
+
+G_GNUC_INTERNAL const char *g_mime_scan_non_ascii (const char *inptr, const char *inend);
+
 G_END_DECLS
 
 #endif /* __GMIME_COMMON_H__ */
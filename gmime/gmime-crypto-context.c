@@ -76,7 +76,13 @@ static int crypto_export_keys (GMimeCryptoContext *ctx, const char *keys[],
 			       GMimeStream *ostream, GError **err);
 
 
+/* Lookups are lock-free; registration publishes a new copy of the
+ * table and retires the old one, which is freed once a registration
+ * finds no lookup in progress (see gmime-object.c). */
 static GHashTable *type_hash = NULL;
+static GPtrArray *retired_type_hashes = NULL;
+static GMutex type_hash_lock;
+static gint type_hash_readers = 0;
 
 static GObjectClass *parent_class = NULL;
 
@@ -101,6 +107,7 @@ g_mime_crypto_context_get_type (void)
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeCryptoContext", &info, 0);
 		
+		retired_type_hashes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_destroy);
 		type_hash = g_hash_table_new_full (g_mime_strcase_hash, g_mime_strcase_equal, g_free, NULL);
 	}
 	
@@ -146,6 +153,9 @@ g_mime_crypto_context_finalize (GObject *object)
 void
 g_mime_crypto_context_shutdown (void)
 {
+	g_ptr_array_free (retired_type_hashes, TRUE);
+	retired_type_hashes = NULL;
+	
 	g_hash_table_destroy (type_hash);
 	type_hash = NULL;
 }
@@ -157,14 +167,36 @@ g_mime_crypto_context_shutdown (void)
  * @callback: a #GMimeCryptoContextNewFunc
  *
  * Registers the callback for the specified @protocol.
+ *
+ * Note: This function is thread-safe.
  **/
 void
 g_mime_crypto_context_register (const char *protocol, GMimeCryptoContextNewFunc callback)
 {
+	GHashTableIter iter;
+	gpointer key, value;
+	GHashTable *hash;
+	
 	g_return_if_fail (protocol != NULL);
 	g_return_if_fail (callback != NULL);
 	
-	g_hash_table_replace (type_hash, g_strdup (protocol), callback);
+	g_mutex_lock (&type_hash_lock);
+	
+	hash = g_hash_table_new_full (g_mime_strcase_hash, g_mime_strcase_equal, g_free, NULL);
+	
+	g_hash_table_iter_init (&iter, type_hash);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_hash_table_insert (hash, g_strdup (key), value);
+	
+	g_hash_table_replace (hash, g_strdup (protocol), callback);
+	
+	g_ptr_array_add (retired_type_hashes, type_hash);
+	g_atomic_pointer_set (&type_hash, hash);
+	
+	if (g_atomic_int_get (&type_hash_readers) == 0)
+		g_ptr_array_remove_range (retired_type_hashes, 0, retired_type_hashes->len);
+	
+	g_mutex_unlock (&type_hash_lock);
 }
 
 
@@ -183,7 +215,11 @@ g_mime_crypto_context_new (const char *protocol)
 	
 	g_return_val_if_fail (protocol != NULL, NULL);
 	
-	if (!(func = g_hash_table_lookup (type_hash, protocol)))
+	g_atomic_int_inc (&type_hash_readers);
+	func = g_hash_table_lookup (g_atomic_pointer_get (&type_hash), protocol);
+	g_atomic_int_add (&type_hash_readers, -1);
+	
+	if (func == NULL)
 		return NULL;
 	
 	return func ();
@@ -23,9 +23,17 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "gmime-data-wrapper.h"
 #include "gmime-stream-filter.h"
 #include "gmime-filter-basic.h"
+#include "gmime-internal.h"
+#include "gmime-common.h"
 
 
 /**
@@ -48,7 +56,18 @@ static void g_mime_data_wrapper_finalize (GObject *object);
 static ssize_t write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream);
 
 
+typedef struct {
+	/* cached by g_mime_data_wrapper_analyze() */
+	GMimeContentAnalysis *analysis;
+	
+	/* serial of the last set_stream/set_encoding, see gmime-object.c */
+	guint modified;
+} GMimeDataWrapperPrivate;
+
+#define GMIME_DATA_WRAPPER_PRIVATE(wrapper) ((GMimeDataWrapperPrivate *) G_STRUCT_MEMBER_P (wrapper, private_offset))
+
 static GObject *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -70,6 +89,7 @@ g_mime_data_wrapper_get_type (void)
 		};
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeDataWrapper", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeDataWrapperPrivate));
 	}
 	
 	return type;
@@ -82,6 +102,7 @@ g_mime_data_wrapper_class_init (GMimeDataWrapperClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_data_wrapper_finalize;
 	
@@ -91,8 +112,13 @@ g_mime_data_wrapper_class_init (GMimeDataWrapperClass *klass)
 static void
 g_mime_data_wrapper_init (GMimeDataWrapper *wrapper, GMimeDataWrapperClass *klass)
 {
+	GMimeDataWrapperPrivate *priv = GMIME_DATA_WRAPPER_PRIVATE (wrapper);
+	
 	wrapper->encoding = GMIME_CONTENT_ENCODING_DEFAULT;
 	wrapper->stream = NULL;
+	
+	priv->analysis = NULL;
+	priv->modified = 0;
 }
 
 static void
@@ -103,6 +129,8 @@ g_mime_data_wrapper_finalize (GObject *object)
 	if (wrapper->stream)
 		g_object_unref (wrapper->stream);
 	
+	g_free (GMIME_DATA_WRAPPER_PRIVATE (wrapper)->analysis);
+	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -165,6 +193,8 @@ g_mime_data_wrapper_new_with_stream (GMimeStream *stream, GMimeContentEncoding e
 void
 g_mime_data_wrapper_set_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 {
+	GMimeDataWrapperPrivate *priv = GMIME_DATA_WRAPPER_PRIVATE (wrapper);
+	
 	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
 	g_return_if_fail (GMIME_IS_STREAM (stream));
 	
@@ -175,6 +205,11 @@ g_mime_data_wrapper_set_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 		g_object_unref (wrapper->stream);
 	
 	wrapper->stream = stream;
+	
+	g_free (priv->analysis);
+	priv->analysis = NULL;
+	
+	priv->modified = _g_mime_object_next_serial ();
 }
 
 
@@ -205,9 +240,19 @@ g_mime_data_wrapper_get_stream (GMimeDataWrapper *wrapper)
 void
 g_mime_data_wrapper_set_encoding (GMimeDataWrapper *wrapper, GMimeContentEncoding encoding)
 {
+	GMimeDataWrapperPrivate *priv = GMIME_DATA_WRAPPER_PRIVATE (wrapper);
+	
 	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
 	
+	if (wrapper->encoding == encoding)
+		return;
+	
 	wrapper->encoding = encoding;
+	
+	g_free (priv->analysis);
+	priv->analysis = NULL;
+	
+	priv->modified = _g_mime_object_next_serial ();
 }
 
 
@@ -228,6 +273,13 @@ g_mime_data_wrapper_get_encoding (GMimeDataWrapper *wrapper)
 }
 
 
+guint
+_g_mime_data_wrapper_get_modified (GMimeDataWrapper *wrapper)
+{
+	return GMIME_DATA_WRAPPER_PRIVATE (wrapper)->modified;
+}
+
+
 static ssize_t
 write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 {
@@ -279,3 +331,344 @@ g_mime_data_wrapper_write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *str
 	
 	return GMIME_DATA_WRAPPER_GET_CLASS (wrapper)->write_to_stream (wrapper, stream);
 }
+
+
+typedef struct {
+	GMimeContentAnalysis *analysis;
+	GChecksum *canonical;
+	GChecksum *md5;
+	gint64 linelen;
+	int from;
+	char pc;
+} ContentScanner;
+
+static void
+scan_content_scalar (ContentScanner *scanner, const unsigned char *inptr, const unsigned char *inend)
+{
+	GMimeContentAnalysis *analysis = scanner->analysis;
+	unsigned char c;
+	
+	while (inptr < inend) {
+		c = *inptr++;
+		
+		if (scanner->from != -1) {
+			/* still comparing the start of the line against "From " */
+			if (c != (unsigned char) "From "[scanner->from]) {
+				scanner->from = -1;
+			} else if (++scanner->from == 5) {
+				analysis->hadfrom = TRUE;
+				scanner->from = -1;
+			}
+		}
+		
+		if (c == '\n') {
+			analysis->maxline = MAX (analysis->maxline, scanner->linelen);
+			analysis->lines++;
+			scanner->linelen = 0;
+			scanner->from = analysis->hadfrom ? -1 : 0;
+			continue;
+		}
+		
+		if (c == 0)
+			analysis->count0++;
+		else if (c & 0x80)
+			analysis->count8++;
+		
+		scanner->linelen++;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static void
+scan_content_sse2 (ContentScanner *scanner, const unsigned char *inptr, const unsigned char *inend)
+{
+	GMimeContentAnalysis *analysis = scanner->analysis;
+	unsigned int lf, n, start;
+	__m128i in;
+	
+	while (inend - inptr >= 16) {
+		in = _mm_loadu_si128 ((const __m128i *) inptr);
+		lf = (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 ('\n')));
+		
+		/* the From-line check needs to be able to look past the end of the block */
+		if (scanner->from != -1 || (lf != 0 && !analysis->hadfrom && inend - inptr < 16 + 5)) {
+			scan_content_scalar (scanner, inptr, inptr + 16);
+			inptr += 16;
+			continue;
+		}
+		
+		analysis->count0 += __builtin_popcount ((unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (in, _mm_setzero_si128 ())));
+		analysis->count8 += __builtin_popcount ((unsigned int) _mm_movemask_epi8 (in));
+		
+		for (start = 0; lf != 0; lf &= lf - 1) {
+			n = __builtin_ctz (lf);
+			
+			scanner->linelen += n - start;
+			analysis->maxline = MAX (analysis->maxline, scanner->linelen);
+			analysis->lines++;
+			scanner->linelen = 0;
+			start = n + 1;
+			
+			if (!analysis->hadfrom && !memcmp (inptr + start, "From ", 5))
+				analysis->hadfrom = TRUE;
+		}
+		
+		scanner->linelen += 16 - start;
+		inptr += 16;
+	}
+	
+	scan_content_scalar (scanner, inptr, inend);
+}
+
+__attribute__((target("avx2")))
+static void
+scan_content_avx2 (ContentScanner *scanner, const unsigned char *inptr, const unsigned char *inend)
+{
+	GMimeContentAnalysis *analysis = scanner->analysis;
+	unsigned int lf, n, start;
+	__m256i in;
+	
+	while (inend - inptr >= 32) {
+		in = _mm256_loadu_si256 ((const __m256i *) inptr);
+		lf = (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('\n')));
+		
+		/* the From-line check needs to be able to look past the end of the block */
+		if (scanner->from != -1 || (lf != 0 && !analysis->hadfrom && inend - inptr < 32 + 5)) {
+			scan_content_scalar (scanner, inptr, inptr + 32);
+			inptr += 32;
+			continue;
+		}
+		
+		analysis->count0 += __builtin_popcount ((unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (in, _mm256_setzero_si256 ())));
+		analysis->count8 += __builtin_popcount ((unsigned int) _mm256_movemask_epi8 (in));
+		
+		for (start = 0; lf != 0; lf &= lf - 1) {
+			n = __builtin_ctz (lf);
+			
+			scanner->linelen += n - start;
+			analysis->maxline = MAX (analysis->maxline, scanner->linelen);
+			analysis->lines++;
+			scanner->linelen = 0;
+			start = n + 1;
+			
+			if (!analysis->hadfrom && !memcmp (inptr + start, "From ", 5))
+				analysis->hadfrom = TRUE;
+		}
+		
+		scanner->linelen += 32 - start;
+		inptr += 32;
+	}
+	
+	scan_content_scalar (scanner, inptr, inend);
+}
+#endif /* HAVE_X86_SIMD */
+
+static void
+scan_content (ContentScanner *scanner, const char *inbuf, size_t inlen)
+{
+	const unsigned char *inptr = (const unsigned char *) inbuf;
+	const unsigned char *inend = inptr + inlen;
+	GMimeContentAnalysis *analysis = scanner->analysis;
+	const char *lf, *start, *ptr;
+#ifdef HAVE_X86_SIMD
+	guint features = g_mime_simd_get_features ();
+#endif
+	
+	analysis->length += inlen;
+	
+	if (analysis->flags & GMIME_CONTENT_ANALYSIS_CHARSET)
+		g_mime_charset_step (&analysis->charset, inbuf, inlen);
+	
+	if (scanner->md5)
+		g_checksum_update (scanner->md5, (const guchar *) inbuf, inlen);
+	
+	if (scanner->canonical && inlen > 0) {
+		/* digest the content as if it had been filtered through GMimeFilterUnix2Dos */
+		start = inbuf;
+		ptr = inbuf;
+		
+		while ((lf = memchr (ptr, '\n', (inbuf + inlen) - ptr))) {
+			if ((lf > inbuf ? lf[-1] : scanner->pc) != '\r') {
+				g_checksum_update (scanner->canonical, (const guchar *) start, lf - start);
+				g_checksum_update (scanner->canonical, (const guchar *) "\r", 1);
+				start = lf;
+			}
+			
+			ptr = lf + 1;
+		}
+		
+		g_checksum_update (scanner->canonical, (const guchar *) start, (inbuf + inlen) - start);
+		scanner->pc = inbuf[inlen - 1];
+	}
+	
+#ifdef HAVE_X86_SIMD
+	if (features & GMIME_SIMD_AVX2) {
+		scan_content_avx2 (scanner, inptr, inend);
+		return;
+	}
+	
+	if (features & GMIME_SIMD_SSE2) {
+		scan_content_sse2 (scanner, inptr, inend);
+		return;
+	}
+#endif
+	
+	scan_content_scalar (scanner, inptr, inend);
+}
+
+
+/**
+ * g_mime_data_wrapper_analyze:
+ * @wrapper: a #GMimeDataWrapper
+ * @flags: the #GMimeContentAnalysisFlags to gather
+ *
+ * Gathers the statistics needed to pick the best Content-Transfer-Encoding
+ * for the decoded content of @wrapper along with any of the optional
+ * statistics requested in @flags, all in a single pass over the content.
+ *
+ * The results are cached on @wrapper until its stream or encoding is
+ * replaced, so subsequent calls requesting the same (or fewer)
+ * statistics do not need to read the content again.
+ *
+ * Note: In order for the charset statistics to be useful, the decoded
+ * content MUST be encoded in UTF-8. Modifying the stream in-place will
+ * not invalidate the cached results.
+ *
+ * Returns: (transfer none): the content analysis of @wrapper.
+ **/
+const GMimeContentAnalysis *
+g_mime_data_wrapper_analyze (GMimeDataWrapper *wrapper, GMimeContentAnalysisFlags flags)
+{
+	GMimeDataWrapperPrivate *priv = GMIME_DATA_WRAPPER_PRIVATE (wrapper);
+	GMimeContentAnalysis *analysis;
+	ContentScanner scanner;
+	GMimeEncoding decoder;
+	char inbuf[4096], *outbuf;
+	gboolean decode;
+	ssize_t nread;
+	gsize len;
+	
+	g_return_val_if_fail (GMIME_IS_DATA_WRAPPER (wrapper), NULL);
+	
+	if ((analysis = priv->analysis) != NULL) {
+		if ((analysis->flags & flags) == flags)
+			return analysis;
+		
+		/* re-gather everything that was gathered before as well */
+		flags |= analysis->flags;
+	} else {
+		analysis = priv->analysis = g_new (GMimeContentAnalysis, 1);
+	}
+	
+	memset (analysis, 0, sizeof (GMimeContentAnalysis));
+	g_mime_charset_init (&analysis->charset);
+	analysis->flags = flags;
+	
+	scanner.md5 = (flags & GMIME_CONTENT_ANALYSIS_MD5) ? g_checksum_new (G_CHECKSUM_MD5) : NULL;
+	scanner.canonical = (flags & GMIME_CONTENT_ANALYSIS_MD5_CANONICAL) ? g_checksum_new (G_CHECKSUM_MD5) : NULL;
+	scanner.analysis = analysis;
+	scanner.linelen = 0;
+	scanner.from = 0;
+	scanner.pc = '\0';
+	
+	if (wrapper->stream != NULL) {
+		switch (wrapper->encoding) {
+		case GMIME_CONTENT_ENCODING_BASE64:
+		case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+		case GMIME_CONTENT_ENCODING_UUENCODE:
+			g_mime_encoding_init_decode (&decoder, wrapper->encoding);
+			outbuf = g_malloc (g_mime_encoding_outlen (&decoder, sizeof (inbuf)));
+			decode = TRUE;
+			break;
+		default:
+			outbuf = NULL;
+			decode = FALSE;
+			break;
+		}
+		
+		g_mime_stream_reset (wrapper->stream);
+		
+		while (!g_mime_stream_eos (wrapper->stream)) {
+			if ((nread = g_mime_stream_read (wrapper->stream, inbuf, sizeof (inbuf))) <= 0)
+				break;
+			
+			if (decode) {
+				len = g_mime_encoding_step (&decoder, inbuf, nread, outbuf);
+				scan_content (&scanner, outbuf, len);
+			} else {
+				scan_content (&scanner, inbuf, nread);
+			}
+		}
+		
+		if (decode) {
+			len = g_mime_encoding_flush (&decoder, inbuf, 0, outbuf);
+			scan_content (&scanner, outbuf, len);
+			g_free (outbuf);
+		}
+		
+		g_mime_stream_reset (wrapper->stream);
+	}
+	
+	analysis->maxline = MAX (analysis->maxline, scanner.linelen);
+	
+	if (scanner.md5) {
+		len = sizeof (analysis->md5);
+		g_checksum_get_digest (scanner.md5, analysis->md5, &len);
+		g_checksum_free (scanner.md5);
+	}
+	
+	if (scanner.canonical) {
+		len = sizeof (analysis->canonical_md5);
+		g_checksum_get_digest (scanner.canonical, analysis->canonical_md5, &len);
+		g_checksum_free (scanner.canonical);
+	}
+	
+	return analysis;
+}
+
+
+/**
+ * g_mime_content_analysis_get_best_encoding:
+ * @analysis: a #GMimeContentAnalysis
+ * @constraint: a #GMimeEncodingConstraint
+ *
+ * Calculates the most efficient Content-Transfer-Encoding for the
+ * analyzed content that fits within the encoding @constraint.
+ *
+ * Returns: the best encoding for the analyzed content.
+ **/
+GMimeContentEncoding
+g_mime_content_analysis_get_best_encoding (const GMimeContentAnalysis *analysis, GMimeEncodingConstraint constraint)
+{
+	g_return_val_if_fail (analysis != NULL, GMIME_CONTENT_ENCODING_DEFAULT);
+	
+	return _g_mime_filter_best_pick_encoding (analysis->count0, analysis->count8, analysis->length,
+						  analysis->maxline, analysis->hadfrom, constraint);
+}
+
+
+/**
+ * g_mime_content_analysis_get_best_charset:
+ * @analysis: a #GMimeContentAnalysis
+ *
+ * Calculates the best charset for encoding the analyzed content.
+ *
+ * Returns: the name of the charset most suitable for encoding the
+ * analyzed content or %NULL if the charset statistics were not
+ * gathered.
+ **/
+const char *
+g_mime_content_analysis_get_best_charset (const GMimeContentAnalysis *analysis)
+{
+	const char *charset;
+	
+	g_return_val_if_fail (analysis != NULL, NULL);
+	
+	if (!(analysis->flags & GMIME_CONTENT_ANALYSIS_CHARSET))
+		return NULL;
+	
+	charset = g_mime_charset_best_name ((GMimeCharset *) &analysis->charset);
+	
+	return charset ? charset : "us-ascii";
+}
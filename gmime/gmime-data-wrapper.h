@@ -27,6 +27,7 @@
 
 #include <gmime/gmime-content-type.h>
 #include <gmime/gmime-encodings.h>
+#include <gmime/gmime-charset.h>
 #include <gmime/gmime-stream.h>
 #include <gmime/gmime-utils.h>
 
@@ -41,6 +42,59 @@ G_BEGIN_DECLS
 
 typedef struct _GMimeDataWrapper GMimeDataWrapper;
 typedef struct _GMimeDataWrapperClass GMimeDataWrapperClass;
+typedef struct _GMimeContentAnalysis GMimeContentAnalysis;
+
+
+/**
+ * GMimeContentAnalysisFlags:
+ * @GMIME_CONTENT_ANALYSIS_DEFAULT: Only gather the statistics needed to pick a Content-Transfer-Encoding.
+ * @GMIME_CONTENT_ANALYSIS_CHARSET: Also gather the statistics needed to pick a charset.
+ * @GMIME_CONTENT_ANALYSIS_MD5: Also compute the MD5 digest of the content.
+ * @GMIME_CONTENT_ANALYSIS_MD5_CANONICAL: Also compute the MD5 digest of the content with bare line feeds converted to CRLF.
+ *
+ * Bit flags to select which (more expensive) statistics
+ * g_mime_data_wrapper_analyze() gathers in addition to the encoding
+ * statistics.
+ **/
+typedef enum {
+	GMIME_CONTENT_ANALYSIS_DEFAULT       = 0,
+	GMIME_CONTENT_ANALYSIS_CHARSET       = (1 << 0),
+	GMIME_CONTENT_ANALYSIS_MD5           = (1 << 1),
+	GMIME_CONTENT_ANALYSIS_MD5_CANONICAL = (1 << 2)
+} GMimeContentAnalysisFlags;
+
+
+/**
+ * GMimeContentAnalysis:
+ * @flags: the #GMimeContentAnalysisFlags that were gathered
+ * @length: the length of the decoded content
+ * @count0: the number of nul bytes
+ * @count8: the number of 8bit bytes
+ * @lines: the number of line feeds
+ * @maxline: the length of the longest line, not counting the line feed
+ * @hadfrom: %TRUE if any line began with "From "
+ * @charset: the #GMimeCharset state if %GMIME_CONTENT_ANALYSIS_CHARSET was requested
+ * @md5: the MD5 digest if %GMIME_CONTENT_ANALYSIS_MD5 was requested
+ * @canonical_md5: the MD5 digest if %GMIME_CONTENT_ANALYSIS_MD5_CANONICAL was requested
+ *
+ * The results of a single-pass analysis of the decoded content of a
+ * #GMimeDataWrapper.
+ **/
+struct _GMimeContentAnalysis {
+	GMimeContentAnalysisFlags flags;
+	
+	gint64 length;
+	gint64 count0;
+	gint64 count8;
+	gint64 lines;
+	gint64 maxline;
+	gboolean hadfrom;
+	
+	GMimeCharset charset;
+	
+	unsigned char md5[16];
+	unsigned char canonical_md5[16];
+};
 
 
 /**
@@ -78,6 +132,11 @@ GMimeContentEncoding g_mime_data_wrapper_get_encoding (GMimeDataWrapper *wrapper
 
 ssize_t g_mime_data_wrapper_write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream);
 
+const GMimeContentAnalysis *g_mime_data_wrapper_analyze (GMimeDataWrapper *wrapper, GMimeContentAnalysisFlags flags);
+
+GMimeContentEncoding g_mime_content_analysis_get_best_encoding (const GMimeContentAnalysis *analysis, GMimeEncodingConstraint constraint);
+const char *g_mime_content_analysis_get_best_charset (const GMimeContentAnalysis *analysis);
+
 G_END_DECLS
 
 #endif /* __GMIME_DATA_WRAPPER_H__ */
@@ -27,8 +27,13 @@
 #include <string.h>
 #include <ctype.h>
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "gmime-table-private.h"
 #include "gmime-encodings.h"
+#include "gmime-common.h"
 
 
 #ifdef ENABLE_WARNINGS
@@ -365,6 +370,336 @@ g_mime_encoding_flush (GMimeEncoding *state, const char *inbuf, size_t inlen, ch
 }
 
 
+/* encodes a single triplet into a quartet */
+static inline void
+base64_encode_triplet (const unsigned char *inptr, unsigned char *outptr)
+{
+	int c1 = inptr[0], c2 = inptr[1], c3 = inptr[2];
+	
+	outptr[0] = base64_alphabet[c1 >> 2];
+	outptr[1] = base64_alphabet[(c2 >> 4) | ((c1 & 0x3) << 4)];
+	outptr[2] = base64_alphabet[((c2 & 0x0f) << 2) | (c3 >> 6)];
+	outptr[3] = base64_alphabet[c3 & 0x3f];
+}
+
+#ifdef HAVE_X86_SIMD
+/* The vectorized kernels below are based on the algorithms described
+ * by Wojciech Muła and Daniel Lemire in "Faster Base64 Encoding and
+ * Decoding using AVX2 Instructions". They only ever handle complete
+ * blocks and leave line breaks, padding, garbage and partial quartets
+ * to the scalar code, so the results are identical. */
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+base64_encode_block_sse41 (__m128i in)
+{
+	const __m128i shift_lut = _mm_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+						 '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+						 '/' - 63, 'A', 0, 0);
+	__m128i indices, t0, t1, t2, t3, result, less;
+	
+	/* split each triplet into 4 6-bit indices, one per byte */
+	in = _mm_shuffle_epi8 (in, _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	t0 = _mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00));
+	t1 = _mm_mulhi_epu16 (t0, _mm_set1_epi32 (0x04000040));
+	t2 = _mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0));
+	t3 = _mm_mullo_epi16 (t2, _mm_set1_epi32 (0x01000010));
+	indices = _mm_or_si128 (t1, t3);
+	
+	/* map the indices onto the base64 alphabet */
+	result = _mm_subs_epu8 (indices, _mm_set1_epi8 (51));
+	less = _mm_cmpgt_epi8 (_mm_set1_epi8 (26), indices);
+	result = _mm_or_si128 (result, _mm_and_si128 (less, _mm_set1_epi8 (13)));
+	result = _mm_shuffle_epi8 (shift_lut, result);
+	
+	return _mm_add_epi8 (result, indices);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+base64_encode_block_avx2 (__m256i in)
+{
+	const __m256i shift_lut = _mm256_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+						    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+						    '/' - 63, 'A', 0, 0,
+						    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+						    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+						    '/' - 63, 'A', 0, 0);
+	__m256i indices, t0, t1, t2, t3, result, less;
+	
+	in = _mm256_shuffle_epi8 (in, _mm256_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+							1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	t0 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00));
+	t1 = _mm256_mulhi_epu16 (t0, _mm256_set1_epi32 (0x04000040));
+	t2 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0));
+	t3 = _mm256_mullo_epi16 (t2, _mm256_set1_epi32 (0x01000010));
+	indices = _mm256_or_si256 (t1, t3);
+	
+	result = _mm256_subs_epu8 (indices, _mm256_set1_epi8 (51));
+	less = _mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), indices);
+	result = _mm256_or_si256 (result, _mm256_and_si256 (less, _mm256_set1_epi8 (13)));
+	result = _mm256_shuffle_epi8 (shift_lut, result);
+	
+	return _mm256_add_epi8 (result, indices);
+}
+
+/* finishes off the current line one quartet at a time */
+static inline const unsigned char *
+base64_encode_line_tail (const unsigned char *inptr, unsigned char **outbuf, int *quartets)
+{
+	unsigned char *outptr = *outbuf;
+	
+	do {
+		base64_encode_triplet (inptr, outptr);
+		outptr += 4;
+		inptr += 3;
+	} while (++(*quartets) < 19);
+	
+	*outptr++ = '\n';
+	*outbuf = outptr;
+	*quartets = 0;
+	
+	return inptr;
+}
+
+__attribute__((target("sse4.1")))
+static size_t
+base64_encode_sse41 (const unsigned char *inbuf, size_t inlen, unsigned char **outbuf, int *quartets)
+{
+	register const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	
+	/* Note: each block consumes 12 bytes but loads 16 */
+	while (inend - inptr >= 16) {
+		if (*quartets > 15) {
+			inptr = base64_encode_line_tail (inptr, outbuf, quartets);
+			continue;
+		}
+		
+		_mm_storeu_si128 ((__m128i *) *outbuf, base64_encode_block_sse41 (_mm_loadu_si128 ((const __m128i *) inptr)));
+		*outbuf += 16;
+		inptr += 12;
+		
+		if ((*quartets += 4) == 19) {
+			*(*outbuf)++ = '\n';
+			*quartets = 0;
+		}
+	}
+	
+	return (size_t) (inptr - inbuf);
+}
+
+__attribute__((target("avx2")))
+static size_t
+base64_encode_avx2 (const unsigned char *inbuf, size_t inlen, unsigned char **outbuf, int *quartets)
+{
+	register const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	__m256i in;
+	
+	/* Note: each block consumes 24 bytes but loads 28 */
+	while (inend - inptr >= 28) {
+		if (*quartets > 11) {
+			inptr = base64_encode_line_tail (inptr, outbuf, quartets);
+			continue;
+		}
+		
+		in = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) inptr)),
+					      _mm_loadu_si128 ((const __m128i *) (inptr + 12)), 1);
+		in = base64_encode_block_avx2 (in);
+		
+		/* each lane holds 16 encoded bytes */
+		_mm256_storeu_si256 ((__m256i *) *outbuf, in);
+		*outbuf += 32;
+		inptr += 24;
+		
+		if ((*quartets += 8) == 19) {
+			*(*outbuf)++ = '\n';
+			*quartets = 0;
+		}
+	}
+	
+	return (size_t) (inptr - inbuf);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+base64_decode_block_sse41 (__m128i in, int *valid)
+{
+	const __m128i lut_lo = _mm_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8 (0, 16, 19, 4, -65, -65, -71, -71,
+						0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i hi_nibbles, lo_nibbles, lo, hi, roll, values, merged;
+	
+	/* classify each character; anything outside of the alphabet (including '=') is invalid */
+	hi_nibbles = _mm_and_si128 (_mm_srli_epi32 (in, 4), _mm_set1_epi8 (0x0f));
+	lo_nibbles = _mm_and_si128 (in, _mm_set1_epi8 (0x0f));
+	lo = _mm_shuffle_epi8 (lut_lo, lo_nibbles);
+	hi = _mm_shuffle_epi8 (lut_hi, hi_nibbles);
+	*valid = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (lo, hi), _mm_setzero_si128 ()));
+	
+	/* translate the characters into their 6-bit values */
+	roll = _mm_add_epi8 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 ('/')), hi_nibbles);
+	values = _mm_add_epi8 (in, _mm_shuffle_epi8 (lut_roll, roll));
+	
+	/* pack each quartet of 6-bit values into a triplet */
+	merged = _mm_maddubs_epi16 (values, _mm_set1_epi32 (0x01400140));
+	merged = _mm_madd_epi16 (merged, _mm_set1_epi32 (0x00011000));
+	
+	return _mm_shuffle_epi8 (merged, _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+base64_decode_block_avx2 (__m256i in, unsigned int *valid)
+{
+	const __m256i lut_lo = _mm256_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+						 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+						 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8 (0, 16, 19, 4, -65, -65, -71, -71,
+						   0, 0, 0, 0, 0, 0, 0, 0,
+						   0, 16, 19, 4, -65, -65, -71, -71,
+						   0, 0, 0, 0, 0, 0, 0, 0);
+	__m256i hi_nibbles, lo_nibbles, lo, hi, roll, values, merged;
+	
+	hi_nibbles = _mm256_and_si256 (_mm256_srli_epi32 (in, 4), _mm256_set1_epi8 (0x0f));
+	lo_nibbles = _mm256_and_si256 (in, _mm256_set1_epi8 (0x0f));
+	lo = _mm256_shuffle_epi8 (lut_lo, lo_nibbles);
+	hi = _mm256_shuffle_epi8 (lut_hi, hi_nibbles);
+	*valid = (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_and_si256 (lo, hi), _mm256_setzero_si256 ()));
+	
+	roll = _mm256_add_epi8 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('/')), hi_nibbles);
+	values = _mm256_add_epi8 (in, _mm256_shuffle_epi8 (lut_roll, roll));
+	
+	merged = _mm256_maddubs_epi16 (values, _mm256_set1_epi32 (0x01400140));
+	merged = _mm256_madd_epi16 (merged, _mm256_set1_epi32 (0x00011000));
+	merged = _mm256_shuffle_epi8 (merged, _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+								2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	
+	/* move the 24 decoded bytes to the bottom of the register */
+	return _mm256_permutevar8x32_epi32 (merged, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 7, 7));
+}
+
+/* Decodes as many complete quartets of base64 characters as possible
+ * and returns the number of characters consumed. @skip is set to the
+ * number of characters the scalar code must process before another
+ * block could possibly be decoded. */
+__attribute__((target("sse4.1")))
+static size_t
+base64_decode_sse41 (const unsigned char *inbuf, size_t inlen, unsigned char **outbuf, size_t *skip)
+{
+	register const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	register unsigned char *outptr = *outbuf;
+	unsigned char block[16];
+	guint32 word;
+	__m128i out;
+	int valid;
+	size_t n;
+	
+	*skip = 0;
+	
+	while (inend - inptr >= 16) {
+		out = base64_decode_block_sse41 (_mm_loadu_si128 ((const __m128i *) inptr), &valid);
+		if (valid != 0xffff) {
+			/* keep the complete quartets that precede the invalid character */
+			n = __builtin_ctz ((unsigned int) ~valid);
+			_mm_storeu_si128 ((__m128i *) block, out);
+			memcpy (outptr, block, (n / 4) * 3);
+			outptr += (n / 4) * 3;
+			inptr += n & ~3;
+			
+			*skip = (n & 3) + 1;
+			break;
+		}
+		
+		_mm_storel_epi64 ((__m128i *) outptr, out);
+		word = (guint32) _mm_extract_epi32 (out, 2);
+		memcpy (outptr + 8, &word, 4);
+		outptr += 12;
+		inptr += 16;
+	}
+	
+	*outbuf = outptr;
+	
+	return (size_t) (inptr - inbuf);
+}
+
+__attribute__((target("avx2")))
+static size_t
+base64_decode_avx2 (const unsigned char *inbuf, size_t inlen, unsigned char **outbuf, size_t *skip)
+{
+	register const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	register unsigned char *outptr = *outbuf;
+	unsigned char block[32];
+	unsigned int valid;
+	guint32 word;
+	__m256i out;
+	__m128i half;
+	int hvalid;
+	size_t n;
+	
+	*skip = 0;
+	
+	while (inend - inptr >= 32) {
+		out = base64_decode_block_avx2 (_mm256_loadu_si256 ((const __m256i *) inptr), &valid);
+		if (valid != 0xffffffff) {
+			/* keep the complete quartets that precede the invalid character
+			 * so that the next call resumes with whole 32-byte blocks */
+			n = __builtin_ctz (~valid);
+			_mm256_storeu_si256 ((__m256i *) block, out);
+			memcpy (outptr, block, (n / 4) * 3);
+			outptr += (n / 4) * 3;
+			inptr += n & ~3;
+			
+			*skip = (n & 3) + 1;
+			goto done;
+		}
+		
+		_mm_storeu_si128 ((__m128i *) outptr, _mm256_castsi256_si128 (out));
+		_mm_storel_epi64 ((__m128i *) (outptr + 16), _mm256_extracti128_si256 (out, 1));
+		outptr += 24;
+		inptr += 32;
+	}
+	
+	/* Note: the remainder is handled here rather than by calling
+	 * base64_decode_sse41() to avoid AVX-SSE transition penalties */
+	if (inend - inptr >= 16) {
+		half = base64_decode_block_sse41 (_mm_loadu_si128 ((const __m128i *) inptr), &hvalid);
+		if (hvalid != 0xffff) {
+			n = __builtin_ctz ((unsigned int) ~hvalid);
+			_mm_storeu_si128 ((__m128i *) block, half);
+			memcpy (outptr, block, (n / 4) * 3);
+			outptr += (n / 4) * 3;
+			inptr += n & ~3;
+			
+			*skip = (n & 3) + 1;
+		} else {
+			_mm_storel_epi64 ((__m128i *) outptr, half);
+			word = (guint32) _mm_extract_epi32 (half, 2);
+			memcpy (outptr + 8, &word, 4);
+			outptr += 12;
+			inptr += 16;
+		}
+	}
+	
+ done:
+	*outbuf = outptr;
+	
+	return (size_t) (inptr - inbuf);
+}
+#endif /* HAVE_X86_SIMD */
+
+
 /**
  * g_mime_encoding_base64_encode_close:
  * @inbuf: input buffer
@@ -435,8 +770,8 @@ size_t
 g_mime_encoding_base64_encode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
 {
 	register const unsigned char *inptr;
-	register unsigned char *outptr;
-	register int quartets;
+	unsigned char *outptr;
+	int quartets;
 	unsigned char *saved;
 	size_t remaining;
 
@@ -447,9 +782,30 @@ g_mime_encoding_base64_encode_step (const unsigned char *inbuf, size_t inlen, un
 	quartets = *state;
 	outptr = outbuf;
 	inptr = inbuf;
-
+	
+#ifdef HAVE_X86_SIMD
+	if (*saved == 0) {
+		guint features = g_mime_simd_get_features ();
+		size_t nread = 0;
+		
+		if (features & GMIME_SIMD_AVX2)
+			nread = base64_encode_avx2 (inptr, inlen, &outptr, &quartets);
+		else if (features & GMIME_SIMD_SSE4_1)
+			nread = base64_encode_sse41 (inptr, inlen, &outptr, &quartets);
+		
+		inptr += nread;
+		inlen -= nread;
+		
+		if (inlen == 0) {
+			*state = quartets;
+			
+			return (size_t) (outptr - outbuf);
+		}
+	}
+#endif
+	
 	if (inlen + *saved > 2) {
-		const unsigned char *inend = inbuf + inlen - 2;
+		const unsigned char *inend = inptr + inlen - 2;
 		register int c1, c2, c3;
 
 		c1 = *saved < 1 ? *inptr++ : saved[1];
@@ -524,12 +880,18 @@ size_t
 g_mime_encoding_base64_decode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
 {
 	register const unsigned char *inptr;
-	register unsigned char *outptr;
+	unsigned char *outptr;
 	const unsigned char *inend;
 	register guint32 saved;
 	unsigned char last[2];
 	unsigned char c, rank;
 	int n;
+#ifdef HAVE_X86_SIMD
+	const unsigned char *retry;
+	size_t nread, skip;
+	guint features;
+	int i;
+#endif
 	
 	inend = inbuf + inlen;
 	outptr = outbuf;
@@ -538,6 +900,11 @@ g_mime_encoding_base64_decode_step (const unsigned char *inbuf, size_t inlen, un
 	saved = *save;
 	n = *state;
 	
+#ifdef HAVE_X86_SIMD
+	features = g_mime_simd_get_features ();
+	retry = (features & GMIME_SIMD_SSE4_1) ? inptr : inend;
+#endif
+	
 	if (n < 0) {
 		last[0] = '=';
 		n = -n;
@@ -549,6 +916,29 @@ g_mime_encoding_base64_decode_step (const unsigned char *inbuf, size_t inlen, un
 	
 	/* convert 4 base64 bytes to 3 normal bytes */
 	while (inptr < inend) {
+#ifdef HAVE_X86_SIMD
+		if (n == 0 && inptr >= retry) {
+			/* decode whole blocks at a time until we hit a line break or padding */
+			if (features & GMIME_SIMD_AVX2)
+				nread = base64_decode_avx2 (inptr, (size_t) (inend - inptr), &outptr, &skip);
+			else
+				nread = base64_decode_sse41 (inptr, (size_t) (inend - inptr), &outptr, &skip);
+			
+			if (nread > 0) {
+				inptr += nread;
+				
+				/* sync the scalar state up with the last quartet decoded */
+				for (i = MIN (nread, 6); i > 0; i--)
+					saved = (saved << 6) | gmime_base64_rank[inptr[-i]];
+				last[0] = inptr[-1];
+				last[1] = inptr[-2];
+			}
+			
+			retry = skip > 0 ? inptr + skip : inend;
+			continue;
+		}
+#endif
+		
 		rank = gmime_base64_rank[(c = *inptr++)];
 		if (rank != 0xff) {
 			saved = (saved << 6) | rank;
@@ -872,6 +1262,80 @@ g_mime_encoding_uudecode_step (const unsigned char *inbuf, size_t inlen, unsigne
 }
 
 
+static const unsigned char *
+qp_literal_span_scalar (const unsigned char *inptr, const unsigned char *inend)
+{
+	while (inptr < inend && is_qpsafe (*inptr))
+		inptr++;
+	
+	return inptr;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static const unsigned char *
+qp_literal_span_sse2 (const unsigned char *inptr, const unsigned char *inend)
+{
+	__m128i in, safe;
+	int mask;
+	
+	/* safe characters are ' ' through '~' except for '=', plus '\t' */
+	while (inend - inptr >= 16) {
+		in = _mm_loadu_si128 ((const __m128i *) inptr);
+		safe = _mm_and_si128 (_mm_cmpgt_epi8 (in, _mm_set1_epi8 (0x1f)), _mm_cmplt_epi8 (in, _mm_set1_epi8 (0x7f)));
+		safe = _mm_andnot_si128 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 ('=')), safe);
+		safe = _mm_or_si128 (safe, _mm_cmpeq_epi8 (in, _mm_set1_epi8 ('\t')));
+		
+		if ((mask = _mm_movemask_epi8 (safe)) != 0xffff)
+			return inptr + __builtin_ctz ((unsigned int) ~mask);
+		
+		inptr += 16;
+	}
+	
+	return qp_literal_span_scalar (inptr, inend);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+qp_literal_span_avx2 (const unsigned char *inptr, const unsigned char *inend)
+{
+	__m256i in, safe;
+	unsigned int mask;
+	
+	while (inend - inptr >= 32) {
+		in = _mm256_loadu_si256 ((const __m256i *) inptr);
+		safe = _mm256_and_si256 (_mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (0x1f)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 (0x7f), in));
+		safe = _mm256_andnot_si256 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('=')), safe);
+		safe = _mm256_or_si256 (safe, _mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('\t')));
+		
+		if ((mask = (unsigned int) _mm256_movemask_epi8 (safe)) != 0xffffffff)
+			return inptr + __builtin_ctz (~mask);
+		
+		inptr += 32;
+	}
+	
+	return qp_literal_span_scalar (inptr, inend);
+}
+#endif /* HAVE_X86_SIMD */
+
+/* finds the end of the run of characters that can be output as-is */
+static const unsigned char *
+qp_literal_span (const unsigned char *inptr, const unsigned char *inend)
+{
+#ifdef HAVE_X86_SIMD
+	guint features = g_mime_simd_get_features ();
+	
+	if (features & GMIME_SIMD_AVX2)
+		return qp_literal_span_avx2 (inptr, inend);
+	
+	if (features & GMIME_SIMD_SSE2)
+		return qp_literal_span_sse2 (inptr, inend);
+#endif
+	
+	return qp_literal_span_scalar (inptr, inend);
+}
+
+
 /**
  * g_mime_encoding_quoted_encode_close:
  * @inbuf: input buffer
@@ -941,9 +1405,37 @@ g_mime_encoding_quoted_encode_step (const unsigned char *inbuf, size_t inlen, un
 	register unsigned char *outptr = outbuf;
 	register guint32 sofar = *save;  /* keeps track of how many chars on a line */
 	register int last = *state;  /* keeps track if last char to end was a space cr etc */
+	const unsigned char *literal;
 	unsigned char c;
+	size_t n;
 	
 	while (inptr < inend) {
+		if (last == -1) {
+			/* Copy runs of safe characters in bulk, only breaking them
+			 * up for soft line breaks. Trailing blanks are left to the
+			 * code below since they may need to be encoded. */
+			literal = qp_literal_span (inptr, inend);
+			while (literal > inptr && is_blank (literal[-1]))
+				literal--;
+			
+			while (inptr < literal) {
+				if (sofar > 74) {
+					*outptr++ = '=';
+					*outptr++ = '\n';
+					sofar = 0;
+				}
+				
+				n = MIN ((size_t) (literal - inptr), 75 - sofar);
+				memcpy (outptr, inptr, n);
+				outptr += n;
+				inptr += n;
+				sofar += n;
+			}
+			
+			if (inptr == inend)
+				break;
+		}
+		
 		c = *inptr++;
 		if (c == '\r') {
 			if (last != -1) {
@@ -1039,33 +1531,29 @@ g_mime_encoding_quoted_decode_step (const unsigned char *inbuf, size_t inlen, un
 	const register unsigned char *inptr = inbuf;
 	const unsigned char *inend = inbuf + inlen;
 	register unsigned char *outptr = outbuf;
+	const unsigned char *escape;
 	guint32 isave = *save;
 	int istate = *state;
 	unsigned char c;
+	size_t n;
 	
 	d(printf ("quoted-printable, decoding text '%.*s'\n", inlen, inbuf));
 	
 	while (inptr < inend) {
 		switch (istate) {
 		case 0:
-			while (inptr < inend) {
-				c = *inptr++;
-				/* FIXME: use a specials table to avoid 3 comparisons for the common case */
-				if (c == '=') { 
-					istate = 1;
-					break;
-				}
-#ifdef CANONICALISE_EOL
-				/*else if (c=='\r') {
-					state = 3;
-				} else if (c=='\n') {
-					*outptr++ = '\r';
-					*outptr++ = c;
-					} */
-#endif
-				else {
-					*outptr++ = c;
-				}
+			/* everything up to the next '=' is literal */
+			if (!(escape = memchr (inptr, '=', (size_t) (inend - inptr))))
+				escape = inend;
+			
+			n = (size_t) (escape - inptr);
+			memcpy (outptr, inptr, n);
+			outptr += n;
+			inptr += n;
+			
+			if (inptr < inend) {
+				istate = 1;
+				inptr++;
 			}
 			break;
 		case 1:
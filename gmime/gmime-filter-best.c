@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-filter-best.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -280,55 +281,64 @@ g_mime_filter_best_charset (GMimeFilterBest *best)
 }
 
 
-/**
- * g_mime_filter_best_encoding:
- * @best: a #GMimeFilterBest
- * @constraint: a #GMimeEncodingConstraint
- *
- * Calculates the most efficient Content-Transfer-Encoding for the
- * content filtered through @best that fits within the encoding
- * @constraint.
- *
- * Returns: the best encoding for the content filtered by @best.
- **/
 GMimeContentEncoding
-g_mime_filter_best_encoding (GMimeFilterBest *best, GMimeEncodingConstraint constraint)
+_g_mime_filter_best_pick_encoding (gint64 count0, gint64 count8, gint64 total, gint64 maxline,
+				   gboolean hadfrom, GMimeEncodingConstraint constraint)
 {
 	GMimeContentEncoding encoding = GMIME_CONTENT_ENCODING_DEFAULT;
 	
-	g_return_val_if_fail (GMIME_IS_FILTER_BEST (best), GMIME_CONTENT_ENCODING_DEFAULT);
-	
-	if (!(best->flags & GMIME_FILTER_BEST_ENCODING))
-		return GMIME_CONTENT_ENCODING_DEFAULT;
-	
 	switch (constraint) {
 	case GMIME_ENCODING_CONSTRAINT_7BIT:
-		if (best->count0 > 0) {
+		if (count0 > 0) {
 			encoding = GMIME_CONTENT_ENCODING_BASE64;
-		} else if (best->count8 > 0) {
-			if (best->count8 >= (unsigned int) (best->total * (17.0 / 100.0)))
+		} else if (count8 > 0) {
+			if (count8 >= (gint64) (total * (17.0 / 100.0)))
 				encoding = GMIME_CONTENT_ENCODING_BASE64;
 			else
 				encoding = GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
-		} else if (best->maxline > 998) {
+		} else if (maxline > 998) {
 			encoding = GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
 		}
 		break;
 	case GMIME_ENCODING_CONSTRAINT_8BIT:
-		if (best->count0 > 0) {
+		if (count0 > 0) {
 			encoding = GMIME_CONTENT_ENCODING_BASE64;
-		} else if (best->maxline > 998) {
+		} else if (maxline > 998) {
 			encoding = GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
 		}
 		break;
 	case GMIME_ENCODING_CONSTRAINT_BINARY:
-		if (best->count0 + best->count8 > 0)
+		if (count0 + count8 > 0)
 			encoding = GMIME_CONTENT_ENCODING_BINARY;
 		break;
 	}
 	
-	if (encoding == GMIME_CONTENT_ENCODING_DEFAULT && best->hadfrom)
+	if (encoding == GMIME_CONTENT_ENCODING_DEFAULT && hadfrom)
 		encoding = GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
 	
 	return encoding;
 }
+
+
+/**
+ * g_mime_filter_best_encoding:
+ * @best: a #GMimeFilterBest
+ * @constraint: a #GMimeEncodingConstraint
+ *
+ * Calculates the most efficient Content-Transfer-Encoding for the
+ * content filtered through @best that fits within the encoding
+ * @constraint.
+ *
+ * Returns: the best encoding for the content filtered by @best.
+ **/
+GMimeContentEncoding
+g_mime_filter_best_encoding (GMimeFilterBest *best, GMimeEncodingConstraint constraint)
+{
+	g_return_val_if_fail (GMIME_IS_FILTER_BEST (best), GMIME_CONTENT_ENCODING_DEFAULT);
+	
+	if (!(best->flags & GMIME_FILTER_BEST_ENCODING))
+		return GMIME_CONTENT_ENCODING_DEFAULT;
+	
+	return _g_mime_filter_best_pick_encoding (best->count0, best->count8, best->total, best->maxline,
+						  best->hadfrom, constraint);
+}
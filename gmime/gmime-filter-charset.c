@@ -28,6 +28,7 @@
 #include "gmime-filter-charset.h"
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -53,7 +54,15 @@ static void filter_complete (GMimeFilter *filter, char *in, size_t len, size_t p
 static void filter_reset (GMimeFilter *filter);
 
 
+/* kept out of the public struct to preserve its ABI */
+typedef struct {
+	GMimeCharsetDecoder decoder;
+} GMimeFilterCharsetPrivate;
+
+#define GMIME_FILTER_CHARSET_PRIVATE(filter) ((GMimeFilterCharsetPrivate *) G_STRUCT_MEMBER_P (filter, private_offset))
+
 static GMimeFilterClass *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -75,6 +84,7 @@ g_mime_filter_charset_get_type (void)
 		};
 		
 		type = g_type_register_static (GMIME_TYPE_FILTER, "GMimeFilterCharset", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeFilterCharsetPrivate));
 	}
 	
 	return type;
@@ -88,6 +98,7 @@ g_mime_filter_charset_class_init (GMimeFilterCharsetClass *klass)
 	GMimeFilterClass *filter_class = GMIME_FILTER_CLASS (klass);
 	
 	parent_class = g_type_class_ref (GMIME_TYPE_FILTER);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_filter_charset_finalize;
 	
@@ -103,6 +114,7 @@ g_mime_filter_charset_init (GMimeFilterCharset *filter, GMimeFilterCharsetClass
 	filter->from_charset = NULL;
 	filter->to_charset = NULL;
 	filter->cd = (iconv_t) -1;
+	GMIME_FILTER_CHARSET_PRIVATE (filter)->decoder = GMIME_CHARSET_DECODER_NONE;
 }
 
 static void
@@ -113,7 +125,7 @@ g_mime_filter_charset_finalize (GObject *object)
 	g_free (filter->from_charset);
 	g_free (filter->to_charset);
 	if (filter->cd != (iconv_t) -1)
-		g_mime_iconv_close (filter->cd);
+		_g_mime_iconv_close (filter->cd);
 	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -127,6 +139,40 @@ filter_copy (GMimeFilter *filter)
 	return g_mime_filter_charset_new (charset->from_charset, charset->to_charset);
 }
 
+static void
+filter_decode (GMimeFilter *filter, char *in, size_t len, size_t prespace,
+	       char **out, size_t *outlen, size_t *outprespace, gboolean flush)
+{
+	GMimeFilterCharsetPrivate *priv = GMIME_FILTER_CHARSET_PRIVATE (filter);
+	size_t nread, ninval;
+	gboolean incomplete;
+	
+	if (priv->decoder == GMIME_CHARSET_DECODER_UTF8) {
+		nread = _g_mime_utf8_validate (in, len, &incomplete);
+		
+		if (nread == len || (incomplete && !flush)) {
+			/* valid UTF-8 can be passed straight through */
+			if (nread < len)
+				g_mime_filter_backup (filter, in + nread, len - nread);
+			
+			*out = in;
+			*outlen = nread;
+			*outprespace = prespace;
+			return;
+		}
+	}
+	
+	g_mime_filter_set_size (filter, len * 3 + 16, FALSE);
+	
+	/* Note: like the iconv code paths, invalid bytes are dropped */
+	*outlen = _g_mime_charset_decode_to_utf8 (priv->decoder, in, len, filter->outbuf, -1, flush, &nread, &ninval);
+	*out = filter->outbuf;
+	*outprespace = filter->outpre;
+	
+	if (nread < len)
+		g_mime_filter_backup (filter, in + nread, len - nread);
+}
+
 static void
 filter_filter (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	       char **out, size_t *outlen, size_t *outprespace)
@@ -136,6 +182,11 @@ filter_filter (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	char *inbuf;
 	char *outbuf;
 	
+	if (GMIME_FILTER_CHARSET_PRIVATE (charset)->decoder != GMIME_CHARSET_DECODER_NONE) {
+		filter_decode (filter, in, len, prespace, out, outlen, outprespace, FALSE);
+		return;
+	}
+	
 	if (charset->cd == (iconv_t) -1)
 		goto noop;
 	
@@ -203,6 +254,11 @@ filter_complete (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	char *inbuf;
 	char *outbuf;
 	
+	if (GMIME_FILTER_CHARSET_PRIVATE (charset)->decoder != GMIME_CHARSET_DECODER_NONE) {
+		filter_decode (filter, in, len, prespace, out, outlen, outprespace, TRUE);
+		return;
+	}
+	
 	if (charset->cd == (iconv_t) -1)
 		goto noop;
 	
@@ -304,16 +360,24 @@ filter_reset (GMimeFilter *filter)
 GMimeFilter *
 g_mime_filter_charset_new (const char *from_charset, const char *to_charset)
 {
+	GMimeCharsetDecoder decoder = GMIME_CHARSET_DECODER_NONE;
+	iconv_t cd = (iconv_t) -1;
 	GMimeFilterCharset *charset;
-	iconv_t cd;
 	
-	cd = g_mime_iconv_open (to_charset, from_charset);
-	if (cd == (iconv_t) -1)
-		return NULL;
+	/* the common charsets are converted to UTF-8 without iconv */
+	if (to_charset && _g_mime_charset_get_utf8_decoder (to_charset) == GMIME_CHARSET_DECODER_UTF8)
+		decoder = _g_mime_charset_get_utf8_decoder (from_charset);
+	
+	if (decoder == GMIME_CHARSET_DECODER_NONE) {
+		cd = _g_mime_iconv_open (to_charset, from_charset);
+		if (cd == (iconv_t) -1)
+			return NULL;
+	}
 	
 	charset = g_object_new (GMIME_TYPE_FILTER_CHARSET, NULL);
 	charset->from_charset = g_strdup (from_charset);
 	charset->to_charset = g_strdup (to_charset);
+	GMIME_FILTER_CHARSET_PRIVATE (charset)->decoder = decoder;
 	charset->cd = cd;
 	
 	return (GMimeFilter *) charset;
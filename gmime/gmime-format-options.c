@@ -28,6 +28,7 @@
 #include "gmime-format-options.h"
 #include "gmime-filter-dos2unix.h"
 #include "gmime-filter-unix2dos.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -45,10 +46,21 @@ struct _GMimeFormatOptions {
 	GMimeNewLineFormat newline;
 	gboolean mixed_charsets;
 	gboolean international;
+	gboolean passthrough;
 	GPtrArray *hidden;
 	guint maxline;
+	
+	/* well-known hidden headers are kept as a set of GMimeHeaderIds so
+	 * that most checks never need to compare strings */
+	guint64 hidden_ids;
+	guint hidden_unknown;
 };
 
+#define HIDDEN_ID_BIT(id) (G_GUINT64_CONSTANT (1) << (id))
+
+/* every well-known header id needs a bit in hidden_ids */
+G_STATIC_ASSERT (GMIME_HEADER_ID_LAST <= 64);
+
 static GMimeFormatOptions *default_options = NULL;
 
 G_DEFINE_BOXED_TYPE (GMimeFormatOptions, g_mime_format_options, g_mime_format_options_clone, g_mime_format_options_free);
@@ -109,6 +121,9 @@ g_mime_format_options_new (void)
 	options->hidden = g_ptr_array_new ();
 	options->mixed_charsets = TRUE;
 	options->international = FALSE;
+	options->passthrough = FALSE;
+	options->hidden_unknown = 0;
+	options->hidden_ids = 0;
 	options->maxline = 78;
 	
 	return options;
@@ -138,19 +153,67 @@ _g_mime_format_options_clone (GMimeFormatOptions *options, gboolean hidden)
 	clone->newline = options->newline;
 	clone->mixed_charsets = options->mixed_charsets;
 	clone->international = options->international;
-	clone->maxline = options->newline;
+	clone->passthrough = options->passthrough;
+	clone->maxline = options->maxline;
 	
 	clone->hidden = g_ptr_array_new ();
+	clone->hidden_unknown = 0;
+	clone->hidden_ids = 0;
 	
 	if (hidden) {
 		for (i = 0; i < options->hidden->len; i++)
 			g_ptr_array_add (clone->hidden, g_strdup (options->hidden->pdata[i]));
+		
+		clone->hidden_unknown = options->hidden_unknown;
+		clone->hidden_ids = options->hidden_ids;
 	}
 	
 	return clone;
 }
 
 
+/**
+ * _g_mime_format_options_equal:
+ * @options: (nullable): a #GMimeFormatOptions or %NULL
+ * @other: (nullable): a #GMimeFormatOptions or %NULL
+ *
+ * Compares two sets of format options.
+ *
+ * Returns: %TRUE if @options and @other would serialize an object
+ * identically or %FALSE otherwise.
+ **/
+gboolean
+_g_mime_format_options_equal (GMimeFormatOptions *options, GMimeFormatOptions *other)
+{
+	guint i;
+	
+	if (options == NULL)
+		options = default_options;
+	
+	if (other == NULL)
+		other = default_options;
+	
+	if (options == other)
+		return TRUE;
+	
+	if (options->method != other->method ||
+	    options->newline != other->newline ||
+	    options->mixed_charsets != other->mixed_charsets ||
+	    options->international != other->international ||
+	    options->passthrough != other->passthrough ||
+	    options->maxline != other->maxline ||
+	    options->hidden->len != other->hidden->len)
+		return FALSE;
+	
+	for (i = 0; i < options->hidden->len; i++) {
+		if (g_ascii_strcasecmp (options->hidden->pdata[i], other->hidden->pdata[i]) != 0)
+			return FALSE;
+	}
+	
+	return TRUE;
+}
+
+
 /**
  * g_mime_format_options_clone:
  * @options: (nullable): a #GMimeFormatOptions or %NULL
@@ -398,6 +461,48 @@ g_mime_format_options_set_max_line (GMimeFormatOptions *options, guint maxline)
 }
 #endif
 
+/**
+ * g_mime_format_options_get_passthrough:
+ * @options: (nullable): a #GMimeFormatOptions or %NULL
+ *
+ * Gets whether or not parts that have not been modified since they were
+ * parsed should be written out verbatim.
+ *
+ * Returns: %TRUE if unmodified parts are written out verbatim or %FALSE otherwise.
+ **/
+gboolean
+g_mime_format_options_get_passthrough (GMimeFormatOptions *options)
+{
+	return options ? options->passthrough : default_options->passthrough;
+}
+
+
+/**
+ * g_mime_format_options_set_passthrough:
+ * @options: a #GMimeFormatOptions
+ * @passthrough: %TRUE if unmodified parts should be written out verbatim
+ *
+ * Sets whether or not parts that have not been modified since they were
+ * parsed should be written out verbatim.
+ *
+ * When enabled, a #GMimePart that was parsed by a #GMimeParser in
+ * persistent stream mode and whose headers and content have not been
+ * changed since is copied byte-for-byte from the original stream instead
+ * of being re-serialized. When both the original stream and the output
+ * stream are #GMimeStreamFs streams, the data is copied in the kernel.
+ *
+ * Note: verbatim parts keep the line endings of the original stream
+ * regardless of the new-line format set on @options.
+ **/
+void
+g_mime_format_options_set_passthrough (GMimeFormatOptions *options, gboolean passthrough)
+{
+	g_return_if_fail (options != NULL);
+	
+	options->passthrough = passthrough;
+}
+
+
 /**
  * g_mime_format_options_is_hidden_header:
  * @options: (nullable): a #GMimeFormatOptions or %NULL
@@ -410,15 +515,39 @@ g_mime_format_options_set_max_line (GMimeFormatOptions *options, guint maxline)
 gboolean
 g_mime_format_options_is_hidden_header (GMimeFormatOptions *options, const char *header)
 {
-	guint i;
-	
 	g_return_val_if_fail (header != NULL, FALSE);
 	
+	return _g_mime_format_options_is_hidden (options, _g_mime_header_id_from_name (header), header);
+}
+
+
+/**
+ * _g_mime_format_options_is_hidden:
+ * @options: (nullable): a #GMimeFormatOptions or %NULL
+ * @id: the #GMimeHeaderId of the header
+ * @name: the name of the header
+ *
+ * Gets whether or not the specified header should be hidden. The
+ * @name is only consulted if @id is %GMIME_HEADER_ID_UNKNOWN.
+ *
+ * Returns: %TRUE if the header should be hidden or %FALSE otherwise.
+ **/
+gboolean
+_g_mime_format_options_is_hidden (GMimeFormatOptions *options, int id, const char *name)
+{
+	guint i;
+	
 	if (options == NULL)
 		options = default_options;
 	
+	if (id != GMIME_HEADER_ID_UNKNOWN)
+		return (options->hidden_ids & HIDDEN_ID_BIT (id)) != 0;
+	
+	if (options->hidden_unknown == 0)
+		return FALSE;
+	
 	for (i = 0; i < options->hidden->len; i++) {
-		if (!g_ascii_strcasecmp (options->hidden->pdata[i], header))
+		if (!g_ascii_strcasecmp (options->hidden->pdata[i], name))
 			return TRUE;
 	}
 	
@@ -436,10 +565,17 @@ g_mime_format_options_is_hidden_header (GMimeFormatOptions *options, const char
 void
 g_mime_format_options_add_hidden_header (GMimeFormatOptions *options, const char *header)
 {
+	GMimeHeaderId id;
+	
 	g_return_if_fail (options != NULL);
 	g_return_if_fail (header != NULL);
 	
 	g_ptr_array_add (options->hidden, g_strdup (header));
+	
+	if ((id = _g_mime_header_id_from_name (header)) != GMIME_HEADER_ID_UNKNOWN)
+		options->hidden_ids |= HIDDEN_ID_BIT (id);
+	else
+		options->hidden_unknown++;
 }
 
 
@@ -453,6 +589,7 @@ g_mime_format_options_add_hidden_header (GMimeFormatOptions *options, const char
 void
 g_mime_format_options_remove_hidden_header (GMimeFormatOptions *options, const char *header)
 {
+	GMimeHeaderId id;
 	guint i;
 	
 	g_return_if_fail (options != NULL);
@@ -462,6 +599,11 @@ g_mime_format_options_remove_hidden_header (GMimeFormatOptions *options, const c
 		if (!g_ascii_strcasecmp (options->hidden->pdata[i - 1], header)) {
 			g_free (options->hidden->pdata[i - 1]);
 			g_ptr_array_remove_index (options->hidden, i - 1);
+			
+			if ((id = _g_mime_header_id_from_name (header)) != GMIME_HEADER_ID_UNKNOWN)
+				options->hidden_ids &= ~HIDDEN_ID_BIT (id);
+			else
+				options->hidden_unknown--;
 		}
 	}
 }
@@ -484,4 +626,6 @@ g_mime_format_options_clear_hidden_headers (GMimeFormatOptions *options)
 		g_free (options->hidden->pdata[i]);
 	
 	g_ptr_array_set_size (options->hidden, 0);
+	options->hidden_unknown = 0;
+	options->hidden_ids = 0;
 }
@@ -98,6 +98,9 @@ GMimeFilter *g_mime_format_options_create_newline_filter (GMimeFormatOptions *op
 /*gboolean g_mime_format_options_get_max_line (GMimeFormatOptions *options);*/
 /*void g_mime_format_options_set_max_line (GMimeFormatOptions *options, gboolean maxline);*/
 
+gboolean g_mime_format_options_get_passthrough (GMimeFormatOptions *options);
+void g_mime_format_options_set_passthrough (GMimeFormatOptions *options, gboolean passthrough);
+
 gboolean g_mime_format_options_is_hidden_header (GMimeFormatOptions *options, const char *header);
 void g_mime_format_options_add_hidden_header (GMimeFormatOptions *options, const char *header);
 void g_mime_format_options_remove_hidden_header (GMimeFormatOptions *options, const char *header);
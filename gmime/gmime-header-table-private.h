@@ -0,0 +1,145 @@
+/* THIS FILE IS AUTOGENERATED: DO NOT EDIT! */
+
+/*
+ * To regenerate:
+ * make gen-header-table
+ * ./gen-header-table > gmime-header-table-private.h
+ */
+
+#ifndef __GMIME_HEADER_TABLE_PRIVATE_H__
+#define __GMIME_HEADER_TABLE_PRIVATE_H__
+
+typedef enum {
+	GMIME_HEADER_ID_UNKNOWN,
+	GMIME_HEADER_ID_RETURN_PATH,
+	GMIME_HEADER_ID_RECEIVED,
+	GMIME_HEADER_ID_DATE,
+	GMIME_HEADER_ID_FROM,
+	GMIME_HEADER_ID_SENDER,
+	GMIME_HEADER_ID_REPLY_TO,
+	GMIME_HEADER_ID_TO,
+	GMIME_HEADER_ID_CC,
+	GMIME_HEADER_ID_BCC,
+	GMIME_HEADER_ID_MESSAGE_ID,
+	GMIME_HEADER_ID_IN_REPLY_TO,
+	GMIME_HEADER_ID_REFERENCES,
+	GMIME_HEADER_ID_SUBJECT,
+	GMIME_HEADER_ID_COMMENTS,
+	GMIME_HEADER_ID_KEYWORDS,
+	GMIME_HEADER_ID_RESENT_DATE,
+	GMIME_HEADER_ID_RESENT_FROM,
+	GMIME_HEADER_ID_RESENT_SENDER,
+	GMIME_HEADER_ID_RESENT_REPLY_TO,
+	GMIME_HEADER_ID_RESENT_TO,
+	GMIME_HEADER_ID_RESENT_CC,
+	GMIME_HEADER_ID_RESENT_BCC,
+	GMIME_HEADER_ID_RESENT_MESSAGE_ID,
+	GMIME_HEADER_ID_MIME_VERSION,
+	GMIME_HEADER_ID_CONTENT_TYPE,
+	GMIME_HEADER_ID_CONTENT_TRANSFER_ENCODING,
+	GMIME_HEADER_ID_CONTENT_DISPOSITION,
+	GMIME_HEADER_ID_CONTENT_DESCRIPTION,
+	GMIME_HEADER_ID_CONTENT_ID,
+	GMIME_HEADER_ID_CONTENT_LOCATION,
+	GMIME_HEADER_ID_CONTENT_MD5,
+	GMIME_HEADER_ID_CONTENT_BASE,
+	GMIME_HEADER_ID_CONTENT_LANGUAGE,
+	GMIME_HEADER_ID_CONTENT_LENGTH,
+	GMIME_HEADER_ID_DISPOSITION_NOTIFICATION_TO,
+	GMIME_HEADER_ID_NEWSGROUPS,
+	GMIME_HEADER_ID_FOLLOWUP_TO,
+	GMIME_HEADER_ID_ORGANIZATION,
+	GMIME_HEADER_ID_LIST_ID,
+	GMIME_HEADER_ID_LIST_UNSUBSCRIBE,
+	GMIME_HEADER_ID_DELIVERED_TO,
+	GMIME_HEADER_ID_AUTHENTICATION_RESULTS,
+	GMIME_HEADER_ID_DKIM_SIGNATURE,
+	GMIME_HEADER_ID_ARC_SEAL,
+	GMIME_HEADER_ID_ARC_MESSAGE_SIGNATURE,
+	GMIME_HEADER_ID_ARC_AUTHENTICATION_RESULTS,
+	GMIME_HEADER_ID_AUTOCRYPT,
+	GMIME_HEADER_ID_AUTOCRYPT_GOSSIP,
+	GMIME_HEADER_ID_X_MAILER,
+	GMIME_HEADER_ID_LAST
+} GMimeHeaderId;
+
+#define GMIME_HEADER_ID_HASH_BITS 8
+#define GMIME_HEADER_ID_HASH_MULT 0x9e3779c1U
+
+#ifdef GMIME_HEADER_TABLE_DATA
+
+static const char *gmime_header_names[GMIME_HEADER_ID_LAST] = {
+	NULL,
+	"Return-Path",
+	"Received",
+	"Date",
+	"From",
+	"Sender",
+	"Reply-To",
+	"To",
+	"Cc",
+	"Bcc",
+	"Message-Id",
+	"In-Reply-To",
+	"References",
+	"Subject",
+	"Comments",
+	"Keywords",
+	"Resent-Date",
+	"Resent-From",
+	"Resent-Sender",
+	"Resent-Reply-To",
+	"Resent-To",
+	"Resent-Cc",
+	"Resent-Bcc",
+	"Resent-Message-Id",
+	"MIME-Version",
+	"Content-Type",
+	"Content-Transfer-Encoding",
+	"Content-Disposition",
+	"Content-Description",
+	"Content-Id",
+	"Content-Location",
+	"Content-Md5",
+	"Content-Base",
+	"Content-Language",
+	"Content-Length",
+	"Disposition-Notification-To",
+	"Newsgroups",
+	"Followup-To",
+	"Organization",
+	"List-Id",
+	"List-Unsubscribe",
+	"Delivered-To",
+	"Authentication-Results",
+	"DKIM-Signature",
+	"ARC-Seal",
+	"ARC-Message-Signature",
+	"ARC-Authentication-Results",
+	"Autocrypt",
+	"Autocrypt-Gossip",
+	"X-Mailer",
+};
+
+static const unsigned char gmime_header_id_slots[1 << GMIME_HEADER_ID_HASH_BITS] = {
+	 0, 23, 45,  0,  0,  0,  0, 13,  0,  0,  0, 40,  0,  7,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0, 11,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0, 37,  0,  9,  0,  0, 46,  2,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  3,  0, 27,  0,  0,  0,  0,  0,  0,  0, 31,
+	 0,  0,  0,  0,  0,  0,  6,  0,  0,  0,  0, 12, 44,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0, 43,  0,  0,  0, 47,  0,  0,  0, 36,
+	19,  0,  0,  0,  0,  0, 10,  0,  0,  0,  0,  0, 34,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1, 14,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 28,  0,
+	 0,  0,  0,  0,  0, 48,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	17,  0, 21,  0,  0,  0,  0,  0,  0,  0, 39, 29,  0,  5,  0,  0,
+	 0,  0,  0,  0,  0,  0, 41,  0,  0,  0,  0, 24,  0,  0,  0,  0,
+	 0, 20,  0,  0, 49, 15,  0, 33,  0,  0,  0, 32,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0, 26,  0, 42,  0,  0,  0,  0, 30,
+	 4,  0,  0,  0,  0,  0,  0, 22,  0,  0,  0,  0,  0,  0,  8,  0,
+	 0,  0,  0,  0, 16,  0, 25,  0,  0,  0,  0,  0, 18, 35, 38,  0
+};
+
+#endif /* GMIME_HEADER_TABLE_DATA */
+
+#endif /* __GMIME_HEADER_TABLE_PRIVATE_H__ */
@@ -26,6 +26,10 @@
 #include <string.h>
 #include <ctype.h>
 
+/* also pull in the name and slot tables behind GMimeHeaderId */
+#define GMIME_HEADER_TABLE_DATA
+#include "gmime-header-table-private.h"
+
 #include "gmime-stream-filter.h"
 #include "gmime-table-private.h"
 #include "gmime-parse-utils.h"
@@ -36,6 +40,7 @@
 #include "gmime-common.h"
 #include "gmime-header.h"
 #include "gmime-events.h"
+#include "gmime-arena.h"
 #include "gmime-utils.h"
 
 
@@ -51,31 +56,31 @@
 
 
 static struct {
-	const char *name;
+	GMimeHeaderId id;
 	GMimeHeaderRawValueFormatter formatter;
 } formatters[] = {
-	{ "Received",                    g_mime_header_format_received            },
-	{ "Sender",                      g_mime_header_format_addrlist            },
-	{ "From",                        g_mime_header_format_addrlist            },
-	{ "Reply-To",                    g_mime_header_format_addrlist            },
-	{ "To",                          g_mime_header_format_addrlist            },
-	{ "Cc",                          g_mime_header_format_addrlist            },
-	{ "Bcc",                         g_mime_header_format_addrlist            },
-	{ "Message-Id",                  g_mime_header_format_message_id          },
-	{ "In-Reply-To",                 g_mime_header_format_references          },
-	{ "References",                  g_mime_header_format_references          },
-	{ "Resent-Sender",               g_mime_header_format_addrlist            },
-	{ "Resent-From",                 g_mime_header_format_addrlist            },
-	{ "Resent-Reply-To",             g_mime_header_format_addrlist            },
-	{ "Resent-To",                   g_mime_header_format_addrlist            },
-	{ "Resent-Cc",                   g_mime_header_format_addrlist            },
-	{ "Resent-Bcc",                  g_mime_header_format_addrlist            },
-	{ "Resent-Message-Id",           g_mime_header_format_message_id          },
-	{ "Content-Type",                g_mime_header_format_content_type        },
-	{ "Content-Disposition",         g_mime_header_format_content_disposition },
-	{ "Content-Id",                  g_mime_header_format_message_id          },
-	{ "Disposition-Notification-To", g_mime_header_format_addrlist            },
-	{ "Newsgroups",                  g_mime_header_format_newsgroups          },
+	{ GMIME_HEADER_ID_RECEIVED,                    g_mime_header_format_received            },
+	{ GMIME_HEADER_ID_SENDER,                      g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_FROM,                        g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_REPLY_TO,                    g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_TO,                          g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_CC,                          g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_BCC,                         g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_MESSAGE_ID,                  g_mime_header_format_message_id          },
+	{ GMIME_HEADER_ID_IN_REPLY_TO,                 g_mime_header_format_references          },
+	{ GMIME_HEADER_ID_REFERENCES,                  g_mime_header_format_references          },
+	{ GMIME_HEADER_ID_RESENT_SENDER,               g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_FROM,                 g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_REPLY_TO,             g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_TO,                   g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_CC,                   g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_BCC,                  g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_RESENT_MESSAGE_ID,           g_mime_header_format_message_id          },
+	{ GMIME_HEADER_ID_CONTENT_TYPE,                g_mime_header_format_content_type        },
+	{ GMIME_HEADER_ID_CONTENT_DISPOSITION,         g_mime_header_format_content_disposition },
+	{ GMIME_HEADER_ID_CONTENT_ID,                  g_mime_header_format_message_id          },
+	{ GMIME_HEADER_ID_DISPOSITION_NOTIFICATION_TO, g_mime_header_format_addrlist            },
+	{ GMIME_HEADER_ID_NEWSGROUPS,                  g_mime_header_format_newsgroups          },
 };
 
 
@@ -83,7 +88,16 @@ static void g_mime_header_class_init (GMimeHeaderClass *klass);
 static void g_mime_header_init (GMimeHeader *header, GMimeHeaderClass *klass);
 static void g_mime_header_finalize (GObject *object);
 
+typedef struct {
+	/* the parser arena that owns the name and raw strings, if any */
+	GMimeArena *arena;
+	int id;
+} GMimeHeaderPrivate;
+
+#define GMIME_HEADER_PRIVATE(header) ((GMimeHeaderPrivate *) G_STRUCT_MEMBER_P (header, header_private_offset))
+
 static GObjectClass *parent_class = NULL;
+static gint header_private_offset = 0;
 
 
 GType
@@ -105,6 +119,7 @@ g_mime_header_get_type (void)
 		};
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeHeader", &info, 0);
+		header_private_offset = g_type_add_instance_private (type, sizeof (GMimeHeaderPrivate));
 	}
 	
 	return type;
@@ -116,6 +131,7 @@ g_mime_header_class_init (GMimeHeaderClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &header_private_offset);
 	
 	object_class->finalize = g_mime_header_finalize;
 }
@@ -133,24 +149,78 @@ g_mime_header_init (GMimeHeader *header, GMimeHeaderClass *klass)
 	header->value = NULL;
 	header->name = NULL;
 	header->offset = -1;
+	GMIME_HEADER_PRIVATE (header)->arena = NULL;
+	GMIME_HEADER_PRIVATE (header)->id = GMIME_HEADER_ID_UNKNOWN;
+}
+
+static void
+header_free_string (GMimeHeader *header, char *str)
+{
+	GMimeArena *arena = GMIME_HEADER_PRIVATE (header)->arena;
+	
+	/* strings owned by the parser's arena are freed along with it */
+	if (arena == NULL || str == NULL || !g_mime_arena_contains (arena, str))
+		g_free (str);
 }
 
 static void
 g_mime_header_finalize (GObject *object)
 {
+	GMimeHeaderPrivate *priv = GMIME_HEADER_PRIVATE (object);
 	GMimeHeader *header = (GMimeHeader *) object;
 	
 	g_mime_event_free (header->changed);
-	g_free (header->raw_value);
-	g_free (header->raw_name);
+	header_free_string (header, header->raw_value);
+	header_free_string (header, header->raw_name);
+	header_free_string (header, header->name);
 	g_free (header->charset);
 	g_free (header->value);
-	g_free (header->name);
+	
+	if (priv->arena)
+		g_mime_arena_unref (priv->arena);
 	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 
+/* must match header_hash() in gen-header-table.c */
+static guint32
+header_id_hash (const char *name)
+{
+	guint32 h = 0;
+	
+	while (*name != '\0') {
+		h = (h << 5) - h + (unsigned char) g_ascii_tolower (*name);
+		name++;
+	}
+	
+	return h;
+}
+
+GMimeHeaderId
+_g_mime_header_id_from_name (const char *name)
+{
+	guint32 slot;
+	int id;
+	
+	/* the perfect hash picks the only candidate, which may still
+	 * be a different header that happens to share its slot */
+	slot = (header_id_hash (name) * GMIME_HEADER_ID_HASH_MULT) >> (32 - GMIME_HEADER_ID_HASH_BITS);
+	id = gmime_header_id_slots[slot];
+	
+	if (id == GMIME_HEADER_ID_UNKNOWN || g_ascii_strcasecmp (gmime_header_names[id], name) != 0)
+		return GMIME_HEADER_ID_UNKNOWN;
+	
+	return (GMimeHeaderId) id;
+}
+
+int
+_g_mime_header_get_id (GMimeHeader *header)
+{
+	return GMIME_HEADER_PRIVATE (header)->id;
+}
+
+
 /**
  * g_mime_header_new:
  * @options: (nullable): a #GMimeParserOptions or %NULL
@@ -159,33 +229,45 @@ g_mime_header_finalize (GObject *object)
  * @raw_value: raw header value
  * @charset: a charset
  * @offset: file/stream offset for the start of the header (or %-1 if unknown)
+ * @arena: (nullable): the #GMimeArena that @name, @raw_name and @raw_value were allocated from
  *
- * Creates a new #GMimeHeader.
+ * Creates a new #GMimeHeader. If @arena is non-%NULL, the header takes
+ * ownership of the arena strings instead of copying them.
  *
  * Returns: a new #GMimeHeader with the specified values.
  **/
 static GMimeHeader *
 g_mime_header_new (GMimeParserOptions *options, const char *name, const char *value,
 		   const char *raw_name, const char *raw_value, const char *charset,
-		   gint64 offset)
+		   gint64 offset, GMimeArena *arena)
 {
 	GMimeHeaderRawValueFormatter formatter;
 	GMimeHeader *header;
 	guint i;
+	int id;
 	
 	header = g_object_new (GMIME_TYPE_HEADER, NULL);
-	header->raw_value = raw_value ? g_strdup (raw_value) : NULL;
+	if (arena != NULL) {
+		GMIME_HEADER_PRIVATE (header)->arena = g_mime_arena_ref (arena);
+		header->raw_value = (char *) raw_value;
+		header->raw_name = (char *) raw_name;
+		header->name = (char *) name;
+	} else {
+		header->raw_value = raw_value ? g_strdup (raw_value) : NULL;
+		header->raw_name = g_strdup (raw_name);
+		header->name = g_strdup (name);
+	}
 	header->charset = charset ? g_strdup (charset) : NULL;
 	header->value = value ? g_strdup (value) : NULL;
-	header->raw_name = g_strdup (raw_name);
-	header->name = g_strdup (name);
 	header->reformat = !raw_value;
 	header->options = options;
 	header->offset = offset;
 	
+	id = GMIME_HEADER_PRIVATE (header)->id = _g_mime_header_id_from_name (name);
+	
 	formatter = g_mime_header_format_default;
-	for (i = 0; i < G_N_ELEMENTS (formatters); i++) {
-		if (!g_ascii_strcasecmp (formatters[i].name, name)) {
+	for (i = 0; i < G_N_ELEMENTS (formatters) && id != GMIME_HEADER_ID_UNKNOWN; i++) {
+		if (formatters[i].id == id) {
 			formatter = header->formatter = formatters[i].formatter;
 			break;
 		}
@@ -260,7 +342,7 @@ g_mime_header_set_value (GMimeHeader *header, GMimeFormatOptions *options, const
 	
 	formatter = header->formatter ? header->formatter : g_mime_header_format_default;
 	buf = g_mime_strdup_trim (value);
-	g_free (header->raw_value);
+	header_free_string (header, header->raw_value);
 	g_free (header->charset);
 	g_free (header->value);
 	
@@ -342,7 +424,7 @@ g_mime_header_set_raw_value (GMimeHeader *header, const char *raw_value)
 	g_return_if_fail (raw_value != NULL);
 	
 	buf = g_strdup (raw_value);
-	g_free (header->raw_value);
+	header_free_string (header, header->raw_value);
 	g_free (header->value);
 
 	header->reformat = FALSE;
@@ -377,6 +459,33 @@ _g_mime_header_set_offset (GMimeHeader *header, gint64 offset)
 }
 
 
+/* gets the raw value to write out for @header; the caller must free
+ * the result if it is not header->raw_value */
+static char *
+header_get_raw_value (GMimeHeader *header, GMimeFormatOptions *options)
+{
+	GMimeHeaderRawValueFormatter formatter;
+	
+	if (!header->reformat)
+		return header->raw_value;
+	
+	formatter = header->formatter ? header->formatter : g_mime_header_format_default;
+	
+	return formatter (header, options, header->value, header->charset);
+}
+
+static void
+header_vector_init (GMimeStreamIOVector *vector, const char *raw_name, const char *raw_value)
+{
+	vector[0].data = (char *) raw_name;
+	vector[0].len = strlen (raw_name);
+	vector[1].data = ":";
+	vector[1].len = 1;
+	vector[2].data = (char *) raw_value;
+	vector[2].len = strlen (raw_value);
+}
+
+
 /**
  * g_mime_header_write_to_stream:
  * @header: a #GMimeHeader
@@ -390,36 +499,25 @@ _g_mime_header_set_offset (GMimeHeader *header, gint64 offset)
 ssize_t
 g_mime_header_write_to_stream (GMimeHeader *header, GMimeFormatOptions *options, GMimeStream *stream)
 {
-	GMimeHeaderRawValueFormatter formatter;
-	ssize_t nwritten, total = 0;
-	char *raw_value, *buf;
+	GMimeStreamIOVector vector[3];
+	gint64 nwritten;
+	char *raw_value;
 	
 	g_return_val_if_fail (GMIME_IS_HEADER (header), -1);
 	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
 	
 	if (!header->raw_value)
 		return 0;
-
-	if (header->reformat) {
-		formatter = header->formatter ? header->formatter : g_mime_header_format_default;
-		raw_value = formatter (header, options, header->value, header->charset);
-	} else {
-		raw_value = header->raw_value;
-	}
-	
-	buf = g_strdup_printf ("%s:%s", header->raw_name, raw_value);
-	nwritten = g_mime_stream_write_string (stream, buf);
 	
-	if (header->reformat)
-		g_free (raw_value);
-	g_free (buf);
+	raw_value = header_get_raw_value (header, options);
+	header_vector_init (vector, header->raw_name, raw_value);
 	
-	if (nwritten == -1)
-		return -1;
+	nwritten = g_mime_stream_writev (stream, vector, 3);
 	
-	total += nwritten;
+	if (raw_value != header->raw_value)
+		g_free (raw_value);
 	
-	return total;
+	return (ssize_t) nwritten;
 }
 
 
@@ -987,12 +1085,46 @@ header_changed (GMimeHeader *header, gpointer user_args, GMimeHeaderList *list)
 }
 
 
+/* Parsed headers that nobody has asked for yet are kept as slots that
+ * point at the parser's arena strings instead of as GMimeHeader objects.
+ * Their entries in the header array are NULL until a GMimeHeader is
+ * materialized for them. */
+typedef struct {
+	const char *name;
+	const char *raw_name;
+	const char *raw_value;
+	gint64 offset;
+	int id;
+} HeaderSlot;
+
+typedef struct {
+	GMimeArena *arena;
+	GArray *slots;
+} HeaderCompact;
+
+static void
+header_compact_free (HeaderCompact *compact)
+{
+	g_mime_arena_unref (compact->arena);
+	g_array_free (compact->slots, TRUE);
+	g_slice_free (HeaderCompact, compact);
+}
+
 static void g_mime_header_list_class_init (GMimeHeaderListClass *klass);
 static void g_mime_header_list_init (GMimeHeaderList *list, GMimeHeaderListClass *klass);
 static void g_mime_header_list_finalize (GObject *object);
 
 
+typedef struct {
+	/* the first instance of each well-known header, by GMimeHeaderId */
+	GMimeHeader *known[GMIME_HEADER_ID_LAST];
+	HeaderCompact *compact;
+} GMimeHeaderListPrivate;
+
+#define GMIME_HEADER_LIST_PRIVATE(list) ((GMimeHeaderListPrivate *) G_STRUCT_MEMBER_P (list, list_private_offset))
+
 static GObjectClass *list_parent_class = NULL;
+static gint list_private_offset = 0;
 
 
 GType
@@ -1014,6 +1146,7 @@ g_mime_header_list_get_type (void)
 		};
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeHeaderList", &info, 0);
+		list_private_offset = g_type_add_instance_private (type, sizeof (GMimeHeaderListPrivate));
 	}
 	
 	return type;
@@ -1026,6 +1159,7 @@ g_mime_header_list_class_init (GMimeHeaderListClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	list_parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &list_private_offset);
 	
 	object_class->finalize = g_mime_header_list_finalize;
 }
@@ -1035,6 +1169,7 @@ g_mime_header_list_init (GMimeHeaderList *list, GMimeHeaderListClass *klass)
 {
 	list->hash = g_hash_table_new (g_mime_strcase_hash,
 				       g_mime_strcase_equal);
+	GMIME_HEADER_LIST_PRIVATE (list)->compact = NULL;
 	list->changed = g_mime_event_new (list);
 	list->array = g_ptr_array_new ();
 }
@@ -1042,16 +1177,22 @@ g_mime_header_list_init (GMimeHeaderList *list, GMimeHeaderListClass *klass)
 static void
 g_mime_header_list_finalize (GObject *object)
 {
+	GMimeHeaderListPrivate *priv = GMIME_HEADER_LIST_PRIVATE (object);
 	GMimeHeaderList *headers = (GMimeHeaderList *) object;
 	GMimeHeader *header;
 	guint i;
 	
 	for (i = 0; i < headers->array->len; i++) {
-		header = (GMimeHeader *) headers->array->pdata[i];
+		if (!(header = (GMimeHeader *) headers->array->pdata[i]))
+			continue;
+		
 		g_mime_event_remove (header->changed, (GMimeEventCallback) header_changed, headers);
 		g_object_unref (header);
 	}
 	
+	if (priv->compact)
+		header_compact_free (priv->compact);
+	
 	g_ptr_array_free (headers->array, TRUE);
 	
 	g_mime_parser_options_free (headers->options);
@@ -1062,6 +1203,172 @@ g_mime_header_list_finalize (GObject *object)
 }
 
 
+static gboolean
+name_equal (int id, const char *name, int other_id, const char *other_name)
+{
+	/* well-known names always map to the same id, so the strings
+	 * only need comparing when neither name has one */
+	if (id != GMIME_HEADER_ID_UNKNOWN || other_id != GMIME_HEADER_ID_UNKNOWN)
+		return id == other_id;
+	
+	return !g_ascii_strcasecmp (name, other_name);
+}
+
+static GMimeHeader *
+header_list_materialize (GMimeHeaderList *headers, guint index)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeHeader *header;
+	HeaderSlot *slot;
+	
+	if ((header = headers->array->pdata[index]) != NULL)
+		return header;
+	
+	slot = &g_array_index (compact->slots, HeaderSlot, index);
+	header = g_mime_header_new (headers->options, slot->name, NULL, slot->raw_name, slot->raw_value,
+				    NULL, slot->offset, compact->arena);
+	g_mime_event_add (header->changed, (GMimeEventCallback) header_changed, headers);
+	headers->array->pdata[index] = header;
+	
+	return header;
+}
+
+/* finds the first header named @name without materializing anything */
+static int
+header_list_scan (GMimeHeaderList *headers, GMimeHeaderId id, const char *name)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeHeader *header;
+	HeaderSlot *slot;
+	guint i;
+	
+	for (i = 0; i < headers->array->len; i++) {
+		if ((header = headers->array->pdata[i]) != NULL) {
+			if (name_equal (_g_mime_header_get_id (header), header->name, id, name))
+				return (int) i;
+		} else {
+			slot = &g_array_index (compact->slots, HeaderSlot, i);
+			if (name_equal (slot->id, slot->name, id, name))
+				return (int) i;
+		}
+	}
+	
+	return -1;
+}
+
+/* The first instance of each well-known header is indexed by its
+ * GMimeHeaderId; only the remaining names go through the hash table.
+ * Compact lists are scanned instead and only get an index once they
+ * have been inflated. */
+static GMimeHeader *
+header_list_lookup (GMimeHeaderList *headers, const char *name)
+{
+	GMimeHeaderId id = _g_mime_header_id_from_name (name);
+	int index;
+	
+	if (GMIME_HEADER_LIST_PRIVATE (headers)->compact != NULL) {
+		if ((index = header_list_scan (headers, id, name)) == -1)
+			return NULL;
+		
+		return header_list_materialize (headers, index);
+	}
+	
+	if (id != GMIME_HEADER_ID_UNKNOWN)
+		return GMIME_HEADER_LIST_PRIVATE (headers)->known[id];
+	
+	return g_hash_table_lookup (headers->hash, name);
+}
+
+static GMimeHeader *
+header_list_first (GMimeHeaderList *headers, GMimeHeader *header)
+{
+	int id = _g_mime_header_get_id (header);
+	
+	if (id != GMIME_HEADER_ID_UNKNOWN)
+		return GMIME_HEADER_LIST_PRIVATE (headers)->known[id];
+	
+	return g_hash_table_lookup (headers->hash, header->name);
+}
+
+static void
+header_list_index (GMimeHeaderList *headers, GMimeHeader *header)
+{
+	int id = _g_mime_header_get_id (header);
+	
+	if (id != GMIME_HEADER_ID_UNKNOWN)
+		GMIME_HEADER_LIST_PRIVATE (headers)->known[id] = header;
+	else
+		g_hash_table_replace (headers->hash, header->name, header);
+}
+
+static void
+header_list_unindex (GMimeHeaderList *headers, GMimeHeader *header)
+{
+	int id = _g_mime_header_get_id (header);
+	
+	if (id != GMIME_HEADER_ID_UNKNOWN)
+		GMIME_HEADER_LIST_PRIVATE (headers)->known[id] = NULL;
+	else
+		g_hash_table_remove (headers->hash, header->name);
+}
+
+static void
+header_list_clear_index (GMimeHeaderList *headers)
+{
+	GMimeHeaderListPrivate *priv = GMIME_HEADER_LIST_PRIVATE (headers);
+	
+	memset (priv->known, 0, sizeof (priv->known));
+	g_hash_table_remove_all (headers->hash);
+}
+
+static gboolean
+header_name_equal (GMimeHeader *header, GMimeHeader *other)
+{
+	return name_equal (_g_mime_header_get_id (header), header->name, _g_mime_header_get_id (other), other->name);
+}
+
+/* materializes every header and rebuilds the lookup index; this is
+ * done before any change other than an append */
+static void
+header_list_inflate (GMimeHeaderList *headers)
+{
+	GMimeHeaderListPrivate *priv = GMIME_HEADER_LIST_PRIVATE (headers);
+	GMimeHeader *header;
+	guint i;
+	
+	if (priv->compact == NULL)
+		return;
+	
+	header_list_clear_index (headers);
+	
+	for (i = 0; i < headers->array->len; i++) {
+		header = header_list_materialize (headers, i);
+		
+		if (!header_list_first (headers, header))
+			header_list_index (headers, header);
+	}
+	
+	header_compact_free (priv->compact);
+	priv->compact = NULL;
+}
+
+static void
+header_list_add (GMimeHeaderList *headers, GMimeHeader *header)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	
+	g_mime_event_add (header->changed, (GMimeEventCallback) header_changed, headers);
+	g_ptr_array_add (headers->array, header);
+	
+	if (compact != NULL) {
+		/* keep the slots parallel to the array */
+		g_array_set_size (compact->slots, headers->array->len);
+	} else if (!header_list_first (headers, header)) {
+		header_list_index (headers, header);
+	}
+}
+
+
 /**
  * g_mime_header_list_new:
  * @options: (nullable): a #GMimeParserOptions or %NULL
@@ -1091,6 +1398,7 @@ g_mime_header_list_new (GMimeParserOptions *options)
 void
 g_mime_header_list_clear (GMimeHeaderList *headers)
 {
+	GMimeHeaderListPrivate *priv = GMIME_HEADER_LIST_PRIVATE (headers);
 	GMimeHeaderListChangedEventArgs args;
 	GMimeHeader *header;
 	guint i;
@@ -1098,12 +1406,19 @@ g_mime_header_list_clear (GMimeHeaderList *headers)
 	g_return_if_fail (GMIME_IS_HEADER_LIST (headers));
 	
 	for (i = 0; i < headers->array->len; i++) {
-		header = (GMimeHeader *) headers->array->pdata[i];
+		if (!(header = (GMimeHeader *) headers->array->pdata[i]))
+			continue;
+		
 		g_mime_event_remove (header->changed, (GMimeEventCallback) header_changed, headers);
 		g_object_unref (header);
 	}
 	
-	g_hash_table_remove_all (headers->hash);
+	if (priv->compact) {
+		header_compact_free (priv->compact);
+		priv->compact = NULL;
+	}
+	
+	header_list_clear_index (headers);
 	
 	g_ptr_array_set_size (headers->array, 0);
 	
@@ -1162,7 +1477,10 @@ g_mime_header_list_contains (GMimeHeaderList *headers, const char *name)
 	g_return_val_if_fail (GMIME_IS_HEADER_LIST (headers), FALSE);
 	g_return_val_if_fail (name != NULL, FALSE);
 	
-	if (!(header = g_hash_table_lookup (headers->hash, name)))
+	if (GMIME_HEADER_LIST_PRIVATE (headers)->compact != NULL)
+		return header_list_scan (headers, _g_mime_header_id_from_name (name), name) != -1;
+	
+	if (!(header = header_list_lookup (headers, name)))
 		return FALSE;
 	
 	return TRUE;
@@ -1191,9 +1509,11 @@ g_mime_header_list_prepend (GMimeHeaderList *headers, const char *name, const ch
 	g_return_if_fail (GMIME_IS_HEADER_LIST (headers));
 	g_return_if_fail (name != NULL);
 	
-	header = g_mime_header_new (headers->options, name, value, name, NULL, charset, -1);
+	header_list_inflate (headers);
+	
+	header = g_mime_header_new (headers->options, name, value, name, NULL, charset, -1, NULL);
 	g_mime_event_add (header->changed, (GMimeEventCallback) header_changed, headers);
-	g_hash_table_replace (headers->hash, header->name, header);
+	header_list_index (headers, header);
 	
 	if (headers->array->len > 0) {
 		args.action = GMIME_HEADER_LIST_CHANGED_ACTION_INSERTED;
@@ -1218,17 +1538,13 @@ g_mime_header_list_prepend (GMimeHeaderList *headers, const char *name, const ch
 
 void
 _g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const char *raw_name,
-			    const char *raw_value, gint64 offset)
+			    const char *raw_value, gint64 offset, GMimeArena *arena)
 {
 	GMimeHeaderListChangedEventArgs args;
 	GMimeHeader *header;
 	
-	header = g_mime_header_new (headers->options, name, NULL, raw_name, raw_value, NULL, offset);
-	g_mime_event_add (header->changed, (GMimeEventCallback) header_changed, headers);
-	g_ptr_array_add (headers->array, header);
-	
-	if (!g_hash_table_lookup (headers->hash, name))
-		g_hash_table_insert (headers->hash, header->name, header);
+	header = g_mime_header_new (headers->options, name, NULL, raw_name, raw_value, NULL, offset, arena);
+	header_list_add (headers, header);
 	
 	args.action = GMIME_HEADER_LIST_CHANGED_ACTION_ADDED;
 	args.header = header;
@@ -1237,6 +1553,41 @@ _g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const ch
 }
 
 
+void
+_g_mime_header_list_append_compact (GMimeHeaderList *headers, int id, const char *name, const char *raw_name,
+				    const char *raw_value, gint64 offset, GMimeArena *arena)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	HeaderSlot *slot;
+	
+	if (compact != NULL && compact->arena != arena) {
+		/* the slots can only refer to strings in a single arena */
+		header_list_inflate (headers);
+		compact = NULL;
+	}
+	
+	if (compact == NULL) {
+		compact = g_slice_new (HeaderCompact);
+		compact->slots = g_array_sized_new (FALSE, TRUE, sizeof (HeaderSlot), headers->array->len + 16);
+		g_array_set_size (compact->slots, headers->array->len);
+		compact->arena = g_mime_arena_ref (arena);
+		GMIME_HEADER_LIST_PRIVATE (headers)->compact = compact;
+	}
+	
+	/* no GMimeHeader is created and no event is emitted until
+	 * somebody asks for this header */
+	g_ptr_array_add (headers->array, NULL);
+	g_array_set_size (compact->slots, headers->array->len);
+	
+	slot = &g_array_index (compact->slots, HeaderSlot, headers->array->len - 1);
+	slot->raw_value = raw_value;
+	slot->raw_name = raw_name;
+	slot->offset = offset;
+	slot->name = name;
+	slot->id = id;
+}
+
+
 /**
  * g_mime_header_list_append:
  * @headers: a #GMimeHeaderList
@@ -1257,12 +1608,8 @@ g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const cha
 	g_return_if_fail (GMIME_IS_HEADER_LIST (headers));
 	g_return_if_fail (name != NULL);
 	
-	header = g_mime_header_new (headers->options, name, value, name, NULL, charset, -1);
-	g_mime_event_add (header->changed, (GMimeEventCallback) header_changed, headers);
-	g_ptr_array_add (headers->array, header);
-	
-	if (!g_hash_table_lookup (headers->hash, name))
-		g_hash_table_insert (headers->hash, header->name, header);
+	header = g_mime_header_new (headers->options, name, value, name, NULL, charset, -1, NULL);
+	header_list_add (headers, header);
 	
 	args.action = GMIME_HEADER_LIST_CHANGED_ACTION_ADDED;
 	args.header = header;
@@ -1286,7 +1633,7 @@ g_mime_header_list_get_header (GMimeHeaderList *headers, const char *name)
 	g_return_val_if_fail (GMIME_IS_HEADER_LIST (headers), NULL);
 	g_return_val_if_fail (name != NULL, NULL);
 	
-	return g_hash_table_lookup (headers->hash, name);
+	return header_list_lookup (headers, name);
 }
 
 
@@ -1300,7 +1647,9 @@ _g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char
 	g_return_if_fail (GMIME_IS_HEADER_LIST (headers));
 	g_return_if_fail (name != NULL);
 	
-	if ((header = g_hash_table_lookup (headers->hash, name))) {
+	header_list_inflate (headers);
+	
+	if ((header = header_list_lookup (headers, name))) {
 		g_mime_header_set_raw_value (header, raw_value);
 		
 		for (i = headers->array->len - 1; i > 0; i--) {
@@ -1309,7 +1658,7 @@ _g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char
 			if (hdr == header)
 				break;
 			
-			if (g_ascii_strcasecmp (header->name, hdr->name) != 0)
+			if (!header_name_equal (header, hdr))
 				continue;
 			
 			g_mime_event_remove (hdr->changed, (GMimeEventCallback) header_changed, headers);
@@ -1322,7 +1671,7 @@ _g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char
 		
 		g_mime_event_emit (headers->changed, &args);
 	} else {
-		_g_mime_header_list_append (headers, name, name, raw_value, -1);
+		_g_mime_header_list_append (headers, name, name, raw_value, -1, NULL);
 	}
 }
 
@@ -1353,7 +1702,9 @@ g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char *
 	g_return_if_fail (GMIME_IS_HEADER_LIST (headers));
 	g_return_if_fail (name != NULL);
 	
-	if ((header = g_hash_table_lookup (headers->hash, name))) {
+	header_list_inflate (headers);
+	
+	if ((header = header_list_lookup (headers, name))) {
 		g_mime_header_set_value (header, NULL, value, charset);
 		
 		for (i = headers->array->len - 1; i > 0; i--) {
@@ -1362,7 +1713,7 @@ g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char *
 			if (hdr == header)
 				break;
 			
-			if (g_ascii_strcasecmp (header->name, hdr->name) != 0)
+			if (!header_name_equal (header, hdr))
 				continue;
 			
 			g_mime_event_remove (hdr->changed, (GMimeEventCallback) header_changed, headers);
@@ -1398,7 +1749,7 @@ g_mime_header_list_get_header_at (GMimeHeaderList *headers, int index)
 	if ((guint) index >= headers->array->len)
 		return NULL;
 	
-	return (GMimeHeader *) headers->array->pdata[index];
+	return header_list_materialize (headers, (guint) index);
 }
 
 
@@ -1422,7 +1773,9 @@ g_mime_header_list_remove (GMimeHeaderList *headers, const char *name)
 	g_return_val_if_fail (GMIME_IS_HEADER_LIST (headers), FALSE);
 	g_return_val_if_fail (name != NULL, FALSE);
 	
-	if (!(header = g_hash_table_lookup (headers->hash, name)))
+	header_list_inflate (headers);
+	
+	if (!(header = header_list_lookup (headers, name)))
 		return FALSE;
 	
 	/* get the index of the header */
@@ -1433,7 +1786,7 @@ g_mime_header_list_remove (GMimeHeaderList *headers, const char *name)
 	
 	g_mime_event_remove (header->changed, (GMimeEventCallback) header_changed, headers);
 	g_ptr_array_remove_index (headers->array, i);
-	g_hash_table_remove (headers->hash, name);
+	header_list_unindex (headers, header);
 
 	args.action = GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED;
 	args.header = header;
@@ -1442,9 +1795,9 @@ g_mime_header_list_remove (GMimeHeaderList *headers, const char *name)
 	while (i < headers->array->len) {
 		hdr = (GMimeHeader *) headers->array->pdata[i];
 		
-		if (!g_ascii_strcasecmp (hdr->name, name)) {
+		if (header_name_equal (hdr, header)) {
 			/* enter this node into the lookup table */
-			g_hash_table_insert (headers->hash, hdr->name, hdr);
+			header_list_index (headers, hdr);
 			break;
 		}
 		
@@ -1478,20 +1831,22 @@ g_mime_header_list_remove_at (GMimeHeaderList *headers, int index)
 	if ((guint) index >= headers->array->len)
 		return;
 	
+	header_list_inflate (headers);
+	
 	header = (GMimeHeader *) headers->array->pdata[index];
 	g_mime_event_remove (header->changed, (GMimeEventCallback) header_changed, headers);
 	g_ptr_array_remove_index (headers->array, index);
 	
 	/* if this is the first instance of a header with this name, then we'll
 	 * need to update the hash table to point to the next instance... */
-	if ((hdr = g_hash_table_lookup (headers->hash, header->name)) == header) {
-		g_hash_table_remove (headers->hash, header->name);
+	if ((hdr = header_list_first (headers, header)) == header) {
+		header_list_unindex (headers, header);
 		
 		for (i = (guint) index; i < headers->array->len; i++) {
 			hdr = (GMimeHeader *) headers->array->pdata[i];
 			
-			if (!g_ascii_strcasecmp (header->name, hdr->name)) {
-				g_hash_table_insert (headers->hash, hdr->name, hdr);
+			if (header_name_equal (header, hdr)) {
+				header_list_index (headers, hdr);
 				break;
 			}
 		}
@@ -1505,6 +1860,67 @@ g_mime_header_list_remove_at (GMimeHeaderList *headers, int index)
 }
 
 
+gint64
+_g_mime_header_list_get_offset_at (GMimeHeaderList *headers, int index)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeHeader *header;
+	
+	if ((header = headers->array->pdata[index]) != NULL)
+		return header->offset;
+	
+	return g_array_index (compact->slots, HeaderSlot, index).offset;
+}
+
+gboolean
+_g_mime_header_list_has_hidden (GMimeHeaderList *headers, GMimeFormatOptions *options)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeHeader *header;
+	HeaderSlot *slot;
+	guint i;
+	
+	for (i = 0; i < headers->array->len; i++) {
+		if ((header = headers->array->pdata[i]) != NULL) {
+			if (_g_mime_format_options_is_hidden (options, _g_mime_header_get_id (header), header->name))
+				return TRUE;
+		} else {
+			slot = &g_array_index (compact->slots, HeaderSlot, i);
+			if (_g_mime_format_options_is_hidden (options, slot->id, slot->name))
+				return TRUE;
+		}
+	}
+	
+	return FALSE;
+}
+
+ssize_t
+_g_mime_header_list_write_header_at (GMimeHeaderList *headers, int index, GMimeFormatOptions *options, GMimeStream *stream)
+{
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeStreamIOVector vector[3];
+	GMimeHeader *header;
+	HeaderSlot *slot;
+	
+	if ((header = headers->array->pdata[index]) != NULL) {
+		if (_g_mime_format_options_is_hidden (options, _g_mime_header_get_id (header), header->name))
+			return 0;
+		
+		return g_mime_header_write_to_stream (header, options, stream);
+	}
+	
+	slot = &g_array_index (compact->slots, HeaderSlot, index);
+	if (_g_mime_format_options_is_hidden (options, slot->id, slot->name))
+		return 0;
+	
+	/* compact headers have never been modified, so their raw
+	 * strings can be written out as-is */
+	header_vector_init (vector, slot->raw_name, slot->raw_value);
+	
+	return (ssize_t) g_mime_stream_writev (stream, vector, 3);
+}
+
+
 /**
  * g_mime_header_list_write_to_stream:
  * @headers: a #GMimeHeaderList
@@ -1518,35 +1934,60 @@ g_mime_header_list_remove_at (GMimeHeaderList *headers, int index)
 ssize_t
 g_mime_header_list_write_to_stream (GMimeHeaderList *headers, GMimeFormatOptions *options, GMimeStream *stream)
 {
-	ssize_t nwritten, total = 0;
+	HeaderCompact *compact = GMIME_HEADER_LIST_PRIVATE (headers)->compact;
+	GMimeStreamIOVector *vector;
+	GPtrArray *formatted;
 	GMimeStream *filtered;
-	GMimeHeader *header;
 	GMimeFilter *filter;
+	GMimeHeader *header;
+	const char *value;
+	HeaderSlot *slot;
+	gint64 nwritten;
+	size_t n = 0;
 	guint i;
 	
 	g_return_val_if_fail (GMIME_IS_HEADER_LIST (headers), -1);
 	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
 	
-	filtered = g_mime_stream_filter_new (stream);
-	filter = g_mime_format_options_create_newline_filter (options, FALSE);
-	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-	g_object_unref (filter);
+	/* gather the entire header block so that it can be written with a
+	 * single g_mime_stream_writev() call */
+	vector = g_new (GMimeStreamIOVector, headers->array->len * 3);
+	formatted = g_ptr_array_new_with_free_func (g_free);
 	
 	for (i = 0; i < headers->array->len; i++) {
-		header = (GMimeHeader *) headers->array->pdata[i];
-		
-		if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-			if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1)
-				return -1;
+		if ((header = headers->array->pdata[i]) != NULL) {
+			if (!header->raw_value || _g_mime_format_options_is_hidden (options, _g_mime_header_get_id (header), header->name))
+				continue;
 			
-			total += nwritten;
+			if ((value = header_get_raw_value (header, options)) != header->raw_value)
+				g_ptr_array_add (formatted, (char *) value);
+			
+			header_vector_init (vector + n, header->raw_name, value);
+		} else {
+			slot = &g_array_index (compact->slots, HeaderSlot, i);
+			if (_g_mime_format_options_is_hidden (options, slot->id, slot->name))
+				continue;
+			
+			header_vector_init (vector + n, slot->raw_name, slot->raw_value);
 		}
+		
+		n += 3;
 	}
 	
+	filtered = g_mime_stream_filter_new (stream);
+	filter = g_mime_format_options_create_newline_filter (options, FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	nwritten = n > 0 ? g_mime_stream_writev (filtered, vector, n) : 0;
+	
 	g_mime_stream_flush (filtered);
 	g_object_unref (filtered);
 	
-	return total;
+	g_ptr_array_free (formatted, TRUE);
+	g_free (vector);
+	
+	return (ssize_t) nwritten;
 }
 
 
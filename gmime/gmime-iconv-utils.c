@@ -29,6 +29,8 @@
 
 #include "gmime-iconv-utils.h"
 #include "gmime-charset.h"
+#include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 #ifdef ENABLE_WARNINGS
 #define w(x) x
@@ -179,19 +181,16 @@ g_mime_iconv_strdup (iconv_t cd, const char *str)
 char *
 g_mime_iconv_locale_to_utf8 (const char *str)
 {
-	const char *locale, *utf8;
+	const char *locale;
 	iconv_t cd;
 	char *buf;
 	
 	if (!(locale = g_mime_locale_charset ()))
 		locale = "iso-8859-1";
 	
-	locale = g_mime_charset_iconv_name (locale);
-	utf8 = g_mime_charset_iconv_name ("UTF-8");
-	
-	cd = iconv_open (locale, utf8);
+	cd = _g_mime_iconv_open (locale, "UTF-8");
 	buf = g_mime_iconv_strdup (cd, str);
-	iconv_close (cd);
+	_g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -211,19 +210,16 @@ g_mime_iconv_locale_to_utf8 (const char *str)
 char *
 g_mime_iconv_locale_to_utf8_length (const char *str, size_t n)
 {
-	const char *locale, *utf8;
+	const char *locale;
 	iconv_t cd;
 	char *buf;
 	
 	if (!(locale = g_mime_locale_charset ()))
 		locale = "iso-8859-1";
 	
-	locale = g_mime_charset_iconv_name (locale);
-	utf8 = g_mime_charset_iconv_name ("UTF-8");
-	
-	cd = iconv_open (locale, utf8);
+	cd = _g_mime_iconv_open (locale, "UTF-8");
 	buf = g_mime_iconv_strndup (cd, str, n);
-	iconv_close (cd);
+	_g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -242,21 +238,18 @@ g_mime_iconv_locale_to_utf8_length (const char *str, size_t n)
 char *
 g_mime_iconv_utf8_to_locale (const char *str)
 {
-	const char *locale, *utf8;
+	const char *locale;
 	iconv_t cd;
 	char *buf;
 	
 	if (!(locale = g_mime_locale_charset ()))
 		return g_strdup (str);
 	
-	locale = g_mime_charset_iconv_name (locale);
-	utf8 = g_mime_charset_iconv_name ("UTF-8");
-	
-	if ((cd = iconv_open (utf8, locale)) == (iconv_t) -1)
+	if ((cd = _g_mime_iconv_open ("UTF-8", locale)) == (iconv_t) -1)
 		return g_strdup (str);
 	
 	buf = g_mime_iconv_strdup (cd, str);
-	iconv_close (cd);
+	_g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -276,21 +269,18 @@ g_mime_iconv_utf8_to_locale (const char *str)
 char *
 g_mime_iconv_utf8_to_locale_length (const char *str, size_t n)
 {
-	const char *locale, *utf8;
+	const char *locale;
 	iconv_t cd;
 	char *buf;
 	
 	if (!(locale = g_mime_locale_charset ()))
 		return g_strndup (str, n);
 	
-	locale = g_mime_charset_iconv_name (locale);
-	utf8 = g_mime_charset_iconv_name ("UTF-8");
-	
-	if ((cd = iconv_open (utf8, locale)) == (iconv_t) -1)
+	if ((cd = _g_mime_iconv_open ("UTF-8", locale)) == (iconv_t) -1)
 		return g_strndup (str, n);
 	
 	buf = g_mime_iconv_strndup (cd, str, n);
-	iconv_close (cd);
+	_g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -24,10 +24,13 @@
 #endif
 
 #include <glib.h>
+#include <string.h>
+#include <stdio.h>
 #include <errno.h>
 
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -42,6 +45,110 @@
  **/
 
 
+#define ICONV_CACHE_SIZE 16
+
+typedef struct _IconvCacheBucket {
+	char *key;
+	GSList *unused;
+} IconvCacheBucket;
+
+typedef struct _IconvCacheNode {
+	IconvCacheBucket *bucket;
+	GList link;
+	iconv_t cd;
+} IconvCacheNode;
+
+/* Since iconv_open(3) can be quite expensive, GMime's own conversions
+ * go through _g_mime_iconv_open() and _g_mime_iconv_close(), which keep
+ * closed descriptors around for reuse.
+ *
+ * iconv_cache maps "to:from" keys to buckets of unused descriptors for that
+ * conversion, iconv_open_cds maps the descriptors that are currently handed
+ * out to their cache nodes and iconv_cache_lru holds all of the unused
+ * descriptors, most recently used first, so that the least recently used
+ * ones can be closed once there are more than ICONV_CACHE_SIZE of them. */
+static GHashTable *iconv_cache = NULL;
+static GHashTable *iconv_open_cds = NULL;
+static GQueue iconv_cache_lru = G_QUEUE_INIT;
+static guint64 iconv_cache_hits = 0;
+static guint64 iconv_cache_misses = 0;
+static GMutex iconv_cache_lock;
+
+
+static void
+iconv_cache_bucket_free (gpointer data)
+{
+	IconvCacheBucket *bucket = data;
+	IconvCacheNode *node;
+	GSList *n;
+	
+	for (n = bucket->unused; n != NULL; n = n->next) {
+		node = n->data;
+		iconv_close (node->cd);
+		g_slice_free (IconvCacheNode, node);
+	}
+	
+	g_slist_free (bucket->unused);
+	g_free (bucket->key);
+	g_slice_free (IconvCacheBucket, bucket);
+}
+
+static void
+iconv_open_cd_free (gpointer data)
+{
+	/* the descriptor is still in use, so it is up to the caller
+	 * to close it (see _g_mime_iconv_close) */
+	g_slice_free (IconvCacheNode, data);
+}
+
+
+void
+g_mime_iconv_init (void)
+{
+	if (iconv_cache)
+		return;
+	
+	iconv_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, iconv_cache_bucket_free);
+	iconv_open_cds = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, iconv_open_cd_free);
+	iconv_cache_hits = 0;
+	iconv_cache_misses = 0;
+}
+
+
+void
+g_mime_iconv_shutdown (void)
+{
+	if (!iconv_cache)
+		return;
+	
+	g_queue_init (&iconv_cache_lru);
+	
+	g_hash_table_destroy (iconv_open_cds);
+	iconv_open_cds = NULL;
+	
+	g_hash_table_destroy (iconv_cache);
+	iconv_cache = NULL;
+}
+
+
+static gboolean
+iconv_charsets (const char **to, const char **from)
+{
+	if (*from == NULL || *to == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+	
+	if (!g_ascii_strcasecmp (*from, "x-unknown"))
+		*from = g_mime_locale_charset ();
+	
+	*from = g_mime_charset_iconv_name (*from);
+	*to = g_mime_charset_iconv_name (*to);
+	
+	return TRUE;
+}
+
+
 /**
  * g_mime_iconv_open: (skip)
  * @to: charset to convert to
@@ -61,16 +168,8 @@
 iconv_t
 g_mime_iconv_open (const char *to, const char *from)
 {
-	if (from == NULL || to == NULL) {
-		errno = EINVAL;
+	if (!iconv_charsets (&to, &from))
 		return (iconv_t) -1;
-	}
-	
-	if (!g_ascii_strcasecmp (from, "x-unknown"))
-		from = g_mime_locale_charset ();
-	
-	from = g_mime_charset_iconv_name (from);
-	to = g_mime_charset_iconv_name (to);
 	
 	return iconv_open (to, from);
 }
@@ -92,3 +191,153 @@ g_mime_iconv_close (iconv_t cd)
 {
 	return iconv_close (cd);
 }
+
+
+/*
+ * _g_mime_iconv_open:
+ * @to: charset to convert to
+ * @from: charset to convert from
+ *
+ * Like g_mime_iconv_open(), but may hand out a cached descriptor that
+ * was previously closed with _g_mime_iconv_close() (after resetting
+ * it to its initial conversion state). A descriptor is never handed
+ * out to more than one caller at a time.
+ *
+ * The returned descriptor must be closed with _g_mime_iconv_close().
+ */
+iconv_t
+_g_mime_iconv_open (const char *to, const char *from)
+{
+	IconvCacheBucket *bucket;
+	IconvCacheNode *node;
+	iconv_t cd;
+	char *key;
+	
+	if (!iconv_charsets (&to, &from))
+		return (iconv_t) -1;
+	
+	if (iconv_cache == NULL)
+		return iconv_open (to, from);
+	
+	key = g_alloca (strlen (to) + strlen (from) + 2);
+	sprintf (key, "%s:%s", to, from);
+	
+	g_mutex_lock (&iconv_cache_lock);
+	
+	if ((bucket = g_hash_table_lookup (iconv_cache, key)) && bucket->unused) {
+		node = bucket->unused->data;
+		bucket->unused = g_slist_delete_link (bucket->unused, bucket->unused);
+		g_queue_unlink (&iconv_cache_lru, &node->link);
+		g_hash_table_insert (iconv_open_cds, node->cd, node);
+		iconv_cache_hits++;
+		
+		g_mutex_unlock (&iconv_cache_lock);
+		
+		/* reset the descriptor to its initial conversion state */
+		iconv (node->cd, NULL, NULL, NULL, NULL);
+		
+		return node->cd;
+	}
+	
+	iconv_cache_misses++;
+	
+	g_mutex_unlock (&iconv_cache_lock);
+	
+	/* don't hold the lock while loading the conversion modules */
+	if ((cd = iconv_open (to, from)) == (iconv_t) -1)
+		return cd;
+	
+	g_mutex_lock (&iconv_cache_lock);
+	
+	if (!(bucket = g_hash_table_lookup (iconv_cache, key))) {
+		bucket = g_slice_new (IconvCacheBucket);
+		bucket->key = g_strdup (key);
+		bucket->unused = NULL;
+		
+		g_hash_table_insert (iconv_cache, bucket->key, bucket);
+	}
+	
+	node = g_slice_new0 (IconvCacheNode);
+	node->link.data = node;
+	node->bucket = bucket;
+	node->cd = cd;
+	
+	g_hash_table_insert (iconv_open_cds, cd, node);
+	
+	g_mutex_unlock (&iconv_cache_lock);
+	
+	return cd;
+}
+
+
+/*
+ * _g_mime_iconv_close:
+ * @cd: iconv conversion descriptor
+ *
+ * Returns a descriptor opened with _g_mime_iconv_open() to the cache,
+ * closing the least recently used cached descriptors once there are
+ * more than ICONV_CACHE_SIZE of them.
+ *
+ * Returns: %0 on success or %-1 on fail as well as setting an
+ * appropriate errno value.
+ */
+int
+_g_mime_iconv_close (iconv_t cd)
+{
+	IconvCacheNode *node;
+	GList *link;
+	
+	if (cd == (iconv_t) -1 || iconv_cache == NULL)
+		return iconv_close (cd);
+	
+	g_mutex_lock (&iconv_cache_lock);
+	
+	if (!(node = g_hash_table_lookup (iconv_open_cds, cd))) {
+		g_mutex_unlock (&iconv_cache_lock);
+		
+		return iconv_close (cd);
+	}
+	
+	g_hash_table_steal (iconv_open_cds, cd);
+	node->bucket->unused = g_slist_prepend (node->bucket->unused, node);
+	g_queue_push_head_link (&iconv_cache_lru, &node->link);
+	
+	while (iconv_cache_lru.length > ICONV_CACHE_SIZE) {
+		link = g_queue_pop_tail_link (&iconv_cache_lru);
+		node = link->data;
+		
+		node->bucket->unused = g_slist_remove (node->bucket->unused, node);
+		iconv_close (node->cd);
+		g_slice_free (IconvCacheNode, node);
+	}
+	
+	g_mutex_unlock (&iconv_cache_lock);
+	
+	return 0;
+}
+
+
+/**
+ * g_mime_iconv_get_cache_stats:
+ * @hits: (out) (optional): return location for the number of cache hits
+ * @misses: (out) (optional): return location for the number of cache misses
+ *
+ * Gets the number of times that GMime was able to reuse a cached
+ * conversion descriptor for its own charset conversions (@hits) and the
+ * number of times that it had to open a new one (@misses) since
+ * g_mime_init() was called. Descriptors opened with g_mime_iconv_open()
+ * are never cached.
+ **/
+void
+g_mime_iconv_get_cache_stats (guint64 *hits, guint64 *misses)
+{
+	g_mutex_lock (&iconv_cache_lock);
+	
+	if (hits)
+		*hits = iconv_cache_hits;
+	
+	if (misses)
+		*misses = iconv_cache_misses;
+	
+	g_mutex_unlock (&iconv_cache_lock);
+}
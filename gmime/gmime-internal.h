@@ -25,8 +25,13 @@
 #include <gmime/gmime-format-options.h>
 #include <gmime/gmime-parser-options.h>
 #include <gmime/gmime-object.h>
+#include <gmime/gmime-data-wrapper.h>
+#include <gmime/gmime-stream-fs.h>
+#include <gmime/gmime-iconv.h>
 #include <gmime/gmime-events.h>
+#include <gmime/gmime-arena.h>
 #include <gmime/gmime-utils.h>
+#include <gmime/gmime-header-table-private.h>
 
 G_BEGIN_DECLS
 
@@ -43,10 +48,34 @@ typedef struct {
 	GMimeHeader *header;
 } GMimeHeaderListChangedEventArgs;
 
+/* GMimeCharset */
+typedef enum {
+	GMIME_CHARSET_DECODER_NONE,
+	GMIME_CHARSET_DECODER_ASCII,
+	GMIME_CHARSET_DECODER_UTF8,
+	GMIME_CHARSET_DECODER_LATIN1,
+	GMIME_CHARSET_DECODER_LATIN9,
+	GMIME_CHARSET_DECODER_CP1252
+} GMimeCharsetDecoder;
+
+G_GNUC_INTERNAL GMimeCharsetDecoder _g_mime_charset_get_utf8_decoder (const char *charset);
+G_GNUC_INTERNAL size_t _g_mime_utf8_validate (const char *inbuf, size_t inlen, gboolean *incomplete);
+G_GNUC_INTERNAL size_t _g_mime_charset_decode_to_utf8 (GMimeCharsetDecoder decoder, const char *inbuf, size_t inlen,
+						       char *outbuf, int replace, gboolean flush, size_t *nread,
+						       size_t *ninval);
+
+/* gmime-iconv */
+G_GNUC_INTERNAL void g_mime_iconv_init (void);
+G_GNUC_INTERNAL void g_mime_iconv_shutdown (void);
+G_GNUC_INTERNAL iconv_t _g_mime_iconv_open (const char *to, const char *from);
+G_GNUC_INTERNAL int _g_mime_iconv_close (iconv_t cd);
+
 /* GMimeFormatOptions */
 G_GNUC_INTERNAL void g_mime_format_options_init (void);
 G_GNUC_INTERNAL void g_mime_format_options_shutdown (void);
 G_GNUC_INTERNAL GMimeFormatOptions *_g_mime_format_options_clone (GMimeFormatOptions *options, gboolean hidden);
+G_GNUC_INTERNAL gboolean _g_mime_format_options_equal (GMimeFormatOptions *options, GMimeFormatOptions *other);
+G_GNUC_INTERNAL gboolean _g_mime_format_options_is_hidden (GMimeFormatOptions *options, int id, const char *name);
 
 /* GMimeParserOptions */
 G_GNUC_INTERNAL void g_mime_parser_options_init (void);
@@ -55,6 +84,8 @@ G_GNUC_INTERNAL void _g_mime_parser_options_warn (GMimeParserOptions *options, g
 						  const gchar *item);
 
 /* GMimeHeader */
+G_GNUC_INTERNAL GMimeHeaderId _g_mime_header_id_from_name (const char *name);
+G_GNUC_INTERNAL int _g_mime_header_get_id (GMimeHeader *header);
 //G_GNUC_INTERNAL void _g_mime_header_set_raw_value (GMimeHeader *header, const char *raw_value);
 G_GNUC_INTERNAL void _g_mime_header_set_offset (GMimeHeader *header, gint64 offset);
 
@@ -62,15 +93,43 @@ G_GNUC_INTERNAL void _g_mime_header_set_offset (GMimeHeader *header, gint64 offs
 G_GNUC_INTERNAL GMimeParserOptions *_g_mime_header_list_get_options (GMimeHeaderList *headers);
 G_GNUC_INTERNAL void _g_mime_header_list_set_options (GMimeHeaderList *headers, GMimeParserOptions *options);
 G_GNUC_INTERNAL void _g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const char *raw_name,
-						 const char *raw_value, gint64 offset);
+						 const char *raw_value, gint64 offset, GMimeArena *arena);
+G_GNUC_INTERNAL void _g_mime_header_list_append_compact (GMimeHeaderList *headers, int id, const char *name, const char *raw_name,
+							 const char *raw_value, gint64 offset, GMimeArena *arena);
 G_GNUC_INTERNAL void _g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char *raw_value);
+G_GNUC_INTERNAL gint64 _g_mime_header_list_get_offset_at (GMimeHeaderList *headers, int index);
+G_GNUC_INTERNAL gboolean _g_mime_header_list_has_hidden (GMimeHeaderList *headers, GMimeFormatOptions *options);
+G_GNUC_INTERNAL ssize_t _g_mime_header_list_write_header_at (GMimeHeaderList *headers, int index, GMimeFormatOptions *options,
+							     GMimeStream *stream);
 
 /* GMimeObject */
 G_GNUC_INTERNAL void _g_mime_object_block_header_list_changed (GMimeObject *object);
 G_GNUC_INTERNAL void _g_mime_object_unblock_header_list_changed (GMimeObject *object);
 G_GNUC_INTERNAL void _g_mime_object_set_content_type (GMimeObject *object, GMimeContentType *content_type);
 G_GNUC_INTERNAL void _g_mime_object_append_header (GMimeObject *object, const char *name, const char *raw_name,
-						   const char *raw_value, gint64 offset);
+						   const char *raw_value, gint64 offset, GMimeArena *arena);
+G_GNUC_INTERNAL void _g_mime_object_set_source (GMimeObject *object, GMimeStream *source);
+G_GNUC_INTERNAL GMimeStream *_g_mime_object_get_source (GMimeObject *object);
+G_GNUC_INTERNAL gboolean _g_mime_object_can_passthrough (GMimeObject *object, GMimeFormatOptions *options);
+G_GNUC_INTERNAL ssize_t _g_mime_object_write_source (GMimeObject *object, GMimeStream *stream);
+G_GNUC_INTERNAL void _g_mime_object_set_dirty (GMimeObject *object);
+G_GNUC_INTERNAL guint _g_mime_object_next_serial (void);
+
+/* GMimeDataWrapper */
+G_GNUC_INTERNAL guint _g_mime_data_wrapper_get_modified (GMimeDataWrapper *wrapper);
+
+/* GMimeStream */
+G_GNUC_INTERNAL void _g_mime_stream_class_set_write_to_stream (GMimeStreamClass *klass,
+							       gint64 (* write_to_stream) (GMimeStream *, GMimeStream *));
+G_GNUC_INTERNAL gint64 _g_mime_stream_generic_write_to_stream (GMimeStream *src, GMimeStream *dest);
+G_GNUC_INTERNAL void _g_mime_stream_class_set_writev (GMimeStreamClass *klass,
+						      gint64 (* writev) (GMimeStream *, GMimeStreamIOVector *, size_t));
+G_GNUC_INTERNAL gint64 _g_mime_stream_generic_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
+
+/* GMimeFilterBest */
+G_GNUC_INTERNAL GMimeContentEncoding _g_mime_filter_best_pick_encoding (gint64 count0, gint64 count8, gint64 total,
+									gint64 maxline, gboolean hadfrom,
+									GMimeEncodingConstraint constraint);
 
 /* GMimeContentType */
 G_GNUC_INTERNAL GMimeContentType *_g_mime_content_type_parse (GMimeParserOptions *options, const char *str, gint64 offset);
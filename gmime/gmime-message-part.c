@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-message-part.h"
+#include "gmime-internal.h"
 
 #define d(x)
 
@@ -243,6 +244,8 @@ g_mime_message_part_set_message (GMimeMessagePart *part, GMimeMessage *message)
 		g_object_unref (part->message);
 	
 	part->message = message;
+	
+	_g_mime_object_set_dirty ((GMimeObject *) part);
 }
 
 
@@ -76,14 +76,15 @@ static GMimeObjectClass *parent_class = NULL;
 
 static struct {
 	const char *name;
+	GMimeHeaderId id;
 	GMimeEventCallback changed_cb;
 } address_types[] = {
-	{ "Sender",          (GMimeEventCallback) sender_changed          },
-	{ "From",            (GMimeEventCallback) from_changed            },
-	{ "Reply-To",        (GMimeEventCallback) reply_to_changed        },
-	{ "To",              (GMimeEventCallback) to_list_changed         },
-	{ "Cc",              (GMimeEventCallback) cc_list_changed         },
-	{ "Bcc",             (GMimeEventCallback) bcc_list_changed        },
+	{ "Sender",          GMIME_HEADER_ID_SENDER,   (GMimeEventCallback) sender_changed          },
+	{ "From",            GMIME_HEADER_ID_FROM,     (GMimeEventCallback) from_changed            },
+	{ "Reply-To",        GMIME_HEADER_ID_REPLY_TO, (GMimeEventCallback) reply_to_changed        },
+	{ "To",              GMIME_HEADER_ID_TO,       (GMimeEventCallback) to_list_changed         },
+	{ "Cc",              GMIME_HEADER_ID_CC,       (GMimeEventCallback) cc_list_changed         },
+	{ "Bcc",             GMIME_HEADER_ID_BCC,      (GMimeEventCallback) bcc_list_changed        },
 };
 
 #define N_ADDRESS_TYPES G_N_ELEMENTS (address_types)
@@ -232,33 +233,6 @@ g_mime_message_finalize (GObject *object)
 }
 
 
-enum {
-	HEADER_SENDER,
-	HEADER_FROM,
-	HEADER_REPLY_TO,
-	HEADER_TO,
-	HEADER_CC,
-	HEADER_BCC,
-	HEADER_SUBJECT,
-	HEADER_DATE,
-	HEADER_MESSAGE_ID,
-	HEADER_MIME_VERSION,
-	HEADER_UNKNOWN
-};
-
-static const char *message_headers[] = {
-	"Sender",
-	"From",
-	"Reply-To",
-	"To",
-	"Cc",
-	"Bcc",
-	"Subject",
-	"Date",
-	"Message-Id",
-	"MIME-Version"
-};
-
 static void
 message_add_addresses (GMimeMessage *message, GMimeParserOptions *options, GMimeHeader *header, GMimeAddressType type)
 {
@@ -280,8 +254,8 @@ message_update_addresses (GMimeMessage *message, GMimeParserOptions *options, GM
 {
 	GMimeHeaderList *headers = ((GMimeObject *) message)->headers;
 	InternetAddressList *addrlist;
-	const char *name, *value;
 	GMimeHeader *header;
+	const char *value;
 	int count, i;
 	
 	block_changed_event (message, type);
@@ -293,9 +267,8 @@ message_update_addresses (GMimeMessage *message, GMimeParserOptions *options, GM
 	count = g_mime_header_list_get_count (headers);
 	for (i = 0; i < count; i++) {
 		header = g_mime_header_list_get_header_at (headers, i);
-		name = g_mime_header_get_name (header);
 		
-		if (g_ascii_strcasecmp (address_types[type].name, name) != 0)
+		if (_g_mime_header_get_id (header) != address_types[type].id)
 			continue;
 		
 		if ((value = g_mime_header_get_raw_value (header)))
@@ -323,54 +296,46 @@ process_header (GMimeObject *object, GMimeHeaderListChangedAction action, GMimeH
 {
 	GMimeParserOptions *options = _g_mime_header_list_get_options (object->headers);
 	GMimeMessage *message = (GMimeMessage *) object;
-	const char *name, *value;
-	guint i;
-	
-	name = g_mime_header_get_name (header);
-	
-	for (i = 0; i < G_N_ELEMENTS (message_headers); i++) {
-		if (!g_ascii_strcasecmp (message_headers[i], name))
-			break;
-	}
+	const char *value;
 	
-	switch (i) {
-	case HEADER_SENDER:
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_SENDER:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_SENDER);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_SENDER);
 		break;
-	case HEADER_FROM:
+	case GMIME_HEADER_ID_FROM:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_FROM);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_FROM);
 		break;
-	case HEADER_REPLY_TO:
+	case GMIME_HEADER_ID_REPLY_TO:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_REPLY_TO);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_REPLY_TO);
 		break;
-	case HEADER_TO:
+	case GMIME_HEADER_ID_TO:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_TO);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_TO);
 		break;
-	case HEADER_CC:
+	case GMIME_HEADER_ID_CC:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_CC);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_CC);
 		break;
-	case HEADER_BCC:
+	case GMIME_HEADER_ID_BCC:
 		if (header_was_appended (object, action, header))
 			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_BCC);
 		else
 			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_BCC);
 		break;
-	case HEADER_SUBJECT:
+	case GMIME_HEADER_ID_SUBJECT:
 		g_free (message->subject);
 		
 		if ((value = g_mime_header_get_value (header)))
@@ -378,7 +343,7 @@ process_header (GMimeObject *object, GMimeHeaderListChangedAction action, GMimeH
 		else
 			message->subject = NULL;
 		break;
-	case HEADER_DATE:
+	case GMIME_HEADER_ID_DATE:
 		if ((value = g_mime_header_get_value (header))) {
 			if (message->date)
 				g_date_time_unref (message->date);
@@ -386,7 +351,7 @@ process_header (GMimeObject *object, GMimeHeaderListChangedAction action, GMimeH
 			message->date = g_mime_utils_header_decode_date (value);
 		}
 		break;
-	case HEADER_MESSAGE_ID:
+	case GMIME_HEADER_ID_MESSAGE_ID:
 		g_free (message->message_id);
 		
 		if ((value = g_mime_header_get_value (header)))
@@ -418,46 +383,37 @@ message_header_removed (GMimeObject *object, GMimeHeader *header)
 {
 	GMimeParserOptions *options = _g_mime_header_list_get_options (object->headers);
 	GMimeMessage *message = (GMimeMessage *) object;
-	const char *name;
-	guint i;
 	
-	name = g_mime_header_get_name (header);
-	
-	for (i = 0; i < G_N_ELEMENTS (message_headers); i++) {
-		if (!g_ascii_strcasecmp (message_headers[i], name))
-			break;
-	}
-	
-	switch (i) {
-	case HEADER_SENDER:
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_SENDER:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_SENDER);
 		break;
-	case HEADER_FROM:
+	case GMIME_HEADER_ID_FROM:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_FROM);
 		break;
-	case HEADER_REPLY_TO:
+	case GMIME_HEADER_ID_REPLY_TO:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_REPLY_TO);
 		break;
-	case HEADER_TO:
+	case GMIME_HEADER_ID_TO:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_TO);
 		break;
-	case HEADER_CC:
+	case GMIME_HEADER_ID_CC:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_CC);
 		break;
-	case HEADER_BCC:
+	case GMIME_HEADER_ID_BCC:
 		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_BCC);
 		break;
-	case HEADER_SUBJECT:
+	case GMIME_HEADER_ID_SUBJECT:
 		g_free (message->subject);
 		message->subject = NULL;
 		break;
-	case HEADER_DATE:
+	case GMIME_HEADER_ID_DATE:
 		if (message->date) {
 			g_date_time_unref (message->date);
 			message->date = NULL;
 		}
 		break;
-	case HEADER_MESSAGE_ID:
+	case GMIME_HEADER_ID_MESSAGE_ID:
 		g_free (message->message_id);
 		message->message_id = NULL;
 		break;
@@ -501,7 +457,6 @@ write_headers_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMime
 	if (mime_part != NULL) {
 		int body_count = g_mime_header_list_get_count (mime_part->headers);
 		int count = g_mime_header_list_get_count (object->headers);
-		GMimeHeader *header, *body_header;
 		ssize_t nwritten, total = 0;
 		gint64 body_offset, offset;
 		GMimeStream *filtered;
@@ -515,65 +470,47 @@ write_headers_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMime
 		g_object_unref (filter);
 		
 		while (index < count && body_index < body_count) {
-			body_header = g_mime_header_list_get_header_at (mime_part->headers, body_index);
-			if ((body_offset = g_mime_header_get_offset (body_header)) < 0)
+			if ((body_offset = _g_mime_header_list_get_offset_at (mime_part->headers, body_index)) < 0)
 				break;
 			
-			header = g_mime_header_list_get_header_at (object->headers, index);
-			offset = g_mime_header_get_offset (header);
+			offset = _g_mime_header_list_get_offset_at (object->headers, index);
 			
 			if (offset < body_offset) {
-				if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-					if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-						g_object_unref (filtered);
-						return -1;
-					}
-					
-					total += nwritten;
+				if ((nwritten = _g_mime_header_list_write_header_at (object->headers, index, options, filtered)) == -1) {
+					g_object_unref (filtered);
+					return -1;
 				}
 				
+				total += nwritten;
 				index++;
 			} else {
-				if (!g_mime_format_options_is_hidden_header (options, body_header->name)) {
-					if ((nwritten = g_mime_header_write_to_stream (body_header, options, filtered)) == -1) {
-						g_object_unref (filtered);
-						return -1;
-					}
-					
-					total += nwritten;
+				if ((nwritten = _g_mime_header_list_write_header_at (mime_part->headers, body_index, options, filtered)) == -1) {
+					g_object_unref (filtered);
+					return -1;
 				}
 				
+				total += nwritten;
 				body_index++;
 			}
 		}
 		
 		while (index < count) {
-			header = g_mime_header_list_get_header_at (object->headers, index);
-			
-			if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-				if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-					g_object_unref (filtered);
-					return -1;
-				}
-				
-				total += nwritten;
+			if ((nwritten = _g_mime_header_list_write_header_at (object->headers, index, options, filtered)) == -1) {
+				g_object_unref (filtered);
+				return -1;
 			}
 			
+			total += nwritten;
 			index++;
 		}
 		
 		while (body_index < body_count) {
-			header = g_mime_header_list_get_header_at (mime_part->headers, body_index);
-			
-			if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-				if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-					g_object_unref (filtered);
-					return -1;
-				}
-				
-				total += nwritten;
+			if ((nwritten = _g_mime_header_list_write_header_at (mime_part->headers, body_index, options, filtered)) == -1) {
+				g_object_unref (filtered);
+				return -1;
 			}
 			
+			total += nwritten;
 			body_index++;
 		}
 		
@@ -1110,6 +1047,8 @@ g_mime_message_set_mime_part (GMimeMessage *message, GMimeObject *mime_part)
 	}
 	
 	message->mime_part = mime_part;
+	
+	_g_mime_object_set_dirty ((GMimeObject *) message);
 }
 
 
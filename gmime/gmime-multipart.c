@@ -147,15 +147,52 @@ g_mime_multipart_finalize (GObject *object)
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* writes a boundary line, preceded by the newline that terminates the
+ * previous part if @pending is %TRUE */
+static ssize_t
+multipart_write_boundary (GMimeStream *stream, const char *boundary, const char *newline, gboolean pending, gboolean end)
+{
+	GMimeStreamIOVector vector[5];
+	size_t n = 0;
+	
+	if (pending) {
+		vector[n].data = (char *) newline;
+		vector[n].len = strlen (newline);
+		n++;
+	}
+	
+	vector[n].data = "--";
+	vector[n].len = 2;
+	n++;
+	
+	vector[n].data = (char *) boundary;
+	vector[n].len = boundary ? strlen (boundary) : 0;
+	n++;
+	
+	if (end) {
+		vector[n].data = "--";
+		vector[n].len = 2;
+		n++;
+	}
+	
+	vector[n].data = (char *) newline;
+	vector[n].len = strlen (newline);
+	n++;
+	
+	return (ssize_t) g_mime_stream_writev (stream, vector, n);
+}
+
 static ssize_t
 multipart_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gboolean content_only, GMimeStream *stream)
 {
 	GMimeMultipart *multipart = (GMimeMultipart *) object;
+	gboolean is_signed, pending = FALSE;
 	const char *boundary, *newline;
 	ssize_t nwritten, total = 0;
+	GMimeStreamIOVector vector[3];
 	GMimeFormatOptions *format;
-	gboolean is_signed;
 	GMimeObject *part;
+	size_t n = 0;
 	guint i;
 	
 	boundary = g_mime_object_get_content_type_parameter (object, "boundary");
@@ -169,20 +206,24 @@ multipart_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gbo
 		total += nwritten;
 		
 		/* terminate the headers */
-		if ((nwritten = g_mime_stream_write_string (stream, newline)) == -1)
-			return -1;
-		
-		total += nwritten;
+		vector[n].data = (char *) newline;
+		vector[n].len = strlen (newline);
+		n++;
 	}
 	
 	/* write the prologue */
 	if (multipart->prologue) {
-		if ((nwritten = g_mime_stream_write_string (stream, multipart->prologue)) == -1)
-			return -1;
+		vector[n].data = multipart->prologue;
+		vector[n].len = strlen (multipart->prologue);
+		n++;
 		
-		total += nwritten;
-		
-		if ((nwritten = g_mime_stream_write_string (stream, newline)) == -1)
+		vector[n].data = (char *) newline;
+		vector[n].len = strlen (newline);
+		n++;
+	}
+	
+	if (n > 0) {
+		if ((nwritten = (ssize_t) g_mime_stream_writev (stream, vector, n)) == -1)
 			return -1;
 		
 		total += nwritten;
@@ -199,8 +240,8 @@ multipart_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gbo
 	for (i = 0; i < multipart->children->len; i++) {
 		part = multipart->children->pdata[i];
 		
-		/* write the boundary */
-		if ((nwritten = g_mime_stream_printf (stream, "--%s%s", boundary, newline)) == -1) {
+		/* write the boundary (along with the newline ending the previous part) */
+		if ((nwritten = multipart_write_boundary (stream, boundary, newline, pending, FALSE)) == -1) {
 			if (is_signed)
 				g_mime_format_options_free (format);
 			return -1;
@@ -217,15 +258,7 @@ multipart_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gbo
 		
 		total += nwritten;
 		
-		if (!GMIME_IS_MULTIPART (part) || ((GMimeMultipart *) part)->write_end_boundary) {
-			if ((nwritten = g_mime_stream_write_string (stream, newline)) == -1) {
-				if (is_signed)
-					g_mime_format_options_free (format);
-				return -1;
-			}
-			
-			total += nwritten;
-		}
+		pending = !GMIME_IS_MULTIPART (part) || ((GMimeMultipart *) part)->write_end_boundary;
 	}
 	
 	if (is_signed)
@@ -233,7 +266,12 @@ multipart_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gbo
 	
 	/* write the end-boundary (but only if a boundary is set) */
 	if (multipart->write_end_boundary && boundary) {
-		if ((nwritten = g_mime_stream_printf (stream, "--%s--%s", boundary, newline)) == -1)
+		if ((nwritten = multipart_write_boundary (stream, boundary, newline, pending, TRUE)) == -1)
+			return -1;
+		
+		total += nwritten;
+	} else if (pending) {
+		if ((nwritten = g_mime_stream_write_string (stream, newline)) == -1)
 			return -1;
 		
 		total += nwritten;
@@ -322,6 +360,8 @@ g_mime_multipart_set_prologue (GMimeMultipart *multipart, const char *prologue)
 	
 	g_free (multipart->prologue);
 	multipart->prologue = g_strdup (prologue);
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
 }
 
 
@@ -356,6 +396,8 @@ g_mime_multipart_set_epilogue (GMimeMultipart *multipart, const char *epilogue)
 	
 	g_free (multipart->epilogue);
 	multipart->epilogue = g_strdup (epilogue);
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
 }
 
 
@@ -400,6 +442,8 @@ g_mime_multipart_clear (GMimeMultipart *multipart)
 	g_return_if_fail (GMIME_IS_MULTIPART (multipart));
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->clear (multipart);
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
 }
 
 
@@ -425,6 +469,8 @@ g_mime_multipart_add (GMimeMultipart *multipart, GMimeObject *part)
 	g_return_if_fail (GMIME_IS_OBJECT (part));
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->add (multipart, part);
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
 }
 
 
@@ -474,6 +520,8 @@ g_mime_multipart_insert (GMimeMultipart *multipart, int index, GMimeObject *part
 	g_return_if_fail (index >= 0);
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->insert (multipart, index, part);
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
 }
 
 
@@ -504,7 +552,12 @@ g_mime_multipart_remove (GMimeMultipart *multipart, GMimeObject *part)
 	g_return_val_if_fail (GMIME_IS_MULTIPART (multipart), FALSE);
 	g_return_val_if_fail (GMIME_IS_OBJECT (part), FALSE);
 	
-	return GMIME_MULTIPART_GET_CLASS (multipart)->remove (multipart, part);
+	if (!GMIME_MULTIPART_GET_CLASS (multipart)->remove (multipart, part))
+		return FALSE;
+	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
+	
+	return TRUE;
 }
 
 
@@ -537,10 +590,15 @@ multipart_remove_at (GMimeMultipart *multipart, int index)
 GMimeObject *
 g_mime_multipart_remove_at (GMimeMultipart *multipart, int index)
 {
+	GMimeObject *part;
+	
 	g_return_val_if_fail (GMIME_IS_MULTIPART (multipart), NULL);
 	g_return_val_if_fail (index >= 0, NULL);
 	
-	return GMIME_MULTIPART_GET_CLASS (multipart)->remove_at (multipart, index);
+	if ((part = GMIME_MULTIPART_GET_CLASS (multipart)->remove_at (multipart, index)))
+		_g_mime_object_set_dirty ((GMimeObject *) multipart);
+	
+	return part;
 }
 
 
@@ -572,6 +630,8 @@ g_mime_multipart_replace (GMimeMultipart *multipart, int index, GMimeObject *rep
 	multipart->children->pdata[index] = replacement;
 	g_object_ref (replacement);
 	
+	_g_mime_object_set_dirty ((GMimeObject *) multipart);
+	
 	return replaced;
 }
 
@@ -28,7 +28,12 @@
 
 #include "gmime-common.h"
 #include "gmime-object.h"
+#include "gmime-multipart.h"
+#include "gmime-part.h"
+#include "gmime-message.h"
+#include "gmime-message-part.h"
 #include "gmime-stream-mem.h"
+#include "gmime-stream-null.h"
 #include "gmime-internal.h"
 #include "gmime-events.h"
 #include "gmime-utils.h"
@@ -55,6 +60,10 @@ struct _subtype_bucket {
 	GType object_type;
 };
 
+/* bumped every time any object is modified; used to tell whether a
+ * cached serialized size is still up-to-date */
+static volatile gint modification_serial = 0;
+
 static void _g_mime_object_set_content_disposition (GMimeObject *object, GMimeContentDisposition *disposition);
 void _g_mime_object_set_content_type (GMimeObject *object, GMimeContentType *content_type);
 
@@ -73,13 +82,39 @@ static ssize_t object_write_to_stream (GMimeObject *object, GMimeFormatOptions *
 static void object_encode (GMimeObject *object, GMimeEncodingConstraint constraint);
 
 static void header_list_changed (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *args, GMimeObject *object);
+static void header_list_modified (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *args, GMimeObject *object);
 static void content_type_changed (GMimeContentType *content_type, gpointer args, GMimeObject *object);
 static void content_disposition_changed (GMimeContentDisposition *disposition, gpointer args, GMimeObject *object);
 
+static GHashTable *type_hash_copy (GHashTable *src);
+
 
+/* The type registry is read on every g_mime_object_new() call, which
+ * happens from the parser and may happen from many threads at once,
+ * so lookups are lock-free: registration builds a new copy of the
+ * table under type_hash_lock and atomically publishes it. Lookups
+ * count themselves in type_hash_readers, so a retired table is freed
+ * as soon as a registration finds no lookup in progress (any lookup
+ * that starts after that point can only see the new table). */
 static GHashTable *type_hash = NULL;
+static GPtrArray *retired_type_hashes = NULL;
+static GMutex type_hash_lock;
+static gint type_hash_readers = 0;
+
+typedef struct {
+	GMimeStream *source;
+	
+	/* the serialized size of the object as of cached_serial */
+	GMimeFormatOptions *cached_options;
+	ssize_t cached_size;
+	guint cached_serial;
+	guint modified;
+} GMimeObjectPrivate;
+
+#define GMIME_OBJECT_PRIVATE(object) ((GMimeObjectPrivate *) G_STRUCT_MEMBER_P (object, private_offset))
 
 static GObjectClass *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -102,6 +137,7 @@ g_mime_object_get_type (void)
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeObject",
 					       &info, G_TYPE_FLAG_ABSTRACT);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeObjectPrivate));
 	}
 	
 	return type;
@@ -114,6 +150,7 @@ g_mime_object_class_init (GMimeObjectClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_object_finalize;
 	
@@ -130,13 +167,20 @@ g_mime_object_class_init (GMimeObjectClass *klass)
 static void
 g_mime_object_init (GMimeObject *object, GMimeObjectClass *klass)
 {
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
 	GMimeHeaderList *headers;
 	
 	headers = g_mime_header_list_new (g_mime_parser_options_get_default ());
 	g_mime_event_add (headers->changed, (GMimeEventCallback) header_list_changed, object);
+	g_mime_event_add (headers->changed, (GMimeEventCallback) header_list_modified, object);
 	object->headers = headers;
 	
 	object->ensure_newline = FALSE;
+	priv->source = NULL;
+	priv->cached_options = NULL;
+	priv->cached_size = -1;
+	priv->cached_serial = 0;
+	priv->modified = 0;
 	object->content_type = NULL;
 	object->disposition = NULL;
 	object->content_id = NULL;
@@ -146,6 +190,7 @@ g_mime_object_init (GMimeObject *object, GMimeObjectClass *klass)
 static void
 g_mime_object_finalize (GObject *object)
 {
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
 	GMimeObject *mime = (GMimeObject *) object;
 	GMimeEvent *event;
 	
@@ -164,27 +209,21 @@ g_mime_object_finalize (GObject *object)
 	if (mime->headers) {
 		event = mime->headers->changed;
 		g_mime_event_remove (event, (GMimeEventCallback) header_list_changed, object);
+		g_mime_event_remove (event, (GMimeEventCallback) header_list_modified, object);
 		g_object_unref (mime->headers);
 	}
 	
+	if (priv->source)
+		g_object_unref (priv->source);
+	
+	if (priv->cached_options)
+		g_mime_format_options_free (priv->cached_options);
+	
 	g_free (mime->content_id);
 	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
-enum {
-	HEADER_CONTENT_DISPOSITION,
-	HEADER_CONTENT_TYPE,
-	HEADER_CONTENT_ID,
-	HEADER_UNKNOWN,
-};
-
-static char *content_headers[] = {
-	"Content-Disposition",
-	"Content-Type",
-	"Content-Id",
-};
-
 static void
 object_header_added (GMimeObject *object, GMimeHeader *header)
 {
@@ -198,37 +237,26 @@ object_header_changed (GMimeObject *object, GMimeHeader *header)
 	gboolean can_warn = g_mime_parser_options_get_warning_callback (options) != NULL;
 	GMimeContentDisposition *disposition;
 	GMimeContentType *content_type;
-	const char *name, *value;
-	guint i;
+	const char *value;
 	
-	name = g_mime_header_get_name (header);
-
 	/* validate header if requested, caches the decoded value */
 	if (G_UNLIKELY (can_warn))
 		g_mime_header_get_value (header);
 	
-	if (g_ascii_strncasecmp (name, "Content-", 8) != 0)
-		return;
-	
-	for (i = 0; i < G_N_ELEMENTS (content_headers); i++) {
-		if (!g_ascii_strcasecmp (content_headers[i] + 8, name + 8))
-			break;
-	}
-	
-	switch (i) {
-	case HEADER_CONTENT_DISPOSITION:
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_CONTENT_DISPOSITION:
 		value = g_mime_header_get_value (header);
 		disposition = _g_mime_content_disposition_parse (options, value, header->offset);
 		_g_mime_object_set_content_disposition (object, disposition);
 		g_object_unref (disposition);
 		break;
-	case HEADER_CONTENT_TYPE:
+	case GMIME_HEADER_ID_CONTENT_TYPE:
 		value = g_mime_header_get_value (header);
 		content_type = _g_mime_content_type_parse (options, value, header->offset);
 		_g_mime_object_set_content_type (object, content_type);
 		g_object_unref (content_type);
 		break;
-	case HEADER_CONTENT_ID:
+	case GMIME_HEADER_ID_CONTENT_ID:
 		value = g_mime_header_get_value (header);
 		g_free (object->content_id);
 		object->content_id = g_mime_utils_decode_message_id (value);
@@ -240,21 +268,9 @@ static void
 object_header_removed (GMimeObject *object, GMimeHeader *header)
 {
 	GMimeEvent *event;
-	const char *name;
-	guint i;
-	
-	name = g_mime_header_get_name (header);
-	
-	if (g_ascii_strncasecmp (name, "Content-", 8) != 0)
-		return;
 	
-	for (i = 0; i < G_N_ELEMENTS (content_headers); i++) {
-		if (!g_ascii_strcasecmp (content_headers[i] + 8, name + 8))
-			break;
-	}
-	
-	switch (i) {
-	case HEADER_CONTENT_DISPOSITION:
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_CONTENT_DISPOSITION:
 		if (object->disposition) {
 			event = object->disposition->changed;
 			g_mime_event_remove (event, (GMimeEventCallback) content_disposition_changed, object);
@@ -262,10 +278,10 @@ object_header_removed (GMimeObject *object, GMimeHeader *header)
 			object->disposition = NULL;
 		}
 		break;
-	case HEADER_CONTENT_TYPE:
+	case GMIME_HEADER_ID_CONTENT_TYPE:
 		/* never allow the removal of the Content-Type header */
 		break;
-	case HEADER_CONTENT_ID:
+	case GMIME_HEADER_ID_CONTENT_ID:
 		g_free (object->content_id);
 		object->content_id = NULL;
 		break;
@@ -309,6 +325,16 @@ header_list_changed (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *
 	}
 }
 
+static void
+header_list_modified (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *args, GMimeObject *object)
+{
+	/* Note: this handler is never blocked, so it also catches the header
+	 * updates made on behalf of the Content-Type, Content-Disposition and
+	 * Content-Id properties. */
+	_g_mime_object_set_source (object, NULL);
+	_g_mime_object_set_dirty (object);
+}
+
 void
 _g_mime_object_block_header_list_changed (GMimeObject *object)
 {
@@ -364,29 +390,84 @@ content_disposition_changed (GMimeContentDisposition *disposition, gpointer args
  *
  * Note: You may use the wildcard "*" to match any type and/or
  * subtype.
+ *
+ * Note: This function is thread-safe and may be called while other
+ * threads are parsing, although registrations are normally done once
+ * right after g_mime_init().
  **/
 void
 g_mime_object_register_type (const char *type, const char *subtype, GType object_type)
 {
 	struct _type_bucket *bucket;
 	struct _subtype_bucket *sub;
+	GHashTable *hash;
 	
 	g_return_if_fail (object_type != 0);
 	g_return_if_fail (subtype != NULL);
 	g_return_if_fail (type != NULL);
 	
-	if (!(bucket = g_hash_table_lookup (type_hash, type))) {
+	g_mutex_lock (&type_hash_lock);
+	
+	hash = type_hash_copy (type_hash);
+	
+	if (!(bucket = g_hash_table_lookup (hash, type))) {
 		bucket = g_new (struct _type_bucket, 1);
 		bucket->type = g_strdup (type);
 		bucket->object_type = *type == '*' ? object_type : 0;
 		bucket->subtype_hash = g_hash_table_new (g_mime_strcase_hash, g_mime_strcase_equal);
-		g_hash_table_insert (type_hash, bucket->type, bucket);
+		g_hash_table_insert (hash, bucket->type, bucket);
+	}
+	
+	if ((sub = g_hash_table_lookup (bucket->subtype_hash, subtype))) {
+		sub->object_type = object_type;
+	} else {
+		sub = g_new (struct _subtype_bucket, 1);
+		sub->subtype = g_strdup (subtype);
+		sub->object_type = object_type;
+		g_hash_table_insert (bucket->subtype_hash, sub->subtype, sub);
+	}
+	
+	g_ptr_array_add (retired_type_hashes, type_hash);
+	g_atomic_pointer_set (&type_hash, hash);
+	
+	if (g_atomic_int_get (&type_hash_readers) == 0)
+		g_ptr_array_remove_range (retired_type_hashes, 0, retired_type_hashes->len);
+	
+	g_mutex_unlock (&type_hash_lock);
+}
+
+static GType
+object_type_lookup (const char *type, const char *subtype)
+{
+	struct _type_bucket *bucket;
+	struct _subtype_bucket *sub;
+	GType obj_type;
+	GHashTable *hash;
+	
+	g_atomic_int_inc (&type_hash_readers);
+	hash = g_atomic_pointer_get (&type_hash);
+	
+	if ((bucket = g_hash_table_lookup (hash, type))) {
+		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, subtype)))
+			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
+		
+		obj_type = sub ? sub->object_type : 0;
+	} else {
+		bucket = g_hash_table_lookup (hash, "*");
+		obj_type = bucket ? bucket->object_type : 0;
+	}
+	
+	if (!obj_type) {
+		/* use the default mime object */
+		if ((bucket = g_hash_table_lookup (hash, "*"))) {
+			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
+			obj_type = sub ? sub->object_type : 0;
+		}
 	}
 	
-	sub = g_new (struct _subtype_bucket, 1);
-	sub->subtype = g_strdup (subtype);
-	sub->object_type = object_type;
-	g_hash_table_insert (bucket->subtype_hash, sub->subtype, sub);
+	g_atomic_int_add (&type_hash_readers, -1);
+	
+	return obj_type;
 }
 
 
@@ -409,33 +490,13 @@ g_mime_object_register_type (const char *type, const char *subtype, GType object
 GMimeObject *
 g_mime_object_new (GMimeParserOptions *options, GMimeContentType *content_type)
 {
-	struct _type_bucket *bucket;
-	struct _subtype_bucket *sub;
 	GMimeObject *object;
 	GType obj_type;
 	
 	g_return_val_if_fail (GMIME_IS_CONTENT_TYPE (content_type), NULL);
 	
-	if ((bucket = g_hash_table_lookup (type_hash, content_type->type))) {
-		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, content_type->subtype)))
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-		
-		obj_type = sub ? sub->object_type : 0;
-	} else {
-		bucket = g_hash_table_lookup (type_hash, "*");
-		obj_type = bucket ? bucket->object_type : 0;
-	}
-	
-	if (!obj_type) {
-		/* use the default mime object */
-		if ((bucket = g_hash_table_lookup (type_hash, "*"))) {
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-			obj_type = sub ? sub->object_type : 0;
-		}
-		
-		if (!obj_type)
-			return NULL;
-	}
+	if (!(obj_type = object_type_lookup (content_type->type, content_type->subtype)))
+		return NULL;
 	
 	object = g_object_new (obj_type, NULL);
 	_g_mime_header_list_set_options (object->headers, options);
@@ -465,33 +526,13 @@ g_mime_object_new (GMimeParserOptions *options, GMimeContentType *content_type)
 GMimeObject *
 g_mime_object_new_type (GMimeParserOptions *options, const char *type, const char *subtype)
 {
-	struct _type_bucket *bucket;
-	struct _subtype_bucket *sub;
 	GMimeObject *object;
 	GType obj_type;
 	
 	g_return_val_if_fail (type != NULL, NULL);
 	
-	if ((bucket = g_hash_table_lookup (type_hash, type))) {
-		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, subtype)))
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-		
-		obj_type = sub ? sub->object_type : 0;
-	} else {
-		bucket = g_hash_table_lookup (type_hash, "*");
-		obj_type = bucket ? bucket->object_type : 0;
-	}
-	
-	if (!obj_type) {
-		/* use the default mime object */
-		if ((bucket = g_hash_table_lookup (type_hash, "*"))) {
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-			obj_type = sub ? sub->object_type : 0;
-		}
-		
-		if (!obj_type)
-			return NULL;
-	}
+	if (!(obj_type = object_type_lookup (type, subtype)))
+		return NULL;
 	
 	object = g_object_new (obj_type, NULL);
 	_g_mime_header_list_set_options (object->headers, options);
@@ -847,11 +888,75 @@ g_mime_object_prepend_header (GMimeObject *object, const char *header, const cha
 }
 
 
+/* checks whether @klass uses one of the GMimeObject, GMimePart or
+ * GMimeMessage header_added() handlers rather than its own */
+static gboolean
+header_added_is_builtin (GMimeObjectClass *klass)
+{
+	GMimeObjectClass *builtin;
+	GType type;
+	
+	if (G_TYPE_CHECK_CLASS_TYPE (klass, GMIME_TYPE_MESSAGE))
+		type = GMIME_TYPE_MESSAGE;
+	else if (G_TYPE_CHECK_CLASS_TYPE (klass, GMIME_TYPE_PART))
+		type = GMIME_TYPE_PART;
+	else
+		type = GMIME_TYPE_OBJECT;
+	
+	builtin = g_type_class_peek (type);
+	
+	return klass->header_added == builtin->header_added;
+}
+
+/* the headers that the built-in header_added() handlers act upon */
+static gboolean
+header_is_processed (int id)
+{
+	switch (id) {
+	case GMIME_HEADER_ID_CONTENT_TYPE:
+	case GMIME_HEADER_ID_CONTENT_DISPOSITION:
+	case GMIME_HEADER_ID_CONTENT_ID:
+	case GMIME_HEADER_ID_CONTENT_TRANSFER_ENCODING:
+	case GMIME_HEADER_ID_CONTENT_DESCRIPTION:
+	case GMIME_HEADER_ID_CONTENT_LOCATION:
+	case GMIME_HEADER_ID_CONTENT_MD5:
+	case GMIME_HEADER_ID_SENDER:
+	case GMIME_HEADER_ID_FROM:
+	case GMIME_HEADER_ID_REPLY_TO:
+	case GMIME_HEADER_ID_TO:
+	case GMIME_HEADER_ID_CC:
+	case GMIME_HEADER_ID_BCC:
+	case GMIME_HEADER_ID_SUBJECT:
+	case GMIME_HEADER_ID_DATE:
+	case GMIME_HEADER_ID_MESSAGE_ID:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
 void
 _g_mime_object_append_header (GMimeObject *object, const char *header, const char *raw_name,
-			      const char *raw_value, gint64 offset)
+			      const char *raw_value, gint64 offset, GMimeArena *arena)
 {
-	_g_mime_header_list_append (object->headers, header, raw_name, raw_value, offset);
+	GMimeParserOptions *options = _g_mime_header_list_get_options (object->headers);
+	int id;
+	
+	/* Headers parsed into an arena that no handler cares about are kept
+	 * in the header list's compact storage. When a warning callback is
+	 * set, every header has to be validated up front instead, and a
+	 * class that overrides header_added() may care about any header. */
+	if (arena != NULL && g_mime_parser_options_get_warning_callback (options) == NULL &&
+	    header_added_is_builtin (GMIME_OBJECT_GET_CLASS (object))) {
+		id = _g_mime_header_id_from_name (header);
+		
+		if (!header_is_processed (id)) {
+			_g_mime_header_list_append_compact (object->headers, id, header, raw_name, raw_value, offset, arena);
+			return;
+		}
+	}
+	
+	_g_mime_header_list_append (object->headers, header, raw_name, raw_value, offset, arena);
 }
 
 
@@ -971,6 +1076,99 @@ object_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gboole
 }
 
 
+guint
+_g_mime_object_next_serial (void)
+{
+	return (guint) g_atomic_int_add (&modification_serial, 1) + 1;
+}
+
+void
+_g_mime_object_set_dirty (GMimeObject *object)
+{
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
+	
+	priv->modified = _g_mime_object_next_serial ();
+	priv->cached_size = -1;
+}
+
+static gboolean
+object_modified_since (GMimeObject *object, guint serial)
+{
+	GMimeMultipart *multipart;
+	GMimeDataWrapper *content;
+	GMimeObject *child;
+	guint i;
+	
+	if (GMIME_OBJECT_PRIVATE (object)->modified > serial)
+		return TRUE;
+	
+	/* the content of a part can be changed without going through the part */
+	if (GMIME_IS_PART (object)) {
+		content = ((GMimePart *) object)->content;
+		
+		return content != NULL && _g_mime_data_wrapper_get_modified (content) > serial;
+	}
+	
+	/* objects may be shared between several parents, so rather than
+	 * propagating changes upward, check the children on demand */
+	if (GMIME_IS_MULTIPART (object)) {
+		multipart = (GMimeMultipart *) object;
+		
+		for (i = 0; i < multipart->children->len; i++) {
+			if (object_modified_since (multipart->children->pdata[i], serial))
+				return TRUE;
+		}
+		
+		return FALSE;
+	}
+	
+	if (GMIME_IS_MESSAGE (object))
+		child = ((GMimeMessage *) object)->mime_part;
+	else if (GMIME_IS_MESSAGE_PART (object))
+		child = (GMimeObject *) ((GMimeMessagePart *) object)->message;
+	else
+		child = NULL;
+	
+	return child != NULL && object_modified_since (child, serial);
+}
+
+static ssize_t
+object_get_cached_size (GMimeObject *object, GMimeFormatOptions *options)
+{
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
+	
+	if (priv->cached_size == -1 || object->ensure_newline)
+		return -1;
+	
+	if (!_g_mime_format_options_equal (priv->cached_options, options))
+		return -1;
+	
+	if (object_modified_since (object, priv->cached_serial))
+		return -1;
+	
+	return priv->cached_size;
+}
+
+static void
+object_set_cached_size (GMimeObject *object, GMimeFormatOptions *options, guint serial, ssize_t size)
+{
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
+	
+	if (object->ensure_newline)
+		return;
+	
+	if (priv->cached_options == NULL || !_g_mime_format_options_equal (priv->cached_options, options)) {
+		if (priv->cached_options)
+			g_mime_format_options_free (priv->cached_options);
+		
+		priv->cached_options = g_mime_format_options_clone (options);
+	}
+	
+	priv->cached_serial = serial;
+	priv->cached_size = size;
+}
+
+
 /**
  * g_mime_object_write_to_stream:
  * @object: a #GMimeObject
@@ -984,10 +1182,29 @@ object_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gboole
 ssize_t
 g_mime_object_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMimeStream *stream)
 {
+	ssize_t nwritten;
+	guint serial;
+	
 	g_return_val_if_fail (GMIME_IS_OBJECT (object), -1);
 	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
 	
-	return GMIME_OBJECT_GET_CLASS (object)->write_to_stream (object, options, FALSE, stream);
+	/* when we are only measuring, skip over unmodified subtrees of known size */
+	if (GMIME_IS_STREAM_NULL (stream) && !((GMimeStreamNull *) stream)->count_newlines &&
+	    (nwritten = object_get_cached_size (object, options)) != -1) {
+		((GMimeStreamNull *) stream)->written += nwritten;
+		stream->position += nwritten;
+		
+		return nwritten;
+	}
+	
+	serial = (guint) g_atomic_int_get (&modification_serial);
+	
+	nwritten = GMIME_OBJECT_GET_CLASS (object)->write_to_stream (object, options, FALSE, stream);
+	
+	if (nwritten != -1)
+		object_set_cached_size (object, options, serial, nwritten);
+	
+	return nwritten;
 }
 
 
@@ -1010,6 +1227,96 @@ g_mime_object_write_content_to_stream (GMimeObject *object, GMimeFormatOptions *
 	return GMIME_OBJECT_GET_CLASS (object)->write_to_stream (object, options, TRUE, stream);
 }
 
+void
+_g_mime_object_set_source (GMimeObject *object, GMimeStream *source)
+{
+	GMimeObjectPrivate *priv = GMIME_OBJECT_PRIVATE (object);
+	
+	if (source)
+		g_object_ref (source);
+	
+	if (priv->source)
+		g_object_unref (priv->source);
+	
+	priv->source = source;
+}
+
+GMimeStream *
+_g_mime_object_get_source (GMimeObject *object)
+{
+	return GMIME_OBJECT_PRIVATE (object)->source;
+}
+
+
+gboolean
+_g_mime_object_can_passthrough (GMimeObject *object, GMimeFormatOptions *options)
+{
+	if (GMIME_OBJECT_PRIVATE (object)->source == NULL || object->ensure_newline)
+		return FALSE;
+	
+	if (!g_mime_format_options_get_passthrough (options))
+		return FALSE;
+	
+	/* the raw source still contains any headers the caller wants hidden */
+	return !_g_mime_header_list_has_hidden (object->headers, options);
+}
+
+
+ssize_t
+_g_mime_object_write_source (GMimeObject *object, GMimeStream *stream)
+{
+	GMimeStream *source = GMIME_OBJECT_PRIVATE (object)->source;
+	gint64 nwritten;
+	
+	if (g_mime_stream_reset (source) == -1)
+		return -1;
+	
+	nwritten = g_mime_stream_write_to_stream (source, stream);
+	g_mime_stream_reset (source);
+	
+	return (ssize_t) nwritten;
+}
+
+
+/**
+ * g_mime_object_get_serialized_size:
+ * @object: a #GMimeObject
+ * @options: (nullable): a #GMimeFormatOptions or %NULL
+ *
+ * Gets the number of bytes that g_mime_object_write_to_stream() would
+ * write for @object using the given @options.
+ *
+ * The size is cached along with the sizes of all of the descendants of
+ * @object, so subsequent calls are cheap until the object (or one of
+ * its descendants) is modified, at which point only the modified
+ * subtrees need to be serialized again.
+ *
+ * Note: Replacing the stream or encoding of a part's #GMimeDataWrapper
+ * is detected, but writing to that stream in-place is not; use
+ * g_mime_data_wrapper_set_stream() or g_mime_part_set_content() to
+ * change the content instead.
+ *
+ * Returns: the serialized size of @object or %-1 on fail.
+ **/
+gint64
+g_mime_object_get_serialized_size (GMimeObject *object, GMimeFormatOptions *options)
+{
+	GMimeStream *stream;
+	ssize_t size;
+	
+	g_return_val_if_fail (GMIME_IS_OBJECT (object), -1);
+	
+	if ((size = object_get_cached_size (object, options)) != -1)
+		return size;
+	
+	stream = g_mime_stream_null_new ();
+	size = g_mime_object_write_to_stream (object, options, stream);
+	g_object_unref (stream);
+	
+	return size;
+}
+
+
 static void
 object_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 {
@@ -1111,11 +1418,50 @@ type_bucket_foreach (gpointer key, gpointer value, gpointer user_data)
 	g_free (bucket);
 }
 
+static GHashTable *
+type_hash_copy (GHashTable *src)
+{
+	struct _subtype_bucket *sub, *subcopy;
+	struct _type_bucket *bucket, *copy;
+	GHashTableIter iter, subiter;
+	GHashTable *hash;
+	
+	hash = g_hash_table_new (g_mime_strcase_hash, g_mime_strcase_equal);
+	
+	g_hash_table_iter_init (&iter, src);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &bucket)) {
+		copy = g_new (struct _type_bucket, 1);
+		copy->type = g_strdup (bucket->type);
+		copy->object_type = bucket->object_type;
+		copy->subtype_hash = g_hash_table_new (g_mime_strcase_hash, g_mime_strcase_equal);
+		g_hash_table_insert (hash, copy->type, copy);
+		
+		g_hash_table_iter_init (&subiter, bucket->subtype_hash);
+		while (g_hash_table_iter_next (&subiter, NULL, (gpointer *) &sub)) {
+			subcopy = g_new (struct _subtype_bucket, 1);
+			subcopy->subtype = g_strdup (sub->subtype);
+			subcopy->object_type = sub->object_type;
+			g_hash_table_insert (copy->subtype_hash, subcopy->subtype, subcopy);
+		}
+	}
+	
+	return hash;
+}
+
+static void
+type_hash_free (gpointer hash)
+{
+	g_hash_table_foreach (hash, type_bucket_foreach, NULL);
+	g_hash_table_destroy (hash);
+}
+
 void
 g_mime_object_type_registry_shutdown (void)
 {
-	g_hash_table_foreach (type_hash, type_bucket_foreach, NULL);
-	g_hash_table_destroy (type_hash);
+	g_ptr_array_free (retired_type_hashes, TRUE);
+	retired_type_hashes = NULL;
+	
+	type_hash_free (type_hash);
 	type_hash = NULL;
 }
 
@@ -1125,6 +1471,7 @@ g_mime_object_type_registry_init (void)
 	if (type_hash)
 		return;
 	
+	retired_type_hashes = g_ptr_array_new_with_free_func (type_hash_free);
 	type_hash = g_hash_table_new (g_mime_strcase_hash, g_mime_strcase_equal);
 }
 
@@ -1176,14 +1523,14 @@ g_mime_object_get_autocrypt_headers (GMimeObject *mime_part, GDateTime *effectiv
 				     gboolean keep_incomplete)
 {
 	g_return_val_if_fail (GMIME_IS_OBJECT (mime_part), NULL);
-
+	
 	int i;
-
+	
 	GMimeAutocryptHeaderList *ret = g_mime_autocrypt_header_list_new ();
 	guint count = g_mime_autocrypt_header_list_add_missing_addresses (ret, addresses);
 	if (!count)
 		return ret;
-
+	
 	/* scan for Autocrypt headers whose addr= attribute matches
 	 * the From: header. */
 	
@@ -1218,7 +1565,7 @@ g_mime_object_get_autocrypt_headers (GMimeObject *mime_part, GDateTime *effectiv
 			g_mime_autocrypt_header_set_effective_date (ah, effective_date);
 		}
 	}
-
+	
 	if (!keep_incomplete)
 		g_mime_autocrypt_header_list_remove_incomplete (ret);
 	return ret;
@@ -137,6 +137,8 @@ ssize_t g_mime_object_write_to_stream (GMimeObject *object, GMimeFormatOptions *
 ssize_t g_mime_object_write_content_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMimeStream *stream);
 char *g_mime_object_to_string (GMimeObject *object, GMimeFormatOptions *options);
 
+gint64 g_mime_object_get_serialized_size (GMimeObject *object, GMimeFormatOptions *options);
+
 void g_mime_object_encode (GMimeObject *object, GMimeEncodingConstraint constraint);
 
 /* Internal API */
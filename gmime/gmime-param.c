@@ -38,6 +38,7 @@
 #include "gmime-charset.h"
 #include "gmime-utils.h"
 #include "gmime-iconv.h"
+#include "gmime-pool.h"
 
 
 #ifdef ENABLE_WARNINGS
@@ -658,11 +659,11 @@ encode_param (GMimeParam *param, GMimeFormatOptions *options, GMimeParamEncoding
 	}
 	
 	if (g_ascii_strcasecmp (charset, "UTF-8") != 0)
-		cd = g_mime_iconv_open (charset, "UTF-8");
+		cd = _g_mime_iconv_open (charset, "UTF-8");
 	
 	if (cd != (iconv_t) -1) {
 		outbuf = g_mime_iconv_strdup (cd, param->value);
-		g_mime_iconv_close (cd);
+		_g_mime_iconv_close (cd);
 		if (outbuf == NULL) {
 			charset = "UTF-8";
 			inptr = start;
@@ -1223,15 +1224,15 @@ charset_convert (const char *charset, char *in, size_t inlen)
 	}
 	
 	/* need charset conversion */
-	cd = g_mime_iconv_open ("UTF-8", charset);
+	cd = _g_mime_iconv_open ("UTF-8", charset);
 	if (cd == (iconv_t) -1 && !locale) {
 		charset = g_mime_locale_charset ();
-		cd = g_mime_iconv_open ("UTF-8", charset);
+		cd = _g_mime_iconv_open ("UTF-8", charset);
 	}
 	
 	if (cd != (iconv_t) -1) {
 		result = g_mime_iconv_strndup (cd, in, inlen);
-		g_mime_iconv_close (cd);
+		_g_mime_iconv_close (cd);
 	}
 	
 	if (result == NULL)
@@ -1266,7 +1267,7 @@ rfc2184_param_add_part (struct _rfc2184_param *rfc2184, char *value, int id, gbo
 	struct _rfc2184_part *part;
 	size_t len;
 	
-	part = g_new (struct _rfc2184_part, 1);
+	part = g_mime_pool_thread_alloc (sizeof (struct _rfc2184_part));
 	g_ptr_array_add (rfc2184->parts, part);
 	part->id = id;
 	
@@ -1286,7 +1287,7 @@ rfc2184_param_new (char *name, char *value, int id, gboolean encoded)
 	struct _rfc2184_param *rfc2184;
 	const char *inptr = value;
 	
-	rfc2184 = g_new (struct _rfc2184_param, 1);
+	rfc2184 = g_mime_pool_thread_alloc (sizeof (struct _rfc2184_param));
 	rfc2184->parts = g_ptr_array_new ();
 	rfc2184->next = NULL;
 	
@@ -1403,7 +1404,7 @@ decode_param_list (GMimeParserOptions *options, const char *in, gint64 offset)
 			part = rfc2184->parts->pdata[i];
 			g_string_append (buf, part->value);
 			g_free (part->value);
-			g_free (part);
+			g_mime_pool_thread_release (sizeof (struct _rfc2184_part), part);
 		}
 		
 		g_ptr_array_free (rfc2184->parts, TRUE);
@@ -1413,10 +1414,10 @@ decode_param_list (GMimeParserOptions *options, const char *in, gint64 offset)
 		param->lang = rfc2184->lang;
 		
 		g_string_free (buf, FALSE);
-		g_free (rfc2184);
+		g_mime_pool_thread_release (sizeof (struct _rfc2184_param), rfc2184);
 		rfc2184 = t;
 	}
-
+	
 	if (can_warn) {
 		GMimeParam *p;
 		guint j;
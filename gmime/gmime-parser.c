@@ -32,11 +32,15 @@
 #include "gmime-table-private.h"
 #include "gmime-message-part.h"
 #include "gmime-parse-utils.h"
+#include "gmime-stream-mmap.h"
 #include "gmime-stream-null.h"
+#include "gmime-stream-bytes.h"
 #include "gmime-stream-mem.h"
 #include "gmime-multipart.h"
 #include "gmime-internal.h"
 #include "gmime-common.h"
+#include "gmime-arena.h"
+#include "gmime-pool.h"
 #include "gmime-part.h"
 
 #ifdef ENABLE_WARNINGS
@@ -82,6 +86,7 @@ typedef struct _boundary_stack {
 typedef struct {
 	char *raw_name, *name;
 	char *raw_value;
+	GMimeArena *arena;
 	gint64 offset;
 } Header;
 
@@ -104,15 +109,23 @@ static GMimeObject *parser_construct_multipart (GMimeParser *parser, GMimeParser
 
 static GObjectClass *parent_class = NULL;
 
-/* size of read buffer */
+/* default size of read buffer */
 #define SCAN_BUF 4096
 
+/* limits on the size of the read buffer */
+#define SCAN_BUF_MIN 4096
+#define SCAN_BUF_MAX (16 * 1024 * 1024)
+
 /* headroom guaranteed to be before each read buffer */
 #define SCAN_HEAD 128
 
 /* conservative growth sizes */
 #define HEADER_INIT_SIZE 256
 
+/* the parser's small structs all come from one pool of this chunk size */
+#define PARSER_POOL_CHUNK MAX (sizeof (Header), MAX (sizeof (BoundaryStack), sizeof (ContentType)))
+#define PARSER_POOL_MAX_FREE 64
+
 typedef enum {
 	GMIME_PARSER_STATE_ERROR = -1,
 	GMIME_PARSER_STATE_INIT,
@@ -134,7 +147,9 @@ struct _GMimeParserPrivate {
 	gint64 offset;
 	
 	/* i/o buffers */
-	char realbuf[SCAN_HEAD + SCAN_BUF + 4];
+	char *realbuf;
+	size_t scan_buf;
+	size_t buffer_size;
 	char *inbuf;
 	char *inptr;
 	char *inend;
@@ -161,6 +176,12 @@ struct _GMimeParserPrivate {
 	
 	GPtrArray *headers;
 	
+	/* freelist for Header, BoundaryStack and ContentType structs */
+	GMimePool *pool;
+	
+	/* arena that header strings are allocated from (or NULL) */
+	GMimeArena *arena;
+	
 	/* header buffer */
 	char *headerbuf;
 	char *headerptr;
@@ -177,7 +198,10 @@ struct _GMimeParserPrivate {
 	unsigned short int have_regex:1;
 	unsigned short int persist_stream:1;
 	unsigned short int respect_content_length:1;
-	unsigned short int unused:11;
+	unsigned short int direct:1;
+	unsigned short int headers_only:1;
+	unsigned short int use_arena:1;
+	unsigned short int unused:8;
 };
 
 static const char MBOX_BOUNDARY[6] = "From ";
@@ -195,7 +219,7 @@ parser_push_boundary (GMimeParser *parser, const char *boundary)
 	
 	max = priv->bounds ? priv->bounds->boundarylenmax : 0;
 	
-	s = g_slice_new (BoundaryStack);
+	s = g_mime_pool_alloc (priv->pool);
 	s->parent = priv->bounds;
 	priv->bounds = s;
 	
@@ -232,7 +256,7 @@ parser_pop_boundary (GMimeParser *parser)
 	
 	g_free (s->boundary);
 	
-	g_slice_free (BoundaryStack, s);
+	g_mime_pool_release (priv->pool, s);
 }
 
 static const char *
@@ -257,6 +281,16 @@ parser_find_header (GMimeParser *parser, const char *name, gint64 *offset)
 	return NULL;
 }
 
+static void
+parser_reset_arena (struct _GMimeParserPrivate *priv)
+{
+	/* headers that were already parsed keep their own references */
+	if (priv->arena)
+		g_mime_arena_unref (priv->arena);
+	
+	priv->arena = priv->use_arena ? g_mime_arena_new () : NULL;
+}
+
 static void
 parser_free_headers (struct _GMimeParserPrivate *priv)
 {
@@ -269,10 +303,15 @@ parser_free_headers (struct _GMimeParserPrivate *priv)
 	for (i = 0; i < priv->headers->len; i++) {
 		header = priv->headers->pdata[i];
 		
-		g_free (header->name);
-		g_free (header->raw_name);
-		g_free (header->raw_value);
-		g_slice_free (Header, header);
+		if (header->arena) {
+			g_mime_arena_unref (header->arena);
+		} else {
+			g_free (header->name);
+			g_free (header->raw_name);
+			g_free (header->raw_value);
+		}
+		
+		g_mime_pool_release (priv->pool, header);
 	}
 	
 	g_ptr_array_set_size (priv->headers, 0);
@@ -317,9 +356,15 @@ static void
 g_mime_parser_init (GMimeParser *parser, GMimeParserClass *klass)
 {
 	parser->priv = g_new (struct _GMimeParserPrivate, 1);
+	parser->priv->realbuf = g_malloc (SCAN_HEAD + SCAN_BUF + 4);
+	parser->priv->scan_buf = SCAN_BUF;
+	parser->priv->buffer_size = SCAN_BUF;
+	parser->priv->pool = g_mime_pool_new (PARSER_POOL_CHUNK, PARSER_POOL_MAX_FREE);
 	parser->priv->respect_content_length = FALSE;
+	parser->priv->headers_only = FALSE;
 	parser->priv->format = GMIME_FORMAT_MESSAGE;
 	parser->priv->persist_stream = TRUE;
+	parser->priv->use_arena = FALSE;
 	parser->priv->have_regex = FALSE;
 	parser->priv->regex = NULL;
 	
@@ -336,12 +381,80 @@ g_mime_parser_finalize (GObject *object)
 	if (parser->priv->regex)
 		g_regex_unref (parser->priv->regex);
 	
+	g_mime_pool_free (parser->priv->pool);
+	g_free (parser->priv->realbuf);
 	g_free (parser->priv);
 	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 
+/* Gets a pointer to the memory backing @stream such that map[offset]
+ * is the byte at stream offset @offset (or %NULL if @stream is not
+ * memory-backed) */
+static const char *
+parser_stream_map (GMimeStream *stream, gint64 *length)
+{
+	const char *map;
+	gint64 end;
+	
+	if (stream == NULL)
+		return NULL;
+	
+	if (G_OBJECT_TYPE (stream) == GMIME_TYPE_STREAM_MEM) {
+		GMimeStreamMem *mem = (GMimeStreamMem *) stream;
+		
+		if (mem->buffer == NULL)
+			return NULL;
+		
+		end = (gint64) mem->buffer->len;
+		if (stream->bound_end != -1)
+			end = MIN (stream->bound_end, end);
+		
+		if (length)
+			*length = end;
+		
+		return (const char *) mem->buffer->data;
+	}
+	
+	if (G_OBJECT_TYPE (stream) == GMIME_TYPE_STREAM_MMAP) {
+		GMimeStreamMmap *mm = (GMimeStreamMmap *) stream;
+		
+		if (mm->fd == -1 || mm->map == NULL)
+			return NULL;
+		
+		end = (gint64) mm->maplen;
+		if (stream->bound_end != -1)
+			end = MIN (stream->bound_end, end);
+		
+		if (length)
+			*length = end;
+		
+		return mm->map;
+	}
+	
+	if (G_OBJECT_TYPE (stream) == GMIME_TYPE_STREAM_BYTES) {
+		GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+		gsize size;
+		
+		if (bytes->bytes == NULL)
+			return NULL;
+		
+		map = g_bytes_get_data (bytes->bytes, &size);
+		
+		end = (gint64) size;
+		if (stream->bound_end != -1)
+			end = MIN (stream->bound_end, end);
+		
+		if (length)
+			*length = end;
+		
+		return map;
+	}
+	
+	return NULL;
+}
+
 static void
 parser_init (GMimeParser *parser, GMimeStream *stream)
 {
@@ -370,6 +483,7 @@ parser_init (GMimeParser *parser, GMimeStream *stream)
 	priv->preheader = NULL;
 	
 	priv->headers = g_ptr_array_new ();
+	priv->arena = NULL;
 	
 	priv->headerbuf = g_malloc (HEADER_INIT_SIZE);
 	priv->headerleft = HEADER_INIT_SIZE - 1;
@@ -388,6 +502,7 @@ parser_init (GMimeParser *parser, GMimeStream *stream)
 	
 	priv->toplevel = FALSE;
 	priv->seekable = offset != -1;
+	priv->direct = priv->seekable && parser_stream_map (stream, NULL) != NULL;
 	
 	priv->bounds = NULL;
 }
@@ -407,6 +522,9 @@ parser_close (GMimeParser *parser)
 	parser_free_headers (priv);
 	g_ptr_array_free (priv->headers, TRUE);
 	
+	if (priv->arena)
+		g_mime_arena_unref (priv->arena);
+	
 	while (priv->bounds)
 		parser_pop_boundary (parser);
 }
@@ -525,6 +643,64 @@ g_mime_parser_set_persist_stream (GMimeParser *parser, gboolean persist)
 }
 
 
+/**
+ * g_mime_parser_get_use_arena:
+ * @parser: a #GMimeParser context
+ *
+ * Gets whether or not the @parser allocates header strings from a
+ * per-message arena.
+ *
+ * Returns: %TRUE if the @parser uses an arena or %FALSE otherwise.
+ **/
+gboolean
+g_mime_parser_get_use_arena (GMimeParser *parser)
+{
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), FALSE);
+	
+	return parser->priv->use_arena;
+}
+
+
+/**
+ * g_mime_parser_set_use_arena:
+ * @parser: a #GMimeParser context
+ * @use_arena: %TRUE if header strings should be allocated from an arena
+ *
+ * Sets whether or not the @parser should allocate header strings from
+ * a per-message arena.
+ *
+ * If @use_arena is %TRUE, the names and raw values of all of the
+ * headers parsed for a message or part are carved out of a few large
+ * blocks of memory rather than being allocated one at a time. The
+ * blocks are freed once the last #GMimeHeader referencing them is
+ * finalized, which is normally when the constructed #GMimeMessage is
+ * finalized.
+ *
+ * This reduces the number of allocations made while parsing messages
+ * with many headers, but keeps the whole arena alive for as long as
+ * any one of the message's headers (or parts) is still referenced.
+ *
+ * Headers that GMime itself does not need to interpret (such as
+ * Received, DKIM-Signature or X- headers) are additionally kept in a
+ * compact form that points into the arena: no #GMimeHeader is created
+ * for them until they are requested from the #GMimeHeaderList, and
+ * they are not passed to the header_added() method of the
+ * #GMimeObject they belong to. This does not apply if a warning
+ * callback has been set on the #GMimeParserOptions, nor to objects
+ * whose class (registered with g_mime_object_register_type())
+ * overrides header_added(): such objects still receive every header.
+ *
+ * By default, this feature is disabled.
+ **/
+void
+g_mime_parser_set_use_arena (GMimeParser *parser, gboolean use_arena)
+{
+	g_return_if_fail (GMIME_IS_PARSER (parser));
+	
+	parser->priv->use_arena = use_arena;
+}
+
+
 /**
  * g_mime_parser_get_format:
  * @parser: a #GMimeParser context
@@ -600,6 +776,128 @@ g_mime_parser_set_respect_content_length (GMimeParser *parser, gboolean respect_
 }
 
 
+/**
+ * g_mime_parser_get_headers_only:
+ * @parser: a #GMimeParser context
+ *
+ * Gets whether or not @parser is set to only parse the headers of
+ * each message.
+ *
+ * Returns: %TRUE if @parser will only parse message headers or %FALSE
+ * otherwise.
+ **/
+gboolean
+g_mime_parser_get_headers_only (GMimeParser *parser)
+{
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), FALSE);
+	
+	return parser->priv->headers_only;
+}
+
+
+/**
+ * g_mime_parser_set_headers_only:
+ * @parser: a #GMimeParser context
+ * @headers_only: %TRUE if the parser should only parse message headers or %FALSE otherwise.
+ *
+ * Sets whether or not @parser should only parse the headers of each
+ * message when constructing messages with
+ * g_mime_parser_construct_message().
+ *
+ * When enabled, the resulting #GMimeMessage will have all of its
+ * headers and a toplevel MIME part matching its Content-Type, but
+ * that MIME part will have no content (and, in the case of a
+ * multipart, no subparts). The message body is never loaded into
+ * memory and is not parsed for MIME structure. When parsing an mbox
+ * or MMDF stream, the parser skips ahead to the start of the next
+ * message; otherwise, it stops right after the message headers.
+ *
+ * This is useful for applications such as indexers that only need
+ * to look at the message headers.
+ *
+ * By default, this feature is disabled.
+ **/
+void
+g_mime_parser_set_headers_only (GMimeParser *parser, gboolean headers_only)
+{
+	g_return_if_fail (GMIME_IS_PARSER (parser));
+	
+	parser->priv->headers_only = headers_only ? 1 : 0;
+}
+
+
+/**
+ * g_mime_parser_get_buffer_size:
+ * @parser: a #GMimeParser context
+ *
+ * Gets the size of the buffer that @parser reads the stream into.
+ *
+ * Returns: the size of the read buffer, in bytes, as clamped by
+ * g_mime_parser_set_buffer_size().
+ **/
+size_t
+g_mime_parser_get_buffer_size (GMimeParser *parser)
+{
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), 0);
+	
+	return parser->priv->buffer_size;
+}
+
+
+/**
+ * g_mime_parser_set_buffer_size:
+ * @parser: a #GMimeParser context
+ * @size: the size of the read buffer, in bytes
+ *
+ * Sets the size of the buffer that @parser reads the stream into.
+ *
+ * A larger buffer reduces the number of reads that need to be made
+ * on the underlying stream, which may help when each read is
+ * expensive.
+ *
+ * The size will be clamped to the range of 4 KiB to 16 MiB, and
+ * g_mime_parser_get_buffer_size() returns the clamped size. Any data
+ * that @parser has already buffered is preserved, even if that means
+ * temporarily keeping a larger buffer.
+ *
+ * Note: this should not be called from within a
+ * #GMimeParserHeaderRegexFunc callback.
+ *
+ * By default, the parser uses a 4 KiB buffer.
+ **/
+void
+g_mime_parser_set_buffer_size (GMimeParser *parser, size_t size)
+{
+	struct _GMimeParserPrivate *priv;
+	size_t inlen;
+	char *realbuf;
+	
+	g_return_if_fail (GMIME_IS_PARSER (parser));
+	
+	priv = parser->priv;
+	size = CLAMP (size, SCAN_BUF_MIN, SCAN_BUF_MAX);
+	priv->buffer_size = size;
+	
+	if (size == priv->scan_buf)
+		return;
+	
+	/* make sure that whatever we've already buffered still fits */
+	inlen = (size_t) (priv->inend - priv->inptr);
+	size = MAX (size, inlen);
+	
+	realbuf = g_malloc (SCAN_HEAD + size + 4);
+	memcpy (realbuf + SCAN_HEAD, priv->inptr, inlen);
+	g_free (priv->realbuf);
+	
+	priv->realbuf = realbuf;
+	priv->scan_buf = size;
+	
+	priv->inbuf = realbuf + SCAN_HEAD;
+	priv->inptr = priv->inbuf;
+	priv->inend = priv->inbuf + inlen;
+}
+
+
 /**
  * g_mime_parser_set_header_regex: (skip)
  * @parser: a #GMimeParser context
@@ -677,7 +975,7 @@ parser_fill (GMimeParser *parser, size_t atleast)
 	
 	priv->inptr = inptr;
 	priv->inend = inbuf;
-	inend = priv->realbuf + SCAN_HEAD + SCAN_BUF;
+	inend = priv->realbuf + SCAN_HEAD + priv->scan_buf;
 	
 	if ((nread = g_mime_stream_read (priv->stream, inbuf, inend - inbuf)) > 0) {
 		priv->offset += nread;
@@ -900,7 +1198,7 @@ check_boundary (struct _GMimeParserPrivate *priv, const char *start, size_t len)
 		
 		bounds = bounds->parent;
 	}
-
+	
 	if (priv->content_end > 0 && bounds != NULL) {
 		/* now it is time to check the mbox From-marker for the Content-Length case */
 		if (offset >= priv->content_end && is_boundary (priv, start, len, bounds->boundary, bounds->boundarylenfinal)) {
@@ -1016,18 +1314,28 @@ header_buffer_parse (GMimeParser *parser, GMimeParserOptions *options)
 		return;
 	}
 	
-	header = g_slice_new (Header);
+	header = g_mime_pool_alloc (priv->pool);
 	g_ptr_array_add (priv->headers, header);
-	
-	header->raw_name = g_strndup (priv->headerbuf, (size_t) (inptr - priv->headerbuf));
-	header->raw_value = g_strdup (inptr + 1);
 	header->offset = priv->header_offset;
 	
+	if (priv->arena) {
+		header->arena = g_mime_arena_ref (priv->arena);
+		header->raw_name = g_mime_arena_strndup (priv->arena, priv->headerbuf, (size_t) (inptr - priv->headerbuf));
+		header->raw_value = g_mime_arena_strdup (priv->arena, inptr + 1);
+	} else {
+		header->arena = NULL;
+		header->raw_name = g_strndup (priv->headerbuf, (size_t) (inptr - priv->headerbuf));
+		header->raw_value = g_strdup (inptr + 1);
+	}
+	
 	/* now walk backwards over lwsp characters */
 	while (inptr > priv->headerbuf && is_blank (inptr[-1]))
 		inptr--;
 	
-	header->name = g_strndup (priv->headerbuf, (size_t) (inptr - priv->headerbuf));
+	if (priv->arena)
+		header->name = g_mime_arena_strndup (priv->arena, priv->headerbuf, (size_t) (inptr - priv->headerbuf));
+	else
+		header->name = g_strndup (priv->headerbuf, (size_t) (inptr - priv->headerbuf));
 	
 	header_buffer_reset (priv);
 	
@@ -1252,7 +1560,7 @@ step_headers (GMimeParser *parser, struct _StepHeadersState *state, GMimeParserO
 		}
 		
 		len = (inptr + 1) - start;
-
+		
 		/* check if we've encountered a parent boundary (malformed message) */
 		if ((priv->boundary = check_boundary (priv, start, len)) != BOUNDARY_NONE) {
 			if (can_warn) {
@@ -1364,12 +1672,12 @@ parser_step_headers (GMimeParser *parser, GMimeParserOptions *options)
 }
 
 static void
-content_type_destroy (ContentType *content_type)
+content_type_destroy (GMimeParser *parser, ContentType *content_type)
 {
 	g_free (content_type->subtype);
 	g_free (content_type->type);
 	
-	g_slice_free (ContentType, content_type);
+	g_mime_pool_release (parser->priv->pool, content_type);
 }
 
 static gboolean
@@ -1389,16 +1697,16 @@ content_type_is_type (ContentType *content_type, const char *type, const char *s
 }
 
 static ContentType *
-parser_content_type (GMimeParser *parser, GMimeContentType *parent)
+parser_content_type (GMimeParser *parser, gboolean digest)
 {
 	ContentType *content_type;
 	const char *value;
 	
-	content_type = g_slice_new (ContentType);
+	content_type = g_mime_pool_alloc (parser->priv->pool);
 	
 	if (!(value = parser_find_header (parser, "Content-Type", NULL)) ||
 	    !g_mime_parse_content_type (&value, &content_type->type, &content_type->subtype)) {
-		if (parent != NULL && g_mime_content_type_is_type (parent, "multipart", "digest")) {
+		if (digest) {
 			content_type->type = g_strdup ("message");
 			content_type->subtype = g_strdup ("rfc822");
 		} else {
@@ -1512,26 +1820,149 @@ parser_step (GMimeParser *parser, GMimeParserOptions *options)
  * inend every trip through our inner while-loop. This cuts the number
  * of instructions down from ~7 to ~4, assuming the compiler does its
  * job correctly ;-)
+ *
+ * 2. A line can only be a boundary (or an mbox/MMDF marker) if it
+ * starts with '-' (or the first character of the marker), so there is
+ * no need to check every line. Instead, we use a (SIMD-accelerated
+ * where available) scan to find the next line that starts with one of
+ * those characters without examining the lines in between.
+ *
+ * 3. Rather than writing each line to the content stream as we go, we
+ * keep track of where the not-yet-written content begins (wstart) and
+ * write all of the content in the input buffer with a single
+ * g_mime_stream_write() call just before the buffer gets refilled (or
+ * when we find a boundary).
+ *
+ * 4. When the stream is a GMimeStreamMem, GMimeStreamMmap or
+ * GMimeStreamBytes, the content is already in memory, so there is no
+ * need to copy it into our read buffer just to scan it. Instead,
+ * parser_scan_content_direct() scans the stream's memory in place
+ * (without ever writing to it) and then resumes buffered reading at
+ * the boundary. Combined with persist-stream mode, this means that
+ * content bytes never get copied at all since the resulting content
+ * streams are just substreams. A GMimeStreamBytes cannot change, so
+ * its content streams are substreams even without persist-stream mode.
  **/
 
 
 /* we add 2 for \r\n */
 #define MAX_BOUNDARY_LEN(bounds) (bounds ? bounds->boundarylenmax + 2 : 0)
 
+static char
+boundary_marker_char (struct _GMimeParserPrivate *priv)
+{
+	/* figure out which character, other than '-', can start a boundary line */
+	switch (priv->format) {
+	case GMIME_FORMAT_MBOX: return MBOX_BOUNDARY[0];
+	case GMIME_FORMAT_MMDF: return MMDF_BOUNDARY[0];
+	default: return '-';
+	}
+}
+
+/* Note: see optimization comment [4] */
+static gboolean
+parser_scan_content_direct (GMimeParser *parser, GMimeStream *content, gboolean *empty)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	const char *map, *begin, *start, *inptr, *inend, *eoln;
+	gint64 offset, length, pos;
+	char marker;
+	
+	if (!(map = parser_stream_map (priv->stream, &length)))
+		return FALSE;
+	
+	offset = parser_offset (priv, NULL);
+	if (offset < 0 || offset > length)
+		return FALSE;
+	
+	d(printf ("scan-content (direct)\n"));
+	
+	priv->openpgp = GMIME_OPENPGP_NONE;
+	priv->boundary = BOUNDARY_NONE;
+	
+	marker = boundary_marker_char (priv);
+	
+	/* point the input buffer at the stream's memory so that parser_offset() and
+	 * check_boundary() work as usual (neither of them write to the buffer) */
+	priv->inbuf = priv->inptr = (char *) map + offset;
+	priv->inend = (char *) map + length;
+	priv->offset = length;
+	
+	begin = start = inptr = priv->inptr;
+	inend = priv->inend;
+	eoln = inend;
+	
+	while (inptr < inend) {
+		start = inptr;
+		
+		if (*inptr != '-' && *inptr != marker) {
+			/* skip to the next line that could possibly be a boundary */
+			if ((eoln = g_mime_scan_line_starts (inptr, inend - 1, '-', marker)) == inend - 1)
+				break;
+			
+			inptr = eoln + 1;
+			continue;
+		}
+		
+		if (!(eoln = memchr (inptr, '\n', (size_t) (inend - inptr))))
+			eoln = inend;
+		
+		if ((priv->boundary = check_boundary (priv, start, (size_t) (eoln - start))) != BOUNDARY_NONE)
+			break;
+		
+		inptr = eoln < inend ? eoln + 1 : inend;
+	}
+	
+	if (priv->boundary == BOUNDARY_NONE) {
+		priv->boundary = BOUNDARY_EOS;
+		start = inend;
+	}
+	
+	if (start > begin)
+		g_mime_stream_write (content, begin, (size_t) (start - begin));
+	
+	/* switch back to our own read buffer, positioned at the boundary */
+	offset = parser_offset (priv, start);
+	priv->inbuf = priv->realbuf + SCAN_HEAD;
+	priv->inptr = priv->inbuf;
+	priv->inend = priv->inbuf;
+	priv->offset = offset;
+	
+	if (g_mime_stream_seek (priv->stream, offset, GMIME_STREAM_SEEK_SET) != -1)
+		parser_fill (parser, MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds)));
+	
+	pos = g_mime_stream_tell (content);
+	*empty = pos == 0;
+	
+	if (priv->boundary != BOUNDARY_EOS && pos > 0) {
+		/* the last \r\n belongs to the boundary */
+		if (eoln[-1] == '\r')
+			g_mime_stream_seek (content, -2, GMIME_STREAM_SEEK_CUR);
+		else
+			g_mime_stream_seek (content, -1, GMIME_STREAM_SEEK_CUR);
+	}
+	
+	return TRUE;
+}
+
 static void
 parser_scan_content (GMimeParser *parser, GMimeStream *content, gboolean *empty)
 {
 	struct _GMimeParserPrivate *priv = parser->priv;
-	char *aligned, *start, *inend;
+	char *aligned, *start, *inend, *eoln, *wstart;
 	register unsigned int *dword;
 	gboolean midline = FALSE;
 	register char *inptr;
 	unsigned int mask;
 	size_t nleft, len;
 	size_t atleast;
+	char marker;
 	gint64 pos;
 	char c;
 	
+	if (priv->direct && parser_scan_content_direct (parser, content, empty))
+		return;
+	
 	d(printf ("scan-content\n"));
 	
 	priv->openpgp = GMIME_OPENPGP_NONE;
@@ -1539,21 +1970,23 @@ parser_scan_content (GMimeParser *parser, GMimeStream *content, gboolean *empty)
 	
 	g_assert (priv->inptr <= priv->inend);
 	
-	start = inptr = priv->inptr;
+	wstart = start = inptr = priv->inptr;
 	
 	/* figure out minimum amount of data we need */
 	atleast = MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds));
 	
+	marker = boundary_marker_char (priv);
+	
 	do {
 	refill:
 		nleft = priv->inend - inptr;
 		if (parser_fill (parser, atleast) <= 0) {
 			priv->boundary = BOUNDARY_EOS;
-			start = priv->inptr;
+			wstart = start = priv->inptr;
 			break;
 		}
 		
-		inptr = priv->inptr;
+		wstart = inptr = priv->inptr;
 		inend = priv->inend;
 		/* Note: see optimization comment [1] */
 		*inend = '\n';
@@ -1564,10 +1997,22 @@ parser_scan_content (GMimeParser *parser, GMimeStream *content, gboolean *empty)
 		
 		midline = FALSE;
 		
+		/* find the end of the last complete line in the buffer */
+		eoln = inend;
+		while (eoln > inptr && eoln[-1] != '\n')
+			eoln--;
+		
 		while (inptr < inend) {
-			aligned = (char *) (((size_t) (inptr + 3)) & ~3);
 			start = inptr;
 			
+			if (inptr < eoln && *inptr != '-' && *inptr != marker) {
+				/* Note: see optimization comment [2] */
+				inptr = (char *) g_mime_scan_line_starts (inptr, eoln - 1, '-', marker) + 1;
+				continue;
+			}
+			
+			aligned = (char *) (((size_t) (inptr + 3)) & ~3);
+			
 			/* Note: see optimization comment [1] */
 			c = *aligned;
 			*aligned = '\n';
@@ -1597,13 +2042,16 @@ parser_scan_content (GMimeParser *parser, GMimeStream *content, gboolean *empty)
 					goto boundary;
 				
 				inptr++;
-				len++;
 			} else {
 				/* didn't find an end-of-line */
 				midline = TRUE;
 				
 				if (priv->boundary == BOUNDARY_NONE) {
-					/* not enough to tell if we found a boundary */
+					/* not enough to tell if we found a boundary; flush the
+					 * complete lines before refilling the input buffer */
+					if (start > wstart)
+						g_mime_stream_write (content, wstart, (size_t) (start - wstart));
+					
 					priv->inptr = start;
 					inptr = start;
 					goto refill;
@@ -1613,15 +2061,21 @@ parser_scan_content (GMimeParser *parser, GMimeStream *content, gboolean *empty)
 				if ((priv->boundary = check_boundary (priv, start, len)) != BOUNDARY_NONE)
 					goto boundary;
 			}
-			
-			g_mime_stream_write (content, start, len);
 		}
 		
+		/* Note: see optimization comment [3] */
+		if (inptr > wstart)
+			g_mime_stream_write (content, wstart, (size_t) (inptr - wstart));
+		wstart = inptr;
+		
 		priv->inptr = inptr;
 	} while (priv->boundary == BOUNDARY_NONE);
 	
  boundary:
 	
+	if (start > wstart)
+		g_mime_stream_write (content, wstart, (size_t) (start - wstart));
+	
 	/* don't chew up the boundary */
 	priv->inptr = start;
 	
@@ -1647,10 +2101,14 @@ parser_scan_mime_part_content (GMimeParser *parser, GMimePart *mime_part)
 	GByteArray *buffer;
 	gint64 start, len;
 	gboolean empty;
+	gboolean slice;
 	
 	g_assert (priv->state >= GMIME_PARSER_STATE_HEADERS_END);
 	
-	if (priv->persist_stream && priv->seekable) {
+	/* immutable streams can always be sliced; see optimization comment [4] */
+	slice = priv->seekable && (priv->persist_stream || G_OBJECT_TYPE (priv->stream) == GMIME_TYPE_STREAM_BYTES);
+	
+	if (slice) {
 		stream = g_mime_stream_null_new ();
 		start = parser_offset (priv, NULL);
 	} else {
@@ -1661,7 +2119,7 @@ parser_scan_mime_part_content (GMimeParser *parser, GMimePart *mime_part)
 	parser_scan_content (parser, stream, &empty);
 	len = g_mime_stream_tell (stream);
 	
-	if (priv->persist_stream && priv->seekable) {
+	if (slice) {
 		g_object_unref (stream);
 		
 		stream = g_mime_stream_substream (priv->stream, start, start + len);
@@ -1705,7 +2163,7 @@ static void
 check_header_conflict (GMimeParserOptions *options, GMimeObject *object, const Header *header)
 {
 	const GMimeHeader *existing;
-
+	
 	if ((existing = g_mime_header_list_get_header (object->headers, header->name)) != NULL) {
 		if (strcmp (existing->raw_value, header->raw_value) != 0)
 			_g_mime_parser_options_warn (options, header->offset, GMIME_CRIT_CONFLICTING_HEADER, header->name);
@@ -1732,6 +2190,53 @@ check_repeated_header (GMimeParserOptions *options, GMimeObject *object, const H
 		check_header_conflict (options, object, header);
 }
 
+/* Check for the possibility of an empty message/rfc822 part. */
+static gboolean
+parser_message_part_is_empty (GMimeParser *parser)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	register char *inptr;
+	size_t atleast;
+	char *inend;
+	
+	if (priv->bounds == NULL)
+		return FALSE;
+	
+	/* figure out minimum amount of data we need */
+	atleast = MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds));
+	
+	if (parser_fill (parser, atleast) <= 0) {
+		priv->boundary = BOUNDARY_EOS;
+		return TRUE;
+	}
+	
+	inptr = priv->inptr;
+	inend = priv->inend;
+	/* Note: see optimization comment [1] */
+	*inend = '\n';
+	
+	while (*inptr != '\n')
+		inptr++;
+	
+	priv->boundary = check_boundary (priv, priv->inptr, inptr - priv->inptr);
+	switch (priv->boundary) {
+	case BOUNDARY_IMMEDIATE_END:
+	case BOUNDARY_IMMEDIATE:
+	case BOUNDARY_PARENT:
+		return TRUE;
+	case BOUNDARY_PARENT_END:
+		/* ignore "From " boundaries, boken mailers tend to include these lines... */
+		if (strncmp (priv->inptr, "From ", 5) != 0)
+			return TRUE;
+		break;
+	case BOUNDARY_NONE:
+	case BOUNDARY_EOS:
+		break;
+	}
+	
+	return FALSE;
+}
+
 static void
 parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMimeMessagePart *mpart, int depth)
 {
@@ -1745,44 +2250,8 @@ parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMim
 	
 	g_assert (priv->state == GMIME_PARSER_STATE_CONTENT);
 	
-	if (priv->bounds != NULL) {
-		/* Check for the possibility of an empty message/rfc822 part. */
-		register char *inptr;
-		size_t atleast;
-		char *inend;
-		
-		/* figure out minimum amount of data we need */
-		atleast = MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds));
-		
-		if (parser_fill (parser, atleast) <= 0) {
-			priv->boundary = BOUNDARY_EOS;
-			return;
-		}
-		
-		inptr = priv->inptr;
-		inend = priv->inend;
-		/* Note: see optimization comment [1] */
-		*inend = '\n';
-		
-		while (*inptr != '\n')
-			inptr++;
-		
-		priv->boundary = check_boundary (priv, priv->inptr, inptr - priv->inptr);
-		switch (priv->boundary) {
-		case BOUNDARY_IMMEDIATE_END:
-		case BOUNDARY_IMMEDIATE:
-		case BOUNDARY_PARENT:
-			return;
-		case BOUNDARY_PARENT_END:
-			/* ignore "From " boundaries, boken mailers tend to include these lines... */
-			if (strncmp (priv->inptr, "From ", 5) != 0)
-				return;
-			break;
-		case BOUNDARY_NONE:
-		case BOUNDARY_EOS:
-			break;
-		}
-	}
+	if (parser_message_part_is_empty (parser))
+		return;
 	
 	/* get the headers */
 	priv->state = GMIME_PARSER_STATE_HEADERS;
@@ -1805,17 +2274,17 @@ parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMim
 			if (can_warn)
 				check_repeated_header (options, (GMimeObject *) message, header);
 			_g_mime_object_append_header ((GMimeObject *) message, header->name, header->raw_name,
-						      header->raw_value, header->offset);
+						      header->raw_value, header->offset, header->arena);
 		}
 	}
 	
-	content_type = parser_content_type (parser, NULL);
+	content_type = parser_content_type (parser, FALSE);
 	if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, TRUE, depth + 1);
 	else
 		object = parser_construct_leaf_part (parser, options, content_type, TRUE, depth + 1);
 	
-	content_type_destroy (content_type);
+	content_type_destroy (parser, content_type);
 	message->mime_part = object;
 	
 	g_mime_message_part_set_message (mpart, message);
@@ -1836,12 +2305,40 @@ is_rfc822 (const char *subtype)
 	return FALSE;
 }
 
+/* checks whether the Content-Transfer-Encoding of the current headers
+ * means that the content cannot be parsed as an rfc822 message */
+static gboolean
+parser_content_is_encoded (struct _GMimeParserPrivate *priv)
+{
+	Header *header;
+	guint i;
+	
+	for (i = 0; i < priv->headers->len; i++) {
+		header = priv->headers->pdata[i];
+		
+		if (g_ascii_strcasecmp (header->name, "Content-Transfer-Encoding") != 0)
+			continue;
+		
+		switch (g_mime_content_encoding_from_string (header->raw_value)) {
+		case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+		case GMIME_CONTENT_ENCODING_UUENCODE:
+		case GMIME_CONTENT_ENCODING_BASE64:
+			return TRUE;
+		default:
+			return FALSE;
+		}
+	}
+	
+	return FALSE;
+}
+
 static GMimeObject *
 parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, ContentType *content_type, gboolean toplevel, int depth)
 {
 	struct _GMimeParserPrivate *priv = parser->priv;
 	const char *subtype = content_type->subtype;
 	const char *type = content_type->type;
+	gint64 headers_begin = priv->headers_begin;
 	GMimeObject *object;
 	Header *header;
 	guint i;
@@ -1860,24 +2357,8 @@ parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, Co
 			is_encoded = TRUE;
 		}
 		
-		for (i = 0; i < priv->headers->len && !is_encoded; i++) {
-			header = priv->headers->pdata[i];
-			
-			if (g_ascii_strcasecmp (header->name, "Content-Transfer-Encoding") != 0)
-				continue;
-			
-			switch (g_mime_content_encoding_from_string (header->raw_value)) {
-			case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
-			case GMIME_CONTENT_ENCODING_UUENCODE:
-			case GMIME_CONTENT_ENCODING_BASE64:
-				is_encoded = TRUE;
-				break;
-			default:
-				break;
-			}
-			
-			break;
-		}
+		if (!is_encoded)
+			is_encoded = parser_content_is_encoded (priv);
 		
 		if (is_encoded) {
 			subtype = "octet-stream";
@@ -1901,7 +2382,7 @@ parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, Co
 		if (!toplevel || !g_ascii_strncasecmp (header->name, "Content-", 8)) {
 			check_header_conflict (options, object, header);
 			_g_mime_object_append_header (object, header->name, header->raw_name,
-						      header->raw_value, header->offset);
+						      header->raw_value, header->offset, header->arena);
 		}
 	}
 	
@@ -1921,7 +2402,20 @@ parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, Co
 		else
 			parser_scan_mime_part_content (parser, (GMimePart *) object);
 	}
-
+	
+	if (!toplevel && content_type->exists && priv->persist_stream && priv->seekable && GMIME_IS_PART (object)) {
+		GMimeDataWrapper *content = ((GMimePart *) object)->content;
+		GMimeStream *source;
+		
+		/* remember where the raw part came from so that it can be written
+		 * back out verbatim for as long as it remains unmodified */
+		if (content != NULL && content->stream != NULL && headers_begin != -1) {
+			source = g_mime_stream_substream (priv->stream, headers_begin, content->stream->bound_end);
+			_g_mime_object_set_source (object, source);
+			g_object_unref (source);
+		}
+	}
+	
 	return object;
 }
 
@@ -1988,6 +2482,7 @@ parser_scan_multipart_subparts (GMimeParser *parser, GMimeParserOptions *options
 	struct _GMimeParserPrivate *priv = parser->priv;
 	ContentType *content_type;
 	GMimeObject *subpart;
+	gboolean digest;
 	
 	do {
 		/* skip over the boundary marker */
@@ -2002,14 +2497,14 @@ parser_scan_multipart_subparts (GMimeParser *parser, GMimeParserOptions *options
 			priv->boundary = BOUNDARY_EOS;
 			break;
 		}
-
+		
 		if (priv->state == GMIME_PARSER_STATE_BOUNDARY) {
 			if (priv->headers->len == 0) {
 				if (priv->boundary == BOUNDARY_IMMEDIATE)
 					continue;
 				break;
 			}
-
+			
 			/* This part has no content, but that will be handled in parser_construct_multipart()
 			 * or parser_consruct_leaf_part(). */
 		}
@@ -2019,14 +2514,15 @@ parser_scan_multipart_subparts (GMimeParser *parser, GMimeParserOptions *options
 			break;
 		}
 		
-		content_type = parser_content_type (parser, ((GMimeObject *) multipart)->content_type);
+		digest = g_mime_content_type_is_type (((GMimeObject *) multipart)->content_type, "multipart", "digest");
+		content_type = parser_content_type (parser, digest);
 		if (content_type_is_type (content_type, "multipart", "*"))
 			subpart = parser_construct_multipart (parser, options, content_type, FALSE, depth + 1);
 		else
 			subpart = parser_construct_leaf_part (parser, options, content_type, FALSE, depth + 1);
 		
 		g_mime_multipart_add (multipart, subpart);
-		content_type_destroy (content_type);
+		content_type_destroy (parser, content_type);
 		g_object_unref (subpart);
 	} while (priv->boundary == BOUNDARY_IMMEDIATE);
 	
@@ -2058,7 +2554,7 @@ parser_construct_multipart (GMimeParser *parser, GMimeParserOptions *options, Co
 				ctype_offset = header->offset;
 			
 			_g_mime_object_append_header (object, header->name, header->raw_name,
-						      header->raw_value, header->offset);
+						      header->raw_value, header->offset, header->arena);
 		}
 	}
 	
@@ -2120,6 +2616,68 @@ parser_construct_multipart (GMimeParser *parser, GMimeParserOptions *options, Co
 	return object;
 }
 
+static GMimeObject *
+parser_construct_headers_only_part (GMimeParser *parser, GMimeParserOptions *options, ContentType *content_type)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	const char *subtype = content_type->subtype;
+	const char *type = content_type->type;
+	GMimeObject *object;
+	gboolean empty;
+	Header *header;
+	guint i;
+	
+	/* treat encoded message/rfc822 parts the same way that
+	 * parser_construct_leaf_part() does */
+	if (!g_ascii_strcasecmp (type, "message") && is_rfc822 (subtype) && parser_content_is_encoded (priv)) {
+		subtype = "octet-stream";
+		type = "application";
+	}
+	
+	object = g_mime_object_new_type (options, type, subtype);
+	
+	if (!content_type->exists) {
+		GMimeContentType *mime_type;
+		
+		mime_type = g_mime_content_type_new (content_type->type, content_type->subtype);
+		_g_mime_object_set_content_type (object, mime_type);
+		g_object_unref (mime_type);
+	}
+	
+	for (i = 0; i < priv->headers->len; i++) {
+		header = priv->headers->pdata[i];
+		
+		if (!g_ascii_strncasecmp (header->name, "Content-", 8)) {
+			check_header_conflict (options, object, header);
+			_g_mime_object_append_header (object, header->name, header->raw_name,
+						      header->raw_value, header->offset, header->arena);
+		}
+	}
+	
+	parser_free_headers (priv);
+	
+	if (priv->format != GMIME_FORMAT_MBOX && priv->format != GMIME_FORMAT_MMDF)
+		return object;
+	
+	if (priv->state == GMIME_PARSER_STATE_HEADERS_END) {
+		/* skip empty line after headers */
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+			priv->boundary = BOUNDARY_EOS;
+			return object;
+		}
+	}
+	
+	if (priv->state == GMIME_PARSER_STATE_CONTENT) {
+		/* skip over the message body to get to the start of the next message */
+		GMimeStream *null = g_mime_stream_null_new ();
+		
+		parser_scan_content (parser, null, &empty);
+		g_object_unref (null);
+	}
+	
+	return object;
+}
+
 static GMimeObject *
 parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
 {
@@ -2127,6 +2685,8 @@ parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
 	ContentType *content_type;
 	GMimeObject *object;
 	
+	parser_reset_arena (priv);
+	
 	/* get the headers */
 	priv->state = GMIME_PARSER_STATE_HEADERS;
 	priv->toplevel = TRUE;
@@ -2136,13 +2696,13 @@ parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
 			return NULL;
 	}
 	
-	content_type = parser_content_type (parser, NULL);
+	content_type = parser_content_type (parser, FALSE);
 	if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, FALSE, 0);
 	else
 		object = parser_construct_leaf_part (parser, options, content_type, FALSE, 0);
 	
-	content_type_destroy (content_type);
+	content_type_destroy (parser, content_type);
 	
 	return object;
 }
@@ -2181,6 +2741,8 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 	char *endptr;
 	guint i;
 	
+	parser_reset_arena (priv);
+	
 	/* scan the from-line if we are parsing an mbox */
 	while (priv->state != GMIME_PARSER_STATE_MESSAGE_HEADERS) {
 		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR)
@@ -2216,7 +2778,7 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 			if (can_warn)
 				check_repeated_header (options, (GMimeObject *) message, header);
 			_g_mime_object_append_header ((GMimeObject *) message, header->name, header->raw_name,
-						      header->raw_value, header->offset);
+						      header->raw_value, header->offset, header->arena);
 		}
 	}
 	
@@ -2230,13 +2792,15 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 		parser_push_boundary (parser, MMDF_BOUNDARY);
 	}
 	
-	content_type = parser_content_type (parser, NULL);
-	if (content_type_is_type (content_type, "multipart", "*"))
+	content_type = parser_content_type (parser, FALSE);
+	if (priv->headers_only)
+		object = parser_construct_headers_only_part (parser, options, content_type);
+	else if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, TRUE, 0);
 	else
 		object = parser_construct_leaf_part (parser, options, content_type, TRUE, 0);
 	
-	content_type_destroy (content_type);
+	content_type_destroy (parser, content_type);
 	message->mime_part = object;
 	
 	if (priv->state == GMIME_PARSER_STATE_ERROR)
@@ -2269,6 +2833,871 @@ g_mime_parser_construct_message (GMimeParser *parser, GMimeParserOptions *option
 }
 
 
+/* A write-only stream that hands the content of each MIME part to the
+ * GMimeParserEvents content callback. The last 2 bytes written are
+ * held back because parser_scan_content() seeks back over the newline
+ * that belongs to the boundary once it finds it. */
+typedef struct {
+	GMimeStream parent_object;
+	
+	const GMimeParserEvents *events;
+	GMimeParser *parser;
+	gpointer user_data;
+	
+	char held[2];
+	size_t nheld;
+} EventStream;
+
+typedef struct {
+	GMimeStreamClass parent_class;
+} EventStreamClass;
+
+static void
+event_stream_emit (EventStream *estream, const char *buf, size_t len)
+{
+	if (len > 0 && estream->events->content)
+		estream->events->content (estream->parser, buf, len, estream->user_data);
+}
+
+static ssize_t
+event_stream_write (GMimeStream *stream, const char *buf, size_t len)
+{
+	EventStream *estream = (EventStream *) stream;
+	size_t n;
+	
+	if (len >= sizeof (estream->held)) {
+		event_stream_emit (estream, estream->held, estream->nheld);
+		n = len - sizeof (estream->held);
+		event_stream_emit (estream, buf, n);
+		memcpy (estream->held, buf + n, sizeof (estream->held));
+		estream->nheld = sizeof (estream->held);
+	} else {
+		if (estream->nheld + len > sizeof (estream->held)) {
+			n = estream->nheld + len - sizeof (estream->held);
+			event_stream_emit (estream, estream->held, n);
+			memmove (estream->held, estream->held + n, estream->nheld - n);
+			estream->nheld -= n;
+		}
+		
+		memcpy (estream->held + estream->nheld, buf, len);
+		estream->nheld += len;
+	}
+	
+	stream->position += len;
+	
+	return len;
+}
+
+static int
+event_stream_flush (GMimeStream *stream)
+{
+	EventStream *estream = (EventStream *) stream;
+	
+	event_stream_emit (estream, estream->held, estream->nheld);
+	estream->nheld = 0;
+	
+	return 0;
+}
+
+static int
+event_stream_reset (GMimeStream *stream)
+{
+	((EventStream *) stream)->nheld = 0;
+	
+	return 0;
+}
+
+static gint64
+event_stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
+{
+	EventStream *estream = (EventStream *) stream;
+	
+	/* only seeking back over the held bytes is supported */
+	if (whence != GMIME_STREAM_SEEK_CUR || offset > 0 || -offset > (gint64) estream->nheld)
+		return -1;
+	
+	estream->nheld -= (size_t) -offset;
+	stream->position += offset;
+	
+	return stream->position;
+}
+
+static void
+event_stream_class_init (EventStreamClass *klass)
+{
+	GMimeStreamClass *stream_class = GMIME_STREAM_CLASS (klass);
+	
+	stream_class->write = event_stream_write;
+	stream_class->flush = event_stream_flush;
+	stream_class->reset = event_stream_reset;
+	stream_class->seek = event_stream_seek;
+}
+
+static GType
+event_stream_get_type (void)
+{
+	static gsize type = 0;
+	
+	/* unlike the public types, this one is not registered by g_mime_init(),
+	 * so guard against two threads registering it at the same time */
+	if (g_once_init_enter (&type)) {
+		static const GTypeInfo info = {
+			sizeof (EventStreamClass),
+			NULL, /* base_class_init */
+			NULL, /* base_class_finalize */
+			(GClassInitFunc) event_stream_class_init,
+			NULL, /* class_finalize */
+			NULL, /* class_data */
+			sizeof (EventStream),
+			0,    /* n_preallocs */
+			NULL, /* instance_init */
+		};
+		
+		g_once_init_leave (&type, g_type_register_static (GMIME_TYPE_STREAM, "GMimeParserEventStream", &info, 0));
+	}
+	
+	return (GType) type;
+}
+
+static GMimeStream *
+event_stream_new (GMimeParser *parser, const GMimeParserEvents *events, gpointer user_data)
+{
+	EventStream *estream;
+	
+	estream = g_object_new (event_stream_get_type (), NULL);
+	g_mime_stream_construct ((GMimeStream *) estream, 0, -1);
+	estream->events = events;
+	estream->parser = parser;
+	estream->user_data = user_data;
+	estream->nheld = 0;
+	
+	return (GMimeStream *) estream;
+}
+
+typedef struct {
+	const GMimeParserEvents *events;
+	gpointer user_data;
+	GMimeStream *content;
+} EventContext;
+
+static void
+parser_events_content (GMimeParser *parser, EventContext *ctx)
+{
+	gboolean empty;
+	
+	g_mime_stream_reset (ctx->content);
+	parser_scan_content (parser, ctx->content, &empty);
+	g_mime_stream_flush (ctx->content);
+}
+
+static char *
+parser_events_boundary (GMimeParser *parser, GMimeParserOptions *options)
+{
+	char *type, *subtype, *boundary = NULL;
+	GMimeParamList *params;
+	const char *inptr;
+	GMimeParam *param;
+	gint64 offset;
+	
+	if (!(inptr = parser_find_header (parser, "Content-Type", &offset)))
+		return NULL;
+	
+	if (!g_mime_parse_content_type (&inptr, &type, &subtype))
+		return NULL;
+	
+	g_free (subtype);
+	g_free (type);
+	
+	/* skip past any remaining junk that shouldn't be here... */
+	skip_cfws (&inptr);
+	while (*inptr && *inptr != ';')
+		inptr++;
+	
+	if (*inptr++ == ';' && *inptr && (params = _g_mime_param_list_parse (options, inptr, offset))) {
+		if ((param = g_mime_param_list_get_parameter (params, "boundary")))
+			boundary = g_strdup (g_mime_param_get_value (param));
+		
+		g_object_unref (params);
+	}
+	
+	return boundary;
+}
+
+static void parser_events_part (GMimeParser *parser, GMimeParserOptions *options, EventContext *ctx,
+				ContentType *content_type, int depth);
+
+static void
+parser_events_message_part (GMimeParser *parser, GMimeParserOptions *options, EventContext *ctx, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	ContentType *content_type;
+	
+	if (parser_message_part_is_empty (parser))
+		return;
+	
+	/* get the headers */
+	priv->state = GMIME_PARSER_STATE_HEADERS;
+	if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+		priv->boundary = BOUNDARY_EOS;
+		return;
+	}
+	
+	content_type = parser_content_type (parser, FALSE);
+	parser_events_part (parser, options, ctx, content_type, depth);
+	content_type_destroy (parser, content_type);
+}
+
+static BoundaryType
+parser_events_subparts (GMimeParser *parser, GMimeParserOptions *options, EventContext *ctx, gboolean digest, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	ContentType *content_type;
+	
+	do {
+		/* skip over the boundary marker */
+		if (parser_skip_line (parser) == -1) {
+			priv->boundary = BOUNDARY_EOS;
+			break;
+		}
+		
+		/* get the headers */
+		priv->state = GMIME_PARSER_STATE_HEADERS;
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+			priv->boundary = BOUNDARY_EOS;
+			break;
+		}
+		
+		if (priv->state == GMIME_PARSER_STATE_BOUNDARY && priv->headers->len == 0) {
+			if (priv->boundary == BOUNDARY_IMMEDIATE)
+				continue;
+			break;
+		}
+		
+		if (priv->state == GMIME_PARSER_STATE_COMPLETE && priv->headers->len == 0) {
+			priv->boundary = BOUNDARY_IMMEDIATE_END;
+			break;
+		}
+		
+		content_type = parser_content_type (parser, digest);
+		parser_events_part (parser, options, ctx, content_type, depth + 1);
+		content_type_destroy (parser, content_type);
+	} while (priv->boundary == BOUNDARY_IMMEDIATE);
+	
+	return priv->boundary;
+}
+
+static void
+parser_events_part (GMimeParser *parser, GMimeParserOptions *options, EventContext *ctx, ContentType *content_type, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	const GMimeParserEvents *events = ctx->events;
+	gboolean multipart, message = FALSE;
+	char *boundary = NULL;
+	Header *header;
+	guint i;
+	
+	g_assert (priv->state >= GMIME_PARSER_STATE_HEADERS_END);
+	
+	if (events->part_begin)
+		events->part_begin (parser, content_type->type, content_type->subtype, depth, priv->headers_begin, ctx->user_data);
+	
+	if (events->header) {
+		for (i = 0; i < priv->headers->len; i++) {
+			header = priv->headers->pdata[i];
+			
+			events->header (parser, header->name, header->raw_value, header->offset, ctx->user_data);
+		}
+	}
+	
+	if ((multipart = content_type_is_type (content_type, "multipart", "*"))) {
+		boundary = parser_events_boundary (parser, options);
+	} else if (!g_ascii_strcasecmp (content_type->type, "message") && is_rfc822 (content_type->subtype)) {
+		const char *encoding;
+		
+		/* encoded message parts are reported as opaque content */
+		message = depth < MAX_LEVEL;
+		if ((encoding = parser_find_header (parser, "Content-Transfer-Encoding", NULL))) {
+			switch (g_mime_content_encoding_from_string (encoding)) {
+			case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+			case GMIME_CONTENT_ENCODING_UUENCODE:
+			case GMIME_CONTENT_ENCODING_BASE64:
+				message = FALSE;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	
+	parser_free_headers (priv);
+	
+	if (priv->state == GMIME_PARSER_STATE_HEADERS_END) {
+		/* skip empty line after headers */
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+			priv->boundary = BOUNDARY_EOS;
+			goto done;
+		}
+	}
+	
+	if (multipart) {
+		if (boundary != NULL && depth < MAX_LEVEL) {
+			parser_push_boundary (parser, boundary);
+			
+			/* prologue */
+			parser_events_content (parser, ctx);
+			
+			if (priv->boundary == BOUNDARY_IMMEDIATE) {
+				gboolean digest = !g_ascii_strcasecmp (content_type->subtype, "digest");
+				
+				priv->boundary = parser_events_subparts (parser, options, ctx, digest, depth);
+			}
+			
+			if (priv->boundary == BOUNDARY_IMMEDIATE_END) {
+				/* eat end boundary */
+				parser_skip_line (parser);
+				parser_pop_boundary (parser);
+				
+				/* epilogue */
+				parser_events_content (parser, ctx);
+				goto done;
+			}
+			
+			parser_pop_boundary (parser);
+			
+			if (priv->boundary == BOUNDARY_PARENT_END && found_immediate_boundary (priv, TRUE))
+				priv->boundary = BOUNDARY_IMMEDIATE_END;
+			else if (priv->boundary == BOUNDARY_PARENT && found_immediate_boundary (priv, FALSE))
+				priv->boundary = BOUNDARY_IMMEDIATE;
+		} else {
+			/* this will scan everything into the prologue */
+			parser_events_content (parser, ctx);
+		}
+	} else if (priv->state == GMIME_PARSER_STATE_CONTENT) {
+		if (message)
+			parser_events_message_part (parser, options, ctx, depth + 1);
+		else
+			parser_events_content (parser, ctx);
+	}
+	
+ done:
+	if (events->part_end)
+		events->part_end (parser, depth, parser_offset (priv, NULL), ctx->user_data);
+	
+	g_free (boundary);
+}
+
+
+/**
+ * g_mime_parser_parse_events:
+ * @parser: a #GMimeParser context
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @events: a #GMimeParserEvents
+ * @user_data: user data passed to each of the @events callbacks
+ *
+ * Parses the next message from @parser, reporting its structure through
+ * @events rather than constructing a #GMimeMessage. For each MIME part
+ * (including the message itself and any embedded message/rfc822 parts),
+ * the @events part_begin callback is invoked, followed by the header
+ * callback for each of the part's headers, then either the content
+ * callback for each chunk of raw content or the events of its children,
+ * and finally the part_end callback.
+ *
+ * No objects are constructed for the MIME parts and the content is never
+ * buffered in memory, so this can be used to scan arbitrarily large
+ * messages or mbox streams in constant memory. The strings passed to the
+ * callbacks are only valid for the duration of the callback, and are
+ * never allocated from the arena enabled by g_mime_parser_set_use_arena().
+ *
+ * When parsing an mbox or MMDF stream, each call parses one message.
+ *
+ * Returns: %TRUE if a message was parsed or %FALSE on error.
+ **/
+gboolean
+g_mime_parser_parse_events (GMimeParser *parser, GMimeParserOptions *options, const GMimeParserEvents *events, gpointer user_data)
+{
+	struct _GMimeParserPrivate *priv;
+	unsigned long content_length = ULONG_MAX;
+	ContentType *content_type;
+	EventContext ctx;
+	const char *inptr;
+	char *endptr;
+	
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), FALSE);
+	g_return_val_if_fail (events != NULL, FALSE);
+	
+	priv = parser->priv;
+	
+	/* the headers are only handed to the callbacks and then freed, so
+	 * don't let them pile up in (or keep alive) a per-message arena */
+	if (priv->arena) {
+		g_mime_arena_unref (priv->arena);
+		priv->arena = NULL;
+	}
+	
+	/* scan the from-line if we are parsing an mbox */
+	while (priv->state != GMIME_PARSER_STATE_MESSAGE_HEADERS) {
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR)
+			return FALSE;
+	}
+	
+	/* parse the headers */
+	priv->toplevel = TRUE;
+	while (priv->state < GMIME_PARSER_STATE_HEADERS_END) {
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR)
+			return FALSE;
+	}
+	
+	if (priv->format == GMIME_FORMAT_MBOX) {
+		if (priv->respect_content_length && (inptr = parser_find_header (parser, "Content-Length", NULL))) {
+			while (is_lwsp (*inptr))
+				inptr++;
+			
+			content_length = strtoul (inptr, &endptr, 10);
+			if (endptr == inptr)
+				content_length = ULONG_MAX;
+		}
+		
+		parser_push_boundary (parser, MBOX_BOUNDARY);
+		priv->content_end = 0;
+		
+		if (priv->respect_content_length && content_length < ULONG_MAX)
+			priv->content_end = parser_offset (priv, NULL) + content_length;
+	} else if (priv->format == GMIME_FORMAT_MMDF) {
+		parser_push_boundary (parser, MMDF_BOUNDARY);
+	}
+	
+	ctx.content = event_stream_new (parser, events, user_data);
+	ctx.user_data = user_data;
+	ctx.events = events;
+	
+	content_type = parser_content_type (parser, FALSE);
+	parser_events_part (parser, options, &ctx, content_type, 0);
+	content_type_destroy (parser, content_type);
+	
+	g_object_unref (ctx.content);
+	
+	if (priv->state == GMIME_PARSER_STATE_ERROR)
+		_g_mime_parser_options_warn (options, -1, GMIME_WARN_MALFORMED_MESSAGE, NULL);
+	
+	if (priv->format == GMIME_FORMAT_MBOX) {
+		priv->state = GMIME_PARSER_STATE_FROM;
+		parser_pop_boundary (parser);
+	}
+	
+	return TRUE;
+}
+
+
+/* size of the blocks read by g_mime_parser_foreach_message() when the
+ * stream is not memory-backed */
+#define SPLIT_BUF (64 * 1024)
+
+typedef struct {
+	gint64 offset;
+	GMimeParserWarning errcode;
+	char *item;
+} ParserWarning;
+
+typedef struct {
+	GMimeStream *stream;
+	GMimeMessage *message;
+	GArray *warnings;
+	char *marker;
+	gint64 offset;
+	gboolean done;
+} ParserJob;
+
+typedef struct {
+	GMimeParserOptions *options;
+	gboolean can_warn;
+	GMimeFormat format;
+	gboolean persist;
+	gboolean headers_only;
+	gboolean use_arena;
+	size_t bufsize;
+	
+	GMutex lock;
+	GCond cond;
+	
+	GMimeParserMessageFunc callback;
+	gpointer user_data;
+	
+	GThreadPool *pool;
+	GQueue queue;
+	guint limit;
+	int count;
+} ParserSplit;
+
+#define split_marker_len(priv) ((priv)->format == GMIME_FORMAT_MBOX ? MBOX_BOUNDARY_LEN : MMDF_BOUNDARY_LEN)
+
+static gboolean
+is_split_marker (struct _GMimeParserPrivate *priv, const char *inptr, size_t len)
+{
+	if (priv->format == GMIME_FORMAT_MBOX)
+		return is_mbox_marker (inptr, len, FALSE);
+	
+	return len >= MMDF_BOUNDARY_LEN && !strncmp (inptr, MMDF_BOUNDARY, MMDF_BOUNDARY_LEN);
+}
+
+/* Finds the first line after @inptr, within @inend, that begins with
+ * the From-line marker. If none is found, returns %NULL and sets
+ * @resume to the point where the scan needs to resume once more data
+ * is available. */
+static const char *
+parser_split_find_marker (struct _GMimeParserPrivate *priv, const char *inptr, const char *inend, const char **resume)
+{
+	char c = priv->format == GMIME_FORMAT_MBOX ? MBOX_BOUNDARY[0] : MMDF_BOUNDARY[0];
+	const char *eoln;
+	
+	*resume = inptr;
+	
+	while (inptr < inend) {
+		if ((eoln = g_mime_scan_line_starts (inptr, inend - 1, c, c)) == inend - 1) {
+			*resume = inend - 1;
+			return NULL;
+		}
+		
+		if ((size_t) (inend - (eoln + 1)) < split_marker_len (priv)) {
+			/* not enough data to tell */
+			*resume = eoln;
+			return NULL;
+		}
+		
+		if (is_split_marker (priv, eoln + 1, (size_t) (inend - (eoln + 1))))
+			return eoln + 1;
+		
+		inptr = eoln + 1;
+		*resume = inptr;
+	}
+	
+	return NULL;
+}
+
+/* collects the warnings for a message so that they can be passed on to the
+ * caller's warning callback from the calling thread */
+static void
+parser_job_warn (gint64 offset, GMimeParserWarning errcode, const gchar *item, gpointer user_data)
+{
+	ParserJob *job = user_data;
+	ParserWarning warning;
+	
+	warning.offset = offset;
+	warning.errcode = errcode;
+	warning.item = g_strdup (item);
+	
+	g_array_append_val (job->warnings, warning);
+}
+
+static void
+parser_job_run (gpointer data, gpointer user_data)
+{
+	ParserSplit *split = user_data;
+	GMimeParserOptions *options;
+	ParserJob *job = data;
+	GMimeMessage *message;
+	GMimeParser *parser;
+	char *marker;
+	
+	if (split->can_warn) {
+		options = g_mime_parser_options_clone (split->options);
+		g_mime_parser_options_set_warning_callback (options, parser_job_warn, job);
+		job->warnings = g_array_new (FALSE, FALSE, sizeof (ParserWarning));
+	} else {
+		options = split->options;
+	}
+	
+	parser = g_mime_parser_new_with_stream (job->stream);
+	g_mime_parser_set_persist_stream (parser, split->persist);
+	g_mime_parser_set_headers_only (parser, split->headers_only);
+	g_mime_parser_set_use_arena (parser, split->use_arena);
+	g_mime_parser_set_buffer_size (parser, split->bufsize);
+	g_mime_parser_set_format (parser, split->format);
+	
+	message = parser_construct_message (parser, options);
+	marker = g_mime_parser_get_mbox_marker (parser);
+	g_object_unref (parser);
+	
+	if (options != split->options)
+		g_mime_parser_options_free (options);
+	
+	g_mutex_lock (&split->lock);
+	job->message = message;
+	job->marker = marker;
+	job->done = TRUE;
+	g_cond_broadcast (&split->cond);
+	g_mutex_unlock (&split->lock);
+}
+
+static void
+parser_split_deliver (ParserSplit *split)
+{
+	ParserJob *job = g_queue_pop_head (&split->queue);
+	
+	g_mutex_lock (&split->lock);
+	while (!job->done)
+		g_cond_wait (&split->cond, &split->lock);
+	g_mutex_unlock (&split->lock);
+	
+	if (job->warnings != NULL) {
+		ParserWarning *warnings = (ParserWarning *) job->warnings->data;
+		guint i;
+		
+		for (i = 0; i < job->warnings->len; i++) {
+			_g_mime_parser_options_warn (split->options, warnings[i].offset, warnings[i].errcode, warnings[i].item);
+			g_free (warnings[i].item);
+		}
+		
+		g_array_free (job->warnings, TRUE);
+	}
+	
+	if (job->message != NULL) {
+		split->callback (job->message, job->marker, job->offset, split->user_data);
+		g_object_unref (job->message);
+		split->count++;
+	}
+	
+	g_object_unref (job->stream);
+	g_free (job->marker);
+	
+	g_slice_free (ParserJob, job);
+}
+
+static void
+parser_split_queue (ParserSplit *split, GMimeStream *stream, gint64 offset)
+{
+	ParserJob *job;
+	
+	/* don't get too far ahead of the caller */
+	while (split->queue.length >= split->limit)
+		parser_split_deliver (split);
+	
+	job = g_slice_new (ParserJob);
+	job->stream = stream;
+	job->message = NULL;
+	job->warnings = NULL;
+	job->marker = NULL;
+	job->offset = offset;
+	job->done = FALSE;
+	
+	g_queue_push_tail (&split->queue, job);
+	g_thread_pool_push (split->pool, job, NULL);
+}
+
+/* Splits a memory-backed stream into substreams, one per message. */
+static void
+parser_split_mapped (GMimeParser *parser, ParserSplit *split, const char *map, gint64 offset, gint64 length)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	const char *start, *next, *inend, *resume;
+	GMimeStream *stream;
+	
+	start = map + offset;
+	inend = map + length;
+	
+	if (start < inend && !is_split_marker (priv, start, (size_t) (inend - start)))
+		start = parser_split_find_marker (priv, start, inend, &resume);
+	else if (start >= inend)
+		start = NULL;
+	
+	while (start != NULL) {
+		next = parser_split_find_marker (priv, start, inend, &resume);
+		
+		stream = g_mime_stream_substream (priv->stream, start - map, next ? next - map : length);
+		parser_split_queue (split, stream, start - map);
+		start = next;
+	}
+	
+	g_mime_stream_seek (priv->stream, length, GMIME_STREAM_SEEK_SET);
+	priv->offset = length;
+}
+
+/* Reads the stream sequentially, copying each message into its own memory stream. */
+static void
+parser_split_buffered (GMimeParser *parser, ParserSplit *split, gint64 offset)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	const char *inbuf, *inend, *next, *resume;
+	gboolean found = FALSE, first = TRUE, eof = FALSE;
+	size_t start = 0, scanned = 0, n;
+	GMimeStream *stream;
+	GByteArray *buffer;
+	ssize_t nread;
+	guint len;
+	
+	/* start with whatever the parser has already read */
+	buffer = g_byte_array_new ();
+	g_byte_array_append (buffer, (unsigned char *) priv->inptr, (guint) (priv->inend - priv->inptr));
+	
+	/* Note: start and scanned are indexes into the buffer. Data before
+	 * start has either been queued or skipped and is only discarded
+	 * once per read (rather than once per message) so that splitting a
+	 * buffer that contains many messages stays linear. */
+	do {
+		if (start > 0) {
+			g_byte_array_remove_range (buffer, 0, (guint) start);
+			scanned -= start;
+			start = 0;
+		}
+		
+		len = buffer->len;
+		g_byte_array_set_size (buffer, len + SPLIT_BUF);
+		nread = g_mime_stream_read (priv->stream, (char *) buffer->data + len, SPLIT_BUF);
+		g_byte_array_set_size (buffer, len + MAX (nread, 0));
+		eof = nread <= 0;
+		
+		inbuf = (const char *) buffer->data;
+		inend = inbuf + buffer->len;
+		
+		do {
+			if (!found) {
+				if (buffer->len - start < split_marker_len (priv) && !eof)
+					break;
+				
+				/* the parser is always positioned at the start of a line */
+				if (first && is_split_marker (priv, inbuf + start, buffer->len - start)) {
+					found = TRUE;
+					first = FALSE;
+					scanned = start;
+				} else {
+					first = FALSE;
+					
+					/* skip over any garbage before the first From-line */
+					next = parser_split_find_marker (priv, inbuf + scanned, inend, &resume);
+					n = (size_t) ((next ? next : resume) - inbuf);
+					offset += n - start;
+					start = scanned = n;
+					
+					if (next == NULL)
+						break;
+					
+					found = TRUE;
+					continue;
+				}
+			}
+			
+			if (!(next = parser_split_find_marker (priv, inbuf + scanned, inend, &resume))) {
+				scanned = (size_t) (resume - inbuf);
+				break;
+			}
+			
+			/* hand a copy of the complete message over to the thread pool */
+			n = (size_t) (next - inbuf);
+			stream = g_mime_stream_mem_new_with_buffer (inbuf + start, n - start);
+			parser_split_queue (split, stream, offset);
+			
+			offset += n - start;
+			start = scanned = n;
+		} while (TRUE);
+	} while (!eof);
+	
+	if (found && buffer->len > start) {
+		stream = g_mime_stream_mem_new_with_buffer ((const char *) buffer->data + start, buffer->len - start);
+		parser_split_queue (split, stream, offset);
+	}
+	
+	g_byte_array_free (buffer, TRUE);
+	
+	priv->offset = g_mime_stream_tell (priv->stream);
+}
+
+
+/**
+ * g_mime_parser_foreach_message:
+ * @parser: a #GMimeParser context
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @max_threads: the maximum number of threads to parse with or %0 to use one per processor
+ * @callback: (scope call): function to call for each message
+ * @user_data: user data passed to @callback
+ *
+ * Parses all of the remaining messages in an mbox or MMDF stream using a pool
+ * of up to @max_threads threads, calling @callback for each message in the
+ * order that they appear in the stream.
+ *
+ * The stream is first split at each From-line (or MMDF marker) and each of the
+ * resulting messages is then parsed by its own #GMimeParser, configured with
+ * the same format, persist-stream, headers-only, use-arena and buffer-size
+ * settings as @parser. Since the split happens before any headers are
+ * parsed, Content-Length headers are never respected.
+ *
+ * @callback is always invoked from the calling thread, as is the warning
+ * callback of @options (any warnings for a message are reported just
+ * before @callback is invoked for it). The @offset passed to
+ * it is the stream offset of the message's From-line. If the stream is
+ * memory-backed (a #GMimeStreamMem, #GMimeStreamMmap or #GMimeStreamBytes),
+ * each message is parsed from a substream of it; otherwise each message is
+ * first read into memory by the calling thread and the offsets within the
+ * resulting message are relative to the start of its From-line.
+ *
+ * Note: @options must not be modified while the messages are being parsed.
+ *
+ * Returns: the number of messages parsed or %-1 if the parser's format is
+ * neither #GMIME_FORMAT_MBOX nor #GMIME_FORMAT_MMDF.
+ **/
+int
+g_mime_parser_foreach_message (GMimeParser *parser, GMimeParserOptions *options, int max_threads,
+			       GMimeParserMessageFunc callback, gpointer user_data)
+{
+	struct _GMimeParserPrivate *priv;
+	gint64 offset, length;
+	ParserSplit split;
+	const char *map;
+	
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), -1);
+	g_return_val_if_fail (callback != NULL, -1);
+	
+	priv = parser->priv;
+	
+	if (priv->format != GMIME_FORMAT_MBOX && priv->format != GMIME_FORMAT_MMDF)
+		return -1;
+	
+	if (priv->stream == NULL)
+		return 0;
+	
+	if (max_threads <= 0)
+		max_threads = (int) g_get_num_processors ();
+	
+	split.options = options;
+	split.can_warn = g_mime_parser_options_get_warning_callback (options) != NULL;
+	split.format = priv->format;
+	split.persist = priv->persist_stream;
+	split.headers_only = priv->headers_only;
+	split.use_arena = priv->use_arena;
+	split.bufsize = priv->buffer_size;
+	split.callback = callback;
+	split.user_data = user_data;
+	split.limit = (guint) max_threads * 4;
+	split.count = 0;
+	g_mutex_init (&split.lock);
+	g_cond_init (&split.cond);
+	g_queue_init (&split.queue);
+	
+	split.pool = g_thread_pool_new (parser_job_run, &split, max_threads, FALSE, NULL);
+	
+	offset = parser_offset (priv, NULL);
+	
+	if ((map = parser_stream_map (priv->stream, &length)) && offset >= 0 && offset <= length)
+		parser_split_mapped (parser, &split, map, offset, length);
+	else
+		parser_split_buffered (parser, &split, offset);
+	
+	while (!g_queue_is_empty (&split.queue))
+		parser_split_deliver (&split);
+	
+	g_thread_pool_free (split.pool, FALSE, TRUE);
+	g_mutex_clear (&split.lock);
+	g_cond_clear (&split.cond);
+	
+	/* the entire stream has been consumed */
+	priv->inbuf = priv->realbuf + SCAN_HEAD;
+	priv->inptr = priv->inbuf;
+	priv->inend = priv->inbuf;
+	
+	priv->state = priv->format == GMIME_FORMAT_MBOX ? GMIME_PARSER_STATE_FROM : GMIME_PARSER_STATE_AAAA;
+	
+	return split.count;
+}
+
+
 /**
  * g_mime_parser_get_mbox_marker:
  * @parser: a #GMimeParser context
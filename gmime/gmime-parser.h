@@ -95,6 +95,48 @@ typedef void (* GMimeParserHeaderRegexFunc) (GMimeParser *parser, const char *he
 					     gpointer user_data);
 
 
+/**
+ * GMimeParserMessageFunc:
+ * @message: The #GMimeMessage that was parsed.
+ * @marker: The mbox-style From-line of the message or %NULL.
+ * @offset: The stream offset of the message's From-line (or MMDF marker).
+ * @user_data: The user-supplied callback data.
+ *
+ * Function signature for the callback to g_mime_parser_foreach_message().
+ **/
+typedef void (* GMimeParserMessageFunc) (GMimeMessage *message, const char *marker,
+					 gint64 offset, gpointer user_data);
+
+
+/**
+ * GMimeParserEvents:
+ * @part_begin: Called when the parser begins a new MIME part (or message), after
+ * its headers have been parsed. @type and @subtype are the part's Content-Type
+ * (or the implied default), @depth is the nesting level (0 for the toplevel part)
+ * and @offset is the stream offset of the part's headers.
+ * @header: Called for each header field of the MIME part that was most recently
+ * begun, with its raw (folded) value and its stream offset.
+ * @content: Called with each chunk of the raw, undecoded content of the current
+ * MIME part. For multiparts, this is the prologue and epilogue.
+ * @part_end: Called when the parser reaches the end of a MIME part. @offset is
+ * the stream offset just past the part's content.
+ *
+ * A set of callbacks for g_mime_parser_parse_events(). Any of the callbacks may
+ * be %NULL.
+ **/
+typedef struct _GMimeParserEvents GMimeParserEvents;
+
+struct _GMimeParserEvents {
+	void (* part_begin) (GMimeParser *parser, const char *type, const char *subtype,
+			     int depth, gint64 offset, gpointer user_data);
+	void (* header) (GMimeParser *parser, const char *name, const char *value,
+			 gint64 offset, gpointer user_data);
+	void (* content) (GMimeParser *parser, const char *buffer, size_t length,
+			  gpointer user_data);
+	void (* part_end) (GMimeParser *parser, int depth, gint64 offset, gpointer user_data);
+};
+
+
 GType g_mime_parser_get_type (void);
 
 GMimeParser *g_mime_parser_new (void);
@@ -105,12 +147,21 @@ void g_mime_parser_init_with_stream (GMimeParser *parser, GMimeStream *stream);
 gboolean g_mime_parser_get_persist_stream (GMimeParser *parser);
 void g_mime_parser_set_persist_stream (GMimeParser *parser, gboolean persist);
 
+gboolean g_mime_parser_get_use_arena (GMimeParser *parser);
+void g_mime_parser_set_use_arena (GMimeParser *parser, gboolean use_arena);
+
 GMimeFormat g_mime_parser_get_format (GMimeParser *parser);
 void g_mime_parser_set_format (GMimeParser *parser, GMimeFormat format);
 
 gboolean g_mime_parser_get_respect_content_length (GMimeParser *parser);
 void g_mime_parser_set_respect_content_length (GMimeParser *parser, gboolean respect_content_length);
 
+gboolean g_mime_parser_get_headers_only (GMimeParser *parser);
+void g_mime_parser_set_headers_only (GMimeParser *parser, gboolean headers_only);
+
+size_t g_mime_parser_get_buffer_size (GMimeParser *parser);
+void g_mime_parser_set_buffer_size (GMimeParser *parser, size_t size);
+
 void g_mime_parser_set_header_regex (GMimeParser *parser, const char *regex,
 				     GMimeParserHeaderRegexFunc header_cb,
 				     gpointer user_data);
@@ -118,6 +169,12 @@ void g_mime_parser_set_header_regex (GMimeParser *parser, const char *regex,
 GMimeObject *g_mime_parser_construct_part (GMimeParser *parser, GMimeParserOptions *options);
 GMimeMessage *g_mime_parser_construct_message (GMimeParser *parser, GMimeParserOptions *options);
 
+gboolean g_mime_parser_parse_events (GMimeParser *parser, GMimeParserOptions *options,
+				     const GMimeParserEvents *events, gpointer user_data);
+
+int g_mime_parser_foreach_message (GMimeParser *parser, GMimeParserOptions *options, int max_threads,
+				   GMimeParserMessageFunc callback, gpointer user_data);
+
 gint64 g_mime_parser_tell (GMimeParser *parser);
 
 gboolean g_mime_parser_eos (GMimeParser *parser);
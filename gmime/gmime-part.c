@@ -36,9 +36,6 @@
 #include "gmime-stream-null.h"
 #include "gmime-stream-filter.h"
 #include "gmime-filter-basic.h"
-#include "gmime-filter-best.h"
-#include "gmime-filter-checksum.h"
-#include "gmime-filter-unix2dos.h"
 #include "gmime-table-private.h"
 
 #define _(x) x
@@ -149,55 +146,28 @@ g_mime_part_finalize (GObject *object)
 }
 
 
-enum {
-	HEADER_CONTENT_TRANSFER_ENCODING,
-	HEADER_CONTENT_DESCRIPTION,
-	HEADER_CONTENT_LOCATION,
-	HEADER_CONTENT_MD5,
-	HEADER_UNKNOWN
-};
-
-static const char *content_headers[] = {
-	"Content-Transfer-Encoding",
-	"Content-Description",
-	"Content-Location",
-	"Content-Md5",
-};
-
-
 static gboolean
 process_header (GMimeObject *object, GMimeHeader *header)
 {
 	GMimePart *mime_part = (GMimePart *) object;
-	const char *name, *value;
-	guint i;
-	
-	name = g_mime_header_get_name (header);
-	
-	if (g_ascii_strncasecmp (name, "Content-", 8) != 0)
-		return FALSE;
-	
-	for (i = 0; i < G_N_ELEMENTS (content_headers); i++) {
-		if (!g_ascii_strcasecmp (content_headers[i] + 8, name + 8))
-			break;
-	}
+	const char *value;
 	
-	switch (i) {
-	case HEADER_CONTENT_TRANSFER_ENCODING:
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_CONTENT_TRANSFER_ENCODING:
 		value = g_mime_header_get_value (header);
 		mime_part->encoding = g_mime_content_encoding_from_string (value);
 		break;
-	case HEADER_CONTENT_DESCRIPTION:
+	case GMIME_HEADER_ID_CONTENT_DESCRIPTION:
 		value = g_mime_header_get_value (header);
 		g_free (mime_part->content_description);
 		mime_part->content_description = g_strdup (value);
 		break;
-	case HEADER_CONTENT_LOCATION:
+	case GMIME_HEADER_ID_CONTENT_LOCATION:
 		value = g_mime_header_get_value (header);
 		g_free (mime_part->content_location);
 		mime_part->content_location = g_strdup (value);
 		break;
-	case HEADER_CONTENT_MD5:
+	case GMIME_HEADER_ID_CONTENT_MD5:
 		value = g_mime_header_get_value (header);
 		g_free (mime_part->content_md5);
 		mime_part->content_md5 = g_strdup (value);
@@ -231,36 +201,25 @@ static void
 mime_part_header_removed (GMimeObject *object, GMimeHeader *header)
 {
 	GMimePart *mime_part = (GMimePart *) object;
-	const char *name;
-	guint i;
 	
-	name = g_mime_header_get_name (header);
-	
-	if (!g_ascii_strncasecmp (name, "Content-", 8)) {
-		for (i = 0; i < G_N_ELEMENTS (content_headers); i++) {
-			if (!g_ascii_strcasecmp (content_headers[i] + 8, name + 8))
-				break;
-		}
-		
-		switch (i) {
-		case HEADER_CONTENT_TRANSFER_ENCODING:
-			mime_part->encoding = GMIME_CONTENT_ENCODING_DEFAULT;
-			break;
-		case HEADER_CONTENT_DESCRIPTION:
-			g_free (mime_part->content_description);
-			mime_part->content_description = NULL;
-			break;
-		case HEADER_CONTENT_LOCATION:
-			g_free (mime_part->content_location);
-			mime_part->content_location = NULL;
-			break;
-		case HEADER_CONTENT_MD5:
-			g_free (mime_part->content_md5);
-			mime_part->content_md5 = NULL;
-			break;
-		default:
-			break;
-		}
+	switch (_g_mime_header_get_id (header)) {
+	case GMIME_HEADER_ID_CONTENT_TRANSFER_ENCODING:
+		mime_part->encoding = GMIME_CONTENT_ENCODING_DEFAULT;
+		break;
+	case GMIME_HEADER_ID_CONTENT_DESCRIPTION:
+		g_free (mime_part->content_description);
+		mime_part->content_description = NULL;
+		break;
+	case GMIME_HEADER_ID_CONTENT_LOCATION:
+		g_free (mime_part->content_location);
+		mime_part->content_location = NULL;
+		break;
+	case GMIME_HEADER_ID_CONTENT_MD5:
+		g_free (mime_part->content_md5);
+		mime_part->content_md5 = NULL;
+		break;
+	default:
+		break;
 	}
 	
 	GMIME_OBJECT_CLASS (parent_class)->header_removed (object, header);
@@ -376,6 +335,22 @@ write_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream
 	return total;
 }
 
+static gboolean
+content_is_unmodified (GMimePart *part)
+{
+	GMimeStream *source = _g_mime_object_get_source ((GMimeObject *) part);
+	GMimeStream *stream;
+	
+	if (!part->content || !(stream = part->content->stream))
+		return FALSE;
+	
+	/* the content must still be the tail end of the original source and
+	 * still be in the encoding that the headers claim it is in */
+	return stream->super_stream == source->super_stream &&
+		stream->bound_end == source->bound_end &&
+		part->content->encoding == part->encoding;
+}
+
 static ssize_t
 mime_part_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gboolean content_only, GMimeStream *stream)
 {
@@ -383,6 +358,9 @@ mime_part_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gbo
 	ssize_t nwritten, total = 0;
 	const char *newline;
 	
+	if (!content_only && _g_mime_object_can_passthrough (object, options) && content_is_unmodified (mime_part))
+		return _g_mime_object_write_source (object, stream);
+	
 	if (!content_only) {
 		/* write the content headers */
 		if ((nwritten = g_mime_header_list_write_to_stream (object->headers, options, stream)) == -1)
@@ -410,9 +388,8 @@ static void
 mime_part_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 {
 	GMimePart *part = (GMimePart *) object;
+	const GMimeContentAnalysis *analysis;
 	GMimeContentEncoding encoding;
-	GMimeStream *stream, *null;
-	GMimeFilter *filter;
 	
 	switch (part->encoding) {
 	case GMIME_CONTENT_ENCODING_BINARY:
@@ -429,17 +406,11 @@ mime_part_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 		break;
 	}
 	
-	filter = g_mime_filter_best_new (GMIME_FILTER_BEST_ENCODING);
-	
-	null = g_mime_stream_null_new ();
-	stream = g_mime_stream_filter_new (null);
-	g_mime_stream_filter_add ((GMimeStreamFilter *) stream, filter);
-	g_object_unref (null);
-	
-	g_mime_data_wrapper_write_to_stream (part->content, stream);
-	g_object_unref (stream);
+	if (part->content == NULL)
+		return;
 	
-	encoding = g_mime_filter_best_encoding ((GMimeFilterBest *) filter, constraint);
+	analysis = g_mime_data_wrapper_analyze (part->content, GMIME_CONTENT_ANALYSIS_DEFAULT);
+	encoding = g_mime_content_analysis_get_best_encoding (analysis, constraint);
 	
 	switch (part->encoding) {
 	case GMIME_CONTENT_ENCODING_DEFAULT:
@@ -447,20 +418,18 @@ mime_part_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 		break;
 	case GMIME_CONTENT_ENCODING_7BIT:
 		/* This encoding is generally safe, but we may need to encode From-lines. */
-		if (((GMimeFilterBest *) filter)->hadfrom)
+		if (analysis->hadfrom)
 			g_mime_part_set_content_encoding (part, GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE);
 		break;
 	case GMIME_CONTENT_ENCODING_8BIT:
 		if (constraint == GMIME_ENCODING_CONSTRAINT_7BIT)
 			g_mime_part_set_content_encoding (part, encoding);
-		else if (((GMimeFilterBest *) filter)->hadfrom)
+		else if (analysis->hadfrom)
 			g_mime_part_set_content_encoding (part, GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE);
 		break;
 	default:
 		break;
 	}
-	
-	g_object_unref (filter);
 }
 
 
@@ -583,6 +552,32 @@ g_mime_part_get_content_id (GMimePart *mime_part)
 }
 
 
+static void
+compute_content_md5 (GMimePart *mime_part, unsigned char b64digest[32])
+{
+	const GMimeContentAnalysis *analysis;
+	GMimeContentType *content_type;
+	const unsigned char *digest;
+	guint32 save = 0;
+	int state = 0;
+	size_t len;
+	
+	/* text parts are digested in their canonical (CRLF) form */
+	content_type = g_mime_object_get_content_type ((GMimeObject *) mime_part);
+	if (g_mime_content_type_is_type (content_type, "text", "*")) {
+		analysis = g_mime_data_wrapper_analyze (mime_part->content, GMIME_CONTENT_ANALYSIS_MD5_CANONICAL);
+		digest = analysis->canonical_md5;
+	} else {
+		analysis = g_mime_data_wrapper_analyze (mime_part->content, GMIME_CONTENT_ANALYSIS_MD5);
+		digest = analysis->md5;
+	}
+	
+	len = g_mime_encoding_base64_encode_close (digest, 16, b64digest, &state, &save);
+	b64digest[len] = '\0';
+	g_strstrip ((char *) b64digest);
+}
+
+
 /**
  * g_mime_part_set_content_md5:
  * @mime_part: a #GMimePart object
@@ -594,45 +589,16 @@ void
 g_mime_part_set_content_md5 (GMimePart *mime_part, const char *content_md5)
 {
 	GMimeObject *object = (GMimeObject *) mime_part;
-	unsigned char digest[16], b64digest[32];
-	GMimeContentType *content_type;
-	GMimeStream *filtered, *stream;
-	GMimeFilter *filter;
-	guint32 save = 0;
-	int state = 0;
-	size_t len;
+	unsigned char b64digest[32];
 	
 	g_return_if_fail (GMIME_IS_PART (mime_part));
+	g_return_if_fail (content_md5 != NULL || GMIME_IS_DATA_WRAPPER (mime_part->content));
 	
 	g_free (mime_part->content_md5);
 	
 	if (!content_md5) {
 		/* compute a md5sum */
-		stream = g_mime_stream_null_new ();
-		filtered = g_mime_stream_filter_new (stream);
-		g_object_unref (stream);
-		
-		content_type = g_mime_object_get_content_type ((GMimeObject *) mime_part);
-		if (g_mime_content_type_is_type (content_type, "text", "*")) {
-			filter = g_mime_filter_unix2dos_new (FALSE);
-			g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-			g_object_unref (filter);
-		}
-		
-	        filter = g_mime_filter_checksum_new (G_CHECKSUM_MD5);
-		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-		
-		g_mime_data_wrapper_write_to_stream (mime_part->content, filtered);
-		g_object_unref (filtered);
-		
-		memset (digest, 0, 16);
-		g_mime_filter_checksum_get_digest ((GMimeFilterChecksum *) filter, digest, 16);
-		g_object_unref (filter);
-		
-		len = g_mime_encoding_base64_encode_close (digest, 16, b64digest, &state, &save);
-		b64digest[len] = '\0';
-		g_strstrip ((char *) b64digest);
-		
+		compute_content_md5 (mime_part, b64digest);
 		content_md5 = (const char *) b64digest;
 	}
 	
@@ -656,13 +622,7 @@ g_mime_part_set_content_md5 (GMimePart *mime_part, const char *content_md5)
 gboolean
 g_mime_part_verify_content_md5 (GMimePart *mime_part)
 {
-	unsigned char digest[16], b64digest[32];
-	GMimeContentType *content_type;
-	GMimeStream *filtered, *stream;
-	GMimeFilter *filter;
-	guint32 save = 0;
-	int state = 0;
-	size_t len;
+	unsigned char b64digest[32];
 	
 	g_return_val_if_fail (GMIME_IS_PART (mime_part), FALSE);
 	g_return_val_if_fail (GMIME_IS_DATA_WRAPPER (mime_part->content), FALSE);
@@ -670,30 +630,7 @@ g_mime_part_verify_content_md5 (GMimePart *mime_part)
 	if (!mime_part->content_md5)
 		return FALSE;
 	
-	stream = g_mime_stream_null_new ();
-	filtered = g_mime_stream_filter_new (stream);
-	g_object_unref (stream);
-	
-	content_type = g_mime_object_get_content_type ((GMimeObject *) mime_part);
-	if (g_mime_content_type_is_type (content_type, "text", "*")) {
-		filter = g_mime_filter_unix2dos_new (FALSE);
-		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-		g_object_unref (filter);
-	}
-	
-	filter = g_mime_filter_checksum_new (G_CHECKSUM_MD5);
-	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-	
-	g_mime_data_wrapper_write_to_stream (mime_part->content, filtered);
-	g_object_unref (filtered);
-	
-	memset (digest, 0, 16);
-	g_mime_filter_checksum_get_digest ((GMimeFilterChecksum *) filter, digest, 16);
-	g_object_unref (filter);
-	
-	len = g_mime_encoding_base64_encode_close (digest, 16, b64digest, &state, &save);
-	b64digest[len] = '\0';
-	g_strstrip ((char *) b64digest);
+	compute_content_md5 (mime_part, b64digest);
 	
 	return !strcmp ((char *) b64digest, mime_part->content_md5);
 }
@@ -818,29 +755,16 @@ g_mime_part_get_content_encoding (GMimePart *mime_part)
 GMimeContentEncoding
 g_mime_part_get_best_content_encoding (GMimePart *mime_part, GMimeEncodingConstraint constraint)
 {
-	GMimeStream *filtered, *stream;
-	GMimeContentEncoding encoding;
-	GMimeFilterBest *best;
-	GMimeFilter *filter;
+	const GMimeContentAnalysis *analysis;
 	
 	g_return_val_if_fail (GMIME_IS_PART (mime_part), GMIME_CONTENT_ENCODING_DEFAULT);
 	
-	stream = g_mime_stream_null_new ();
-	filtered = g_mime_stream_filter_new (stream);
-	g_object_unref (stream);
-	
-	filter = g_mime_filter_best_new (GMIME_FILTER_BEST_ENCODING);
-	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-	best = (GMimeFilterBest *) filter;
-	
-	g_mime_data_wrapper_write_to_stream (mime_part->content, filtered);
-	g_mime_stream_flush (filtered);
-	g_object_unref (filtered);
+	if (mime_part->content == NULL)
+		return GMIME_CONTENT_ENCODING_DEFAULT;
 	
-	encoding = g_mime_filter_best_encoding (best, constraint);
-	g_object_unref (best);
+	analysis = g_mime_data_wrapper_analyze (mime_part->content, GMIME_CONTENT_ANALYSIS_DEFAULT);
 	
-	return encoding;
+	return g_mime_content_analysis_get_best_encoding (analysis, constraint);
 }
 
 
@@ -923,6 +847,10 @@ set_content (GMimePart *mime_part, GMimeDataWrapper *content)
 	
 	mime_part->openpgp = (GMimeOpenPGPData) -1;
 	
+	/* the original source no longer matches the content */
+	_g_mime_object_set_source ((GMimeObject *) mime_part, NULL);
+	_g_mime_object_set_dirty ((GMimeObject *) mime_part);
+	
 	mime_part->content = content;
 	g_object_ref (content);
 }
@@ -0,0 +1,261 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gmime-pool.h"
+
+
+/* A GMimePool is a freelist of fixed-size chunks. Released chunks are
+ * kept (up to max_free of them) and handed back out by the next
+ * allocation instead of going through malloc/free every time.
+ *
+ * Every chunk is a separate heap allocation, so a chunk may be
+ * released to a different pool of the same size than the one it was
+ * allocated from. That is what makes the per-thread pools below safe
+ * to use for structs that are allocated on one thread and freed on
+ * another. A GMimePool is not itself thread-safe. */
+
+#define POOL_ALIGN       sizeof (gpointer)
+#define POOL_NCLASSES    8
+#define POOL_MAX_SIZE    (POOL_ALIGN * POOL_NCLASSES)
+#define POOL_THREAD_FREE 256
+
+struct _GMimePool {
+	gpointer free;
+	size_t size;
+	guint nfree;
+	guint max_free;
+};
+
+
+/**
+ * g_mime_pool_new:
+ * @size: the size of the chunks
+ * @max_free: the maximum number of released chunks to keep around
+ *
+ * Creates a new #GMimePool for chunks of @size bytes.
+ *
+ * Returns: a new #GMimePool.
+ **/
+GMimePool *
+g_mime_pool_new (size_t size, guint max_free)
+{
+	GMimePool *pool;
+	
+	pool = g_new (GMimePool, 1);
+	pool->size = MAX (size, sizeof (gpointer));
+	pool->max_free = max_free;
+	pool->free = NULL;
+	pool->nfree = 0;
+	
+	return pool;
+}
+
+
+/**
+ * g_mime_pool_free:
+ * @pool: a #GMimePool
+ *
+ * Frees @pool along with all of the released chunks that it holds.
+ * Chunks that are still in use are not affected.
+ **/
+void
+g_mime_pool_free (GMimePool *pool)
+{
+	gpointer mem, next;
+	
+	mem = pool->free;
+	while (mem != NULL) {
+		next = *((gpointer *) mem);
+		g_free (mem);
+		mem = next;
+	}
+	
+	g_free (pool);
+}
+
+
+/**
+ * g_mime_pool_alloc:
+ * @pool: a #GMimePool
+ *
+ * Allocates an uninitialized chunk from @pool.
+ *
+ * Returns: the chunk.
+ **/
+gpointer
+g_mime_pool_alloc (GMimePool *pool)
+{
+	gpointer mem;
+	
+	if ((mem = pool->free) == NULL)
+		return g_malloc (pool->size);
+	
+	pool->free = *((gpointer *) mem);
+	pool->nfree--;
+	
+	return mem;
+}
+
+
+/**
+ * g_mime_pool_alloc0:
+ * @pool: a #GMimePool
+ *
+ * Allocates a zero-filled chunk from @pool.
+ *
+ * Returns: the chunk.
+ **/
+gpointer
+g_mime_pool_alloc0 (GMimePool *pool)
+{
+	return memset (g_mime_pool_alloc (pool), 0, pool->size);
+}
+
+
+/**
+ * g_mime_pool_release:
+ * @pool: a #GMimePool
+ * @mem: a chunk allocated from a #GMimePool of the same size
+ *
+ * Releases @mem back to @pool.
+ **/
+void
+g_mime_pool_release (GMimePool *pool, gpointer mem)
+{
+	if (pool->nfree >= pool->max_free) {
+		g_free (mem);
+		return;
+	}
+	
+	*((gpointer *) mem) = pool->free;
+	pool->free = mem;
+	pool->nfree++;
+}
+
+
+typedef struct {
+	GMimePool *pools[POOL_NCLASSES];
+} ThreadPools;
+
+static void
+thread_pools_free (gpointer data)
+{
+	ThreadPools *tp = data;
+	guint i;
+	
+	for (i = 0; i < POOL_NCLASSES; i++)
+		g_mime_pool_free (tp->pools[i]);
+	
+	g_free (tp);
+}
+
+static GPrivate thread_pools = G_PRIVATE_INIT (thread_pools_free);
+
+static GMimePool *
+thread_pool_get (size_t size)
+{
+	ThreadPools *tp;
+	guint i;
+	
+	if (!(tp = g_private_get (&thread_pools))) {
+		tp = g_new (ThreadPools, 1);
+		for (i = 0; i < POOL_NCLASSES; i++)
+			tp->pools[i] = g_mime_pool_new ((i + 1) * POOL_ALIGN, POOL_THREAD_FREE);
+		
+		g_private_set (&thread_pools, tp);
+	}
+	
+	return tp->pools[(size - 1) / POOL_ALIGN];
+}
+
+
+/**
+ * g_mime_pool_thread_alloc:
+ * @size: the size of the chunk
+ *
+ * Allocates an uninitialized chunk of @size bytes from the calling
+ * thread's pools.
+ *
+ * Returns: the chunk.
+ **/
+gpointer
+g_mime_pool_thread_alloc (size_t size)
+{
+	if (size == 0 || size > POOL_MAX_SIZE)
+		return g_malloc (size);
+	
+	return g_mime_pool_alloc (thread_pool_get (size));
+}
+
+
+/**
+ * g_mime_pool_thread_alloc0:
+ * @size: the size of the chunk
+ *
+ * Allocates a zero-filled chunk of @size bytes from the calling
+ * thread's pools.
+ *
+ * Returns: the chunk.
+ **/
+gpointer
+g_mime_pool_thread_alloc0 (size_t size)
+{
+	return memset (g_mime_pool_thread_alloc (size), 0, size);
+}
+
+
+/**
+ * g_mime_pool_thread_release:
+ * @size: the size that was passed to g_mime_pool_thread_alloc()
+ * @mem: the chunk
+ *
+ * Releases @mem back to the calling thread's pools. The chunk does
+ * not need to have been allocated on the calling thread.
+ **/
+void
+g_mime_pool_thread_release (size_t size, gpointer mem)
+{
+	if (size == 0 || size > POOL_MAX_SIZE) {
+		g_free (mem);
+		return;
+	}
+	
+	g_mime_pool_release (thread_pool_get (size), mem);
+}
+
+
+/**
+ * g_mime_pool_thread_shutdown:
+ *
+ * Frees the calling thread's pools. Other threads' pools are freed
+ * when those threads exit.
+ **/
+void
+g_mime_pool_thread_shutdown (void)
+{
+	g_private_replace (&thread_pools, NULL);
+}
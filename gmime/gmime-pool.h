@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifndef __GMIME_POOL_H__
+#define __GMIME_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GMimePool GMimePool;
+
+G_GNUC_INTERNAL GMimePool *g_mime_pool_new (size_t size, guint max_free);
+G_GNUC_INTERNAL void g_mime_pool_free (GMimePool *pool);
+
+G_GNUC_INTERNAL gpointer g_mime_pool_alloc (GMimePool *pool);
+G_GNUC_INTERNAL gpointer g_mime_pool_alloc0 (GMimePool *pool);
+G_GNUC_INTERNAL void g_mime_pool_release (GMimePool *pool, gpointer mem);
+
+G_GNUC_INTERNAL gpointer g_mime_pool_thread_alloc (size_t size);
+G_GNUC_INTERNAL gpointer g_mime_pool_thread_alloc0 (size_t size);
+G_GNUC_INTERNAL void g_mime_pool_thread_release (size_t size, gpointer mem);
+
+G_GNUC_INTERNAL void g_mime_pool_thread_shutdown (void);
+
+G_END_DECLS
+
+#endif /* __GMIME_POOL_H__ */
@@ -26,7 +26,16 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
 #include "gmime-stream-buffer.h"
+#include "gmime-stream-bytes.h"
+#include "gmime-stream-mmap.h"
+#include "gmime-stream-mem.h"
+#include "gmime-stream-fs.h"
+#include "gmime-internal.h"
 
 /**
  * SECTION: gmime-stream-buffer
@@ -42,9 +51,18 @@
  * can become memory intensive but can be very helpful when inheriting
  * from a stream that does not support seeking (Note: this mode is the
  * least tested so be careful using it).
+ *
+ * The size of the blocks may be chosen using
+ * g_mime_stream_buffer_new_with_size(). When reading from a file that
+ * is slow to access (such as one on a network file system), block
+ * reads may also be told to prefetch the next block ahead of time using
+ * g_mime_stream_buffer_set_readahead().
  **/
 
 #define BLOCK_BUFFER_LEN   4096
+#define GETS_BLOCK_LEN     256
+
+#define BUFFER_SIZE(buffer) ((size_t) ((buffer)->bufend - (buffer)->buffer))
 
 static void g_mime_stream_buffer_class_init (GMimeStreamBufferClass *klass);
 static void g_mime_stream_buffer_init (GMimeStreamBuffer *stream, GMimeStreamBufferClass *klass);
@@ -60,9 +78,17 @@ static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence w
 static gint64 stream_tell (GMimeStream *stream);
 static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
 
 
+typedef struct {
+	gboolean readahead;
+} GMimeStreamBufferPrivate;
+
+#define GMIME_STREAM_BUFFER_PRIVATE(stream) ((GMimeStreamBufferPrivate *) G_STRUCT_MEMBER_P (stream, private_offset))
+
 static GMimeStreamClass *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -84,6 +110,7 @@ g_mime_stream_buffer_get_type (void)
 		};
 		
 		type = g_type_register_static (GMIME_TYPE_STREAM, "GMimeStreamBuffer", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeStreamBufferPrivate));
 	}
 	
 	return type;
@@ -97,6 +124,7 @@ g_mime_stream_buffer_class_init (GMimeStreamBufferClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (GMIME_TYPE_STREAM);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_stream_buffer_finalize;
 	
@@ -110,6 +138,7 @@ g_mime_stream_buffer_class_init (GMimeStreamBufferClass *klass)
 	stream_class->tell = stream_tell;
 	stream_class->length = stream_length;
 	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_writev (stream_class, stream_writev);
 }
 
 static void
@@ -121,6 +150,8 @@ g_mime_stream_buffer_init (GMimeStreamBuffer *stream, GMimeStreamBufferClass *kl
 	stream->bufend = NULL;
 	stream->buflen = 0;
 	stream->mode = 0;
+	
+	GMIME_STREAM_BUFFER_PRIVATE (stream)->readahead = FALSE;
 }
 
 static void
@@ -134,6 +165,43 @@ g_mime_stream_buffer_finalize (GObject *object)
 }
 
 
+static void
+buffer_readahead (GMimeStreamBuffer *buffer)
+{
+#if defined (HAVE_POSIX_FADVISE) && defined (POSIX_FADV_WILLNEED)
+	GMimeStream *source = buffer->source;
+	gint64 len = (gint64) BUFFER_SIZE (buffer);
+	int fd;
+	
+	if (!GMIME_STREAM_BUFFER_PRIVATE (buffer)->readahead || !GMIME_IS_STREAM_FS (source))
+		return;
+	
+	if ((fd = ((GMimeStreamFs *) source)->fd) == -1)
+		return;
+	
+	if (source->bound_end != -1 && (len = MIN (source->bound_end - source->position, len)) <= 0)
+		return;
+	
+	/* ask the kernel to start fetching the next block so that it is
+	 * (hopefully) already in the page cache by the time we need it */
+	posix_fadvise (fd, (off_t) source->position, (off_t) len, POSIX_FADV_WILLNEED);
+#endif
+}
+
+static ssize_t
+buffer_fill (GMimeStreamBuffer *buffer)
+{
+	ssize_t n;
+	
+	buffer->bufptr = buffer->buffer;
+	if ((n = g_mime_stream_read (buffer->source, buffer->buffer, BUFFER_SIZE (buffer))) > 0) {
+		buffer->buflen = n;
+		buffer_readahead (buffer);
+	}
+	
+	return n;
+}
+
 static ssize_t
 stream_read (GMimeStream *stream, char *buf, size_t len)
 {
@@ -156,7 +224,7 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 				len -= n;
 			}
 			
-			if (len >= BLOCK_BUFFER_LEN) {
+			if (len >= BUFFER_SIZE (buffer)) {
 				/* bypass intermediate buffer, read straight from disk */
 				buffer->bufptr = buffer->buffer;
 				if ((n = g_mime_stream_read (buffer->source, buf + nread, len)) > 0) {
@@ -167,10 +235,7 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 				break;
 			} else if (len > 0) {
 				/* buffer more data */
-				if ((n = g_mime_stream_read (buffer->source, buffer->buffer, BLOCK_BUFFER_LEN)) > 0)
-					buffer->buflen = n;
-				
-				buffer->bufptr = buffer->buffer;
+				n = buffer_fill (buffer);
 			}
 			
 			if (n <= 0) {
@@ -195,6 +260,7 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 {
 	GMimeStreamBuffer *buffer = (GMimeStreamBuffer *) stream;
 	GMimeStream *source = buffer->source;
+	size_t bufsize = BUFFER_SIZE (buffer);
 	ssize_t n, nwritten = 0;
 	size_t left = len;
 	
@@ -205,8 +271,8 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 	
 	if (buffer->mode == GMIME_STREAM_BUFFER_BLOCK_WRITE) {
 		while (left > 0) {
-			n = MIN (BLOCK_BUFFER_LEN - buffer->buflen, left);
-			if (buffer->buflen > 0 || n < BLOCK_BUFFER_LEN) {
+			n = MIN (bufsize - buffer->buflen, left);
+			if (buffer->buflen > 0 || n < bufsize) {
 				/* add the data to our pending write buffer */
 				memcpy (buffer->bufptr, buf + nwritten, n);
 				buffer->bufptr += n;
@@ -215,16 +281,16 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 				left -= n;
 			}
 			
-			if (buffer->buflen == BLOCK_BUFFER_LEN) {
+			if (buffer->buflen == bufsize) {
 				/* flush our buffer... */
-				n = g_mime_stream_write (source, buffer->buffer, BLOCK_BUFFER_LEN);
-				if (n == BLOCK_BUFFER_LEN) {
+				n = g_mime_stream_write (source, buffer->buffer, bufsize);
+				if (n == bufsize) {
 					/* wrote everything... */
 					buffer->bufptr = buffer->buffer;
 					buffer->buflen = 0;
 				} else if (n > 0) {
 					/* still have buffered data left... */
-					memmove (buffer->buffer, buffer->buffer + n, BLOCK_BUFFER_LEN - n);
+					memmove (buffer->buffer, buffer->buffer + n, bufsize - n);
 					buffer->bufptr -= n;
 					buffer->buflen -= n;
 				} else if (n == -1) {
@@ -235,9 +301,9 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 				}
 			}
 			
-			if (buffer->buflen == 0 && left >= BLOCK_BUFFER_LEN) {
-				while (left >= BLOCK_BUFFER_LEN) {
-					if ((n = g_mime_stream_write (source, buf + nwritten, BLOCK_BUFFER_LEN)) == -1) {
+			if (buffer->buflen == 0 && left >= bufsize) {
+				while (left >= bufsize) {
+					if ((n = g_mime_stream_write (source, buf + nwritten, bufsize)) == -1) {
 						if (nwritten == 0)
 							return -1;
 						
@@ -248,7 +314,7 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 					left -= n;
 				}
 				
-				if (left >= BLOCK_BUFFER_LEN)
+				if (left >= bufsize)
 					break;
 			}
 		}
@@ -262,6 +328,46 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 	return nwritten;
 }
 
+static gint64
+stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+{
+	GMimeStreamBuffer *buffer = (GMimeStreamBuffer *) stream;
+	size_t len = 0, i;
+	gint64 nwritten;
+	
+	if (buffer->source == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	if (buffer->mode != GMIME_STREAM_BUFFER_BLOCK_WRITE) {
+		/* writes are not buffered, so pass the whole vector on */
+		if ((nwritten = g_mime_stream_writev (buffer->source, vector, count)) == -1)
+			return -1;
+		
+		stream->position += nwritten;
+		
+		return nwritten;
+	}
+	
+	for (i = 0; i < count; i++)
+		len += vector[i].len;
+	
+	if (buffer->buflen + len >= BUFFER_SIZE (buffer))
+		return _g_mime_stream_generic_writev (stream, vector, count);
+	
+	/* everything fits in our pending write buffer */
+	for (i = 0; i < count; i++) {
+		memcpy (buffer->bufptr, vector[i].data, vector[i].len);
+		buffer->bufptr += vector[i].len;
+	}
+	
+	buffer->buflen += len;
+	stream->position += len;
+	
+	return len;
+}
+
 static int
 stream_flush (GMimeStream *stream)
 {
@@ -491,19 +597,43 @@ stream_substream (GMimeStream *stream, gint64 start, gint64 end)
  **/
 GMimeStream *
 g_mime_stream_buffer_new (GMimeStream *source, GMimeStreamBufferMode mode)
+{
+	return g_mime_stream_buffer_new_with_size (source, mode, BLOCK_BUFFER_LEN);
+}
+
+
+/**
+ * g_mime_stream_buffer_new_with_size:
+ * @source: source stream
+ * @mode: buffering mode
+ * @size: the size of the blocks to read or write or %0 for the default
+ *
+ * Creates a new GMimeStreamBuffer object that reads or writes blocks of
+ * @size bytes at a time rather than the default of 4k.
+ *
+ * Larger blocks mean fewer (but bigger) reads or writes on @source,
+ * which helps when each access has a high latency.
+ *
+ * Returns: a new buffer stream with source @source and mode @mode.
+ **/
+GMimeStream *
+g_mime_stream_buffer_new_with_size (GMimeStream *source, GMimeStreamBufferMode mode, size_t size)
 {
 	GMimeStreamBuffer *buffer;
 	
 	g_return_val_if_fail (GMIME_IS_STREAM (source), NULL);
 	
+	if (size == 0)
+		size = BLOCK_BUFFER_LEN;
+	
 	buffer = g_object_new (GMIME_TYPE_STREAM_BUFFER, NULL);
 	
 	buffer->source = source;
 	g_object_ref (source);
 	
 	buffer->mode = mode;
-	buffer->buffer = g_malloc (BLOCK_BUFFER_LEN);
-	buffer->bufend = buffer->buffer + BLOCK_BUFFER_LEN;
+	buffer->buffer = g_malloc (size);
+	buffer->bufend = buffer->buffer + size;
 	buffer->bufptr = buffer->buffer;
 	buffer->buflen = 0;
 	
@@ -515,6 +645,74 @@ g_mime_stream_buffer_new (GMimeStream *source, GMimeStreamBufferMode mode)
 }
 
 
+/**
+ * g_mime_stream_buffer_set_readahead:
+ * @stream: a #GMimeStreamBuffer
+ * @readahead: %TRUE if the next block should be prefetched
+ *
+ * Sets whether or not a #GMIME_STREAM_BUFFER_BLOCK_READ buffer stream
+ * should prefetch the next block of its source stream each time that
+ * it reads a block.
+ *
+ * Prefetching is done by the operating system in the background, so it
+ * is only possible when the source stream is a #GMimeStreamFs on a
+ * system that supports posix_fadvise(). Otherwise this has no effect.
+ **/
+void
+g_mime_stream_buffer_set_readahead (GMimeStreamBuffer *stream, gboolean readahead)
+{
+	g_return_if_fail (GMIME_IS_STREAM_BUFFER (stream));
+	
+	GMIME_STREAM_BUFFER_PRIVATE (stream)->readahead = readahead;
+	
+#if defined (HAVE_POSIX_FADVISE) && defined (POSIX_FADV_SEQUENTIAL)
+	if (readahead && stream->mode == GMIME_STREAM_BUFFER_BLOCK_READ && GMIME_IS_STREAM_FS (stream->source)) {
+		GMimeStream *source = stream->source;
+		int fd = ((GMimeStreamFs *) source)->fd;
+		gint64 len = 0;
+		
+		if (fd == -1)
+			return;
+		
+		if (source->bound_end != -1)
+			len = source->bound_end - source->bound_start;
+		
+		/* let the kernel know that it may use a larger readahead window */
+		posix_fadvise (fd, (off_t) source->bound_start, (off_t) len, POSIX_FADV_SEQUENTIAL);
+	}
+#endif
+}
+
+
+/**
+ * g_mime_stream_buffer_get_readahead:
+ * @stream: a #GMimeStreamBuffer
+ *
+ * Gets whether or not @stream prefetches the next block of its source
+ * stream.
+ *
+ * Returns: %TRUE if readahead is enabled or %FALSE otherwise.
+ **/
+gboolean
+g_mime_stream_buffer_get_readahead (GMimeStreamBuffer *stream)
+{
+	g_return_val_if_fail (GMIME_IS_STREAM_BUFFER (stream), FALSE);
+	
+	return GMIME_STREAM_BUFFER_PRIVATE (stream)->readahead;
+}
+
+
+/* streams that can seek back over data they have already returned for
+ * next to nothing; gets() reads these a block at a time and rewinds to
+ * just past the newline, anything else is read a byte at a time */
+static gboolean
+stream_can_reread (GMimeStream *stream)
+{
+	return GMIME_IS_STREAM_MEM (stream) || GMIME_IS_STREAM_MMAP (stream) ||
+		GMIME_IS_STREAM_BYTES (stream) || GMIME_IS_STREAM_FS (stream);
+}
+
+
 /**
  * g_mime_stream_buffer_gets:
  * @stream: stream
@@ -527,6 +725,11 @@ g_mime_stream_buffer_new (GMimeStream *source, GMimeStreamBufferMode mode)
  * the buffer. A '\0' is stored after the last character in the
  * buffer.
  *
+ * If @stream is not a #GMIME_STREAM_BUFFER_BLOCK_READ buffer stream,
+ * a #GMimeStreamFs, #GMimeStreamMem, #GMimeStreamMmap or
+ * #GMimeStreamBytes is read in small blocks and then seeked back to
+ * just past the newline. Any other stream is read a byte at a time.
+ *
  * Returns: the number of characters read into @buf on success or %-1
  * on fail.
  **/
@@ -536,6 +739,7 @@ g_mime_stream_buffer_gets (GMimeStream *stream, char *buf, size_t max)
 	register char *inptr, *outptr;
 	char *inend, *outend;
 	ssize_t nread, n;
+	gint64 offset;
 	char c = '\0';
 	
 	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
@@ -565,12 +769,8 @@ g_mime_stream_buffer_gets (GMimeStream *stream, char *buf, size_t max)
 				
 				if (buffer->buflen == 0) {
 					/* buffer more data */
-					buffer->bufptr = buffer->buffer;
-					n = g_mime_stream_read (buffer->source, buffer->buffer, BLOCK_BUFFER_LEN);
-					if (n <= 0)
+					if (buffer_fill (buffer) <= 0)
 						break;
-					
-					buffer->buflen = n;
 				}
 			}
 			
@@ -580,10 +780,36 @@ g_mime_stream_buffer_gets (GMimeStream *stream, char *buf, size_t max)
 			goto slow_and_painful;
 		}
 	} else {
-		/* ugh...do it the slow and painful way... */
 	slow_and_painful:
-		while (outptr < outend && c != '\n' && (nread = g_mime_stream_read (stream, &c, 1)) == 1)
-			*outptr++ = c;
+		if (stream_can_reread (stream) &&
+		    (offset = g_mime_stream_tell (stream)) != -1 &&
+		    g_mime_stream_seek (stream, offset, GMIME_STREAM_SEEK_SET) == offset) {
+			/* read a block at a time and then seek back to just past the newline */
+			while (outptr < outend && c != '\n') {
+				n = (ssize_t) MIN ((size_t) (outend - outptr), GETS_BLOCK_LEN);
+				if ((nread = g_mime_stream_read (stream, outptr, n)) <= 0)
+					break;
+				
+				inptr = outptr;
+				inend = outptr + nread;
+				
+				while (inptr < inend && *inptr != '\n')
+					inptr++;
+				
+				if (inptr < inend) {
+					c = *inptr++;
+					
+					if (inptr < inend && g_mime_stream_seek (stream, offset + (inptr - buf), GMIME_STREAM_SEEK_SET) == -1)
+						return -1;
+				}
+				
+				outptr = inptr;
+			}
+		} else {
+			/* ugh...do it the slow and painful way... */
+			while (outptr < outend && c != '\n' && (nread = g_mime_stream_read (stream, &c, 1)) == 1)
+				*outptr++ = c;
+		}
 	}
 	
 	if (outptr <= outend) {
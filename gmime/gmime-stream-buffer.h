@@ -39,8 +39,8 @@ typedef struct _GMimeStreamBufferClass GMimeStreamBufferClass;
 
 /**
  * GMimeStreamBufferMode:
- * @GMIME_STREAM_BUFFER_BLOCK_READ: Read in 4k blocks.
- * @GMIME_STREAM_BUFFER_BLOCK_WRITE: Write in 4k blocks.
+ * @GMIME_STREAM_BUFFER_BLOCK_READ: Read in blocks (4k by default).
+ * @GMIME_STREAM_BUFFER_BLOCK_WRITE: Write in blocks (4k by default).
  *
  * The buffering mode for a #GMimeStreamBuffer stream.
  **/
@@ -83,6 +83,10 @@ struct _GMimeStreamBufferClass {
 GType g_mime_stream_buffer_get_type (void);
 
 GMimeStream *g_mime_stream_buffer_new (GMimeStream *source, GMimeStreamBufferMode mode);
+GMimeStream *g_mime_stream_buffer_new_with_size (GMimeStream *source, GMimeStreamBufferMode mode, size_t size);
+
+void g_mime_stream_buffer_set_readahead (GMimeStreamBuffer *stream, gboolean readahead);
+gboolean g_mime_stream_buffer_get_readahead (GMimeStreamBuffer *stream);
 
 ssize_t g_mime_stream_buffer_gets (GMimeStream *stream, char *buf, size_t max);
 
@@ -0,0 +1,383 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+
+#include "gmime-stream-bytes.h"
+#include "gmime-internal.h"
+
+
+/**
+ * SECTION: gmime-stream-bytes
+ * @title: GMimeStreamBytes
+ * @short_description: A read-only stream backed by a #GBytes
+ * @see_also: #GMimeStream, #GMimeStreamMem
+ *
+ * A read-only #GMimeStream implementation that wraps an immutable
+ * #GBytes without copying it. Substreams share the same #GBytes, so
+ * slicing a #GMimeStreamBytes never copies any data either.
+ *
+ * When a #GMimeParser parses a #GMimeStreamBytes, the content of each
+ * MIME part is a substream of it even if persist-stream mode has been
+ * disabled since the underlying data cannot change.
+ **/
+
+
+static void g_mime_stream_bytes_class_init (GMimeStreamBytesClass *klass);
+static void g_mime_stream_bytes_init (GMimeStreamBytes *stream, GMimeStreamBytesClass *klass);
+static void g_mime_stream_bytes_finalize (GObject *object);
+
+static ssize_t stream_read (GMimeStream *stream, char *buf, size_t len);
+static ssize_t stream_write (GMimeStream *stream, const char *buf, size_t len);
+static int stream_flush (GMimeStream *stream);
+static int stream_close (GMimeStream *stream);
+static gboolean stream_eos (GMimeStream *stream);
+static int stream_reset (GMimeStream *stream);
+static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence);
+static gint64 stream_tell (GMimeStream *stream);
+static gint64 stream_length (GMimeStream *stream);
+static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_write_to_stream (GMimeStream *stream, GMimeStream *dest);
+
+
+static GMimeStreamClass *parent_class = NULL;
+
+
+GType
+g_mime_stream_bytes_get_type (void)
+{
+	static GType type = 0;
+	
+	if (!type) {
+		static const GTypeInfo info = {
+			sizeof (GMimeStreamBytesClass),
+			NULL, /* base_class_init */
+			NULL, /* base_class_finalize */
+			(GClassInitFunc) g_mime_stream_bytes_class_init,
+			NULL, /* class_finalize */
+			NULL, /* class_data */
+			sizeof (GMimeStreamBytes),
+			0,    /* n_preallocs */
+			(GInstanceInitFunc) g_mime_stream_bytes_init,
+		};
+		
+		type = g_type_register_static (GMIME_TYPE_STREAM, "GMimeStreamBytes", &info, 0);
+	}
+	
+	return type;
+}
+
+
+static void
+g_mime_stream_bytes_class_init (GMimeStreamBytesClass *klass)
+{
+	GMimeStreamClass *stream_class = GMIME_STREAM_CLASS (klass);
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	
+	parent_class = g_type_class_ref (GMIME_TYPE_STREAM);
+	
+	object_class->finalize = g_mime_stream_bytes_finalize;
+	
+	stream_class->read = stream_read;
+	stream_class->write = stream_write;
+	stream_class->flush = stream_flush;
+	stream_class->close = stream_close;
+	stream_class->eos = stream_eos;
+	stream_class->reset = stream_reset;
+	stream_class->seek = stream_seek;
+	stream_class->tell = stream_tell;
+	stream_class->length = stream_length;
+	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_write_to_stream (stream_class, stream_write_to_stream);
+}
+
+static void
+g_mime_stream_bytes_init (GMimeStreamBytes *stream, GMimeStreamBytesClass *klass)
+{
+	stream->bytes = NULL;
+}
+
+static void
+g_mime_stream_bytes_finalize (GObject *object)
+{
+	GMimeStream *stream = (GMimeStream *) object;
+	
+	stream_close (stream);
+	
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static gint64
+bytes_bound_end (GMimeStream *stream)
+{
+	gint64 len = (gint64) g_bytes_get_size (((GMimeStreamBytes *) stream)->bytes);
+	
+	return stream->bound_end != -1 ? MIN (stream->bound_end, len) : len;
+}
+
+static ssize_t
+stream_read (GMimeStream *stream, char *buf, size_t len)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	const char *data;
+	ssize_t n;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	n = (ssize_t) MIN (bytes_bound_end (stream) - stream->position, (gint64) len);
+	if (n > 0) {
+		data = g_bytes_get_data (bytes->bytes, NULL);
+		memcpy (buf, data + stream->position, n);
+		stream->position += n;
+	} else if (n < 0) {
+		errno = EINVAL;
+		n = -1;
+	}
+	
+	return n;
+}
+
+static ssize_t
+stream_write (GMimeStream *stream, const char *buf, size_t len)
+{
+	/* GBytes are immutable */
+	errno = EBADF;
+	
+	return -1;
+}
+
+static int
+stream_flush (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	return 0;
+}
+
+static int
+stream_close (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes) {
+		g_bytes_unref (bytes->bytes);
+		bytes->bytes = NULL;
+	}
+	
+	return 0;
+}
+
+static gboolean
+stream_eos (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes == NULL)
+		return TRUE;
+	
+	return stream->position >= bytes_bound_end (stream);
+}
+
+static int
+stream_reset (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	return 0;
+}
+
+static gint64
+stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	gint64 bound_end, real = stream->position;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	bound_end = bytes_bound_end (stream);
+	
+	switch (whence) {
+	case GMIME_STREAM_SEEK_SET:
+		real = offset;
+		break;
+	case GMIME_STREAM_SEEK_END:
+		real = offset + bound_end;
+		break;
+	case GMIME_STREAM_SEEK_CUR:
+		real = stream->position + offset;
+		break;
+	}
+	
+	/* the data cannot grow, so seeking past the end is never allowed */
+	if (real < stream->bound_start || real > bound_end) {
+		errno = EINVAL;
+		return -1;
+	}
+	
+	stream->position = real;
+	
+	return stream->position;
+}
+
+static gint64
+stream_tell (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	return stream->position;
+}
+
+static gint64
+stream_length (GMimeStream *stream)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	return bytes_bound_end (stream) - stream->bound_start;
+}
+
+static GMimeStream *
+stream_substream (GMimeStream *stream, gint64 start, gint64 end)
+{
+	GMimeStreamBytes *bytes;
+	
+	bytes = g_object_new (GMIME_TYPE_STREAM_BYTES, NULL);
+	g_mime_stream_construct ((GMimeStream *) bytes, start, end);
+	
+	/* share the parent's storage rather than slicing it so that the
+	 * substream offsets stay relative to the same data */
+	if (((GMimeStreamBytes *) stream)->bytes)
+		bytes->bytes = g_bytes_ref (((GMimeStreamBytes *) stream)->bytes);
+	
+	return (GMimeStream *) bytes;
+}
+
+static gint64
+stream_write_to_stream (GMimeStream *stream, GMimeStream *dest)
+{
+	GMimeStreamBytes *bytes = (GMimeStreamBytes *) stream;
+	GMimeStreamIOVector vector;
+	gint64 bound_end, nwritten;
+	
+	if (bytes->bytes == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	if (stream->position >= (bound_end = bytes_bound_end (stream)))
+		return 0;
+	
+	vector.data = (char *) g_bytes_get_data (bytes->bytes, NULL) + stream->position;
+	vector.len = (size_t) (bound_end - stream->position);
+	
+	if ((nwritten = g_mime_stream_writev (dest, &vector, 1)) == -1)
+		return -1;
+	
+	stream->position += nwritten;
+	
+	return nwritten;
+}
+
+
+/**
+ * g_mime_stream_bytes_new:
+ * @bytes: a #GBytes
+ *
+ * Creates a new read-only #GMimeStreamBytes that reads from @bytes
+ * without copying it.
+ *
+ * Returns: a new bytes stream.
+ **/
+GMimeStream *
+g_mime_stream_bytes_new (GBytes *bytes)
+{
+	GMimeStreamBytes *stream;
+	
+	g_return_val_if_fail (bytes != NULL, NULL);
+	
+	stream = g_object_new (GMIME_TYPE_STREAM_BYTES, NULL);
+	g_mime_stream_construct ((GMimeStream *) stream, 0, -1);
+	stream->bytes = g_bytes_ref (bytes);
+	
+	return (GMimeStream *) stream;
+}
+
+
+/**
+ * g_mime_stream_bytes_get_bytes:
+ * @stream: a #GMimeStreamBytes
+ *
+ * Gets the data within the bounds of @stream. For a substream, this is
+ * a slice of the #GBytes that the original stream was created with and
+ * shares its memory.
+ *
+ * Returns: (transfer full) (nullable): the data within the bounds of
+ * @stream or %NULL if @stream has been closed.
+ **/
+GBytes *
+g_mime_stream_bytes_get_bytes (GMimeStreamBytes *stream)
+{
+	gint64 bound_end;
+	
+	g_return_val_if_fail (GMIME_IS_STREAM_BYTES (stream), NULL);
+	
+	if (stream->bytes == NULL)
+		return NULL;
+	
+	bound_end = bytes_bound_end ((GMimeStream *) stream);
+	
+	if (bound_end <= stream->parent_object.bound_start)
+		return g_bytes_new_from_bytes (stream->bytes, 0, 0);
+	
+	return g_bytes_new_from_bytes (stream->bytes, (gsize) stream->parent_object.bound_start,
+				       (gsize) (bound_end - stream->parent_object.bound_start));
+}
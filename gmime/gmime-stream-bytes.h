@@ -0,0 +1,67 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifndef __GMIME_STREAM_BYTES_H__
+#define __GMIME_STREAM_BYTES_H__
+
+#include <glib.h>
+#include <gmime/gmime-stream.h>
+
+G_BEGIN_DECLS
+
+#define GMIME_TYPE_STREAM_BYTES            (g_mime_stream_bytes_get_type ())
+#define GMIME_STREAM_BYTES(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GMIME_TYPE_STREAM_BYTES, GMimeStreamBytes))
+#define GMIME_STREAM_BYTES_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GMIME_TYPE_STREAM_BYTES, GMimeStreamBytesClass))
+#define GMIME_IS_STREAM_BYTES(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GMIME_TYPE_STREAM_BYTES))
+#define GMIME_IS_STREAM_BYTES_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GMIME_TYPE_STREAM_BYTES))
+#define GMIME_STREAM_BYTES_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GMIME_TYPE_STREAM_BYTES, GMimeStreamBytesClass))
+
+typedef struct _GMimeStreamBytes GMimeStreamBytes;
+typedef struct _GMimeStreamBytesClass GMimeStreamBytesClass;
+
+/**
+ * GMimeStreamBytes:
+ * @parent_object: parent #GMimeStream
+ * @bytes: the immutable backing store
+ *
+ * A read-only #GMimeStream backed by a #GBytes.
+ **/
+struct _GMimeStreamBytes {
+	GMimeStream parent_object;
+	
+	GBytes *bytes;
+};
+
+struct _GMimeStreamBytesClass {
+	GMimeStreamClass parent_class;
+	
+};
+
+
+GType g_mime_stream_bytes_get_type (void);
+
+GMimeStream *g_mime_stream_bytes_new (GBytes *bytes);
+
+GBytes *g_mime_stream_bytes_get_bytes (GMimeStreamBytes *stream);
+
+G_END_DECLS
+
+#endif /* __GMIME_STREAM_BYTES_H__ */
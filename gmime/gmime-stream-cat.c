@@ -37,6 +37,12 @@
  * @see_also: #GMimeStream
  *
  * A #GMimeStream which chains together any number of other streams.
+ *
+ * The lengths of the source streams are looked up the first time that
+ * they are needed (e.g. when seeking) and are then remembered until
+ * data is written to them through the #GMimeStreamCat, so the source
+ * streams should not be modified by other means once they have been
+ * added.
  **/
 
 
@@ -56,16 +62,26 @@ static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
 
 
-static GMimeStreamClass *parent_class = NULL;
-
-
 struct _cat_node {
 	struct _cat_node *next;
 	GMimeStream *stream;
 	gint64 position;
-	int id; /* for debugging */
+	gint64 offset;  /* offset of this source within the cat (once indexed) */
+	gint64 length;  /* length of this source (once indexed) */
+	int id;         /* index into priv->nodes */
 };
 
+typedef struct {
+	GPtrArray *nodes;  /* the sources, in order */
+	guint indexed;     /* number of sources whose offset and length are known */
+} GMimeStreamCatPrivate;
+
+#define GMIME_STREAM_CAT_PRIVATE(cat) ((GMimeStreamCatPrivate *) G_STRUCT_MEMBER_P (cat, private_offset))
+
+static GMimeStreamClass *parent_class = NULL;
+static gint private_offset = 0;
+
+
 GType
 g_mime_stream_cat_get_type (void)
 {
@@ -85,6 +101,7 @@ g_mime_stream_cat_get_type (void)
 		};
 		
 		type = g_type_register_static (GMIME_TYPE_STREAM, "GMimeStreamCat", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeStreamCatPrivate));
 	}
 	
 	return type;
@@ -98,6 +115,7 @@ g_mime_stream_cat_class_init (GMimeStreamCatClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (GMIME_TYPE_STREAM);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_stream_cat_finalize;
 	
@@ -116,27 +134,122 @@ g_mime_stream_cat_class_init (GMimeStreamCatClass *klass)
 static void
 g_mime_stream_cat_init (GMimeStreamCat *stream, GMimeStreamCatClass *klass)
 {
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (stream);
+	
 	stream->sources = NULL;
 	stream->current = NULL;
+	priv->nodes = g_ptr_array_new ();
+	priv->indexed = 0;
 }
 
 static void
 g_mime_stream_cat_finalize (GObject *object)
 {
 	GMimeStream *stream = (GMimeStream *) object;
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (object);
 	
 	stream_close (stream);
 	
+	g_ptr_array_free (priv->nodes, TRUE);
+	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* makes sure that the offsets and lengths of the sources are known up to
+ * (and including) the source that contains @offset */
+static gboolean
+cat_index_build (GMimeStreamCat *cat, gint64 offset)
+{
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (cat);
+	struct _cat_node *node, *prev = NULL;
+	gint64 len;
+	
+	while (priv->indexed < priv->nodes->len) {
+		if (priv->indexed > 0) {
+			prev = priv->nodes->pdata[priv->indexed - 1];
+			if (prev->offset + prev->length > offset)
+				break;
+		}
+		
+		node = priv->nodes->pdata[priv->indexed];
+		
+		if (node->stream->bound_end != -1) {
+			len = node->stream->bound_end - node->stream->bound_start;
+		} else {
+			if ((len = g_mime_stream_length (node->stream)) == -1)
+				return FALSE;
+		}
+		
+		node->offset = prev ? prev->offset + prev->length : 0;
+		node->length = len;
+		priv->indexed++;
+	}
+	
+	return TRUE;
+}
+
+/* binary searches the index for the source containing @offset */
+static struct _cat_node *
+cat_index_lookup (GMimeStreamCat *cat, gint64 offset)
+{
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (cat);
+	struct _cat_node *node;
+	guint lo = 0, hi, mid;
+	
+	if (!cat_index_build (cat, offset) || priv->indexed == 0)
+		return NULL;
+	
+	hi = priv->indexed;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		node = priv->nodes->pdata[mid];
+		
+		if (node->offset <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	
+	node = priv->nodes->pdata[lo];
+	
+	/* only the end of the very last source may be sought to */
+	if (offset > node->offset + node->length)
+		return NULL;
+	
+	return node;
+}
+
+/* forgets the lengths of @node and all sources that follow it */
+static void
+cat_index_invalidate (GMimeStreamCat *cat, struct _cat_node *node)
+{
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (cat);
+	
+	if (priv->indexed > (guint) node->id)
+		priv->indexed = (guint) node->id;
+}
+
+/* moves the source stream to where we left off if something else has moved it */
+static int
+cat_node_sync (struct _cat_node *node)
+{
+	gint64 offset = node->stream->bound_start + node->position;
+	
+	if (g_mime_stream_tell (node->stream) == offset)
+		return 0;
+	
+	if (g_mime_stream_seek (node->stream, offset, GMIME_STREAM_SEEK_SET) == -1)
+		return -1;
+	
+	return 0;
+}
+
 static ssize_t
 stream_read (GMimeStream *stream, char *buf, size_t len)
 {
 	GMimeStreamCat *cat = (GMimeStreamCat *) stream;
 	struct _cat_node *current;
 	ssize_t nread = 0;
-	gint64 offset;
 	
 	/* check for end-of-stream */
 	if (stream->bound_end != -1 && stream->position >= stream->bound_end)
@@ -150,8 +263,7 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 		return -1;
 	
 	/* make sure our stream position is where it should be */
-	offset = current->stream->bound_start + current->position;
-	if (g_mime_stream_seek (current->stream, offset, GMIME_STREAM_SEEK_SET) == -1)
+	if (cat_node_sync (current) == -1)
 		return -1;
 	
 	do {
@@ -181,7 +293,6 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 	struct _cat_node *current;
 	size_t nwritten = 0;
 	ssize_t n = -1;
-	gint64 offset;
 	
 	/* check for end-of-stream */
 	if (stream->bound_end != -1 && stream->position >= stream->bound_end)
@@ -195,10 +306,12 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 		return -1;
 	
 	/* make sure our stream position is where it should be */
-	offset = current->stream->bound_start + current->position;
-	if (g_mime_stream_seek (current->stream, offset, GMIME_STREAM_SEEK_SET) == -1)
+	if (cat_node_sync (current) == -1)
 		return -1;
 	
+	/* writing may change the lengths of the sources */
+	cat_index_invalidate (cat, current);
+	
 	do {
 		n = -1;
 		while (!g_mime_stream_eos (current->stream) && nwritten < len) {
@@ -263,6 +376,7 @@ stream_flush (GMimeStream *stream)
 static int
 stream_close (GMimeStream *stream)
 {
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (stream);
 	GMimeStreamCat *cat = (GMimeStreamCat *) stream;
 	struct _cat_node *n, *nn;
 	
@@ -277,6 +391,9 @@ stream_close (GMimeStream *stream)
 	
 	cat->sources = NULL;
 	
+	g_ptr_array_set_size (priv->nodes, 0);
+	priv->indexed = 0;
+	
 	return 0;
 }
 
@@ -321,8 +438,8 @@ static gint64
 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
 {
 	GMimeStreamCat *cat = (GMimeStreamCat *) stream;
-	struct _cat_node *current, *n;
-	gint64 real, off, len;
+	struct _cat_node *current;
+	gint64 len;
 	
 	d(fprintf (stderr, "GMimeStreamCat::stream_seek (%p, %ld, %d)\n",
 		   stream, offset, whence));
@@ -353,115 +470,17 @@ stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
 			return offset;
 		}
 		
-		real = 0;
-		n = cat->sources;
-		current = cat->current;
-		
-		while (n != current) {
-			if (real + n->position > offset)
-				break;
-			real += n->position;
-			n = n->next;
-		}
-		
-		if (n == NULL) {
+		if (!(current = cat_index_lookup (cat, offset))) {
 			/* offset not within our grasp... */
 			return -1;
 		}
 		
-		if (n != current) {
-			/* seeking to a previous stream (n->stream) */
-			if ((offset - real) != n->position) {
-				/* FIXME: could probably skip these seek checks... */
-				off = n->stream->bound_start + (offset - real);
-				if (g_mime_stream_seek (n->stream, off, GMIME_STREAM_SEEK_SET) == -1)
-					return -1;
-			}
-			
-			d(fprintf (stderr, "setting current stream to %i and updating cur->position to %ld\n",
-				   n->id, offset - real));
-			
-			current = n;
-			current->position = offset - real;
-			
-			break;
-		} else {
-			/* seeking to someplace in our current (or next) stream */
-			d(fprintf (stderr, "seek offset %ld in current stream[%d] or after\n",
-				   offset, current->id));
-			if ((offset - real) == current->position) {
-				/* exactly at our current position */
-				d(fprintf (stderr, "seek offset at cur position of stream[%d]\n",
-					   current->id));
-				stream->position = offset;
-				return offset;
-			}
-			
-			if ((offset - real) < current->position) {
-				/* in current stream, but before current position */
-				d(fprintf (stderr, "seeking backwards in cur stream[%d]\n",
-					   current->id));
-				/* FIXME: again, could probably skip seek checks... */
-				off = current->stream->bound_start + (offset - real);
-				if (g_mime_stream_seek (current->stream, off, GMIME_STREAM_SEEK_SET) == -1)
-					return -1;
-				
-				d(fprintf (stderr, "setting cur stream[%d] position to %ld\n",
-					   current->id, offset - real));
-				current->position = offset - real;
-				
-				break;
-			}
-			
-			/* after our current position */
-			d(fprintf (stderr, "after cur position in stream[%d] or in a later stream\n",
-				   current->id));
-			do {
-				if (current->stream->bound_end != -1) {
-					len = current->stream->bound_end - current->stream->bound_start;
-				} else {
-					if ((len = g_mime_stream_length (current->stream)) == -1)
-						return -1;
-				}
-				
-				d(fprintf (stderr, "real = %lld, stream[%d] len = %lld\n",
-					   real, current->id, len));
-				
-				if ((real + len) > offset) {
-					/* within the bounds of the current stream */
-					d(fprintf (stderr, "offset within bounds of stream[%d]\n",
-						   current->id));
-					break;
-				} else {
-					d(fprintf (stderr, "not within bounds of stream[%d]\n",
-						   current->id));
-					current->position = len;
-					real += len;
-					
-					current = current->next;
-					if (current == NULL) {
-						d(fprintf (stderr, "ran out of streams, failed\n"));
-						return -1;
-					}
-					
-					d(fprintf (stderr, "advanced to stream[%d]...\n", current->id));
-					
-					if (g_mime_stream_reset (current->stream) == -1)
-						return -1;
-					
-					current->position = 0;
-				}
-			} while (1);
-			
-			/* FIXME: another seek check... probably can skip this */
-			off = current->stream->bound_start + (offset - real);
-			if (g_mime_stream_seek (current->stream, off, GMIME_STREAM_SEEK_SET) == -1)
-				return -1;
-			
-			d(fprintf (stderr, "setting cur position of stream[%d] to %ld\n",
-				   current->id, offset - real));
-			current->position = offset - real;
-		}
+		d(fprintf (stderr, "setting cur position of stream[%d] to %ld\n",
+			   current->id, offset - current->offset));
+		
+		/* the source stream itself is only sought once it is read
+		 * from or written to */
+		current->position = offset - current->offset;
 		
 		break;
 	case GMIME_STREAM_SEEK_CUR:
@@ -477,18 +496,11 @@ stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
 			return -1;
 		
 		/* calculate the offset of the end of the stream */
-		n = cat->sources;
-		real = stream->bound_start;
-		while (n != NULL) {
-			if ((len = g_mime_stream_length (n->stream)) == -1)
-				return -1;
-			
-			real += len;
-			n = n->next;
-		}
+		if ((len = stream_length (stream)) == -1)
+			return -1;
 		
 		/* calculate offset relative to the beginning of the stream */
-		offset = real + offset;
+		offset = stream->bound_start + len + offset;
 		goto seek_set;
 		break;
 	default:
@@ -502,15 +514,6 @@ stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
 	stream->position = offset;
 	cat->current = current;
 	
-	/* reset all following streams */
-	n = current->next;
-	while (n != NULL) {
-		if (g_mime_stream_reset (n->stream) == -1)
-			return -1;
-		n->position = 0;
-		n = n->next;
-	}
-	
 	return offset;
 }
 
@@ -523,23 +526,22 @@ stream_tell (GMimeStream *stream)
 static gint64
 stream_length (GMimeStream *stream)
 {
+	GMimeStreamCatPrivate *priv = GMIME_STREAM_CAT_PRIVATE (stream);
 	GMimeStreamCat *cat = GMIME_STREAM_CAT (stream);
-	gint64 len, total = 0;
-	struct _cat_node *n;
+	struct _cat_node *last;
 	
 	if (stream->bound_end != -1)
 		return stream->bound_end - stream->bound_start;
 	
-	n = cat->sources;
-	while (n != NULL) {
-		if ((len = g_mime_stream_length (n->stream)) == -1)
-			return -1;
-		
-		total += len;
-		n = n->next;
-	}
+	if (priv->nodes->len == 0)
+		return 0;
+	
+	if (!cat_index_build (cat, G_MAXINT64))
+		return -1;
 	
-	return total;
+	last = priv->nodes->pdata[priv->nodes->len - 1];
+	
+	return last->offset + last->length;
 }
 
 struct _sub_node {
@@ -699,29 +701,32 @@ g_mime_stream_cat_new (void)
 int
 g_mime_stream_cat_add_source (GMimeStreamCat *cat, GMimeStream *source)
 {
+	GMimeStreamCatPrivate *priv;
 	struct _cat_node *node, *n;
 	
 	g_return_val_if_fail (GMIME_IS_STREAM_CAT (cat), -1);
 	g_return_val_if_fail (GMIME_IS_STREAM (source), -1);
 	
+	priv = GMIME_STREAM_CAT_PRIVATE (cat);
+	
 	node = g_new (struct _cat_node, 1);
 	node->next = NULL;
 	node->stream = source;
 	g_object_ref (source);
 	node->position = 0;
+	node->offset = 0;
+	node->length = 0;
 	
-	n = cat->sources;
-	while (n && n->next)
-		n = n->next;
-	
-	if (n == NULL) {
+	if (priv->nodes->len == 0) {
 		cat->sources = node;
-		node->id = 0;
 	} else {
-		node->id = n->id + 1;
+		n = priv->nodes->pdata[priv->nodes->len - 1];
 		n->next = node;
 	}
 	
+	node->id = (int) priv->nodes->len;
+	g_ptr_array_add (priv->nodes, node);
+	
 	if (!cat->current)
 		cat->current = node;
 	
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-stream-filter.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -83,6 +84,7 @@ static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence w
 static gint64 stream_tell (GMimeStream *stream);
 static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
 
 
 static GMimeStreamClass *parent_class = NULL;
@@ -133,6 +135,7 @@ g_mime_stream_filter_class_init (GMimeStreamFilterClass *klass)
 	stream_class->tell = stream_tell;
 	stream_class->length = stream_length;
 	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_writev (stream_class, stream_writev);
 }
 
 static void
@@ -260,6 +263,37 @@ stream_write (GMimeStream *stream, const char *buf, size_t n)
 	return nwritten;
 }
 
+static gint64
+stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+{
+	char stackbuf[4096], *buf = stackbuf, *outptr;
+	size_t len = 0, i;
+	ssize_t nwritten;
+	
+	if (count == 1)
+		return stream_write (stream, vector[0].data, vector[0].len);
+	
+	for (i = 0; i < count; i++)
+		len += vector[i].len;
+	
+	if (len > sizeof (stackbuf))
+		buf = g_malloc (len);
+	
+	/* gather the blocks so that the filters only run once */
+	outptr = buf;
+	for (i = 0; i < count; i++) {
+		memcpy (outptr, vector[i].data, vector[i].len);
+		outptr += vector[i].len;
+	}
+	
+	nwritten = stream_write (stream, buf, len);
+	
+	if (buf != stackbuf)
+		g_free (buf);
+	
+	return nwritten;
+}
+
 static int
 stream_flush (GMimeStream *stream)
 {
@@ -23,6 +23,8 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
+
 #include <glib.h>
 #include <glib/gstdio.h>
 
@@ -32,7 +34,16 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+#ifdef HAVE_PWRITEV
+#include <sys/uio.h>
+#endif
+
 #include "gmime-stream-fs.h"
+#include "gmime-internal.h"
 #include "gmime-error.h"
 
 #ifndef HAVE_FSYNC
@@ -54,6 +65,20 @@ static int fsync (int fd) { return 0; }
  *
  * A simple #GMimeStream implementation that sits on top of the
  * low-level UNIX file descriptor based I/O layer.
+ *
+ * Reads and writes use positional I/O (pread() and pwrite()) where
+ * the system supports them, so the file descriptor's own offset is
+ * never used. This means that substreams of the same #GMimeStreamFs
+ * may be read from different threads at the same time (although each
+ * individual stream must still only be used by one thread at a time).
+ *
+ * As a consequence, the file descriptor's offset does not track the
+ * stream's position. g_mime_stream_fs_new() only reads it once, to get
+ * the start of the stream, and g_mime_stream_length() (or seeking
+ * relative to the end) on a stream without an end boundary may leave
+ * it at the end of the file. Use g_mime_stream_tell() to get the
+ * stream's position, and lseek() the descriptor explicitly before
+ * using it directly.
  **/
 
 
@@ -71,6 +96,8 @@ static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence w
 static gint64 stream_tell (GMimeStream *stream);
 static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_write_to_stream (GMimeStream *stream, GMimeStream *dest);
+static gint64 stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
 
 
 static GMimeStreamClass *parent_class = NULL;
@@ -121,6 +148,8 @@ g_mime_stream_fs_class_init (GMimeStreamFsClass *klass)
 	stream_class->tell = stream_tell;
 	stream_class->length = stream_length;
 	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_write_to_stream (stream_class, stream_write_to_stream);
+	_g_mime_stream_class_set_writev (stream_class, stream_writev);
 }
 
 static void
@@ -141,6 +170,33 @@ g_mime_stream_fs_finalize (GObject *object)
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+
+static ssize_t
+fs_pread (int fd, char *buf, size_t len, gint64 offset)
+{
+#ifdef HAVE_PREAD
+	return pread (fd, buf, len, (off_t) offset);
+#else
+	if (lseek (fd, (off_t) offset, SEEK_SET) == -1)
+		return -1;
+	
+	return read (fd, buf, len);
+#endif
+}
+
+static ssize_t
+fs_pwrite (int fd, const char *buf, size_t len, gint64 offset)
+{
+#ifdef HAVE_PWRITE
+	return pwrite (fd, buf, len, (off_t) offset);
+#else
+	if (lseek (fd, (off_t) offset, SEEK_SET) == -1)
+		return -1;
+	
+	return write (fd, buf, len);
+#endif
+}
+
 static ssize_t
 stream_read (GMimeStream *stream, char *buf, size_t len)
 {
@@ -160,12 +216,8 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 	if (stream->bound_end != -1)
 		len = (size_t) MIN (stream->bound_end - stream->position, (gint64) len);
 	
-	/* make sure we are at the right position */
-	if (lseek (fs->fd, (off_t) stream->position, SEEK_SET) == -1)
-		return -1;
-	
 	do {
-		nread = read (fs->fd, buf, len);
+		nread = fs_pread (fs->fd, buf, len, stream->position);
 	} while (nread == -1 && errno == EINTR);
 	
 	if (nread > 0) {
@@ -197,13 +249,9 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 	if (stream->bound_end != -1)
 		len = (size_t) MIN (stream->bound_end - stream->position, (gint64) len);
 	
-	/* make sure we are at the right position */
-	if (lseek (fs->fd, (off_t) stream->position, SEEK_SET) == -1)
-		return -1;
-	
 	do {
 		do {
-			n = write (fs->fd, buf + nwritten, len - nwritten);
+			n = fs_pwrite (fs->fd, buf + nwritten, len - nwritten, stream->position + nwritten);
 		} while (n == -1 && (errno == EINTR || errno == EAGAIN));
 		
 		if (n > 0)
@@ -277,17 +325,8 @@ stream_reset (GMimeStream *stream)
 		return -1;
 	}
 	
-	if (stream->position == stream->bound_start) {
-		fs->eos = FALSE;
-		return 0;
-	}
-	
-	/* FIXME: if stream_read/write is always going to lseek to
-	 * make sure fd's seek position matches our own, we could just
-	 * set stream->position = stream->bound_start and be done. */
-	if (lseek (fs->fd, (off_t) stream->bound_start, SEEK_SET) == -1)
-		return -1;
-	
+	/* reads and writes always specify the position, so there is
+	 * no need to move the fd's own offset */
 	fs->eos = FALSE;
 	
 	return 0;
@@ -349,9 +388,6 @@ stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence whence)
 		return -1;
 	}
 	
-	if ((real = lseek (fs->fd, (off_t) real, SEEK_SET)) == -1)
-		return -1;
-	
 	/* reset eos if appropriate */
 	if ((stream->bound_end != -1 && real < stream->bound_end) ||
 	    (fs->eos && real < stream->position))
@@ -385,9 +421,6 @@ stream_length (GMimeStream *stream)
 	if ((bound_end = lseek (fs->fd, (off_t) 0, SEEK_END)) == -1)
 		return -1;
 	
-	if (lseek (fs->fd, (off_t) stream->position, SEEK_SET) == -1)
-		return -1;
-	
 	if (bound_end < stream->bound_start) {
 		errno = EINVAL;
 		return -1;
@@ -410,6 +443,177 @@ stream_substream (GMimeStream *stream, gint64 start, gint64 end)
 	return (GMimeStream *) fs;
 }
 
+/* Copies the remaining content of @src to @dest without bouncing the
+ * data through userspace, using copy_file_range() or sendfile() where
+ * the system supports them. This may copy fewer bytes than remain in
+ * @src (including none at all) if the kernel cannot copy between the
+ * two file descriptors. */
+static gint64
+fs_copy (GMimeStreamFs *src, GMimeStreamFs *dest)
+{
+#if defined (HAVE_COPY_FILE_RANGE) || defined (HAVE_SENDFILE)
+	GMimeStream *istream = (GMimeStream *) src;
+	GMimeStream *ostream = (GMimeStream *) dest;
+	gint64 remaining, total = 0;
+	gboolean kernel_copy = TRUE;
+	struct stat st;
+	ssize_t n;
+	
+	if (src->fd == -1 || dest->fd == -1)
+		return 0;
+	
+	if (istream->bound_end != -1) {
+		remaining = istream->bound_end - istream->position;
+	} else {
+		if (fstat (src->fd, &st) == -1 || !S_ISREG (st.st_mode))
+			return 0;
+		
+		remaining = st.st_size - istream->position;
+	}
+	
+	if (ostream->bound_end != -1)
+		remaining = MIN (remaining, ostream->bound_end - ostream->position);
+	
+	while (remaining > 0) {
+		size_t len = (size_t) MIN (remaining, (gint64) G_MAXSSIZE);
+		
+#ifdef HAVE_COPY_FILE_RANGE
+		if (kernel_copy) {
+			/* Note: copy_file_range() always takes 64-bit offsets */
+			gint64 in_offset = istream->position;
+			gint64 out_offset = ostream->position;
+			
+			do {
+				n = copy_file_range (src->fd, &in_offset, dest->fd, &out_offset, len, 0);
+			} while (n == -1 && errno == EINTR);
+			
+			if (n == -1) {
+				/* not supported between these two descriptors, try sendfile() */
+				kernel_copy = FALSE;
+				continue;
+			}
+		} else
+#endif
+		{
+#ifdef HAVE_SENDFILE
+			off_t offset = (off_t) istream->position;
+			
+			if (lseek (dest->fd, (off_t) ostream->position, SEEK_SET) == -1)
+				break;
+			
+			do {
+				n = sendfile (dest->fd, src->fd, &offset, len);
+			} while (n == -1 && errno == EINTR);
+			
+			if (n == -1)
+				break;
+#else
+			break;
+#endif
+		}
+		
+		if (n == 0)
+			break;
+		
+		istream->position += n;
+		ostream->position += n;
+		remaining -= n;
+		total += n;
+	}
+	
+	return total;
+#else
+	return 0;
+#endif
+}
+
+static gint64
+stream_write_to_stream (GMimeStream *stream, GMimeStream *dest)
+{
+	gint64 nwritten, copied = 0;
+	
+	/* let the kernel do the copying if both ends are file descriptors */
+	if (GMIME_IS_STREAM_FS (dest))
+		copied = fs_copy ((GMimeStreamFs *) stream, (GMimeStreamFs *) dest);
+	
+	/* copy whatever is left (which is everything if the above failed) */
+	if ((nwritten = _g_mime_stream_generic_write_to_stream (stream, dest)) == -1)
+		return -1;
+	
+	return copied + nwritten;
+}
+
+/* the most iovecs we pass to a single pwritev() call */
+#define FS_IOV_MAX 64
+
+static gint64
+stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+{
+#ifdef HAVE_PWRITEV
+	GMimeStreamFs *fs = (GMimeStreamFs *) stream;
+	struct iovec iov[FS_IOV_MAX];
+	size_t index = 0, skip = 0;
+	gint64 total = 0;
+	ssize_t n;
+	int niov;
+	
+	if (fs->fd == -1) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	/* bounded streams need every write clipped, so leave those to stream_write() */
+	if (stream->bound_end != -1)
+		return _g_mime_stream_generic_writev (stream, vector, count);
+	
+	while (index < count) {
+		size_t i = index, offset = skip;
+		
+		for (niov = 0; niov < FS_IOV_MAX && i < count; i++, offset = 0) {
+			if (vector[i].len == offset)
+				continue;
+			
+			iov[niov].iov_base = (char *) vector[i].data + offset;
+			iov[niov].iov_len = vector[i].len - offset;
+			niov++;
+		}
+		
+		if (niov == 0)
+			break;
+		
+		do {
+			n = pwritev (fs->fd, iov, niov, (off_t) stream->position);
+		} while (n == -1 && (errno == EINTR || errno == EAGAIN));
+		
+		if (n == -1) {
+			if (errno == EFBIG || errno == ENOSPC)
+				fs->eos = TRUE;
+			
+			return -1;
+		}
+		
+		if (n == 0)
+			break;
+		
+		stream->position += n;
+		total += n;
+		
+		/* skip past whatever the kernel managed to write */
+		while (index < count && (size_t) n >= vector[index].len - skip) {
+			n -= vector[index].len - skip;
+			skip = 0;
+			index++;
+		}
+		
+		skip += n;
+	}
+	
+	return total;
+#else
+	return _g_mime_stream_generic_writev (stream, vector, count);
+#endif
+}
+
 
 /**
  * g_mime_stream_fs_new:
@@ -528,3 +732,4 @@ g_mime_stream_fs_set_owner (GMimeStreamFs *stream, gboolean owner)
 	
 	stream->owner = owner;
 }
+
@@ -27,6 +27,7 @@
 #include <errno.h>
 
 #include "gmime-stream-mem.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -54,6 +55,8 @@ static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence w
 static gint64 stream_tell (GMimeStream *stream);
 static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_write_to_stream (GMimeStream *stream, GMimeStream *dest);
+static gint64 stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
 
 
 static GMimeStreamClass *parent_class = NULL;
@@ -104,6 +107,8 @@ g_mime_stream_mem_class_init (GMimeStreamMemClass *klass)
 	stream_class->tell = stream_tell;
 	stream_class->length = stream_length;
 	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_write_to_stream (stream_class, stream_write_to_stream);
+	_g_mime_stream_class_set_writev (stream_class, stream_writev);
 }
 
 static void
@@ -182,6 +187,40 @@ stream_write (GMimeStream *stream, const char *buf, size_t len)
 	return n;
 }
 
+static gint64
+stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+{
+	GMimeStreamMem *mem = (GMimeStreamMem *) stream;
+	size_t len = 0, i;
+	guint8 *outptr;
+	
+	if (mem->buffer == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	/* bounded streams need every write clipped, so leave those to stream_write() */
+	if (stream->bound_end != -1)
+		return _g_mime_stream_generic_writev (stream, vector, count);
+	
+	for (i = 0; i < count; i++)
+		len += vector[i].len;
+	
+	/* grow the buffer once for all of the blocks */
+	if (stream->position + len > mem->buffer->len)
+		g_byte_array_set_size (mem->buffer, (guint) stream->position + len);
+	
+	outptr = mem->buffer->data + stream->position;
+	for (i = 0; i < count; i++) {
+		memcpy (outptr, vector[i].data, vector[i].len);
+		outptr += vector[i].len;
+	}
+	
+	stream->position += len;
+	
+	return len;
+}
+
 static int
 stream_flush (GMimeStream *stream)
 {
@@ -326,6 +365,36 @@ stream_substream (GMimeStream *stream, gint64 start, gint64 end)
 	return (GMimeStream *) mem;
 }
 
+static gint64
+stream_write_to_stream (GMimeStream *stream, GMimeStream *dest)
+{
+	GMimeStreamMem *mem = (GMimeStreamMem *) stream;
+	GMimeStreamIOVector vector;
+	gint64 bound_end, nwritten;
+	
+	if (mem->buffer == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	bound_end = stream->bound_end != -1 ? stream->bound_end : (gint64) mem->buffer->len;
+	bound_end = MIN (bound_end, (gint64) mem->buffer->len);
+	
+	if (stream->position >= bound_end)
+		return 0;
+	
+	/* the content is already in memory, so hand it all to @dest at once */
+	vector.data = mem->buffer->data + stream->position;
+	vector.len = (size_t) (bound_end - stream->position);
+	
+	if ((nwritten = g_mime_stream_writev (dest, &vector, 1)) == -1)
+		return -1;
+	
+	stream->position += nwritten;
+	
+	return nwritten;
+}
+
 
 /**
  * g_mime_stream_mem_new:
@@ -384,7 +453,7 @@ GMimeStream *
 g_mime_stream_mem_new_with_buffer (const char *buffer, size_t len)
 {
 	GMimeStreamMem *mem;
-
+	
 	g_return_val_if_fail (buffer != NULL, NULL);
 	
 	mem = (GMimeStreamMem *) g_mime_stream_mem_new ();
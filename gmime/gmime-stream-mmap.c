@@ -34,6 +34,7 @@
 #include <errno.h>
 
 #include "gmime-stream-mmap.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -63,6 +64,7 @@ static gint64 stream_seek (GMimeStream *stream, gint64 offset, GMimeSeekWhence w
 static gint64 stream_tell (GMimeStream *stream);
 static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
+static gint64 stream_write_to_stream (GMimeStream *stream, GMimeStream *dest);
 
 
 static GMimeStreamClass *parent_class = NULL;
@@ -113,6 +115,7 @@ g_mime_stream_mmap_class_init (GMimeStreamMmapClass *klass)
 	stream_class->tell = stream_tell;
 	stream_class->length = stream_length;
 	stream_class->substream = stream_substream;
+	_g_mime_stream_class_set_write_to_stream (stream_class, stream_write_to_stream);
 }
 
 static void
@@ -369,6 +372,38 @@ stream_substream (GMimeStream *stream, gint64 start, gint64 end)
 	return (GMimeStream *) mm;
 }
 
+static gint64
+stream_write_to_stream (GMimeStream *stream, GMimeStream *dest)
+{
+	GMimeStreamMmap *mm = (GMimeStreamMmap *) stream;
+	GMimeStreamIOVector vector;
+	gint64 bound_end, nwritten;
+	
+	if (mm->fd == -1) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	bound_end = stream->bound_end != -1 ? stream->bound_end : (gint64) mm->maplen;
+	
+	if (stream->position < bound_end) {
+		/* write the whole mapped span with a single call */
+		vector.data = mm->map + stream->position;
+		vector.len = (size_t) (bound_end - stream->position);
+		
+		if ((nwritten = g_mime_stream_writev (dest, &vector, 1)) == -1)
+			return -1;
+		
+		stream->position += nwritten;
+	} else {
+		nwritten = 0;
+	}
+	
+	mm->eos = TRUE;
+	
+	return nwritten;
+}
+
 
 /**
  * g_mime_stream_mmap_new:
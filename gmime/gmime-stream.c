@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-stream.h"
+#include "gmime-internal.h"
 
 #define d(x)
 
@@ -59,6 +60,16 @@ static gint64 stream_length (GMimeStream *stream);
 static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64 end);
 
 
+/* Optional fast paths that subclasses can override. These live in
+ * private class data rather than in GMimeStreamClass so that the
+ * public class struct keeps its size. */
+typedef struct {
+	gint64 (* write_to_stream) (GMimeStream *stream, GMimeStream *dest);
+	gint64 (* writev) (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count);
+} GMimeStreamClassPrivate;
+
+#define GMIME_STREAM_CLASS_PRIVATE(klass) (G_TYPE_CLASS_GET_PRIVATE ((klass), GMIME_TYPE_STREAM, GMimeStreamClassPrivate))
+
 static GObjectClass *parent_class = NULL;
 
 
@@ -82,6 +93,7 @@ g_mime_stream_get_type (void)
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeStream",
 					       &info, G_TYPE_FLAG_ABSTRACT);
+		g_type_add_class_private (type, sizeof (GMimeStreamClassPrivate));
 	}
 	
 	return type;
@@ -107,6 +119,22 @@ g_mime_stream_class_init (GMimeStreamClass *klass)
 	klass->tell = stream_tell;
 	klass->length = stream_length;
 	klass->substream = stream_substream;
+	
+	GMIME_STREAM_CLASS_PRIVATE (klass)->write_to_stream = _g_mime_stream_generic_write_to_stream;
+	GMIME_STREAM_CLASS_PRIVATE (klass)->writev = _g_mime_stream_generic_writev;
+}
+
+
+void
+_g_mime_stream_class_set_write_to_stream (GMimeStreamClass *klass, gint64 (* write_to_stream) (GMimeStream *, GMimeStream *))
+{
+	GMIME_STREAM_CLASS_PRIVATE (klass)->write_to_stream = write_to_stream;
+}
+
+void
+_g_mime_stream_class_set_writev (GMimeStreamClass *klass, gint64 (* writev) (GMimeStream *, GMimeStreamIOVector *, size_t))
+{
+	GMIME_STREAM_CLASS_PRIVATE (klass)->writev = writev;
 }
 
 static void
@@ -528,28 +556,22 @@ g_mime_stream_printf (GMimeStream *stream, const char *fmt, ...)
 }
 
 
-/**
- * g_mime_stream_write_to_stream:
- * @src: source stream
- * @dest: destination stream
- *
- * Attempts to write the source stream to the destination stream.
- *
- * Returns: the number of bytes written or %-1 on fail.
- **/
+/* the copy buffer starts out on the stack and doubles in size (up to
+ * COPY_BUFFER_MAX) for as long as the source keeps filling it */
+#define COPY_BUFFER_MIN 4096
+#define COPY_BUFFER_MAX (64 * 1024)
+
 gint64
-g_mime_stream_write_to_stream (GMimeStream *src, GMimeStream *dest)
+_g_mime_stream_generic_write_to_stream (GMimeStream *src, GMimeStream *dest)
 {
+	char stackbuf[COPY_BUFFER_MIN], *buf = stackbuf;
+	size_t size = sizeof (stackbuf);
 	ssize_t nread, nwritten;
 	gint64 total = 0;
-	char buf[4096];
-	
-	g_return_val_if_fail (GMIME_IS_STREAM (src), -1);
-	g_return_val_if_fail (GMIME_IS_STREAM (dest), -1);
 	
 	while (!g_mime_stream_eos (src)) {
-		if ((nread = g_mime_stream_read (src, buf, sizeof (buf))) < 0)
-			return -1;
+		if ((nread = g_mime_stream_read (src, buf, size)) < 0)
+			goto error;
 		
 		if (nread > 0) {
 			nwritten = 0;
@@ -557,37 +579,66 @@ g_mime_stream_write_to_stream (GMimeStream *src, GMimeStream *dest)
 				ssize_t len;
 				
 				if ((len = g_mime_stream_write (dest, buf + nwritten, nread - nwritten)) < 0)
-					return -1;
+					goto error;
 				
 				nwritten += len;
 			}
 			
 			total += nwritten;
 		}
+		
+		if ((size_t) nread == size && size < COPY_BUFFER_MAX) {
+			if (buf != stackbuf)
+				g_free (buf);
+			
+			size *= 2;
+			buf = g_malloc (size);
+		}
 	}
 	
+	if (buf != stackbuf)
+		g_free (buf);
+	
 	return total;
+	
+ error:
+	if (buf != stackbuf)
+		g_free (buf);
+	
+	return -1;
 }
 
 
 /**
- * g_mime_stream_writev:
- * @stream: a #GMimeStream
- * @vector: (array length=count): a #GMimeStreamIOVector
- * @count: number of vector elements
+ * g_mime_stream_write_to_stream:
+ * @src: source stream
+ * @dest: destination stream
  *
- * Writes at most @count blocks described by @vector to @stream.
+ * Attempts to write the source stream to the destination stream.
+ *
+ * Streams that already have their content in memory write it to @dest
+ * directly and two #GMimeStreamFs streams let the kernel do the copy
+ * where possible. Everything else is copied through an intermediate
+ * buffer.
  *
  * Returns: the number of bytes written or %-1 on fail.
  **/
 gint64
-g_mime_stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+g_mime_stream_write_to_stream (GMimeStream *src, GMimeStream *dest)
+{
+	g_return_val_if_fail (GMIME_IS_STREAM (src), -1);
+	g_return_val_if_fail (GMIME_IS_STREAM (dest), -1);
+	
+	return GMIME_STREAM_CLASS_PRIVATE (GMIME_STREAM_GET_CLASS (src))->write_to_stream (src, dest);
+}
+
+
+gint64
+_g_mime_stream_generic_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
 {
 	gint64 total = 0;
 	size_t i;
 	
-	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
-	
 	for (i = 0; i < count; i++) {
 		char *buffer = vector[i].data;
 		size_t nwritten = 0;
@@ -606,3 +657,26 @@ g_mime_stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t c
 	
 	return total;
 }
+
+
+/**
+ * g_mime_stream_writev:
+ * @stream: a #GMimeStream
+ * @vector: (array length=count): a #GMimeStreamIOVector
+ * @count: number of vector elements
+ *
+ * Writes at most @count blocks described by @vector to @stream.
+ *
+ * Streams that can do so write all of the blocks at once (e.g. with a
+ * single writev() call), which is much cheaper than writing many small
+ * pieces one at a time.
+ *
+ * Returns: the number of bytes written or %-1 on fail.
+ **/
+gint64
+g_mime_stream_writev (GMimeStream *stream, GMimeStreamIOVector *vector, size_t count)
+{
+	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
+	
+	return GMIME_STREAM_CLASS_PRIVATE (GMIME_STREAM_GET_CLASS (stream))->writev (stream, vector, count);
+}
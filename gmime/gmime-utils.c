@@ -65,6 +65,7 @@
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
 #include "gmime-iconv-utils.h"
+#include "gmime-pool.h"
 
 #ifdef ENABLE_WARNINGS
 #define w(x) x
@@ -209,7 +210,7 @@ g_mime_utils_header_format_date (GDateTime *date)
 	char sign;
 	
 	g_return_val_if_fail (date != NULL, NULL);
-
+	
 	tz = g_date_time_get_utc_offset (date);
 	if (tz % G_TIME_SPAN_MINUTE == 0) {
 		if (tz < 0) {
@@ -218,7 +219,7 @@ g_mime_utils_header_format_date (GDateTime *date)
 		} else {
 			sign = '+';
 		}
-
+		
 		tz_offset = 100 * (tz / G_TIME_SPAN_HOUR);
 		tz_offset += (tz % G_TIME_SPAN_HOUR) / G_TIME_SPAN_MINUTE;
 	} else {
@@ -230,7 +231,7 @@ g_mime_utils_header_format_date (GDateTime *date)
 		tz_offset = 0;
 		sign = '-';
 	}
-
+	
 	wday = g_date_time_get_day_of_week (date);
 	year = g_date_time_get_year (date);
 	month = g_date_time_get_month (date);
@@ -238,7 +239,7 @@ g_mime_utils_header_format_date (GDateTime *date)
 	hour = g_date_time_get_hour (date);
 	min = g_date_time_get_minute (date);
 	sec = g_date_time_get_second (date);
-
+	
 	if (utc != NULL)
 		g_date_time_unref (utc);
 	
@@ -256,8 +257,8 @@ typedef struct _date_token {
 	size_t len;
 } date_token;
 
-#define date_token_free(tok) g_slice_free (date_token, tok)
-#define date_token_new() g_slice_new (date_token)
+#define date_token_free(tok) g_mime_pool_thread_release (sizeof (date_token), tok)
+#define date_token_new() ((date_token *) g_mime_pool_thread_alloc (sizeof (date_token)))
 
 static date_token *
 datetok (const char *date)
@@ -466,13 +467,13 @@ static int
 format_timezone_identifier (char *identifier, int len, char sign, int tz_offset)
 {
 	int minutes, hours;
-
+	
 	hours = tz_offset / 100;
 	minutes = tz_offset % 100;
-
+	
 	if (hours >= 24)
 		return -1;
-
+	
 	return snprintf (identifier, len, "%c%02d:%02d:00", sign, hours, minutes);
 }
 
@@ -496,7 +497,7 @@ get_tzone (date_token **token)
 		if (len == 5 && (*inptr == '+' || *inptr == '-')) {
 			if ((tz_offset = decode_int (inptr + 1, len - 1)) == -1)
 				return NULL;
-
+			
 			if (format_timezone_identifier (identifier, sizeof (identifier), *inptr, tz_offset) < 0)
 				return NULL;
 			
@@ -520,7 +521,7 @@ get_tzone (date_token **token)
 			// TODO: modify the struct to have an `identifier` field instead of `offset` that is a pre-formatted string?
 			char sign = tz_offsets[t].offset < 0 ? '-' : '+';
 			tz_offset = ABS(tz_offsets[t].offset);
-
+			
 			if (format_timezone_identifier (identifier, sizeof (identifier), sign, tz_offset) < 0)
 				return NULL;
 			
@@ -1192,6 +1193,83 @@ charset_convert (iconv_t cd, const char *inbuf, size_t inleft, char **outp, size
 }
 
 
+/**
+ * charset_decode:
+ * @decoder: a built-in charset decoder
+ * @inbuf: input text buffer to convert
+ * @inleft: length of the input buffer
+ * @outp: pointer to output buffer
+ * @outlenp: pointer to output buffer length
+ * @ninval: the number of invalid bytes in @inbuf
+ *
+ * Like charset_convert(), but converts the input buffer into UTF-8
+ * using one of the built-in decoders rather than iconv.
+ *
+ * Returns: the string length of the output buffer.
+ **/
+static size_t
+charset_decode (GMimeCharsetDecoder decoder, const char *inbuf, size_t inleft, char **outp, size_t *outlenp, size_t *ninval)
+{
+	size_t outlen, nread, nwritten;
+	char *out;
+	
+	/* each input byte can become at most 3 bytes of UTF-8 */
+	outlen = (inleft * 3) + 16;
+	
+	if (*outp == NULL) {
+		out = g_malloc (outlen + 1);
+	} else if (*outlenp < outlen) {
+		out = g_realloc (*outp, outlen + 1);
+	} else {
+		outlen = *outlenp;
+		out = *outp;
+	}
+	
+	nwritten = _g_mime_charset_decode_to_utf8 (decoder, inbuf, inleft, out, '?', TRUE, &nread, ninval);
+	out[nwritten] = '\0';
+	
+	*outlenp = outlen;
+	*outp = out;
+	
+	return nwritten;
+}
+
+/**
+ * charset_convert_to_utf8:
+ * @charset: the charset of the input text
+ * @inbuf: input text buffer to convert
+ * @inleft: length of the input buffer
+ * @outp: pointer to output buffer
+ * @outlenp: pointer to output buffer length
+ * @ninval: the number of invalid bytes in @inbuf
+ *
+ * Converts the input buffer from @charset into UTF-8, using one of
+ * the built-in decoders if there is one for @charset and iconv
+ * otherwise. See charset_convert() for details.
+ *
+ * Returns: the string length of the output buffer or (size_t) -1 if
+ * @charset is not supported.
+ **/
+static size_t
+charset_convert_to_utf8 (const char *charset, const char *inbuf, size_t inleft, char **outp, size_t *outlenp, size_t *ninval)
+{
+	GMimeCharsetDecoder decoder;
+	size_t outlen;
+	iconv_t cd;
+	
+	if ((decoder = _g_mime_charset_get_utf8_decoder (charset)) != GMIME_CHARSET_DECODER_NONE)
+		return charset_decode (decoder, inbuf, inleft, outp, outlenp, ninval);
+	
+	if ((cd = _g_mime_iconv_open ("UTF-8", charset)) == (iconv_t) -1)
+		return (size_t) -1;
+	
+	outlen = charset_convert (cd, inbuf, inleft, outp, outlenp, ninval);
+	_g_mime_iconv_close (cd);
+	
+	return outlen;
+}
+
+
 /**
  * g_mime_utils_decode_8bit:
  * @options: (nullable): a #GMimeParserOptions or %NULL
@@ -1213,7 +1291,6 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 	size_t outleft, outlen, min, ninval;
 	const char **charsets;
 	const char *best;
-	iconv_t cd;
 	char *out;
 	int i;
 	
@@ -1227,13 +1304,9 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 	out = g_malloc (outleft + 1);
 	
 	for (i = 0; charsets[i]; i++) {
-		if ((cd = g_mime_iconv_open ("UTF-8", charsets[i])) == (iconv_t) -1)
+		if ((outlen = charset_convert_to_utf8 (charsets[i], text, len, &out, &outleft, &ninval)) == (size_t) -1)
 			continue;
 		
-		outlen = charset_convert (cd, text, len, &out, &outleft, &ninval);
-		
-		g_mime_iconv_close (cd);
-		
 		if (ninval == 0)
 			return g_realloc (out, outlen + 1);
 		
@@ -1247,7 +1320,7 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 	 * try to find the one that fit the best and use that to convert what we can,
 	 * replacing any byte we can't convert with a '?' */
 	
-	if ((cd = g_mime_iconv_open ("UTF-8", best)) == (iconv_t) -1) {
+	if ((outlen = charset_convert_to_utf8 (best, text, len, &out, &outleft, &ninval)) == (size_t) -1) {
 		/* this shouldn't happen... but if we are here, then
 		 * it did...  the only thing we can do at this point
 		 * is replace the 8bit garbage and pray */
@@ -1269,10 +1342,6 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 		return g_realloc (out, (size_t) (outbuf - out));
 	}
 	
-	outlen = charset_convert (cd, text, len, &out, &outleft, &ninval);
-	
-	g_mime_iconv_close (cd);
-	
 	return g_realloc (out, outlen + 1);
 }
 
@@ -1414,15 +1483,26 @@ typedef struct _rfc2047_token {
 	char is_8bit;
 } rfc2047_token;
 
-#define rfc2047_token_list_free(tokens) g_slice_free_chain (rfc2047_token, tokens, next)
-#define rfc2047_token_free(token) g_slice_free (rfc2047_token, token)
+#define rfc2047_token_free(token) g_mime_pool_thread_release (sizeof (rfc2047_token), token)
+
+static void
+rfc2047_token_list_free (rfc2047_token *tokens)
+{
+	rfc2047_token *next;
+	
+	while (tokens != NULL) {
+		next = tokens->next;
+		rfc2047_token_free (tokens);
+		tokens = next;
+	}
+}
 
 static rfc2047_token *
 rfc2047_token_new (const char *text, size_t len)
 {
 	rfc2047_token *token;
 	
-	token = g_slice_new0 (rfc2047_token);
+	token = g_mime_pool_thread_alloc0 (sizeof (rfc2047_token));
 	token->length = len;
 	token->text = text;
 	
@@ -1808,21 +1888,20 @@ rfc2047_token_decode (rfc2047_token *token, unsigned char *outbuf, int *state, g
 static char *
 rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_t buflen, const char **charset_out)
 {
+	size_t outlen, ninval, len, utf8len = 0;
 	rfc2047_token *token, *next;
-	size_t outlen, ninval, len;
 	unsigned char *outptr;
 	const char *charset;
 	GByteArray *outbuf;
+	char *str, *utf8 = NULL;
 	GString *decoded;
 	char encoding;
 	guint32 save;
-	iconv_t cd;
 	int state;
-	char *str;
 	
 	decoded = g_string_sized_new (buflen + 1);
 	outbuf = g_byte_array_sized_new (76);
-
+	
 	if (charset_out)
 		*charset_out = NULL;
 	
@@ -1872,18 +1951,11 @@ rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_
 			outptr = outbuf->data;
 			
 			/* convert the raw decoded text into UTF-8 */
-			if (!g_ascii_strcasecmp (charset, "UTF-8")) {
-				/* slight optimization over going through iconv */
-				str = (char *) outptr;
-				len = outlen;
-				
-				while (!g_utf8_validate (str, len, (const char **) &str)) {
-					len = outlen - (str - (char *) outptr);
-					*str = '?';
-				}
-				
+			if (!g_ascii_strcasecmp (charset, "UTF-8") &&
+			    _g_mime_utf8_validate ((char *) outptr, outlen, NULL) == outlen) {
+				/* valid UTF-8 can be passed straight through */
 				g_string_append_len (decoded, (char *) outptr, outlen);
-			} else if ((cd = g_mime_iconv_open ("UTF-8", charset)) == (iconv_t) -1) {
+			} else if ((len = charset_convert_to_utf8 (charset, (char *) outptr, outlen, &utf8, &utf8len, &ninval)) == (size_t) -1) {
 				w(g_warning ("Cannot convert from %s to UTF-8, header display may "
 					     "be corrupt: %s", charset[0] ? charset : "unspecified charset",
 					     g_strerror (errno)));
@@ -1892,14 +1964,7 @@ rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_
 				g_string_append (decoded, str);
 				g_free (str);
 			} else {
-				str = g_malloc (outlen + 1);
-				len = outlen;
-				
-				len = charset_convert (cd, (char *) outptr, outlen, &str, &len, &ninval);
-				g_mime_iconv_close (cd);
-				
-				g_string_append_len (decoded, str, len);
-				g_free (str);
+				g_string_append_len (decoded, utf8, len);
 				
 #if w(!)0
 				if (ninval > 0) {
@@ -1921,6 +1986,7 @@ rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_
 	}
 	
 	g_byte_array_free (outbuf, TRUE);
+	g_free (utf8);
 	
 	return g_string_free (decoded, FALSE);
 }
@@ -2067,11 +2133,11 @@ rfc2047_encode_word (GString *string, const char *word, size_t len,
 	char encoding;
 	
 	if (g_ascii_strcasecmp (charset, "UTF-8") != 0)
-		cd = g_mime_iconv_open (charset, "UTF-8");
+		cd = _g_mime_iconv_open (charset, "UTF-8");
 	
 	if (cd != (iconv_t) -1) {
 		uword = g_mime_iconv_strndup (cd, (char *) word, len);
-		g_mime_iconv_close (cd);
+		_g_mime_iconv_close (cd);
 	}
 	
 	if (uword) {
@@ -2140,8 +2206,8 @@ typedef struct _rfc822_word {
 	int encoding;
 } rfc822_word;
 
-#define rfc822_word_free(word) g_slice_free (rfc822_word, word)
-#define rfc822_word_new() g_slice_new (rfc822_word)
+#define rfc822_word_free(word) g_mime_pool_thread_release (sizeof (rfc822_word), word)
+#define rfc822_word_new() ((rfc822_word *) g_mime_pool_thread_alloc (sizeof (rfc822_word)))
 
 /* okay, so 'unstructured text' fields don't actually contain 'word'
  * tokens, but we can group stuff similarly... */
@@ -2834,26 +2900,26 @@ g_mime_utils_header_unfold (const char *value)
 	register const char *inptr = value;
 	const char *start, *inend;
 	char *str, *outptr;
-
+	
 	while (is_lwsp (*inptr))
 		inptr++;
-
+	
 	inend = start = inptr;
 	while (*inptr) {
 		if (!is_lwsp (*inptr++))
 			inend = inptr;
 	}
-
+	
 	outptr = str = g_malloc ((size_t) (inend - start) + 1);
 	inptr = start;
-
+	
 	while (inptr < inend) {
 		if (*inptr != '\r' && *inptr != '\n')
 			*outptr++ = *inptr;
 		inptr++;
 	}
-
+	
 	*outptr = '\0';
-
+	
 	return str;
 }
@@ -32,6 +32,7 @@
 
 #include "gmime.h"
 #include "gmime-internal.h"
+#include "gmime-pool.h"
 
 #ifdef ENABLE_CRYPTOGRAPHY
 #include "gmime-pkcs7-context.h"
@@ -93,6 +94,32 @@ g_mime_check_version (guint major, guint minor, guint micro)
  * g_mime_init:
  *
  * Initializes GMime.
+ *
+ * This must be called (and must return) before any other GMime
+ * function is used from any thread. All of GMime's public types and
+ * global lookup tables are set up here, so that afterwards independent
+ * #GMimeParser, #GMimeMessage and #GMimeStream instances may be used
+ * from different threads at the same time. Individual objects are not
+ * internally locked, so a single instance must not be used from more
+ * than one thread at once without external locking.
+ *
+ * The global tables consulted while parsing (the charset map used by
+ * g_mime_charset_iconv_name(), the object type registry used by
+ * g_mime_object_new() and the crypto context registry used by
+ * g_mime_crypto_context_new()) can be read concurrently. Registry
+ * lookups take no lock. g_mime_object_register_type() and
+ * g_mime_crypto_context_register() remain safe to call at any time,
+ * but are best done once, right after g_mime_init().
+ *
+ * g_mime_charset_iconv_name() takes no lock for the charsets that
+ * g_mime_init() puts in the charset map: us-ascii, utf-8, the
+ * iso-8859-* and windows-125x series, koi8-r, koi8-u and the common
+ * Chinese, Japanese and Korean charsets and aliases. The iconv names of
+ * all other charsets are cached in a table guarded by a global mutex,
+ * so concurrent lookups of those charsets serialize.
+ *
+ * g_mime_shutdown() must only be called once no other thread is using
+ * GMime.
  **/
 void
 g_mime_init (void)
@@ -117,6 +144,7 @@ g_mime_init (void)
 	g_mime_format_options_init ();
 	g_mime_parser_options_init ();
 	g_mime_charset_map_init ();
+	g_mime_iconv_init ();
 	
 #ifdef ENABLE_CRYPTO
 	/* gpgme_check_version() initializes GpgMe */
@@ -125,7 +153,7 @@ g_mime_init (void)
 	
 	gmime_gpgme_error_quark = g_quark_from_static_string ("gmime-gpgme");
 	gmime_error_quark = g_quark_from_static_string ("gmime");
-
+	
 	/* register our GObject types with the GType system */
 	g_mime_crypto_context_get_type ();
 	g_mime_decrypt_result_get_type ();
@@ -156,6 +184,7 @@ g_mime_init (void)
 	
 	g_mime_stream_get_type ();
 	g_mime_stream_buffer_get_type ();
+	g_mime_stream_bytes_get_type ();
 	g_mime_stream_cat_get_type ();
 	g_mime_stream_file_get_type ();
 	g_mime_stream_filter_get_type ();
@@ -229,5 +258,7 @@ g_mime_shutdown (void)
 	g_mime_crypto_context_shutdown ();
 	g_mime_format_options_shutdown ();
 	g_mime_parser_options_shutdown ();
+	g_mime_iconv_shutdown ();
 	g_mime_charset_map_shutdown ();
+	g_mime_pool_thread_shutdown ();
 }
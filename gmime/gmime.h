@@ -52,6 +52,7 @@
 #include <gmime/gmime-references.h>
 #include <gmime/gmime-stream.h>
 #include <gmime/gmime-stream-buffer.h>
+#include <gmime/gmime-stream-bytes.h>
 #include <gmime/gmime-stream-cat.h>
 #include <gmime/gmime-stream-file.h>
 #include <gmime/gmime-stream-filter.h>
@@ -385,6 +385,76 @@ test_cat_seek (GMimeStream *whole, struct _StreamPart *parts, int bounded)
 	}
 }
 
+static void
+test_cat_seek_many (GMimeStream *whole, struct _StreamPart *parts, int bounded)
+{
+	struct _StreamPart *part = parts;
+	char buf[2][64], errstr[256];
+	GMimeStream *stream, *cat;
+	gint64 offset, len;
+	ssize_t nread[2];
+	Exception *ex;
+	int fd, i;
+	
+	if (whole->bound_end != -1) {
+		len = whole->bound_end - whole->bound_start;
+	} else if ((len = g_mime_stream_length (whole)) == -1) {
+		ex = exception_new ("unable to get original stream length");
+		throw (ex);
+	}
+	
+	cat = g_mime_stream_cat_new ();
+	
+	while (part != NULL) {
+		if ((fd = open (part->filename, O_RDONLY, 0)) == -1) {
+			ex = exception_new ("could not open `%s': %s", part->filename, g_strerror (errno));
+			g_object_unref (cat);
+			throw (ex);
+		}
+		
+		stream = g_mime_stream_fs_new_with_bounds (fd, part->pstart, bounded ? part->pend : -1);
+		g_mime_stream_cat_add_source ((GMimeStreamCat *) cat, stream);
+		g_object_unref (stream);
+		
+		part = part->next;
+	}
+	
+	/* jump back and forth between random offsets (which will often
+	 * land in different source streams) and compare what we read */
+	*errstr = '\0';
+	for (i = 0; i < 32 && *errstr == '\0'; i++) {
+		offset = (gint64) (len * randf ());
+		
+		if (g_mime_stream_seek (whole, offset, GMIME_STREAM_SEEK_SET) == -1) {
+			snprintf (errstr, sizeof (errstr), "could not seek to %lld in original stream: %s",
+				  (long long) offset, g_strerror (errno));
+			break;
+		}
+		
+		if (g_mime_stream_seek (cat, offset, GMIME_STREAM_SEEK_SET) == -1) {
+			snprintf (errstr, sizeof (errstr), "could not seek to %lld: %s",
+				  (long long) offset, g_strerror (errno));
+			break;
+		}
+		
+		nread[0] = g_mime_stream_read (whole, buf[0], sizeof (buf[0]));
+		nread[1] = g_mime_stream_read (cat, buf[1], sizeof (buf[1]));
+		
+		/* the cat may return less data at the end of a source */
+		if (nread[1] <= 0 || nread[1] > nread[0] || memcmp (buf[0], buf[1], nread[1]) != 0)
+			snprintf (errstr, sizeof (errstr), "streams did not match at offset %lld",
+				  (long long) offset);
+	}
+	
+	if (*errstr == '\0' && g_mime_stream_seek (cat, 0, GMIME_STREAM_SEEK_END) != len)
+		snprintf (errstr, sizeof (errstr), "could not seek to the end of the stream");
+	
+	g_object_unref (cat);
+	
+	if (*errstr != '\0')
+		throw (exception_new ("%s", errstr));
+}
+
 static void
 test_cat_substream (GMimeStream *whole, struct _StreamPart *parts, int bounded)
 {
@@ -462,13 +532,15 @@ struct {
 	checkFunc check;
 	int bounded;
 } checks[] = {
-	{ "GMimeStreamCat::write()",            test_cat_write,     FALSE },
-	{ "GMimeStreamCat::read(bound)",        test_cat_read,      TRUE  },
-	{ "GMimeStreamCat::read(unbound)",      test_cat_read,      FALSE },
-	{ "GMimeStreamCat::seek(bound)",        test_cat_seek,      TRUE  },
-	{ "GMimeStreamCat::seek(unbound)",      test_cat_seek,      FALSE },
-	{ "GMimeStreamCat::substream(bound)",   test_cat_substream, TRUE  },
-	{ "GMimeStreamCat::substream(unbound)", test_cat_substream, FALSE },
+	{ "GMimeStreamCat::write()",                 test_cat_write,     FALSE },
+	{ "GMimeStreamCat::read(bound)",             test_cat_read,      TRUE  },
+	{ "GMimeStreamCat::read(unbound)",           test_cat_read,      FALSE },
+	{ "GMimeStreamCat::seek(bound)",             test_cat_seek,      TRUE  },
+	{ "GMimeStreamCat::seek(unbound)",           test_cat_seek,      FALSE },
+	{ "GMimeStreamCat::seek(repeated, bound)",   test_cat_seek_many, TRUE  },
+	{ "GMimeStreamCat::seek(repeated, unbound)", test_cat_seek_many, FALSE },
+	{ "GMimeStreamCat::substream(bound)",        test_cat_substream, TRUE  },
+	{ "GMimeStreamCat::substream(unbound)",      test_cat_substream, FALSE },
 };
 
 int main (int argc, char **argv)
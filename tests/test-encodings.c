@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -504,6 +505,297 @@ error:
 	g_byte_array_free (actual, TRUE);
 }
 
+/* The original byte-at-a-time quoted-printable encoder and decoder,
+ * kept as a reference for the optimized implementations */
+#define ref_is_qpsafe(c) (((c) >= 32 && (c) <= 126 && (c) != '=') || (c) == '\t')
+#define ref_is_blank(c) ((c) == ' ' || (c) == '\t')
+
+static const char ref_tohex[16] = "0123456789ABCDEF";
+
+static size_t
+reference_quoted_encode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
+{
+	const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	unsigned char *outptr = outbuf;
+	guint32 sofar = *save;
+	int last = *state;
+	unsigned char c;
+	
+	while (inptr < inend) {
+		c = *inptr++;
+		if (c == '\r') {
+			if (last != -1) {
+				*outptr++ = '=';
+				*outptr++ = ref_tohex[(last >> 4) & 0xf];
+				*outptr++ = ref_tohex[last & 0xf];
+				sofar += 3;
+			}
+			last = c;
+		} else if (c == '\n') {
+			if (last != -1 && last != '\r') {
+				*outptr++ = '=';
+				*outptr++ = ref_tohex[(last >> 4) & 0xf];
+				*outptr++ = ref_tohex[last & 0xf];
+			}
+			*outptr++ = '\n';
+			sofar = 0;
+			last = -1;
+		} else {
+			if (last != -1) {
+				if (ref_is_qpsafe (last)) {
+					*outptr++ = last;
+					sofar++;
+				} else {
+					*outptr++ = '=';
+					*outptr++ = ref_tohex[(last >> 4) & 0xf];
+					*outptr++ = ref_tohex[last & 0xf];
+					sofar += 3;
+				}
+			}
+			
+			if (ref_is_qpsafe (c)) {
+				if (sofar > 74) {
+					*outptr++ = '=';
+					*outptr++ = '\n';
+					sofar = 0;
+				}
+				
+				if (ref_is_blank (c)) {
+					last = c;
+				} else {
+					*outptr++ = c;
+					sofar++;
+					last = -1;
+				}
+			} else {
+				if (sofar > 72) {
+					*outptr++ = '=';
+					*outptr++ = '\n';
+					sofar = 3;
+				} else
+					sofar += 3;
+				
+				*outptr++ = '=';
+				*outptr++ = ref_tohex[(c >> 4) & 0xf];
+				*outptr++ = ref_tohex[c & 0xf];
+				last = -1;
+			}
+		}
+	}
+	
+	*save = sofar;
+	*state = last;
+	
+	return (outptr - outbuf);
+}
+
+static size_t
+reference_quoted_decode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
+{
+	const unsigned char *inptr = inbuf;
+	const unsigned char *inend = inbuf + inlen;
+	unsigned char *outptr = outbuf;
+	guint32 isave = *save;
+	int istate = *state;
+	unsigned char c;
+	
+	while (inptr < inend) {
+		switch (istate) {
+		case 0:
+			while (inptr < inend) {
+				c = *inptr++;
+				if (c == '=') {
+					istate = 1;
+					break;
+				}
+				
+				*outptr++ = c;
+			}
+			break;
+		case 1:
+			c = *inptr++;
+			if (c == '\n') {
+				istate = 0;
+			} else {
+				isave = c;
+				istate = 2;
+			}
+			break;
+		case 2:
+			c = *inptr++;
+			if (isxdigit (c) && isxdigit (isave)) {
+				c = toupper ((int) c);
+				isave = toupper ((int) isave);
+				*outptr++ = (((isave >= 'A' ? isave - 'A' + 10 : isave - '0') & 0x0f) << 4)
+					| ((c >= 'A' ? c - 'A' + 10 : c - '0') & 0x0f);
+			} else if (c == '\n' && isave == '\r') {
+				/* soft break ... canonical end of line */
+			} else {
+				*outptr++ = '=';
+				*outptr++ = isave;
+				*outptr++ = c;
+			}
+			istate = 0;
+			break;
+		}
+	}
+	
+	*state = istate;
+	*save = isave;
+	
+	return (outptr - outbuf);
+}
+
+static const char *qp_differential_alphabets[] = {
+	"abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 .,;:!?-",
+	"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa \t",
+	"plain text with \t\r\n line breaks, trailing  \n blanks and =equals=",
+	"caf\xc3\xa9 na\xc3\xafve \xe9\xe8\xff\x01\x7f\r\n",
+	"=3D=0D=0A=\r\n=\n==3=ZZ=3d = \r \n",
+};
+
+static void
+test_quoted_printable_differential (void)
+{
+	unsigned char *input, *expected, *actual;
+	int estate, astate, alphabet, encode;
+	guint32 esave, asave, seed = 42;
+	size_t inlen, elen, alen, chunk;
+	size_t i, n, len;
+	const char *chars;
+	guint iter;
+	
+	input = g_malloc (16384);
+	expected = g_malloc (16384 * 4);
+	actual = g_malloc (16384 * 4);
+	
+#define next_rand() (seed = seed * 1103515245 + 12345, (seed >> 16) & 0x7fff)
+	
+	for (encode = 0; encode < 2; encode++) {
+		testsuite_check ("quoted-printable %s matches the reference implementation", encode ? "encoder" : "decoder");
+		
+		for (iter = 0; iter < 2000; iter++) {
+			alphabet = next_rand () % G_N_ELEMENTS (qp_differential_alphabets);
+			chars = qp_differential_alphabets[alphabet];
+			len = strlen (chars);
+			
+			inlen = next_rand () % (iter < 1900 ? 512 : 16384);
+			for (i = 0; i < inlen; i++)
+				input[i] = chars[next_rand () % len];
+			
+			chunk = 1 + (next_rand () % 2 ? next_rand () % 8 : next_rand () % 4096);
+			estate = astate = encode ? -1 : 0;
+			esave = asave = 0;
+			elen = alen = 0;
+			
+			for (i = 0; i < inlen; i += n) {
+				n = MIN (chunk, inlen - i);
+				
+				if (encode) {
+					elen += reference_quoted_encode_step (input + i, n, expected + elen, &estate, &esave);
+					alen += g_mime_encoding_quoted_encode_step (input + i, n, actual + alen, &astate, &asave);
+				} else {
+					elen += reference_quoted_decode_step (input + i, n, expected + elen, &estate, &esave);
+					alen += g_mime_encoding_quoted_decode_step (input + i, n, actual + alen, &astate, &asave);
+				}
+			}
+			
+			if (elen != alen || memcmp (expected, actual, elen) != 0 || estate != astate || esave != asave)
+				break;
+		}
+		
+		if (iter < 2000) {
+			testsuite_check_failed ("quoted-printable %s differs from the reference implementation "
+						"(alphabet %d, %zu bytes in %zu byte chunks)", encode ? "encoder" : "decoder",
+						alphabet, inlen, chunk);
+		} else {
+			testsuite_check_passed ();
+		}
+	}
+	
+#undef next_rand
+	
+	g_free (expected);
+	g_free (actual);
+	g_free (input);
+}
+
+#define BENCHMARK_SIZE (8 * 1024 * 1024)
+
+static double
+throughput (size_t nbytes, gint64 elapsed)
+{
+	return elapsed > 0 ? (nbytes / (1024.0 * 1024.0)) / (elapsed / (double) G_USEC_PER_SEC) : 0.0;
+}
+
+static void
+test_base64_throughput (void)
+{
+	size_t inlen, outlen, enclen, declen, n, i;
+	unsigned char *input, *encoded, *crlf, *decoded;
+	gint64 start, encode_time, decode_time;
+	guint32 save = 0, seed = 0x2545F491;
+	unsigned char *outptr;
+	int state = 0;
+	
+	testsuite_check ("base64 throughput (%u MB)", BENCHMARK_SIZE / (1024 * 1024));
+	
+	input = g_malloc (BENCHMARK_SIZE);
+	for (i = 0; i < BENCHMARK_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		input[i] = (unsigned char) (seed >> 16);
+	}
+	
+	encoded = g_malloc (BENCHMARK_SIZE * 2);
+	crlf = g_malloc (BENCHMARK_SIZE * 2);
+	decoded = g_malloc (BENCHMARK_SIZE + 16);
+	
+	/* encode in 4K chunks like GMimeFilterBasic does */
+	start = g_get_monotonic_time ();
+	outptr = encoded;
+	for (i = 0; i < BENCHMARK_SIZE; i += n) {
+		n = MIN (4096, BENCHMARK_SIZE - i);
+		outptr += g_mime_encoding_base64_encode_step (input + i, n, outptr, &state, &save);
+	}
+	outptr += g_mime_encoding_base64_encode_close (NULL, 0, outptr, &state, &save);
+	encode_time = g_get_monotonic_time () - start;
+	enclen = outptr - encoded;
+	
+	/* decode the way it would appear on the wire, with CRLF line endings */
+	for (i = 0, outlen = 0; i < enclen; i++) {
+		if (encoded[i] == '\n')
+			crlf[outlen++] = '\r';
+		crlf[outlen++] = encoded[i];
+	}
+	
+	inlen = outlen;
+	state = 0;
+	save = 0;
+	
+	start = g_get_monotonic_time ();
+	outptr = decoded;
+	for (i = 0; i < inlen; i += n) {
+		n = MIN (4096, inlen - i);
+		outptr += g_mime_encoding_base64_decode_step (crlf + i, n, outptr, &state, &save);
+	}
+	decode_time = g_get_monotonic_time () - start;
+	declen = outptr - decoded;
+	
+	if (declen != BENCHMARK_SIZE || memcmp (input, decoded, declen) != 0) {
+		testsuite_check_failed ("base64 throughput failed: decoded data does not match the original");
+	} else {
+		v(fprintf (stdout, "base64 encode: %.2f MB/s; decode: %.2f MB/s\n",
+			   throughput (BENCHMARK_SIZE, encode_time), throughput (inlen, decode_time)));
+		testsuite_check_passed ();
+	}
+	
+	g_free (decoded);
+	g_free (encoded);
+	g_free (input);
+	g_free (crlf);
+}
+
 int main (int argc, char **argv)
 {
 	const char *datadir = "data/encodings";
@@ -561,6 +853,10 @@ int main (int argc, char **argv)
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 1024);
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 16);
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 1);
+	
+	/* the throughput benchmark is only run when asked for (-vvvv) */
+	if (verbose > 3)
+		test_base64_throughput ();
 	testsuite_end ();
 	
 	testsuite_start ("uuencode");
@@ -580,6 +876,7 @@ int main (int argc, char **argv)
 	test_quoted_printable_encode_space_unix_linebreak ();
 	test_quoted_printable_encode_ending_with_space ();
 	test_quoted_printable_decode_invalid_soft_break ();
+	test_quoted_printable_differential ();
 	test_encoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, wikipedia, qp, 4096);
 	test_encoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, wikipedia, qp, 1024);
 	test_encoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, wikipedia, qp, 16);
@@ -156,6 +156,65 @@ error:
 	g_byte_array_free (actual, TRUE);
 }
 
+static struct {
+	const char *charset;
+	const char *input;
+	const char *expected;
+} builtin_charsets[] = {
+	{ "iso-8859-1", "caf\xe9 cr\xe8me \xa4\xff", "caf\xc3\xa9 cr\xc3\xa8me \xc2\xa4\xc3\xbf" },
+	{ "iso-8859-15", "\xa4 100, \xbd\xbe", "\xe2\x82\xac 100, \xc5\x93\xc5\xb8" },
+	{ "windows-1252", "\x93quoted\x94 \x80 \x81\x9d.", "\xe2\x80\x9cquoted\xe2\x80\x9d \xe2\x82\xac ." },
+	{ "us-ascii", "plain \xe9text", "plain text" },
+	{ "utf-8", "Gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac \xf0\x9f\x98\x80", "Gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac \xf0\x9f\x98\x80" },
+	{ "utf-8", "bad \xc3\x28 \xed\xa0\x80 \xc0\xaf \xe2\x82", "bad ( " "  " },
+};
+
+static void
+test_charset_builtin (void)
+{
+	const char *what = "GMimeFilterCharset";
+	GMimeStream *stream, *filtered;
+	GMimeFilter *filter;
+	GByteArray *actual;
+	guint i;
+	
+	for (i = 0; i < G_N_ELEMENTS (builtin_charsets); i++) {
+		testsuite_check ("%s (built-in %s -> utf-8 #%u)", what, builtin_charsets[i].charset, i);
+		
+		if (!(filter = g_mime_filter_charset_new (builtin_charsets[i].charset, "utf-8"))) {
+			testsuite_check_failed ("%s failed: no converter from %s to utf-8", what, builtin_charsets[i].charset);
+			continue;
+		}
+		
+		actual = g_byte_array_new ();
+		stream = g_mime_stream_mem_new_with_byte_array (actual);
+		g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+		
+		/* feed the filter one byte at a time so that multibyte sequences get split */
+		filtered = g_mime_stream_filter_new (stream);
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+		g_object_unref (stream);
+		
+		stream = test_stream_onebyte_new (filtered);
+		g_object_unref (filtered);
+		
+		g_mime_stream_write_string (stream, builtin_charsets[i].input);
+		g_mime_stream_flush (stream);
+		g_object_unref (stream);
+		
+		if (actual->len != strlen (builtin_charsets[i].expected) ||
+		    memcmp (actual->data, builtin_charsets[i].expected, actual->len) != 0) {
+			testsuite_check_failed ("%s failed: expected \"%s\"; actual \"%.*s\"", what,
+						builtin_charsets[i].expected, (int) actual->len, (char *) actual->data);
+		} else {
+			testsuite_check_passed ();
+		}
+		
+		g_byte_array_free (actual, TRUE);
+	}
+}
+
 static void
 test_enriched (const char *datadir, const char *input, const char *output)
 {
@@ -503,6 +562,9 @@ int main (int argc, char **argv)
 	test_charset_conversion (datadir, "japanese", "iso-2022-jp", "utf-8");
 	test_charset_conversion (datadir, "japanese", "utf-8", "shift-jis");
 	test_charset_conversion (datadir, "japanese", "shift-jis", "utf-8");
+	test_charset_conversion (datadir, "japanese", "utf-8", "utf-8");
+	test_charset_conversion (datadir, "french-fable", "cp1252", "utf-8");
+	test_charset_builtin ();
 	
 	test_enriched (datadir, "enriched.txt", "enriched.html");
 	
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "testsuite.h"
 
@@ -227,6 +228,89 @@ test_remove_at (void)
 	g_object_unref (list);
 }
 
+static void
+test_header_ids (void)
+{
+	GMimeFormatOptions *options;
+	GMimeHeader *received, *xfoo;
+	GMimeHeaderList *list;
+	gboolean hidden[4];
+	int count;
+	
+	list = header_list_new ();
+	g_mime_header_list_append (list, "X-Foo", "first x-foo", NULL);
+	g_mime_header_list_append (list, "x-FOO", "second x-foo", NULL);
+	
+	/* well-known and unknown names must both be looked up case-insensitively */
+	received = g_mime_header_list_get_header (list, "rEcEiVeD");
+	xfoo = g_mime_header_list_get_header (list, "X-fOO");
+	
+	testsuite_check ("case-insensitive lookups");
+	try {
+		if (received == NULL || strcmp (g_mime_header_get_value (received), initial[0].value) != 0)
+			throw (exception_new ("expected first Received header"));
+		
+		if (xfoo == NULL || strcmp (g_mime_header_get_value (xfoo), "first x-foo") != 0)
+			throw (exception_new ("expected first X-Foo header"));
+		
+		if (!g_mime_header_list_contains (list, "MESSAGE-ID") || g_mime_header_list_contains (list, "Message"))
+			throw (exception_new ("contains returned the wrong result"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("case-insensitive lookups: %s", ex->message);
+	} finally;
+	
+	/* setting a header replaces the first instance and drops the rest */
+	g_mime_header_list_set (list, "RECEIVED", "only received header", NULL);
+	g_mime_header_list_remove (list, "x-foo");
+	received = g_mime_header_list_get_header (list, "Received");
+	xfoo = g_mime_header_list_get_header (list, "X-Foo");
+	count = g_mime_header_list_get_count (list);
+	
+	testsuite_check ("setting and removing");
+	try {
+		if (count != (int) G_N_ELEMENTS (initial) - 1)
+			throw (exception_new ("unexpected header count: %d", count));
+		
+		if (received == NULL || strcmp (g_mime_header_get_value (received), "only received header") != 0)
+			throw (exception_new ("Received header was not replaced"));
+		
+		if (xfoo == NULL || strcmp (g_mime_header_get_value (xfoo), "second x-foo") != 0)
+			throw (exception_new ("expected second X-Foo header"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("setting and removing: %s", ex->message);
+	} finally;
+	
+	options = g_mime_format_options_new ();
+	g_mime_format_options_add_hidden_header (options, "subject");
+	g_mime_format_options_add_hidden_header (options, "X-FOO");
+	g_mime_format_options_add_hidden_header (options, "x-bar");
+	g_mime_format_options_remove_hidden_header (options, "X-Bar");
+	hidden[0] = g_mime_format_options_is_hidden_header (options, "Subject");
+	hidden[1] = g_mime_format_options_is_hidden_header (options, "x-foo");
+	hidden[2] = g_mime_format_options_is_hidden_header (options, "X-Bar");
+	hidden[3] = g_mime_format_options_is_hidden_header (options, "Sender");
+	g_mime_format_options_free (options);
+	
+	testsuite_check ("hidden headers");
+	try {
+		if (!hidden[0] || !hidden[1])
+			throw (exception_new ("header should have been hidden"));
+		
+		if (hidden[2] || hidden[3])
+			throw (exception_new ("header should not have been hidden"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("hidden headers: %s", ex->message);
+	} finally;
+	
+	g_object_unref (list);
+}
+
 static void
 test_content_type_sync (void)
 {
@@ -657,6 +741,161 @@ test_parameter_lists (void)
 	g_string_free (str, TRUE);
 }
 
+#define ARENA_LONG_HEADER_LEN 5000
+
+static const char arena_message[] =
+	"Received: from mx.example.com by localhost\n"
+	"From: Jane Doe <jane@example.com>\n"
+	"To: John Doe <john@example.com>\n"
+	"Subject : parsed with an arena\n"
+	"Message-Id: <arena@example.com>\n"
+	"MIME-Version: 1.0\n"
+	"Content-Type: multipart/mixed; boundary=\"=-arena\"\n"
+	"\n"
+	"--=-arena\n"
+	"Content-Type: text/plain; charset=us-ascii\n"
+	"Content-Description: the first part\n"
+	"\n"
+	"Hello.\n"
+	"--=-arena\n"
+	"Content-Type: application/octet-stream; name=\"data.bin\"\n"
+	"X-Long-Header: %s\n"
+	"\n"
+	"data\n"
+	"--=-arena--\n";
+
+static GMimeMessage *
+parse_arena_message (const char *text, gboolean use_arena)
+{
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	
+	stream = g_mime_stream_mem_new_with_buffer (text, strlen (text));
+	parser = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_use_arena (parser, use_arena);
+	g_object_unref (stream);
+	
+	message = g_mime_parser_construct_message (parser, NULL);
+	g_object_unref (parser);
+	
+	return message;
+}
+
+static char *
+edit_arena_message (GMimeMessage *message, GMimeObject **attachment)
+{
+	GMimeMultipart *multipart = (GMimeMultipart *) message->mime_part;
+	GMimeHeader *header;
+	
+	g_mime_message_set_subject (message, "edited after parsing", NULL);
+	g_mime_object_remove_header ((GMimeObject *) message, "Received");
+	
+	header = g_mime_header_list_get_header (((GMimeObject *) message)->headers, "To");
+	g_mime_header_set_raw_value (header, " Someone Else <else@example.com>\n");
+	
+	g_mime_object_set_header (g_mime_multipart_get_part (multipart, 0), "Content-Description", "the edited part", NULL);
+	
+	*attachment = g_object_ref (g_mime_multipart_get_part (multipart, 1));
+	
+	return g_mime_object_to_string ((GMimeObject *) message, NULL);
+}
+
+static void
+test_arena (void)
+{
+	char *long_value, *text, *expected, *actual;
+	char *hidden_expected, *hidden_actual;
+	GMimeFormatOptions *options;
+	GMimeMessage *heap, *arena;
+	GMimeObject *attachment;
+	const char *raw_name;
+	const char *value;
+	int count;
+	
+	long_value = g_malloc (ARENA_LONG_HEADER_LEN + 1);
+	memset (long_value, 'x', ARENA_LONG_HEADER_LEN);
+	long_value[ARENA_LONG_HEADER_LEN] = '\0';
+	text = g_strdup_printf (arena_message, long_value);
+	
+	heap = parse_arena_message (text, FALSE);
+	arena = parse_arena_message (text, TRUE);
+	g_free (text);
+	
+	if (heap == NULL || arena == NULL) {
+		testsuite_check ("parsing with an arena");
+		testsuite_check_failed ("parsing with an arena failed: could not parse message");
+		g_free (long_value);
+		return;
+	}
+	
+	expected = g_mime_object_to_string ((GMimeObject *) heap, NULL);
+	actual = g_mime_object_to_string ((GMimeObject *) arena, NULL);
+	
+	/* headers that were never looked at must still honor the format options */
+	options = g_mime_format_options_new ();
+	g_mime_format_options_add_hidden_header (options, "received");
+	g_mime_format_options_add_hidden_header (options, "X-LONG-HEADER");
+	hidden_expected = g_mime_object_to_string ((GMimeObject *) heap, options);
+	hidden_actual = g_mime_object_to_string ((GMimeObject *) arena, options);
+	g_mime_format_options_free (options);
+	
+	count = g_mime_header_list_get_count (((GMimeObject *) arena)->headers);
+	raw_name = g_mime_header_get_raw_name (g_mime_header_list_get_header (((GMimeObject *) arena)->headers, "Subject"));
+	
+	testsuite_check ("parsing with an arena");
+	try {
+		if (strcmp (expected, actual) != 0)
+			throw (exception_new ("serialized messages do not match:\n%s", actual));
+		
+		if (strcmp (hidden_expected, hidden_actual) != 0 || strstr (hidden_actual, "Received") != NULL)
+			throw (exception_new ("hidden headers were serialized:\n%s", hidden_actual));
+		
+		if (count != g_mime_header_list_get_count (((GMimeObject *) heap)->headers))
+			throw (exception_new ("header counts do not match"));
+		
+		if (strcmp (raw_name, "Subject ") != 0)
+			throw (exception_new ("raw header name does not match: '%s'", raw_name));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("parsing with an arena failed: %s", ex->message);
+	} finally;
+	
+	g_free (hidden_expected);
+	g_free (hidden_actual);
+	g_free (expected);
+	g_free (actual);
+	
+	expected = edit_arena_message (heap, &attachment);
+	g_object_unref (attachment);
+	g_object_unref (heap);
+	
+	actual = edit_arena_message (arena, &attachment);
+	g_object_unref (arena);
+	
+	/* the attachment's headers must outlive the message they were parsed with */
+	value = g_mime_object_get_header (attachment, "X-Long-Header");
+	
+	testsuite_check ("modifying arena-backed headers");
+	try {
+		if (strcmp (expected, actual) != 0)
+			throw (exception_new ("serialized messages do not match:\n%s", actual));
+		
+		if (value == NULL || strcmp (value, long_value) != 0)
+			throw (exception_new ("X-Long-Header does not match"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("modifying arena-backed headers failed: %s", ex->message);
+	} finally;
+	
+	g_object_unref (attachment);
+	g_free (long_value);
+	g_free (expected);
+	g_free (actual);
+}
+
 int main (int argc, char **argv)
 {
 	g_mime_init ();
@@ -675,6 +914,10 @@ int main (int argc, char **argv)
 	test_remove_at ();
 	testsuite_end ();
 	
+	testsuite_start ("header name lookups");
+	test_header_ids ();
+	testsuite_end ();
+	
 	testsuite_start ("header synchronization");
 	test_content_type_sync ();
 	test_disposition_sync ();
@@ -689,6 +932,10 @@ int main (int argc, char **argv)
 	test_parameter_lists ();
 	testsuite_end ();
 	
+	testsuite_start ("parsing with an arena");
+	test_arena ();
+	testsuite_end ();
+	
 	g_mime_shutdown ();
 	
 	return testsuite_exit ();
@@ -132,6 +132,132 @@ test_utils (void)
 	testsuite_end ();
 }
 
+static char *
+filter_string (GMimeFilter *filter, const char *str, size_t *outlen)
+{
+	size_t outprespace;
+	char *outbuf;
+	
+	g_mime_filter_filter (filter, (char *) str, strlen (str), 0, &outbuf, outlen, &outprespace);
+	
+	return outbuf;
+}
+
+static void
+test_cache (void)
+{
+	guint64 hits, misses, hits0, misses0;
+	GMimeFilter *filter, *filter2;
+	gboolean reused;
+	size_t outlen;
+	char *outbuf;
+	iconv_t cd;
+	
+	testsuite_start ("iconv descriptor cache");
+	
+	testsuite_check ("descriptors are reused");
+	try {
+		g_mime_iconv_get_cache_stats (&hits0, &misses0);
+		
+		if (!(filter = g_mime_filter_charset_new ("UTF-8", "iso-8859-1")))
+			throw (exception_new ("could not open conversion for UTF-8 to iso-8859-1"));
+		cd = ((GMimeFilterCharset *) filter)->cd;
+		g_object_unref (filter);
+		
+		/* the charset names should be canonicalized before being used as a key */
+		if (!(filter = g_mime_filter_charset_new ("utf-8", "ISO_8859-1")))
+			throw (exception_new ("could not reopen conversion for UTF-8 to iso-8859-1"));
+		reused = ((GMimeFilterCharset *) filter)->cd == cd;
+		g_object_unref (filter);
+		
+		if (!reused)
+			throw (exception_new ("descriptor was not reused"));
+		
+		g_mime_iconv_get_cache_stats (&hits, &misses);
+		if (hits - hits0 < 1)
+			throw (exception_new ("hit was not counted"));
+		if (misses - misses0 > 1)
+			throw (exception_new ("expected at most 1 miss, got %lu", (unsigned long) (misses - misses0)));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("descriptors are reused: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("descriptors are not shared while open");
+	try {
+		if (!(filter = g_mime_filter_charset_new ("UTF-8", "iso-8859-1")))
+			throw (exception_new ("could not open conversion for UTF-8 to iso-8859-1"));
+		
+		if (!(filter2 = g_mime_filter_charset_new ("UTF-8", "iso-8859-1"))) {
+			g_object_unref (filter);
+			throw (exception_new ("could not open a second conversion for UTF-8 to iso-8859-1"));
+		}
+		
+		cd = ((GMimeFilterCharset *) filter)->cd;
+		if (((GMimeFilterCharset *) filter2)->cd == cd) {
+			g_object_unref (filter2);
+			g_object_unref (filter);
+			throw (exception_new ("the same descriptor was handed out twice"));
+		}
+		
+		g_object_unref (filter2);
+		g_object_unref (filter);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("descriptors are not shared while open: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("reused descriptors are reset");
+	try {
+		if (!(filter = g_mime_filter_charset_new ("UTF-8", "iso-2022-jp")))
+			throw (exception_new ("could not open conversion for UTF-8 to iso-2022-jp"));
+		
+		/* leave the descriptor in the JIS X 0208 shift state */
+		filter_string (filter, "\xe6\x97\xa5\xe6\x9c\xac", &outlen);
+		g_object_unref (filter);
+		
+		if (!(filter = g_mime_filter_charset_new ("UTF-8", "iso-2022-jp")))
+			throw (exception_new ("could not reopen conversion for UTF-8 to iso-2022-jp"));
+		
+		outbuf = filter_string (filter, "abc", &outlen);
+		
+		/* if the state was not reset, there would be an escape sequence */
+		if (outlen != 3 || strncmp (outbuf, "abc", 3) != 0) {
+			g_object_unref (filter);
+			throw (exception_new ("descriptor was not reset to its initial state"));
+		}
+		
+		g_object_unref (filter);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("reused descriptors are reset: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("g_mime_iconv_open() bypasses the cache");
+	try {
+		g_mime_iconv_get_cache_stats (&hits0, &misses0);
+		
+		if ((cd = g_mime_iconv_open ("UTF-8", "iso-8859-1")) == (iconv_t) -1)
+			throw (exception_new ("could not open conversion for iso-8859-1 to UTF-8"));
+		
+		if (g_mime_iconv_close (cd) != 0)
+			throw (exception_new ("g_mime_iconv_close() failed"));
+		
+		g_mime_iconv_get_cache_stats (&hits, &misses);
+		if (hits != hits0 || misses != misses0)
+			throw (exception_new ("descriptor went through the cache"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("g_mime_iconv_open() bypasses the cache: %s", ex->message);
+	} finally;
+	
+	testsuite_end ();
+}
+
 int main (int argc, char **argv)
 {
 	g_mime_init ();
@@ -139,6 +265,7 @@ int main (int argc, char **argv)
 	testsuite_init (argc, argv);
 	
 	test_utils ();
+	test_cache ();
 	
 	g_mime_shutdown ();
 	
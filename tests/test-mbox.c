@@ -176,6 +176,381 @@ test_parser (GMimeParser *parser, GMimeStream *mbox, GMimeStream *summary)
 	}
 }
 
+static void
+test_headers_only (GMimeStream *stream, gboolean respect_content_length)
+{
+	const char *subject, *expected_subject;
+	GMimeContentType *type, *expected_type;
+	GMimeMessage *expected, *message;
+	GMimeParser *full, *headers;
+	Exception *ex = NULL;
+	int nmsg = 0;
+	
+	g_mime_stream_reset (stream);
+	full = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (full, GMIME_FORMAT_MBOX);
+	g_mime_parser_set_respect_content_length (full, respect_content_length);
+	
+	/* parse the same mbox using a separate substream so that the two parsers don't interfere */
+	stream = g_mime_stream_substream (stream, stream->bound_start, stream->bound_end);
+	headers = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (headers, GMIME_FORMAT_MBOX);
+	g_mime_parser_set_respect_content_length (headers, respect_content_length);
+	g_mime_parser_set_headers_only (headers, TRUE);
+	g_object_unref (stream);
+	
+	if (!g_mime_parser_get_headers_only (headers))
+		ex = exception_new ("headers-only check failed");
+	
+	while (ex == NULL && !g_mime_parser_eos (full)) {
+		if (!(expected = g_mime_parser_construct_message (full, NULL))) {
+			ex = exception_new ("failed to parse message #%d", nmsg);
+			break;
+		}
+		
+		if (!(message = g_mime_parser_construct_message (headers, NULL))) {
+			ex = exception_new ("failed to parse the headers of message #%d", nmsg);
+			g_object_unref (expected);
+			break;
+		}
+		
+		if (!(expected_subject = g_mime_message_get_subject (expected)))
+			expected_subject = "";
+		
+		if (!(subject = g_mime_message_get_subject (message)))
+			subject = "";
+		
+		expected_type = g_mime_object_get_content_type (expected->mime_part);
+		type = g_mime_object_get_content_type (message->mime_part);
+		
+		if (strcmp (subject, expected_subject) != 0 ||
+		    G_OBJECT_TYPE (message->mime_part) != G_OBJECT_TYPE (expected->mime_part) ||
+		    g_ascii_strcasecmp (type->type, expected_type->type) != 0 ||
+		    g_ascii_strcasecmp (type->subtype, expected_type->subtype) != 0 ||
+		    g_mime_parser_get_headers_begin (headers) != g_mime_parser_get_headers_begin (full) ||
+		    g_mime_parser_get_headers_end (headers) != g_mime_parser_get_headers_end (full) ||
+		    g_mime_parser_tell (headers) != g_mime_parser_tell (full))
+			ex = exception_new ("headers-only parse of message #%d does not match", nmsg);
+		
+		g_object_unref (expected);
+		g_object_unref (message);
+		nmsg++;
+	}
+	
+	if (ex == NULL && !g_mime_parser_eos (headers))
+		ex = exception_new ("headers-only parser did not reach the end of the mbox");
+	
+	g_object_unref (headers);
+	g_object_unref (full);
+	
+	if (ex != NULL)
+		throw (ex);
+}
+
+#define MAX_EVENT_DEPTH 64
+
+typedef struct {
+	gboolean multipart[MAX_EVENT_DEPTH];
+	gint64 content_length;
+	int nheaders;
+	int nparts;
+	int depth;
+	int error;
+} EventState;
+
+static void
+event_part_begin (GMimeParser *parser, const char *type, const char *subtype, int depth, gint64 offset, gpointer user_data)
+{
+	EventState *state = user_data;
+	
+	if (depth != state->depth + 1 || depth >= MAX_EVENT_DEPTH) {
+		state->error++;
+		return;
+	}
+	
+	state->multipart[depth] = !g_ascii_strcasecmp (type, "multipart");
+	state->depth = depth;
+	state->nparts++;
+}
+
+static void
+event_header (GMimeParser *parser, const char *name, const char *value, gint64 offset, gpointer user_data)
+{
+	EventState *state = user_data;
+	
+	if (state->depth == 0)
+		state->nheaders++;
+}
+
+static void
+event_content (GMimeParser *parser, const char *buffer, size_t length, gpointer user_data)
+{
+	EventState *state = user_data;
+	
+	/* only count the content of leaf parts (i.e. not the prologue/epilogue of multiparts) */
+	if (state->depth >= 0 && !state->multipart[state->depth])
+		state->content_length += length;
+}
+
+static void
+event_part_end (GMimeParser *parser, int depth, gint64 offset, gpointer user_data)
+{
+	EventState *state = user_data;
+	
+	if (depth != state->depth)
+		state->error++;
+	
+	state->depth = depth - 1;
+}
+
+static const GMimeParserEvents test_events_cb = {
+	event_part_begin,
+	event_header,
+	event_content,
+	event_part_end
+};
+
+static int
+count_parts (GMimeObject *object, gint64 *content_length)
+{
+	GMimeDataWrapper *content;
+	GMimeMessage *message;
+	int count = 1;
+	int i, n;
+	
+	if (GMIME_IS_MULTIPART (object)) {
+		n = g_mime_multipart_get_count ((GMimeMultipart *) object);
+		for (i = 0; i < n; i++)
+			count += count_parts (g_mime_multipart_get_part ((GMimeMultipart *) object, i), content_length);
+	} else if (GMIME_IS_MESSAGE_PART (object)) {
+		if ((message = g_mime_message_part_get_message ((GMimeMessagePart *) object)) && message->mime_part)
+			count += count_parts (message->mime_part, content_length);
+	} else if (GMIME_IS_PART (object)) {
+		if ((content = g_mime_part_get_content ((GMimePart *) object)))
+			*content_length += g_mime_stream_length (g_mime_data_wrapper_get_stream (content));
+	}
+	
+	return count;
+}
+
+static void
+test_events (GMimeStream *stream, gboolean respect_content_length)
+{
+	GMimeParser *full, *events;
+	gint64 content_length;
+	GMimeMessage *expected;
+	Exception *ex = NULL;
+	EventState state;
+	int nheaders;
+	int nparts;
+	int nmsg = 0;
+	
+	g_mime_stream_reset (stream);
+	full = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (full, GMIME_FORMAT_MBOX);
+	g_mime_parser_set_respect_content_length (full, respect_content_length);
+	
+	/* parse the same mbox using a separate substream so that the two parsers don't interfere */
+	stream = g_mime_stream_substream (stream, stream->bound_start, stream->bound_end);
+	events = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (events, GMIME_FORMAT_MBOX);
+	g_mime_parser_set_respect_content_length (events, respect_content_length);
+	g_object_unref (stream);
+	
+	while (!g_mime_parser_eos (full)) {
+		if (!(expected = g_mime_parser_construct_message (full, NULL))) {
+			ex = exception_new ("failed to parse message #%d", nmsg);
+			break;
+		}
+		
+		memset (&state, 0, sizeof (state));
+		state.depth = -1;
+		
+		if (!g_mime_parser_parse_events (events, NULL, &test_events_cb, &state)) {
+			ex = exception_new ("failed to parse the events of message #%d", nmsg);
+			g_object_unref (expected);
+			break;
+		}
+		
+		content_length = 0;
+		nparts = count_parts (expected->mime_part, &content_length);
+		nheaders = g_mime_header_list_get_count (((GMimeObject *) expected)->headers) +
+			g_mime_header_list_get_count (expected->mime_part->headers);
+		
+		if (state.error || state.depth != -1)
+			ex = exception_new ("unbalanced part events for message #%d", nmsg);
+		else if (state.nparts != nparts)
+			ex = exception_new ("expected %d part events for message #%d, got %d", nparts, nmsg, state.nparts);
+		else if (state.nheaders != nheaders)
+			ex = exception_new ("expected %d header events for message #%d, got %d", nheaders, nmsg, state.nheaders);
+		else if (state.content_length != content_length)
+			ex = exception_new ("expected %" G_GINT64_FORMAT " bytes of content for message #%d, got %" G_GINT64_FORMAT,
+					    content_length, nmsg, state.content_length);
+		else if (g_mime_parser_get_headers_begin (events) != g_mime_parser_get_headers_begin (full) ||
+			 g_mime_parser_tell (events) != g_mime_parser_tell (full))
+			ex = exception_new ("event parse of message #%d ended at the wrong offset", nmsg);
+		
+		g_object_unref (expected);
+		
+		if (ex != NULL)
+			break;
+		
+		nmsg++;
+	}
+	
+	if (ex == NULL && !g_mime_parser_eos (events))
+		ex = exception_new ("event parser did not reach the end of the mbox");
+	
+	g_object_unref (events);
+	g_object_unref (full);
+	
+	if (ex != NULL)
+		throw (ex);
+}
+
+typedef struct {
+	GPtrArray *expected;
+	GThread *thread;
+	Exception *ex;
+	guint index;
+	int foreign;
+} ForeachState;
+
+static char *
+message_summary (GMimeMessage *message, const char *marker, gint64 offset)
+{
+	GMimeStream *stream;
+	GByteArray *buffer;
+	const char *subject;
+	char *summary;
+	
+	if (!(subject = g_mime_message_get_subject (message)))
+		subject = "";
+	
+	stream = g_mime_stream_mem_new ();
+	g_mime_stream_printf (stream, "%s @ %" G_GINT64_FORMAT "\n", marker ? marker : "", offset);
+	g_mime_stream_printf (stream, "Subject: %s\n", subject);
+	print_mime_struct (stream, g_mime_message_get_mime_part (message), 0);
+	
+	buffer = g_mime_stream_mem_get_byte_array ((GMimeStreamMem *) stream);
+	summary = g_strndup ((char *) buffer->data, buffer->len);
+	g_object_unref (stream);
+	
+	return summary;
+}
+
+static void
+foreach_message_cb (GMimeMessage *message, const char *marker, gint64 offset, gpointer user_data)
+{
+	ForeachState *state = user_data;
+	char *summary;
+	
+	if (state->ex != NULL)
+		return;
+	
+	if (state->index >= state->expected->len) {
+		state->ex = exception_new ("too many messages");
+		return;
+	}
+	
+	summary = message_summary (message, marker, offset);
+	if (strcmp (summary, state->expected->pdata[state->index]) != 0)
+		state->ex = exception_new ("message #%u does not match", state->index);
+	g_free (summary);
+	
+	state->index++;
+}
+
+static void
+foreach_warning_cb (gint64 offset, GMimeParserWarning errcode, const gchar *item, gpointer user_data)
+{
+	ForeachState *state = user_data;
+	
+	/* warnings must be reported on the thread that is splitting the mbox */
+	if (g_thread_self () != state->thread)
+		state->foreign++;
+}
+
+static void
+test_foreach_message (GMimeStream *stream)
+{
+	GMimeParserOptions *options;
+	GMimeMessage *message;
+	GMimeParser *parser;
+	gboolean headers_only;
+	ForeachState state;
+	Exception *ex = NULL;
+	GMimeStream *mem;
+	int count, i, pass;
+	char *marker;
+	
+	state.expected = g_ptr_array_new_with_free_func (g_free);
+	state.thread = g_thread_self ();
+	
+	options = g_mime_parser_options_new ();
+	g_mime_parser_options_set_warning_callback (options, foreach_warning_cb, &state);
+	
+	parser = g_mime_parser_new ();
+	
+	mem = g_mime_stream_mem_new ();
+	g_mime_stream_reset (stream);
+	g_mime_stream_write_to_stream (stream, mem);
+	
+	/* the worker parsers must inherit the headers-only and arena settings */
+	for (pass = 0; pass < 2 && ex == NULL; pass++) {
+		headers_only = pass == 1;
+		
+		g_ptr_array_set_size (state.expected, 0);
+		
+		g_mime_stream_reset (stream);
+		g_mime_parser_init_with_stream (parser, stream);
+		g_mime_parser_set_format (parser, GMIME_FORMAT_MBOX);
+		g_mime_parser_set_headers_only (parser, headers_only);
+		g_mime_parser_set_use_arena (parser, headers_only);
+		
+		while (!g_mime_parser_eos (parser)) {
+			if (!(message = g_mime_parser_construct_message (parser, NULL)))
+				break;
+			
+			marker = g_mime_parser_get_mbox_marker (parser);
+			g_ptr_array_add (state.expected, message_summary (message, marker, g_mime_parser_get_mbox_marker_offset (parser)));
+			g_object_unref (message);
+			g_free (marker);
+		}
+		
+		/* split the mbox using both the buffered path and the in-memory path */
+		for (i = 0; i < 2 && ex == NULL; i++) {
+			GMimeStream *input = i == 0 ? stream : mem;
+			
+			g_mime_stream_reset (input);
+			g_mime_parser_init_with_stream (parser, input);
+			
+			state.index = 0;
+			state.foreign = 0;
+			state.ex = NULL;
+			
+			count = g_mime_parser_foreach_message (parser, options, 4, foreach_message_cb, &state);
+			
+			if (state.ex != NULL)
+				ex = state.ex;
+			else if (state.foreign > 0)
+				ex = exception_new ("%d warnings were reported from a worker thread", state.foreign);
+			else if (count != (int) state.expected->len || state.index != state.expected->len)
+				ex = exception_new ("expected %u messages, got %d", state.expected->len, count);
+			else if (!g_mime_parser_eos (parser))
+				ex = exception_new ("parser did not reach the end of the mbox");
+		}
+	}
+	
+	g_ptr_array_free (state.expected, TRUE);
+	g_mime_parser_options_free (options);
+	g_object_unref (parser);
+	g_object_unref (mem);
+	
+	if (ex != NULL)
+		throw (ex);
+}
+
 static gboolean
 streams_match (GMimeStream *istream, GMimeStream *ostream)
 {
@@ -275,7 +650,7 @@ int main (int argc, char **argv)
 {
 	const char *datadir = "data/mbox";
 	char input[256], output[256], *tmp, *p, *q;
-	GMimeStream *istream, *ostream, *mstream, *pstream;
+	GMimeStream *istream, *ostream, *mstream, *pstream, *mem;
 	GMimeParser *parser;
 	const char *dent;
 	const char *path;
@@ -284,7 +659,7 @@ int main (int argc, char **argv)
 	int i;
 #ifdef ENABLE_MBOX_MATCH
 	int fd;
-
+	
 	if (mkdir ("./tmp", 0755) == -1 && errno != EEXIST)
 		return 0;
 #endif
@@ -400,6 +775,55 @@ int main (int argc, char **argv)
 				if (!streams_match (ostream, pstream))
 					throw (exception_new ("summaries do not match for `%s'", dent));
 				
+				/* parse the mbox again, this time using a larger read buffer */
+				g_object_unref (pstream);
+				pstream = g_mime_stream_mem_new ();
+				
+				g_mime_stream_reset (istream);
+				g_mime_parser_init_with_stream (parser, istream);
+				g_mime_parser_set_buffer_size (parser, 0);
+				
+				if (g_mime_parser_get_buffer_size (parser) != 4096)
+					throw (exception_new ("buffer size was not clamped"));
+				
+				g_mime_parser_set_buffer_size (parser, 64 * 1024);
+				
+				if (g_mime_parser_get_buffer_size (parser) != 64 * 1024)
+					throw (exception_new ("buffer size check failed"));
+				
+				test_parser (parser, NULL, pstream);
+				
+				g_mime_stream_reset (ostream);
+				g_mime_stream_reset (pstream);
+				if (!streams_match (ostream, pstream))
+					throw (exception_new ("summaries do not match for `%s' using a 64 KiB read buffer", dent));
+				
+				/* parse the mbox once more, this time from memory (which the parser scans in place) */
+				g_object_unref (pstream);
+				pstream = g_mime_stream_mem_new ();
+				
+				mem = g_mime_stream_mem_new ();
+				g_mime_stream_reset (istream);
+				g_mime_stream_write_to_stream (istream, mem);
+				g_mime_stream_reset (mem);
+				
+				g_mime_parser_init_with_stream (parser, mem);
+				g_object_unref (mem);
+				
+				test_parser (parser, NULL, pstream);
+				
+				g_mime_stream_reset (ostream);
+				g_mime_stream_reset (pstream);
+				if (!streams_match (ostream, pstream))
+					throw (exception_new ("summaries do not match for `%s' when parsing from memory", dent));
+				
+				test_headers_only (istream, strstr (dent, "content-length") != NULL);
+				test_events (istream, strstr (dent, "content-length") != NULL);
+				
+				/* splitting the mbox doesn't respect Content-Length */
+				if (strstr (dent, "content-length") == NULL)
+					test_foreach_message (istream);
+				
 				testsuite_check_passed ();
 				
 #ifdef ENABLE_MBOX_MATCH
@@ -220,6 +220,144 @@ test_content_transfer_encoding (GMimePart *mime_part, GMimeEncodingConstraint co
 	testsuite_check_passed ();
 }
 
+static void
+digest_content (GMimeDataWrapper *content, gboolean canonical, unsigned char digest[16])
+{
+	GMimeStream *filtered, *stream;
+	GMimeFilter *filter;
+	
+	stream = g_mime_stream_null_new ();
+	filtered = g_mime_stream_filter_new (stream);
+	g_object_unref (stream);
+	
+	if (canonical) {
+		filter = g_mime_filter_unix2dos_new (FALSE);
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+	}
+	
+	filter = g_mime_filter_checksum_new (G_CHECKSUM_MD5);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	
+	g_mime_data_wrapper_write_to_stream (content, filtered);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	memset (digest, 0, 16);
+	g_mime_filter_checksum_get_digest ((GMimeFilterChecksum *) filter, digest, 16);
+	g_object_unref (filter);
+}
+
+static void
+check_content_analysis (GMimeDataWrapper *content)
+{
+	GMimeContentAnalysisFlags flags = GMIME_CONTENT_ANALYSIS_CHARSET | GMIME_CONTENT_ANALYSIS_MD5 | GMIME_CONTENT_ANALYSIS_MD5_CANONICAL;
+	const GMimeContentAnalysis *analysis;
+	GMimeStream *filtered, *stream;
+	unsigned char digest[16];
+	GMimeFilterBest *best;
+	GMimeFilter *filter;
+	int i;
+	
+	stream = g_mime_stream_null_new ();
+	filtered = g_mime_stream_filter_new (stream);
+	g_object_unref (stream);
+	
+	filter = g_mime_filter_best_new (GMIME_FILTER_BEST_CHARSET | GMIME_FILTER_BEST_ENCODING);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	best = (GMimeFilterBest *) filter;
+	
+	g_mime_data_wrapper_write_to_stream (content, filtered);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	try {
+		analysis = g_mime_data_wrapper_analyze (content, flags);
+		
+		if (analysis->length != best->total || analysis->count0 != best->count0 || analysis->count8 != best->count8)
+			throw (exception_new ("byte counts do not match"));
+		
+		if (analysis->hadfrom != best->hadfrom)
+			throw (exception_new ("From-line detection does not match"));
+		
+		if (strcmp (g_mime_content_analysis_get_best_charset (analysis), g_mime_filter_best_charset (best)) != 0)
+			throw (exception_new ("best charsets do not match"));
+		
+		for (i = GMIME_ENCODING_CONSTRAINT_7BIT; i <= GMIME_ENCODING_CONSTRAINT_BINARY; i++) {
+			if (g_mime_content_analysis_get_best_encoding (analysis, i) != g_mime_filter_best_encoding (best, i))
+				throw (exception_new ("best encodings do not match (constraint: %s)", constraints[i]));
+		}
+		
+		digest_content (content, FALSE, digest);
+		if (memcmp (analysis->md5, digest, 16) != 0)
+			throw (exception_new ("md5 digests do not match"));
+		
+		digest_content (content, TRUE, digest);
+		if (memcmp (analysis->canonical_md5, digest, 16) != 0)
+			throw (exception_new ("canonical md5 digests do not match"));
+		
+		/* the results should be cached until the content changes */
+		if (g_mime_data_wrapper_analyze (content, GMIME_CONTENT_ANALYSIS_MD5) != analysis)
+			throw (exception_new ("analysis was not cached"));
+		
+		g_object_unref (best);
+	} catch (ex) {
+		g_object_unref (best);
+		throw (ex);
+	} finally;
+}
+
+static void
+test_content_analysis (const char *datadir, const char *filename)
+{
+	const char *what = "GMimeDataWrapper::analyze()";
+	GMimeStream *stream, *encoded, *filtered;
+	GMimeDataWrapper *content, *base64;
+	GMimeFilter *filter;
+	char *path;
+	
+	testsuite_check ("%s (%s)", what, filename);
+	
+	path = g_build_filename (datadir, filename, NULL);
+	stream = g_mime_stream_fs_open (path, O_RDONLY, 0644, NULL);
+	g_free (path);
+	
+	if (stream == NULL) {
+		testsuite_check_failed ("%s failed: could not open %s", what, filename);
+		return;
+	}
+	
+	/* also analyze a base64 encoded copy to make sure the content gets decoded */
+	encoded = g_mime_stream_mem_new ();
+	filtered = g_mime_stream_filter_new (encoded);
+	filter = g_mime_filter_basic_new (GMIME_CONTENT_ENCODING_BASE64, TRUE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	g_mime_stream_write_to_stream (stream, filtered);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	g_mime_stream_reset (encoded);
+	g_mime_stream_reset (stream);
+	
+	content = g_mime_data_wrapper_new_with_stream (stream, GMIME_CONTENT_ENCODING_DEFAULT);
+	base64 = g_mime_data_wrapper_new_with_stream (encoded, GMIME_CONTENT_ENCODING_BASE64);
+	g_object_unref (encoded);
+	g_object_unref (stream);
+	
+	try {
+		check_content_analysis (content);
+		check_content_analysis (base64);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("%s failed: %s", what, ex->message);
+	} finally;
+	
+	g_object_unref (content);
+	g_object_unref (base64);
+}
+
 static GMimePart *
 create_mime_part (const char *type, const char *subtype, const char *datadir, const char *filename)
 {
@@ -560,6 +698,272 @@ cleanup:
 	g_object_unref (part);
 }
 
+#define PASSTHROUGH_PART1 \
+	"Content-Type: text/plain; charset=us-ascii\r\n" \
+	"Content-Transfer-Encoding: 7bit\r\n" \
+	"\r\n" \
+	"Hello, world!"
+
+#define PASSTHROUGH_PART2 \
+	"Content-Type: application/octet-stream; name=\"data.bin\"\r\n" \
+	"Content-Transfer-Encoding: base64\r\n" \
+	"\r\n" \
+	"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8=\r\n" \
+	"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8="
+
+static const char passthrough_message[] =
+	"From: Sender <sender@example.com>\r\n"
+	"Subject: passthrough\r\n"
+	"MIME-Version: 1.0\r\n"
+	"Content-Type: multipart/mixed; boundary=\"=-passthrough\"\r\n"
+	"\r\n"
+	"--=-passthrough\r\n"
+	PASSTHROUGH_PART1 "\r\n"
+	"--=-passthrough\r\n"
+	PASSTHROUGH_PART2 "\r\n"
+	"--=-passthrough--\r\n";
+
+static GMimeStream *
+open_tmp_stream (char **path)
+{
+	int fd;
+	
+	if ((fd = g_file_open_tmp ("gmime-passthrough-XXXXXX", path, NULL)) == -1)
+		return NULL;
+	
+	return g_mime_stream_fs_new (fd);
+}
+
+static void
+test_passthrough (void)
+{
+	const char *what = "GMimePart passthrough";
+	GMimeStream *stream, *ostream = NULL;
+	GMimeMessage *message = NULL;
+	char *path, *opath = NULL;
+	GMimeFormatOptions *options;
+	GMimeMultipart *multipart;
+	GByteArray *actual = NULL;
+	GMimeObject *part;
+	GMimeParser *parser;
+	char *str;
+	
+	testsuite_check ("%s", what);
+	
+	options = g_mime_format_options_clone (NULL);
+	g_mime_format_options_set_newline_format (options, GMIME_NEWLINE_FORMAT_UNIX);
+	g_mime_format_options_set_passthrough (options, TRUE);
+	
+	if (!(stream = open_tmp_stream (&path))) {
+		testsuite_check_failed ("%s failed: could not create a temporary file", what);
+		g_mime_format_options_free (options);
+		return;
+	}
+	
+	g_mime_stream_write (stream, passthrough_message, sizeof (passthrough_message) - 1);
+	g_mime_stream_reset (stream);
+	
+	parser = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_persist_stream (parser, TRUE);
+	message = g_mime_parser_construct_message (parser, NULL);
+	g_object_unref (parser);
+	
+	if (message == NULL || !GMIME_IS_MULTIPART (message->mime_part)) {
+		testsuite_check_failed ("%s failed: could not parse the message", what);
+		goto error;
+	}
+	
+	multipart = (GMimeMultipart *) message->mime_part;
+	part = g_mime_multipart_get_part (multipart, 0);
+	
+	/* an unmodified part should be written out exactly as it was parsed... */
+	str = g_mime_object_to_string (part, options);
+	if (strcmp (str, PASSTHROUGH_PART1) != 0) {
+		testsuite_check_failed ("%s failed: unmodified part was not copied verbatim", what);
+		g_free (str);
+		goto error;
+	}
+	g_free (str);
+	
+	/* ...but only when passthrough is enabled */
+	g_mime_format_options_set_passthrough (options, FALSE);
+	str = g_mime_object_to_string (part, options);
+	g_mime_format_options_set_passthrough (options, TRUE);
+	if (strchr (str, '\r') != NULL) {
+		testsuite_check_failed ("%s failed: part was copied verbatim without passthrough", what);
+		g_free (str);
+		goto error;
+	}
+	g_free (str);
+	
+	/* modifying the headers should force the part to be re-serialized */
+	g_mime_object_set_header (part, "X-Modified", "yes", NULL);
+	str = g_mime_object_to_string (part, options);
+	if (strchr (str, '\r') != NULL || strstr (str, "X-Modified: yes\n") == NULL) {
+		testsuite_check_failed ("%s failed: modified part was not re-serialized", what);
+		g_free (str);
+		goto error;
+	}
+	g_free (str);
+	
+	/* an unmodified part written to a file should also be copied verbatim */
+	if (!(ostream = open_tmp_stream (&opath))) {
+		testsuite_check_failed ("%s failed: could not create a temporary file", what);
+		goto error;
+	}
+	
+	part = g_mime_multipart_get_part (multipart, 1);
+	if (g_mime_object_write_to_stream (part, options, ostream) != sizeof (PASSTHROUGH_PART2) - 1) {
+		testsuite_check_failed ("%s failed: unexpected length written to file", what);
+		goto error;
+	}
+	
+	g_mime_stream_reset (ostream);
+	actual = g_byte_array_new ();
+	str = g_malloc (4096);
+	while (!g_mime_stream_eos (ostream)) {
+		ssize_t n;
+		
+		if ((n = g_mime_stream_read (ostream, str, 4096)) <= 0)
+			break;
+		
+		g_byte_array_append (actual, (guint8 *) str, n);
+	}
+	g_free (str);
+	
+	if (actual->len != sizeof (PASSTHROUGH_PART2) - 1 || memcmp (actual->data, PASSTHROUGH_PART2, actual->len) != 0) {
+		testsuite_check_failed ("%s failed: part was not copied verbatim to a file", what);
+		goto error;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	if (actual)
+		g_byte_array_free (actual, TRUE);
+	
+	if (ostream) {
+		g_object_unref (ostream);
+		unlink (opath);
+		g_free (opath);
+	}
+	
+	if (message)
+		g_object_unref (message);
+	
+	g_mime_format_options_free (options);
+	g_object_unref (stream);
+	unlink (path);
+	g_free (path);
+}
+
+static gboolean
+check_serialized_size (GMimeObject *object, GMimeFormatOptions *options, gint64 *size)
+{
+	gint64 expected;
+	char *str;
+	
+	/* Note: get the size first so that a stale cached size gets caught */
+	*size = g_mime_object_get_serialized_size (object, options);
+	
+	str = g_mime_object_to_string (object, options);
+	expected = strlen (str);
+	g_free (str);
+	
+	return *size == expected && g_mime_object_get_serialized_size (object, options) == expected;
+}
+
+static void
+test_serialized_size (void)
+{
+	const char *what = "GMimeObject::get_serialized_size()";
+	const char *replaced_text = "Hello, everyone in the whole wide world and beyond!\n";
+	GMimeFormatOptions *options;
+	GMimeMultipart *multipart;
+	GMimeMessage *message;
+	GMimeTextPart *text;
+	GMimeObject *part;
+	GMimeParser *parser;
+	GMimeStream *content;
+	GMimeStream *stream;
+	gint64 size, prev;
+	
+	testsuite_check ("%s", what);
+	
+	stream = g_mime_stream_mem_new_with_buffer (passthrough_message, sizeof (passthrough_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	message = g_mime_parser_construct_message (parser, NULL);
+	g_object_unref (parser);
+	g_object_unref (stream);
+	
+	options = g_mime_format_options_new ();
+	
+	try {
+		if (message == NULL || !GMIME_IS_MULTIPART (message->mime_part))
+			throw (exception_new ("could not parse the message"));
+		
+		multipart = (GMimeMultipart *) message->mime_part;
+		part = g_mime_multipart_get_part (multipart, 0);
+		
+		if (!check_serialized_size ((GMimeObject *) message, options, &size))
+			throw (exception_new ("unmodified message"));
+		
+		/* a change to a header deep inside the tree must invalidate the cached size */
+		prev = size;
+		g_mime_object_set_header (part, "X-Modified", "yes", NULL);
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("modified header"));
+		
+		/* ...as must a content-type parameter change */
+		prev = size;
+		g_mime_object_set_content_type_parameter (part, "format", "flowed");
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("modified content-type"));
+		
+		/* ...and a change to the content */
+		prev = size;
+		g_mime_text_part_set_text ((GMimeTextPart *) part, "Hello, everyone in the whole wide world!\n");
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("modified content"));
+		
+		/* ...even when only the stream of the existing content wrapper is replaced */
+		prev = size;
+		content = g_mime_stream_mem_new_with_buffer (replaced_text, strlen (replaced_text));
+		g_mime_data_wrapper_set_stream (g_mime_part_get_content ((GMimePart *) part), content);
+		g_object_unref (content);
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("replaced content stream"));
+		
+		/* ...and structural changes to a multipart */
+		prev = size;
+		text = g_mime_text_part_new ();
+		g_mime_text_part_set_text (text, "Another part.\n");
+		g_mime_multipart_add (multipart, (GMimeObject *) text);
+		g_object_unref (text);
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("added part"));
+		
+		prev = size;
+		g_mime_multipart_set_epilogue (multipart, "This is the epilogue.\n");
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("modified epilogue"));
+		
+		/* changing the format options must not reuse the cached size */
+		g_mime_format_options_set_newline_format (options, GMIME_NEWLINE_FORMAT_DOS);
+		if (!check_serialized_size ((GMimeObject *) message, options, &size) || size <= prev)
+			throw (exception_new ("different newline format"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("%s failed: %s", what, ex->message);
+	} finally;
+	
+	g_mime_format_options_free (options);
+	
+	if (message)
+		g_object_unref (message);
+}
+
 int main (int argc, char **argv)
 {
 	const char *datadir = "data/mime-part";
@@ -597,6 +1001,13 @@ int main (int argc, char **argv)
 	
 	test_text_part (datadir, "french-fable.txt", "iso-8859-1");
 	
+	test_content_analysis (datadir, "raptors.png");
+	test_content_analysis (datadir, "french-fable.txt");
+	test_content_analysis (datadir, "signed-body.txt");
+	
+	test_passthrough ();
+	test_serialized_size ();
+	
 	testsuite_end ();
 	
 	g_mime_shutdown ();
@@ -0,0 +1,282 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <gmime/gmime.h>
+
+#if !defined (G_OS_WIN32) || defined (__MINGW32__)
+#define ENABLE_ZENTIMER
+#endif
+#include "zentimer.h"
+
+#define BOUNDARY "=-parser-perf-boundary"
+
+static const char base64_alphabet[64] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static GMimeStream *
+build_message (int nparts, int nlines, int linelen)
+{
+	GMimeStream *stream;
+	char *line;
+	int i, j;
+	
+	stream = g_mime_stream_mem_new ();
+	line = g_malloc (linelen + 2);
+	
+	g_mime_stream_printf (stream, "From: Sender <sender@example.com>\n");
+	g_mime_stream_printf (stream, "To: Recipient <recipient@example.com>\n");
+	g_mime_stream_printf (stream, "Subject: parser throughput benchmark\n");
+	g_mime_stream_printf (stream, "Date: Fri, 1 Jan 2021 00:00:00 +0000\n");
+	g_mime_stream_printf (stream, "Message-Id: <parser-perf@example.com>\n");
+	g_mime_stream_printf (stream, "MIME-Version: 1.0\n");
+	g_mime_stream_printf (stream, "Content-Type: multipart/mixed; boundary=\"%s\"\n\n", BOUNDARY);
+	
+	for (i = 0; i < nparts; i++) {
+		g_mime_stream_printf (stream, "--%s\n", BOUNDARY);
+		g_mime_stream_printf (stream, "Content-Type: application/octet-stream; name=\"part%d.bin\"\n", i);
+		g_mime_stream_printf (stream, "Content-Transfer-Encoding: base64\n\n");
+		
+		for (j = 0; j < nlines; j++) {
+			int k;
+			
+			for (k = 0; k < linelen; k++)
+				line[k] = base64_alphabet[(i * 7 + j * 13 + k * 31) & 63];
+			line[linelen] = '\n';
+			
+			g_mime_stream_write (stream, line, linelen + 1);
+		}
+	}
+	
+	g_mime_stream_printf (stream, "--%s--\n", BOUNDARY);
+	g_mime_stream_reset (stream);
+	g_free (line);
+	
+	return stream;
+}
+
+static void
+bench_parser (const char *what, GMimeStream *stream, gboolean persist, size_t bufsize, int iterations)
+{
+	GMimeMessage *message;
+	GMimeParser *parser;
+	gint64 length;
+	double elapsed;
+	int i;
+	
+	length = g_mime_stream_length (stream);
+	
+	ZenTimerStart (NULL);
+	for (i = 0; i < iterations; i++) {
+		g_mime_stream_reset (stream);
+		
+		parser = g_mime_parser_new_with_stream (stream);
+		g_mime_parser_set_persist_stream (parser, persist);
+		g_mime_parser_set_buffer_size (parser, bufsize);
+		message = g_mime_parser_construct_message (parser, NULL);
+		g_object_unref (parser);
+		
+		if (message == NULL) {
+			fprintf (stderr, "failed to parse message\n");
+			exit (EXIT_FAILURE);
+		}
+		
+		g_object_unref (message);
+	}
+	ZenTimerStop (NULL);
+	
+#ifdef ENABLE_ZENTIMER
+	elapsed = ZenTimerElapsed (NULL, NULL);
+#else
+	elapsed = 0.0;
+#endif
+	
+	fprintf (stdout, "%-40s %s, %7lu byte buffer: %8.2f MB/s\n",
+		 what, persist ? "persist" : "   copy", (unsigned long) bufsize,
+		 elapsed > 0.0 ? ((length * (double) iterations) / (1024.0 * 1024.0)) / elapsed : 0.0);
+}
+
+static GMimeStream *
+build_header_corpus_message (int n)
+{
+	GMimeStream *stream;
+	int i;
+	
+	stream = g_mime_stream_mem_new ();
+	
+	for (i = 0; i < 4; i++) {
+		g_mime_stream_printf (stream, "Received: from relay%d.example.com (relay%d.example.com [192.0.2.%d])\n"
+				      "\tby mx.example.com with ESMTPS id %08x for <recipient@example.com>;\n"
+				      "\tFri, 1 Jan 2021 00:00:%02d +0000\n", i, i, i + 1, n * 4 + i, i);
+	}
+	
+	g_mime_stream_printf (stream, "DKIM-Signature: v=1; a=rsa-sha256; c=relaxed/relaxed; d=example.com; s=selector;\n"
+			      "\th=from:to:subject:date:message-id:mime-version:content-type;\n"
+			      "\tbh=47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=;\n"
+			      "\tb=dGhpcyBpcyBub3QgYSByZWFsIHNpZ25hdHVyZSwganVzdCBzb21lIGZpbGxlciB0ZXh0\n"
+			      "\t YW5kIG1vcmUgZmlsbGVyIHRleHQgdG8gbWFrZSB0aGUgaGVhZGVyIHJlYWxpc3RpYw==\n");
+	g_mime_stream_printf (stream, "From: Sender %d <sender%d@example.com>\n", n, n);
+	g_mime_stream_printf (stream, "To: Recipient <recipient@example.com>, Other <other@example.com>\n");
+	g_mime_stream_printf (stream, "Cc: List <list@lists.example.com>\n");
+	g_mime_stream_printf (stream, "Subject: header corpus message %d\n", n);
+	g_mime_stream_printf (stream, "Date: Fri, 1 Jan 2021 00:00:00 +0000\n");
+	g_mime_stream_printf (stream, "Message-Id: <corpus-%d@example.com>\n", n);
+	g_mime_stream_printf (stream, "In-Reply-To: <corpus-%d@example.com>\n", n - 1);
+	g_mime_stream_printf (stream, "References: <corpus-%d@example.com> <corpus-%d@example.com>\n", n - 2, n - 1);
+	g_mime_stream_printf (stream, "List-Id: Example List <list.example.com>\n");
+	g_mime_stream_printf (stream, "List-Unsubscribe: <mailto:list-unsubscribe@example.com>\n");
+	g_mime_stream_printf (stream, "X-Mailer: parser benchmark\n");
+	g_mime_stream_printf (stream, "MIME-Version: 1.0\n");
+	g_mime_stream_printf (stream, "Content-Type: multipart/alternative; boundary=\"%s\"\n\n", BOUNDARY);
+	g_mime_stream_printf (stream, "--%s\n", BOUNDARY);
+	g_mime_stream_printf (stream, "Content-Type: text/plain; charset=us-ascii\n");
+	g_mime_stream_printf (stream, "Content-Transfer-Encoding: 7bit\n\n");
+	g_mime_stream_printf (stream, "This is message %d.\n", n);
+	g_mime_stream_printf (stream, "--%s\n", BOUNDARY);
+	g_mime_stream_printf (stream, "Content-Type: text/html; charset=us-ascii\n");
+	g_mime_stream_printf (stream, "Content-Transfer-Encoding: 7bit\n\n");
+	g_mime_stream_printf (stream, "<p>This is message %d.</p>\n", n);
+	g_mime_stream_printf (stream, "--%s--\n", BOUNDARY);
+	g_mime_stream_reset (stream);
+	
+	return stream;
+}
+
+static double
+resident_size (void)
+{
+#ifdef __linux__
+	unsigned long size, resident;
+	FILE *fp;
+	int n;
+	
+	if (!(fp = fopen ("/proc/self/statm", "r")))
+		return 0.0;
+	
+	n = fscanf (fp, "%lu %lu", &size, &resident);
+	fclose (fp);
+	
+	if (n != 2)
+		return 0.0;
+	
+	return ((double) resident * sysconf (_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#else
+	return 0.0;
+#endif
+}
+
+/* Parses @nmessages header-heavy messages and keeps all of them alive
+ * so that the growth of the resident set reflects what it costs to
+ * hold a parsed mailbox in memory. Run each mode in a fresh process
+ * so that memory freed by one mode is not reused by the other. */
+static void
+bench_header_corpus (gboolean use_arena, int nmessages)
+{
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	GPtrArray *messages;
+	double before, after;
+	double elapsed;
+	int i;
+	
+	messages = g_ptr_array_new_full (nmessages, g_object_unref);
+	before = resident_size ();
+	
+	ZenTimerStart (NULL);
+	for (i = 0; i < nmessages; i++) {
+		stream = build_header_corpus_message (i);
+		parser = g_mime_parser_new_with_stream (stream);
+		g_mime_parser_set_persist_stream (parser, FALSE);
+		g_mime_parser_set_use_arena (parser, use_arena);
+		message = g_mime_parser_construct_message (parser, NULL);
+		g_object_unref (parser);
+		g_object_unref (stream);
+		
+		if (message == NULL) {
+			fprintf (stderr, "failed to parse message\n");
+			exit (EXIT_FAILURE);
+		}
+		
+		g_ptr_array_add (messages, message);
+	}
+	ZenTimerStop (NULL);
+	
+	after = resident_size ();
+	
+#ifdef ENABLE_ZENTIMER
+	elapsed = ZenTimerElapsed (NULL, NULL);
+#else
+	elapsed = 0.0;
+#endif
+	
+	fprintf (stdout, "%d header-heavy messages, %s: %8.3f seconds, %8.1f MB resident growth\n",
+		 nmessages, use_arena ? "arena" : " heap", elapsed, after - before);
+	
+	g_ptr_array_free (messages, TRUE);
+}
+
+int main (int argc, char **argv)
+{
+	static const size_t bufsizes[] = { 4096, 64 * 1024, 1024 * 1024 };
+	GMimeStream *stream;
+	int iterations = 20;
+	guint i;
+	
+	g_mime_init ();
+	
+	if (argc > 1)
+		iterations = MAX (atoi (argv[1]), 1);
+	
+	if (argc > 2 && (!strcmp (argv[2], "heap") || !strcmp (argv[2], "arena"))) {
+		/* e.g. test-parser-perf 100000 arena */
+		bench_header_corpus (!strcmp (argv[2], "arena"), iterations);
+		g_mime_shutdown ();
+		return 0;
+	}
+	
+	for (i = 0; i < G_N_ELEMENTS (bufsizes); i++) {
+		/* 4 x ~5 MB base64 attachments with standard 76-column lines */
+		stream = build_message (4, 65536, 76);
+		bench_parser ("base64 attachments, 76-column lines", stream, TRUE, bufsizes[i], iterations);
+		bench_parser ("base64 attachments, 76-column lines", stream, FALSE, bufsizes[i], iterations);
+		g_object_unref (stream);
+		
+		/* same amount of data, but in very short lines */
+		stream = build_message (4, 262144, 16);
+		bench_parser ("base64 attachments, 16-column lines", stream, TRUE, bufsizes[i], iterations);
+		bench_parser ("base64 attachments, 16-column lines", stream, FALSE, bufsizes[i], iterations);
+		g_object_unref (stream);
+	}
+	
+	g_mime_shutdown ();
+	
+	return 0;
+}
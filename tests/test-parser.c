@@ -157,22 +157,33 @@ print_mime_struct_iter (GMimeMessage *message)
 #endif /* PRINT_MIME_STRUCT_ITER */
 
 static void
-test_parser (GMimeStream *stream)
+test_parser (GMimeStream *stream, size_t bufsize)
 {
 	GMimeFormatOptions *format = g_mime_format_options_get_default ();
 	GMimeParser *parser;
 	GMimeMessage *message;
+	gint64 length;
 	char *text;
 	
 	fprintf (stdout, "\nTesting MIME parser...\n\n");
 	
+	length = g_mime_stream_length (stream);
+	
 	parser = g_mime_parser_new ();
 	g_mime_parser_init_with_stream (parser, stream);
 	
+	if (bufsize > 0)
+		g_mime_parser_set_buffer_size (parser, bufsize);
+	
 	ZenTimerStart (NULL);
 	message = g_mime_parser_construct_message (parser, NULL);
 	ZenTimerStop (NULL);
 	ZenTimerReport (NULL, "gmime::parser_construct_message");
+#ifdef ENABLE_ZENTIMER
+	if (length > 0)
+		fprintf (stderr, "ZenTimer: gmime::parser_construct_message throughput: %.2f MB/s\n",
+			 (length / (1024.0 * 1024.0)) / ZenTimerElapsed (NULL, NULL));
+#endif
 	
 	g_object_unref (parser);
 	
@@ -235,6 +246,7 @@ int main (int argc, char **argv)
 {
 	char *filename = NULL;
 	GMimeStream *stream;
+	size_t bufsize = 0;
 	int fd;
 	
 	g_mime_init ();
@@ -244,6 +256,10 @@ int main (int argc, char **argv)
 	else
 		return 0;
 	
+	/* optional read buffer size for the parser (in bytes) */
+	if (argc > 2)
+		bufsize = strtoul (argv[2], NULL, 10);
+	
 	if ((fd = open (filename, O_RDONLY, 0)) == -1)
 		return 0;
 	
@@ -268,7 +284,7 @@ int main (int argc, char **argv)
 	stream = istream;
 #endif
 	
-	test_parser (stream);
+	test_parser (stream, bufsize);
 	
 	g_object_unref (stream);
 	
@@ -197,9 +197,143 @@ test_stream_buffer_gets (const char *filename)
 		g_object_unref (buffered);
 	}
 	
+	testsuite_check ("GMimeStreamBuffer::gets() (small blocks, readahead)");
+	try {
+		g_mime_stream_reset (stream);
+		buffered = g_mime_stream_buffer_new_with_size (stream, GMIME_STREAM_BUFFER_BLOCK_READ, 13);
+		g_mime_stream_buffer_set_readahead ((GMimeStreamBuffer *) buffered, TRUE);
+		test_stream_gets (buffered, filename);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("GMimeStreamBuffer::gets() (small blocks, readahead) failed: %s",
+					ex->message);
+	} finally {
+		g_object_unref (buffered);
+	}
+	
+	testsuite_check ("g_mime_stream_buffer_gets() (unbuffered)");
+	try {
+		g_mime_stream_reset (stream);
+		test_stream_gets (stream, filename);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("g_mime_stream_buffer_gets() (unbuffered) failed: %s",
+					ex->message);
+	} finally;
+	
 	g_object_unref (stream);
 }
 
+static void
+check_writev (GMimeStream *stream, GMimeStream *output, GMimeStreamIOVector *vector, size_t count, GByteArray *expected)
+{
+	GByteArray *actual;
+	gint64 nwritten;
+	gboolean match;
+	char buf[4096];
+	ssize_t n;
+	
+	if ((nwritten = g_mime_stream_writev (stream, vector, count)) != (gint64) expected->len)
+		throw (exception_new ("wrote %" G_GINT64_FORMAT " bytes instead of %u", nwritten, expected->len));
+	
+	if (g_mime_stream_tell (stream) != (gint64) expected->len)
+		throw (exception_new ("stream is at the wrong position"));
+	
+	g_mime_stream_flush (stream);
+	g_mime_stream_reset (output);
+	
+	actual = g_byte_array_new ();
+	while ((n = g_mime_stream_read (output, buf, sizeof (buf))) > 0)
+		g_byte_array_append (actual, (guint8 *) buf, n);
+	
+	match = actual->len == expected->len && !memcmp (actual->data, expected->data, actual->len);
+	g_byte_array_free (actual, TRUE);
+	
+	if (!match)
+		throw (exception_new ("content does not match"));
+}
+
+static void
+test_stream_writev (void)
+{
+	GMimeStreamIOVector vector[150];
+	GMimeStream *stream, *output;
+	GByteArray *expected;
+	char data[256];
+	char *path;
+	size_t i;
+	int fd;
+	
+	for (i = 0; i < sizeof (data); i++)
+		data[i] = (char) i;
+	
+	/* more blocks than GMimeStreamFs hands to a single pwritev() call,
+	 * with some empty ones mixed in */
+	expected = g_byte_array_new ();
+	for (i = 0; i < G_N_ELEMENTS (vector); i++) {
+		vector[i].data = data + (i % 64);
+		vector[i].len = (i % 5) == 0 ? 0 : ((i * 7) % 128) + 1;
+		g_byte_array_append (expected, vector[i].data, vector[i].len);
+	}
+	
+	testsuite_check ("GMimeStreamFs::writev()");
+	if ((fd = g_file_open_tmp ("gmime-streams-XXXXXX", &path, NULL)) != -1) {
+		stream = g_mime_stream_fs_new (fd);
+		
+		try {
+			check_writev (stream, stream, vector, G_N_ELEMENTS (vector), expected);
+			testsuite_check_passed ();
+		} catch (ex) {
+			testsuite_check_failed ("GMimeStreamFs::writev() failed: %s", ex->message);
+		} finally {
+			g_object_unref (stream);
+			unlink (path);
+			g_free (path);
+		}
+	} else {
+		testsuite_check_failed ("GMimeStreamFs::writev() failed: could not create a temporary file");
+	}
+	
+	testsuite_check ("GMimeStreamMem::writev()");
+	stream = g_mime_stream_mem_new ();
+	try {
+		check_writev (stream, stream, vector, G_N_ELEMENTS (vector), expected);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("GMimeStreamMem::writev() failed: %s", ex->message);
+	} finally {
+		g_object_unref (stream);
+	}
+	
+	testsuite_check ("GMimeStreamBuffer::writev() (gathered)");
+	output = g_mime_stream_mem_new ();
+	stream = g_mime_stream_buffer_new_with_size (output, GMIME_STREAM_BUFFER_BLOCK_WRITE, 16384);
+	try {
+		check_writev (stream, output, vector, G_N_ELEMENTS (vector), expected);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("GMimeStreamBuffer::writev() (gathered) failed: %s", ex->message);
+	} finally {
+		g_object_unref (stream);
+		g_object_unref (output);
+	}
+	
+	testsuite_check ("GMimeStreamBuffer::writev() (overflow)");
+	output = g_mime_stream_mem_new ();
+	stream = g_mime_stream_buffer_new (output, GMIME_STREAM_BUFFER_BLOCK_WRITE);
+	try {
+		check_writev (stream, output, vector, G_N_ELEMENTS (vector), expected);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("GMimeStreamBuffer::writev() (overflow) failed: %s", ex->message);
+	} finally {
+		g_object_unref (stream);
+		g_object_unref (output);
+	}
+	
+	g_byte_array_free (expected, TRUE);
+}
+
 
 #if 0
 static void
@@ -463,6 +597,213 @@ check_stream_buffer (const char *input, const char *output, const char *filename
 	return TRUE;
 }
 
+static gboolean
+check_stream_bytes (const char *input, const char *output, const char *filename, gint64 start, gint64 end)
+{
+	GMimeStream *streams[2], *stream;
+	Exception *ex = NULL;
+	GBytes *bytes, *slice;
+	char *content;
+	gsize len;
+	int fd;
+	
+	if (!g_file_get_contents (input, &content, &len, NULL))
+		return FALSE;
+	
+	if ((fd = open (output, O_RDONLY, 0)) == -1) {
+		g_free (content);
+		return FALSE;
+	}
+	
+	bytes = g_bytes_new_take (content, len);
+	stream = g_mime_stream_bytes_new (bytes);
+	
+	streams[0] = g_mime_stream_substream (stream, start, end);
+	g_object_unref (stream);
+	
+	streams[1] = g_mime_stream_fs_new (fd);
+	
+	/* the substream must share the original data rather than copy it */
+	slice = g_mime_stream_bytes_get_bytes ((GMimeStreamBytes *) streams[0]);
+	if (g_bytes_get_size (slice) > 0 && g_bytes_get_data (slice, NULL) != (const char *) content + start) {
+		ex = exception_new ("GMimeStreamBytes substream does not share its data `%s'", filename);
+		g_bytes_unref (slice);
+		goto cleanup;
+	}
+	
+	g_bytes_unref (slice);
+	
+	if (!streams_match (streams, filename)) {
+		ex = exception_new ("GMimeStreamBytes streams did not match for `%s'", filename);
+		goto cleanup;
+	}
+	
+	if (!g_mime_stream_eos (streams[0])) {
+		ex = exception_new ("GMimeStreamBytes is not at the end-of-stream `%s'", filename);
+		goto cleanup;
+	}
+	
+	if (g_mime_stream_write (streams[0], "x", 1) != -1) {
+		ex = exception_new ("GMimeStreamBytes should not be writable `%s'", filename);
+		goto cleanup;
+	}
+	
+	/* an empty substream is still at the end-of-stream after a reset */
+	g_mime_stream_reset (streams[0]);
+	if (g_mime_stream_length (streams[0]) > 0 && g_mime_stream_eos (streams[0])) {
+		ex = exception_new ("GMimeStreamBytes did not properly reset `%s'", filename);
+		goto cleanup;
+	}
+	
+cleanup:
+	
+	g_object_unref (streams[0]);
+	g_object_unref (streams[1]);
+	g_bytes_unref (bytes);
+	
+	if (ex != NULL)
+		throw (ex);
+	
+	return TRUE;
+}
+
+static gboolean
+check_write_to_stream (const char *input, const char *output, const char *filename, gint64 start, gint64 end)
+{
+	GMimeStream *streams[2], *stream, *source;
+	Exception *ex = NULL;
+	gint64 nwritten;
+	int fd[2];
+	
+	if ((fd[0] = open (input, O_RDONLY, 0)) == -1)
+		return FALSE;
+	
+	if ((fd[1] = open (output, O_RDONLY, 0)) == -1) {
+		close (fd[0]);
+		return FALSE;
+	}
+	
+	/* GMimeStreamFs -> GMimeStreamMem goes through the generic copy loop */
+	stream = g_mime_stream_fs_new (fd[0]);
+	source = g_mime_stream_substream (stream, start, end);
+	g_object_unref (stream);
+	
+	stream = g_mime_stream_mem_new ();
+	nwritten = g_mime_stream_write_to_stream (source, stream);
+	g_object_unref (source);
+	
+	/* GMimeStreamMem -> GMimeStreamMem writes the buffer out directly */
+	streams[0] = g_mime_stream_mem_new ();
+	g_mime_stream_reset (stream);
+	if (g_mime_stream_write_to_stream (stream, streams[0]) != nwritten)
+		nwritten = -1;
+	g_object_unref (stream);
+	
+	g_mime_stream_reset (streams[0]);
+	streams[1] = g_mime_stream_fs_new (fd[1]);
+	
+	if (nwritten == -1)
+		ex = exception_new ("g_mime_stream_write_to_stream() failed for `%s'", filename);
+	else if (!streams_match (streams, filename))
+		ex = exception_new ("g_mime_stream_write_to_stream() streams did not match for `%s'", filename);
+	
+	g_object_unref (streams[0]);
+	g_object_unref (streams[1]);
+	
+	if (ex != NULL)
+		throw (ex);
+	
+	return TRUE;
+}
+
+static gboolean
+check_write_to_stream_fs (const char *input, const char *output, const char *filename, gint64 start, gint64 end)
+{
+	const char *names[3];
+	GMimeStream *sources[3], *streams[2], *stream, *dest;
+	const char *prefix = "Prefix: ";
+	size_t prelen = strlen (prefix);
+	Exception *ex = NULL;
+	gint64 nwritten, len;
+	int fd, i, n = 0;
+	GBytes *bytes;
+	char *content;
+	gsize size;
+	char *path;
+	
+	if ((fd = open (input, O_RDONLY, 0)) == -1)
+		return FALSE;
+	
+	stream = g_mime_stream_fs_new (fd);
+	names[n] = "GMimeStreamFs";
+	sources[n++] = g_mime_stream_substream (stream, start, end);
+	g_object_unref (stream);
+	
+#ifdef HAVE_MMAP
+	if ((fd = open (input, O_RDONLY, 0)) != -1) {
+		stream = g_mime_stream_mmap_new (fd, PROT_READ, MAP_PRIVATE);
+		names[n] = "GMimeStreamMmap";
+		sources[n++] = g_mime_stream_substream (stream, start, end);
+		g_object_unref (stream);
+	}
+#endif /* HAVE_MMAP */
+	
+	if (g_file_get_contents (input, &content, &size, NULL)) {
+		bytes = g_bytes_new_take (content, size);
+		stream = g_mime_stream_bytes_new (bytes);
+		names[n] = "GMimeStreamBytes";
+		sources[n++] = g_mime_stream_substream (stream, start, end);
+		g_object_unref (stream);
+		g_bytes_unref (bytes);
+	}
+	
+	len = g_mime_stream_length (sources[0]);
+	
+	/* copy each source into a GMimeStreamFs after some leading content,
+	 * which exercises the fs -> fs kernel copy and the in-memory fast
+	 * paths, all of which have to honor the destination's position */
+	for (i = 0; i < n && ex == NULL; i++) {
+		if ((fd = g_file_open_tmp ("gmime-streams-XXXXXX", &path, NULL)) == -1) {
+			ex = exception_new ("could not create a temporary file for `%s'", filename);
+			break;
+		}
+		
+		dest = g_mime_stream_fs_new (fd);
+		
+		if (g_mime_stream_write (dest, prefix, prelen) != (ssize_t) prelen) {
+			ex = exception_new ("could not write to the temporary file for `%s'", filename);
+		} else if ((nwritten = g_mime_stream_write_to_stream (sources[i], dest)) != len) {
+			ex = exception_new ("%s: wrote %" G_GINT64_FORMAT " bytes instead of %" G_GINT64_FORMAT " for `%s'",
+					    names[i], nwritten, len, filename);
+		} else if (g_mime_stream_tell (dest) != (gint64) prelen + len) {
+			ex = exception_new ("%s: destination is at the wrong position for `%s'", names[i], filename);
+		} else if ((fd = open (output, O_RDONLY, 0)) == -1) {
+			ex = exception_new ("could not open `%s'", filename);
+		} else {
+			streams[0] = g_mime_stream_fs_new (fd);
+			streams[1] = g_mime_stream_substream (dest, prelen, -1);
+			
+			if (!streams_match (streams, filename))
+				ex = exception_new ("%s: streams did not match for `%s'", names[i], filename);
+			
+			g_object_unref (streams[0]);
+			g_object_unref (streams[1]);
+		}
+		
+		g_object_unref (dest);
+		unlink (path);
+		g_free (path);
+	}
+	
+	for (i = 0; i < n; i++)
+		g_object_unref (sources[i]);
+	
+	if (ex != NULL)
+		throw (ex);
+	
+	return TRUE;
+}
+
 static gboolean
 check_stream_gio (const char *input, const char *output, const char *filename, gint64 start, gint64 end)
 {
@@ -539,7 +880,10 @@ static struct {
 	{ "GMimeStreamMmap",   check_stream_mmap   },
 #endif /* HAVE_MMAP */
 	{ "GMimeStreamBuffer", check_stream_buffer },
+	{ "GMimeStreamBytes",  check_stream_bytes  },
 	{ "GMimeStreamGIO",    check_stream_gio    },
+	{ "g_mime_stream_write_to_stream", check_write_to_stream },
+	{ "g_mime_stream_write_to_stream to GMimeStreamFs", check_write_to_stream_fs },
 };
 
 static void
@@ -783,6 +1127,8 @@ int main (int argc, char **argv)
 		test_stream_buffer_gets (path);
 	}
 	
+	test_stream_writev ();
+	
 	if (gen_data && stream_name && testsuite_total_errors () == 0) {
 		/* since all tests were successful, unlink the generated test data */
 		strcpy (p, stream_name);
@@ -0,0 +1,420 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gmime/gmime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "testsuite.h"
+
+extern int verbose;
+
+#define v(x) if (verbose > 3) x
+
+#define NTHREADS    8
+#define ITERATIONS  250
+#define NREGISTERED 64
+#define SLICE_SIZE  (64 * 1024)
+
+/* Note: the try/catch macros use global state, so the worker threads
+ * below must never use them. Instead, they just count the mismatches
+ * and the main thread reports the results. */
+
+static const char *messages[] = {
+	"From: Jane Doe <jane@example.com>\n"
+	"To: John Doe <john@example.com>\n"
+	"Subject: =?iso-8859-1?q?caf=E9_cr=E8me?=\n"
+	"Date: Fri, 1 Jan 2021 00:00:00 +0000\n"
+	"Message-Id: <threads-1@example.com>\n"
+	"MIME-Version: 1.0\n"
+	"Content-Type: text/plain; charset=iso-8859-1\n"
+	"Content-Transfer-Encoding: quoted-printable\n"
+	"\n"
+	"Un caf=E9 cr=E8me, s'il vous pla=EEt.\n",
+
+	"From: =?koi8-r?b?8NLJ18XU?= <privet@example.com>\n"
+	"To: undisclosed-recipients:;\n"
+	"Subject: multipart with mixed charsets\n"
+	"Message-Id: <threads-2@example.com>\n"
+	"MIME-Version: 1.0\n"
+	"Content-Type: multipart/mixed; boundary=\"=-outer\"\n"
+	"\n"
+	"--=-outer\n"
+	"Content-Type: text/plain; charset=koi8-r\n"
+	"Content-Transfer-Encoding: base64\n"
+	"\n"
+	"8NLJ18XUIMzA18nNydEK\n"
+	"--=-outer\n"
+	"Content-Type: text/plain; charset=windows-1252\n"
+	"\n"
+	"Smart \x93quotes\x94 and an \x80 sign.\n"
+	"--=-outer\n"
+	"Content-Type: text/plain; charset=x-thread-test-bogus\n"
+	"\n"
+	"This charset does not exist.\n"
+	"--=-outer\n"
+	"Content-Type: application/octet-stream; name=\"data.bin\"\n"
+	"Content-Disposition: attachment; filename=\"data.bin\"\n"
+	"Content-Transfer-Encoding: base64\n"
+	"\n"
+	"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8=\n"
+	"--=-outer--\n",
+
+	"From: Forwarder <fwd@example.com>\n"
+	"Subject: Fwd: nested message\n"
+	"Message-Id: <threads-3@example.com>\n"
+	"MIME-Version: 1.0\n"
+	"Content-Type: multipart/mixed; boundary=\"=-fwd\"\n"
+	"\n"
+	"--=-fwd\n"
+	"Content-Type: text/plain; charset=us-ascii\n"
+	"\n"
+	"See the attached message.\n"
+	"--=-fwd\n"
+	"Content-Type: message/rfc822\n"
+	"\n"
+	"From: Original <orig@example.com>\n"
+	"Subject: =?utf-8?b?w7xiZXIgZ3LDvMOfZQ==?=\n"
+	"MIME-Version: 1.0\n"
+	"Content-Type: multipart/alternative; boundary=\"=-alt\"\n"
+	"\n"
+	"--=-alt\n"
+	"Content-Type: text/plain; charset=iso-8859-15\n"
+	"Content-Transfer-Encoding: quoted-printable\n"
+	"\n"
+	"Gr=FC=DFe und =A4 100.\n"
+	"--=-alt\n"
+	"Content-Type: text/html; charset=utf-8\n"
+	"\n"
+	"<p>Gr\xc3\xbc\xc3\x9f" "e</p>\n"
+	"--=-alt--\n"
+	"\n"
+	"--=-fwd--\n",
+};
+
+typedef struct {
+	char **expected;
+	int id;
+	int mismatches;
+	int failures;
+} ThreadData;
+
+static void
+summarize_part (GMimeObject *parent, GMimeObject *part, gpointer user_data)
+{
+	GString *summary = user_data;
+	char *str;
+	
+	str = g_mime_content_type_get_mime_type (g_mime_object_get_content_type (part));
+	g_string_append_printf (summary, "[%s]\n", str);
+	g_free (str);
+	
+	if (GMIME_IS_TEXT_PART (part)) {
+		if ((str = g_mime_text_part_get_text ((GMimeTextPart *) part))) {
+			g_string_append (summary, str);
+			g_free (str);
+		}
+	} else if (GMIME_IS_PART (part) && !GMIME_IS_MULTIPART (part)) {
+		GMimeDataWrapper *content = g_mime_part_get_content ((GMimePart *) part);
+		GMimeStream *stream = g_mime_stream_null_new ();
+		
+		g_mime_data_wrapper_write_to_stream (content, stream);
+		g_string_append_printf (summary, "%lu bytes\n", (unsigned long) ((GMimeStreamNull *) stream)->written);
+		g_object_unref (stream);
+	}
+}
+
+static char *
+summarize (const char *text)
+{
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	GString *summary;
+	char *str;
+	
+	stream = g_mime_stream_mem_new_with_buffer (text, strlen (text));
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	message = g_mime_parser_construct_message (parser, NULL);
+	g_object_unref (parser);
+	
+	if (message == NULL)
+		return NULL;
+	
+	summary = g_string_new ("");
+	g_string_append_printf (summary, "Subject: %s\n", g_mime_message_get_subject (message));
+	
+	str = internet_address_list_to_string (g_mime_message_get_from (message), NULL, FALSE);
+	g_string_append_printf (summary, "From: %s\n", str);
+	g_free (str);
+	
+	g_mime_message_foreach (message, summarize_part, summary);
+	
+	str = g_mime_object_to_string ((GMimeObject *) message, NULL);
+	g_string_append (summary, str);
+	g_free (str);
+	
+	g_object_unref (message);
+	
+	return g_string_free (summary, FALSE);
+}
+
+static gpointer
+parse_thread (gpointer user_data)
+{
+	ThreadData *data = user_data;
+	char charset[64], *summary;
+	const char *iconv_name;
+	guint n, i;
+	
+	for (i = 0; i < ITERATIONS; i++) {
+		n = (data->id + i) % G_N_ELEMENTS (messages);
+		
+		if (!(summary = summarize (messages[n]))) {
+			data->failures++;
+			continue;
+		}
+		
+		if (strcmp (summary, data->expected[n]) != 0)
+			data->mismatches++;
+		
+		g_free (summary);
+		
+		/* hammer the charset map with names that are not yet in it */
+		g_snprintf (charset, sizeof (charset), "x-thread-%d-charset-%u", data->id, i % 32);
+		iconv_name = g_mime_charset_iconv_name (charset);
+		if (iconv_name == NULL || strcmp (iconv_name, charset) != 0)
+			data->mismatches++;
+		
+		/* ...as well as with names that are */
+		iconv_name = g_mime_charset_iconv_name ((i & 1) ? "ISO-8859-1" : "Windows-1252");
+		if (iconv_name == NULL)
+			data->failures++;
+	}
+	
+	return NULL;
+}
+
+static gpointer
+register_thread (gpointer user_data)
+{
+	char subtype[64];
+	guint i;
+	
+	/* register new types while the other threads are busy looking types up */
+	for (i = 0; i < NREGISTERED; i++) {
+		g_snprintf (subtype, sizeof (subtype), "x-thread-test-%u", i);
+		g_mime_object_register_type ("application", subtype, GMIME_TYPE_PART);
+	}
+	
+	return NULL;
+}
+
+static void
+test_concurrent_parsing (void)
+{
+	ThreadData data[NTHREADS];
+	GThread *threads[NTHREADS];
+	char *expected[G_N_ELEMENTS (messages)];
+	GMimeObject *object;
+	GThread *registrar;
+	int mismatches = 0;
+	int failures = 0;
+	guint i;
+	
+	testsuite_check ("parsing from %d threads at once", NTHREADS);
+	try {
+		for (i = 0; i < G_N_ELEMENTS (messages); i++) {
+			if (!(expected[i] = summarize (messages[i])))
+				throw (exception_new ("failed to parse message %u", i));
+			
+			v(fprintf (stdout, "%s\n", expected[i]));
+		}
+		
+		registrar = g_thread_new ("register", register_thread, NULL);
+		
+		for (i = 0; i < NTHREADS; i++) {
+			data[i].expected = expected;
+			data[i].id = i;
+			data[i].mismatches = 0;
+			data[i].failures = 0;
+			
+			threads[i] = g_thread_new ("parse", parse_thread, &data[i]);
+		}
+		
+		for (i = 0; i < NTHREADS; i++) {
+			g_thread_join (threads[i]);
+			mismatches += data[i].mismatches;
+			failures += data[i].failures;
+		}
+		
+		g_thread_join (registrar);
+		
+		for (i = 0; i < G_N_ELEMENTS (messages); i++)
+			g_free (expected[i]);
+		
+		if (failures > 0)
+			throw (exception_new ("%d parser failures", failures));
+		
+		if (mismatches > 0)
+			throw (exception_new ("%d results differed from a single-threaded parse", mismatches));
+		
+		object = g_mime_object_new_type (NULL, "application", "x-thread-test-0");
+		if (!GMIME_IS_PART (object) || GMIME_IS_TEXT_PART (object))
+			throw (exception_new ("concurrently registered type was lost"));
+		g_object_unref (object);
+		
+		object = g_mime_object_new_type (NULL, "text", "plain");
+		if (!GMIME_IS_TEXT_PART (object))
+			throw (exception_new ("default type registration was lost"));
+		g_object_unref (object);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("parsing from %d threads at once: %s", NTHREADS, ex->message);
+	} finally;
+}
+
+typedef struct {
+	GMimeStream *stream;
+	guint seed;
+	int mismatches;
+} SliceData;
+
+static char
+slice_byte (guint seed, gint64 offset)
+{
+	return (char) ((seed * 31 + offset * 7) & 0xff);
+}
+
+static gpointer
+read_slice_thread (gpointer user_data)
+{
+	SliceData *data = user_data;
+	gint64 offset = 0;
+	char buf[1000];
+	ssize_t n, i;
+	
+	/* odd-sized reads so the threads keep interleaving */
+	while ((n = g_mime_stream_read (data->stream, buf, sizeof (buf))) > 0) {
+		for (i = 0; i < n; i++) {
+			if (buf[i] != slice_byte (data->seed, offset + i))
+				data->mismatches++;
+		}
+		
+		offset += n;
+	}
+	
+	if (offset != SLICE_SIZE)
+		data->mismatches++;
+	
+	return NULL;
+}
+
+static void
+test_concurrent_substreams (void)
+{
+	SliceData data[NTHREADS];
+	GThread *threads[NTHREADS];
+	GMimeStream *stream;
+	int mismatches = 0;
+	gint64 length, j;
+	char *path, *buf;
+	guint i;
+	int fd;
+	
+	testsuite_check ("reading GMimeStreamFs substreams from %d threads at once", NTHREADS);
+	
+	if ((fd = g_file_open_tmp ("gmime-threads-XXXXXX", &path, NULL)) == -1) {
+		testsuite_check_warn ("could not create a temporary file");
+		return;
+	}
+	
+	stream = g_mime_stream_fs_new (fd);
+	buf = g_malloc (SLICE_SIZE);
+	
+	for (i = 0; i < NTHREADS; i++) {
+		for (j = 0; j < SLICE_SIZE; j++)
+			buf[j] = slice_byte (i, j);
+		
+		g_mime_stream_write (stream, buf, SLICE_SIZE);
+	}
+	
+	length = g_mime_stream_length (stream);
+	g_free (buf);
+	
+	for (i = 0; i < NTHREADS; i++) {
+		data[i].stream = g_mime_stream_substream (stream, (gint64) SLICE_SIZE * i, (gint64) SLICE_SIZE * (i + 1));
+		data[i].seed = i;
+		data[i].mismatches = 0;
+		
+		threads[i] = g_thread_new ("read", read_slice_thread, &data[i]);
+	}
+	
+	for (i = 0; i < NTHREADS; i++) {
+		g_thread_join (threads[i]);
+		mismatches += data[i].mismatches;
+		g_object_unref (data[i].stream);
+	}
+	
+	g_object_unref (stream);
+	unlink (path);
+	g_free (path);
+	
+	try {
+		if (length != (gint64) SLICE_SIZE * NTHREADS)
+			throw (exception_new ("failed to write the test data"));
+		
+		if (mismatches > 0)
+			throw (exception_new ("%d bytes differed from what was written", mismatches));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("reading GMimeStreamFs substreams from %d threads at once: %s", NTHREADS, ex->message);
+	} finally;
+}
+
+int main (int argc, char **argv)
+{
+	g_mime_init ();
+	
+	testsuite_init (argc, argv);
+	
+	testsuite_start ("Concurrent parsing");
+	test_concurrent_parsing ();
+	testsuite_end ();
+	
+	testsuite_start ("Concurrent stream access");
+	test_concurrent_substreams ();
+	testsuite_end ();
+	
+	g_mime_shutdown ();
+	
+	return testsuite_exit ();
+}